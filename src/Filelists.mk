@@ -34,10 +34,13 @@ COREFILES=$(LWIPDIR)/core/init.c \
 	$(LWIPDIR)/core/def.c \
 	$(LWIPDIR)/core/dns.c \
 	$(LWIPDIR)/core/inet_chksum.c \
+	$(LWIPDIR)/core/inet_chksum_simd.c \
 	$(LWIPDIR)/core/ip.c \
 	$(LWIPDIR)/core/mem.c \
 	$(LWIPDIR)/core/memp.c \
 	$(LWIPDIR)/core/netif.c \
+	$(LWIPDIR)/core/netif_gro.c \
+	$(LWIPDIR)/core/netif_gso.c \
 	$(LWIPDIR)/core/pbuf.c \
 	$(LWIPDIR)/core/raw.c \
 	$(LWIPDIR)/core/stats.c \
@@ -47,6 +50,18 @@ COREFILES=$(LWIPDIR)/core/init.c \
 	$(LWIPDIR)/core/tcp.c \
 	$(LWIPDIR)/core/tcp_in.c \
 	$(LWIPDIR)/core/tcp_out.c \
+	$(LWIPDIR)/core/tcp_rack.c \
+	$(LWIPDIR)/core/tcp_cc.c \
+	$(LWIPDIR)/core/tcp_fastopen.c \
+	$(LWIPDIR)/core/tcp_syncookie.c \
+	$(LWIPDIR)/core/tcp_synreq.c \
+	$(LWIPDIR)/core/tcp_tw.c \
+	$(LWIPDIR)/core/tcp_ooseq.c \
+	$(LWIPDIR)/core/tcp_autotune.c \
+	$(LWIPDIR)/core/tcp_sndbuf.c \
+	$(LWIPDIR)/core/tcp_pmtu.c \
+	$(LWIPDIR)/core/tcp_ooseq_mem.c \
+	$(LWIPDIR)/core/tcp_zc.c \
 	$(LWIPDIR)/core/timeouts.c \
 	$(LWIPDIR)/core/udp.c
 
@@ -56,6 +71,7 @@ CORE4FILES=$(LWIPDIR)/core/ipv4/autoip.c \
 	$(LWIPDIR)/core/ipv4/icmp.c \
 	$(LWIPDIR)/core/ipv4/igmp.c \
 	$(LWIPDIR)/core/ipv4/ip4_frag.c \
+	$(LWIPDIR)/core/ipv4/ip4_pmtu.c \
 	$(LWIPDIR)/core/ipv4/ip4.c \
 	$(LWIPDIR)/core/ipv4/ip4_addr.c
 
@@ -887,6 +887,8 @@ netconn_send(struct netconn *conn, struct netbuf *buf)
  * - NETCONN_COPY: data will be copied into memory belonging to the stack
  * - NETCONN_MORE: for TCP connection, PSH flag will be set on last segment sent
  * - NETCONN_DONTBLOCK: only write the data if all data can be written at once
+ * - NETCONN_ZEROCOPY: data is referenced and counted in netconn_get_zc_done()
+ *   when the stack is done with it (LWIP_TCP_ZEROCOPY)
  * @param bytes_written pointer to a location that receives the number of written bytes
  * @return ERR_OK if data was sent, any other err_t on error
  */
@@ -910,6 +912,8 @@ netconn_write_partly(struct netconn *conn, const void *dataptr, size_t size,
  * - NETCONN_COPY: data will be copied into memory belonging to the stack
  * - NETCONN_MORE: for TCP connection, PSH flag will be set on last segment sent
  * - NETCONN_DONTBLOCK: only write the data if all data can be written at once
+ * - NETCONN_ZEROCOPY: data is referenced and counted in netconn_get_zc_done()
+ *   when the stack is done with it (LWIP_TCP_ZEROCOPY)
  * @param bytes_written pointer to a location that receives the number of written bytes
  * @return ERR_OK if data was sent, any other err_t on error
  */
@@ -1085,6 +1089,41 @@ netconn_shutdown(struct netconn *conn, u8_t shut_rx, u8_t shut_tx)
   return netconn_close_shutdown(conn, (u8_t)((shut_rx ? NETCONN_SHUT_RD : 0) | (shut_tx ? NETCONN_SHUT_WR : 0)));
 }
 
+#if LWIP_TCP && LWIP_TCP_INFO
+/**
+ * @ingroup netconn_tcp
+ * Get a snapshot of the state and the counters of a TCP netconn
+ * (see tcp_get_info()).
+ *
+ * @param conn the TCP netconn to query
+ * @param info where to store the snapshot
+ * @return ERR_OK if the information was retrieved,
+ *         ERR_VAL for non-TCP netconns, ERR_CONN if there is no pcb
+ */
+err_t
+netconn_tcp_info(struct netconn *conn, struct tcp_info *info)
+{
+  API_MSG_VAR_DECLARE(msg);
+  err_t err;
+
+  LWIP_ERROR("netconn_tcp_info: invalid conn", (conn != NULL), return ERR_ARG;);
+  LWIP_ERROR("netconn_tcp_info: invalid info", (info != NULL), return ERR_ARG;);
+
+  API_MSG_VAR_ALLOC(msg);
+  API_MSG_VAR_REF(msg).conn = conn;
+#if LWIP_MPU_COMPATIBLE
+  err = netconn_apimsg(lwip_netconn_do_tcp_info, &API_MSG_VAR_REF(msg));
+  *info = msg->msg.ti.info;
+#else /* LWIP_MPU_COMPATIBLE */
+  msg.msg.ti.info = info;
+  err = netconn_apimsg(lwip_netconn_do_tcp_info, &msg);
+#endif /* LWIP_MPU_COMPATIBLE */
+  API_MSG_VAR_FREE(msg);
+
+  return err;
+}
+#endif /* LWIP_TCP && LWIP_TCP_INFO */
+
 #if LWIP_IGMP || (LWIP_IPV6 && LWIP_IPV6_MLD)
 /**
  * @ingroup netconn_udp
@@ -363,13 +363,23 @@ poll_tcp(void *arg, struct tcp_pcb *pcb)
   if (conn->flags & NETCONN_FLAG_CHECK_WRITESPACE) {
     /* If the queued byte- or pbuf-count drops below the configured low-water limit,
        let select mark this pcb as writable again. */
-    if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > TCP_SNDLOWAT) &&
-      (tcp_sndqueuelen(conn->pcb.tcp) < TCP_SNDQUEUELOWAT)) {
+    if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > TCP_SNDLOWAT_PCB(conn->pcb.tcp)) &&
+      (tcp_sndqueuelen(conn->pcb.tcp) < TCP_SNDQUEUELOWAT_PCB(conn->pcb.tcp))) {
       netconn_clear_flags(conn, NETCONN_FLAG_CHECK_WRITESPACE);
       API_EVENT(conn, NETCONN_EVT_SENDPLUS, 0);
     }
   }
 
+#if LWIP_TCP_PCB_TIMERS
+  /* Nothing left to retry: stop polling so an idle pcb does not keep its
+     timer running. Polling is restarted by lwip_netconn_do_write() and when
+     closing fails. */
+  if ((conn->pcb.tcp != NULL) && (conn->state == NETCONN_NONE) &&
+      !(conn->flags & NETCONN_FLAG_CHECK_WRITESPACE)) {
+    tcp_poll(conn->pcb.tcp, NULL, 0);
+  }
+#endif /* LWIP_TCP_PCB_TIMERS */
+
   return ERR_OK;
 }
 
@@ -397,8 +407,8 @@ sent_tcp(void *arg, struct tcp_pcb *pcb, u16_t len)
 
     /* If the queued byte- or pbuf-count drops below the configured low-water limit,
        let select mark this pcb as writable again. */
-    if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > TCP_SNDLOWAT) &&
-      (tcp_sndqueuelen(conn->pcb.tcp) < TCP_SNDQUEUELOWAT)) {
+    if ((conn->pcb.tcp != NULL) && (tcp_sndbuf(conn->pcb.tcp) > TCP_SNDLOWAT_PCB(conn->pcb.tcp)) &&
+      (tcp_sndqueuelen(conn->pcb.tcp) < TCP_SNDQUEUELOWAT_PCB(conn->pcb.tcp))) {
       netconn_clear_flags(conn, NETCONN_FLAG_CHECK_WRITESPACE);
       API_EVENT(conn, NETCONN_EVT_SENDPLUS, len);
     }
@@ -407,6 +417,27 @@ sent_tcp(void *arg, struct tcp_pcb *pcb, u16_t len)
   return ERR_OK;
 }
 
+#if LWIP_TCP_ZEROCOPY
+/**
+ * Zero-copy completion callback function for TCP netconns.
+ * Counts the bytes of NETCONN_ZEROCOPY writes the stack is done with.
+ *
+ * @see tcp.h (struct tcp_pcb.zc_done) for parameters and return value
+ */
+static err_t
+zc_done_tcp(void *arg, struct tcp_pcb *pcb, void *cookie, u16_t len)
+{
+  struct netconn *conn = (struct netconn *)arg;
+
+  LWIP_UNUSED_ARG(cookie);
+  /* pcb == NULL: the pcb has been freed, the netconn may be gone, too */
+  if ((conn != NULL) && (pcb != NULL)) {
+    conn->zc_done += len;
+  }
+  return ERR_OK;
+}
+#endif /* LWIP_TCP_ZEROCOPY */
+
 /**
  * Error callback function for TCP netconns.
  * Signals conn->sem, posts to all conn mboxes and calls API_EVENT.
@@ -505,7 +536,13 @@ setup_tcp(struct netconn *conn)
   tcp_arg(pcb, conn);
   tcp_recv(pcb, recv_tcp);
   tcp_sent(pcb, sent_tcp);
+#if LWIP_TCP_ZEROCOPY
+  tcp_zc_done(pcb, zc_done_tcp);
+#endif /* LWIP_TCP_ZEROCOPY */
+#if !LWIP_TCP_PCB_TIMERS
+  /* with per-pcb timers, polling is only enabled while writing or closing */
   tcp_poll(pcb, poll_tcp, NETCONN_TCP_POLL_INTERVAL);
+#endif /* !LWIP_TCP_PCB_TIMERS */
   tcp_err(pcb, err_tcp);
 }
 
@@ -750,6 +787,9 @@ netconn_alloc(enum netconn_type t, netconn_callback callback)
 #if LWIP_TCP
   conn->current_msg  = NULL;
 #endif /* LWIP_TCP */
+#if LWIP_TCP && LWIP_TCP_ZEROCOPY
+  conn->zc_done      = 0;
+#endif /* LWIP_TCP && LWIP_TCP_ZEROCOPY */
 #if LWIP_SO_SNDTIMEO
   conn->send_timeout = 0;
 #endif /* LWIP_SO_SNDTIMEO */
@@ -1325,6 +1365,21 @@ lwip_netconn_do_connect(void *m)
         err = ERR_ISCONN;
       } else {
         setup_tcp(msg->conn);
+#if LWIP_TCP_FASTOPEN
+        if (netconn_get_fastopen(msg->conn)) {
+          /* Don't wait for the connection to be established: data written
+             until the SYN is sent goes with it (if a cookie is cached) */
+          tcp_fastopen_enable(msg->conn->pcb.tcp);
+          err = tcp_connect(msg->conn->pcb.tcp, API_EXPR_REF(msg->msg.bc.ipaddr),
+            msg->msg.bc.port, NULL);
+          if (err == ERR_OK) {
+            /* the pcb takes data now: tell select() it is writable (as
+               lwip_netconn_do_connected() does for a normal connect) */
+            API_EVENT(msg->conn, NETCONN_EVT_SENDPLUS, 0);
+          }
+          break;
+        }
+#endif /* LWIP_TCP_FASTOPEN */
         err = tcp_connect(msg->conn->pcb.tcp, API_EXPR_REF(msg->msg.bc.ipaddr),
           msg->msg.bc.port, lwip_netconn_do_connected);
         if (err == ERR_OK) {
@@ -1423,6 +1478,11 @@ lwip_netconn_do_listen(void *m)
             IP_SET_TYPE_VAL(msg->conn->pcb.tcp->remote_ip, IPADDR_TYPE_ANY);
           }
 #endif /* LWIP_IPV4 && LWIP_IPV6 */
+#if LWIP_TCP_FASTOPEN
+          if (netconn_get_fastopen(msg->conn)) {
+            tcp_fastopen_enable(msg->conn->pcb.tcp);
+          }
+#endif /* LWIP_TCP_FASTOPEN */
 
           lpcb = tcp_listen_with_backlog_and_err(msg->conn->pcb.tcp, backlog, &err);
 
@@ -1657,7 +1717,14 @@ lwip_netconn_do_writemore(struct netconn *conn  WRITE_DELAYED_PARAM)
       } else {
         write_more = 0;
       }
-      err = tcp_write(conn->pcb.tcp, dataptr, len, apiflags);
+#if LWIP_TCP_ZEROCOPY
+      if ((apiflags & NETCONN_ZEROCOPY) && (len > 0)) {
+        err = tcp_write_ref(conn->pcb.tcp, dataptr, len, apiflags, NULL);
+      } else
+#endif /* LWIP_TCP_ZEROCOPY */
+      {
+        err = tcp_write(conn->pcb.tcp, dataptr, len, apiflags);
+      }
       if (err == ERR_OK) {
         conn->current_msg->msg.w.offset += len;
         conn->current_msg->msg.w.vector_off += len;
@@ -1680,8 +1747,8 @@ err_mem:
            and let poll_tcp check writable space to mark the pcb writable again */
         API_EVENT(conn, NETCONN_EVT_SENDMINUS, 0);
         conn->flags |= NETCONN_FLAG_CHECK_WRITESPACE;
-      } else if ((tcp_sndbuf(conn->pcb.tcp) <= TCP_SNDLOWAT) ||
-                 (tcp_sndqueuelen(conn->pcb.tcp) >= TCP_SNDQUEUELOWAT)) {
+      } else if ((tcp_sndbuf(conn->pcb.tcp) <= TCP_SNDLOWAT_PCB(conn->pcb.tcp)) ||
+                 (tcp_sndqueuelen(conn->pcb.tcp) >= TCP_SNDQUEUELOWAT_PCB(conn->pcb.tcp))) {
         /* The queued byte- or pbuf-count exceeds the configured low-water limit,
            let select mark this pcb as non-writable. */
         API_EVENT(conn, NETCONN_EVT_SENDMINUS, 0);
@@ -1775,6 +1842,9 @@ lwip_netconn_do_write(void *m)
         LWIP_ASSERT("already writing or closing", msg->conn->current_msg == NULL);
         LWIP_ASSERT("msg->msg.w.len != 0", msg->msg.w.len != 0);
         msg->conn->current_msg = msg;
+#if LWIP_TCP_PCB_TIMERS
+        tcp_poll(msg->conn->pcb.tcp, poll_tcp, NETCONN_TCP_POLL_INTERVAL);
+#endif /* LWIP_TCP_PCB_TIMERS */
 #if LWIP_TCPIP_CORE_LOCKING
         if (lwip_netconn_do_writemore(msg->conn, 0) != ERR_OK) {
           LWIP_ASSERT("state!", msg->conn->state == NETCONN_WRITE);
@@ -1947,6 +2017,29 @@ lwip_netconn_do_close(void *m)
   TCPIP_APIMSG_ACK(msg);
 }
 
+#if LWIP_TCP && LWIP_TCP_INFO
+/**
+ * Get a snapshot of the state of a TCP netconn
+ * Called from netconn_tcp_info
+ *
+ * @param m the api_msg pointing to the connection
+ */
+void
+lwip_netconn_do_tcp_info(void *m)
+{
+  struct api_msg *msg = (struct api_msg*)m;
+
+  if (NETCONNTYPE_GROUP(msg->conn->type) != NETCONN_TCP) {
+    msg->err = ERR_VAL;
+  } else if (msg->conn->pcb.tcp == NULL) {
+    msg->err = ERR_CONN;
+  } else {
+    msg->err = tcp_get_info(msg->conn->pcb.tcp, &API_EXPR_DEREF(msg->msg.ti.info));
+  }
+  TCPIP_APIMSG_ACK(msg);
+}
+#endif /* LWIP_TCP && LWIP_TCP_INFO */
+
 #if LWIP_IGMP || (LWIP_IPV6 && LWIP_IPV6_MLD)
 /**
  * Join multicast groups for UDP netconns.
@@ -151,6 +151,21 @@ static void sockaddr_to_ipaddr_port(const struct sockaddr* sockaddr, ip_addr_t*
                                                     SOCK_ADDR_TYPE_MATCH(name, sock))
 #define IS_SOCK_ADDR_ALIGNED(name)      ((((mem_ptr_t)(name)) % 4) == 0)
 
+/* send flags lwip_sendmsg() supports in addition to MSG_DONTWAIT and MSG_MORE */
+#if LWIP_TCP && LWIP_TCP_FASTOPEN
+#define LWIP_SENDMSG_FASTOPEN MSG_FASTOPEN
+#else /* LWIP_TCP && LWIP_TCP_FASTOPEN */
+#define LWIP_SENDMSG_FASTOPEN 0
+#endif /* LWIP_TCP && LWIP_TCP_FASTOPEN */
+#if LWIP_TCP && LWIP_TCP_ZEROCOPY
+#define LWIP_SENDMSG_ZEROCOPY MSG_ZEROCOPY
+/* MSG_ZEROCOPY references the application's data instead of copying it */
+#define LWIP_SEND_COPY_FLAGS(flags) (((flags) & MSG_ZEROCOPY) ? NETCONN_ZEROCOPY : NETCONN_COPY)
+#else /* LWIP_TCP && LWIP_TCP_ZEROCOPY */
+#define LWIP_SENDMSG_ZEROCOPY 0
+#define LWIP_SEND_COPY_FLAGS(flags) NETCONN_COPY
+#endif /* LWIP_TCP && LWIP_TCP_ZEROCOPY */
+
 
 #define LWIP_SOCKOPT_CHECK_OPTLEN(sock, optlen, opttype) do { if ((optlen) < sizeof(opttype)) { done_socket(sock); return EINVAL; }}while(0)
 #define LWIP_SOCKOPT_CHECK_OPTLEN_CONN(sock, optlen, opttype) do { \
@@ -1310,7 +1325,7 @@ lwip_send(int s, const void *data, size_t size, int flags)
 #endif /* (LWIP_UDP || LWIP_RAW) */
   }
 
-  write_flags = (u8_t)(NETCONN_COPY |
+  write_flags = (u8_t)(LWIP_SEND_COPY_FLAGS(flags) |
     ((flags & MSG_MORE)     ? NETCONN_MORE      : 0) |
     ((flags & MSG_DONTWAIT) ? NETCONN_DONTBLOCK : 0));
   written = 0;
@@ -1344,7 +1359,7 @@ lwip_sendmsg(int s, const struct msghdr *msg, int flags)
              sock_set_errno(sock, err_to_errno(ERR_ARG)); done_socket(sock); return -1;);
   LWIP_ERROR("lwip_sendmsg: maximum iovs exceeded", (msg->msg_iovlen > 0) && (msg->msg_iovlen <= IOV_MAX),
              sock_set_errno(sock, EMSGSIZE); done_socket(sock); return -1;);
-  LWIP_ERROR("lwip_sendmsg: unsupported flags", (flags & ~(MSG_DONTWAIT|MSG_MORE)) == 0,
+  LWIP_ERROR("lwip_sendmsg: unsupported flags", (flags & ~(MSG_DONTWAIT|MSG_MORE|LWIP_SENDMSG_FASTOPEN|LWIP_SENDMSG_ZEROCOPY)) == 0,
              sock_set_errno(sock, EOPNOTSUPP); done_socket(sock); return -1;);
 
   LWIP_UNUSED_ARG(msg->msg_control);
@@ -1353,7 +1368,17 @@ lwip_sendmsg(int s, const struct msghdr *msg, int flags)
 
   if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) {
 #if LWIP_TCP
-    write_flags = (u8_t)(NETCONN_COPY |
+#if LWIP_TCP_FASTOPEN
+    if ((flags & MSG_FASTOPEN) && (msg->msg_name != NULL)) {
+      /* connect with TCP Fast Open, see lwip_sendto() */
+      netconn_set_fastopen(sock->conn, 1);
+      if (lwip_connect(s, (const struct sockaddr *)msg->msg_name, msg->msg_namelen) < 0) {
+        done_socket(sock);
+        return -1;
+      }
+    }
+#endif /* LWIP_TCP_FASTOPEN */
+    write_flags = (u8_t)(LWIP_SEND_COPY_FLAGS(flags) |
     ((flags & MSG_MORE)     ? NETCONN_MORE      : 0) |
     ((flags & MSG_DONTWAIT) ? NETCONN_DONTBLOCK : 0));
 
@@ -1406,15 +1431,21 @@ lwip_sendmsg(int s, const struct msghdr *msg, int flags)
     } else {
       /* flatten the IO vectors */
       size_t offset = 0;
+#if LWIP_CHECKSUM_ON_COPY
+      /* copy and checksum each IO vector in one pass, aggregating the checksum */
+      u16_t chksum = 0;
       for (i = 0; i < msg->msg_iovlen; i++) {
-        MEMCPY(&((u8_t*)chain_buf.p->payload)[offset], msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+        if (msg->msg_iov[i].iov_len > 0) {
+          pbuf_fill_chksum(chain_buf.p, (u16_t)offset, msg->msg_iov[i].iov_base,
+                           (u16_t)msg->msg_iov[i].iov_len, &chksum);
+        }
         offset += msg->msg_iov[i].iov_len;
       }
-#if LWIP_CHECKSUM_ON_COPY
-      {
-        /* This can be improved by using LWIP_CHKSUM_COPY() and aggregating the checksum for each IO vector */
-        u16_t chksum = ~inet_chksum_pbuf(chain_buf.p);
-        netbuf_set_chksum(&chain_buf, chksum);
+      netbuf_set_chksum(&chain_buf, chksum);
+#else /* LWIP_CHECKSUM_ON_COPY */
+      for (i = 0; i < msg->msg_iovlen; i++) {
+        MEMCPY(&((u8_t*)chain_buf.p->payload)[offset], msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+        offset += msg->msg_iov[i].iov_len;
       }
 #endif /* LWIP_CHECKSUM_ON_COPY */
       err = ERR_OK;
@@ -1503,6 +1534,18 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
 
   if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) {
 #if LWIP_TCP
+#if LWIP_TCP_FASTOPEN
+    if ((flags & MSG_FASTOPEN) && (to != NULL)) {
+      /* Connect without waiting for the handshake: the data is sent with
+         the SYN if a cookie for this server is cached */
+      netconn_set_fastopen(sock->conn, 1);
+      done_socket(sock);
+      if (lwip_connect(s, to, tolen) < 0) {
+        return -1;
+      }
+      return lwip_send(s, data, size, flags);
+    }
+#endif /* LWIP_TCP_FASTOPEN */
     done_socket(sock);
     return lwip_send(s, data, size, flags);
 #else /* LWIP_TCP */
@@ -2516,12 +2559,29 @@ lwip_getsockopt_impl(int s, int level, int optname, void *optval, socklen_t *opt
       LWIP_SO_SNDRCVTIMEO_SET(optval, netconn_get_recvtimeout(sock->conn));
       break;
 #endif /* LWIP_SO_RCVTIMEO */
-#if LWIP_SO_RCVBUF
+#if LWIP_SO_RCVBUF || (LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE)
     case SO_RCVBUF:
       LWIP_SOCKOPT_CHECK_OPTLEN_CONN(sock, *optlen, int);
+#if LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE
+      if ((NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) &&
+          (sock->conn->pcb.tcp != NULL)) {
+        *(int *)optval = (int)LWIP_MIN(tcp_get_rcvbuf(sock->conn->pcb.tcp), INT_MAX);
+        break;
+      }
+#endif /* LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE */
+#if LWIP_SO_RCVBUF
       *(int *)optval = netconn_get_recvbufsize(sock->conn);
-      break;
+#else /* LWIP_SO_RCVBUF */
+      err = ENOPROTOOPT;
 #endif /* LWIP_SO_RCVBUF */
+      break;
+#endif /* LWIP_SO_RCVBUF || (LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE) */
+#if LWIP_TCP && LWIP_TCP_SNDBUF_PCB
+    case SO_SNDBUF:
+      LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, *optlen, int, NETCONN_TCP);
+      *(int *)optval = (int)LWIP_MIN(tcp_get_sndbuf(sock->conn->pcb.tcp), INT_MAX);
+      break;
+#endif /* LWIP_TCP && LWIP_TCP_SNDBUF_PCB */
 #if LWIP_SO_LINGER
     case SO_LINGER:
       {
@@ -2552,6 +2612,12 @@ lwip_getsockopt_impl(int s, int level, int optname, void *optval, socklen_t *opt
       *(int*)optval = (udp_flags(sock->conn->pcb.udp) & UDP_FLAGS_NOCHKSUM) ? 1 : 0;
       break;
 #endif /* LWIP_UDP*/
+#if LWIP_TCP && LWIP_TCP_PACING
+    case SO_MAX_PACING_RATE:
+      LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, *optlen, u32_t, NETCONN_TCP);
+      *(u32_t*)optval = tcp_get_max_pacing_rate(sock->conn->pcb.tcp);
+      break;
+#endif /* LWIP_TCP && LWIP_TCP_PACING */
     default:
       LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_getsockopt(%d, SOL_SOCKET, UNIMPL: optname=0x%x, ..)\n",
                   s, optname));
@@ -2618,8 +2684,51 @@ lwip_getsockopt_impl(int s, int level, int optname, void *optval, socklen_t *opt
 #if LWIP_TCP
 /* Level: IPPROTO_TCP */
   case IPPROTO_TCP:
-    /* Special case: all IPPROTO_TCP option take an int */
+    if (optname == TCP_CONGESTION) {
+      /* the only IPPROTO_TCP option taking a string */
+      const char *name;
+      size_t len;
+      LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, *optlen, char, NETCONN_TCP);
+      name = tcp_get_congestion(sock->conn->pcb.tcp);
+      len = LWIP_MIN(strlen(name) + 1, (size_t)*optlen);
+      MEMCPY(optval, name, len);
+      *optlen = (socklen_t)len;
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_getsockopt(%d, IPPROTO_TCP, TCP_CONGESTION) = %s\n",
+                  s, name));
+      break;
+    }
+#if LWIP_TCP_INFO
+    if (optname == TCP_INFO) {
+      /* valid for listening sockets, too (only the state is set) */
+      LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, *optlen, struct tcp_info, NETCONN_TCP);
+      tcp_get_info(sock->conn->pcb.tcp, (struct tcp_info *)optval);
+      *optlen = sizeof(struct tcp_info);
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_getsockopt(%d, IPPROTO_TCP, TCP_INFO) = state %d\n",
+                  s, ((struct tcp_info *)optval)->state));
+      break;
+    }
+#endif /* LWIP_TCP_INFO */
+#if LWIP_TCP_ZEROCOPY
+    if (optname == TCP_ZEROCOPY_DONE) {
+      LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, *optlen, u32_t, NETCONN_TCP);
+      *(u32_t*)optval = netconn_get_zc_done(sock->conn);
+      *optlen = sizeof(u32_t);
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_getsockopt(%d, IPPROTO_TCP, TCP_ZEROCOPY_DONE) = %"U32_F"\n",
+                  s, *(u32_t*)optval));
+      break;
+    }
+#endif /* LWIP_TCP_ZEROCOPY */
+    /* Special case: all other IPPROTO_TCP options take an int */
     LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, *optlen, int, NETCONN_TCP);
+#if LWIP_TCP_FASTOPEN
+    if (optname == TCP_FASTOPEN) {
+      /* valid for listening sockets, too */
+      *(int*)optval = tcp_fastopen_enabled(sock->conn->pcb.tcp);
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_getsockopt(%d, IPPROTO_TCP, TCP_FASTOPEN) = %s\n",
+                  s, (*(int*)optval)?"on":"off") );
+      break;
+    }
+#endif /* LWIP_TCP_FASTOPEN */
     if (sock->conn->pcb.tcp->state == LISTEN) {
       done_socket(sock);
       return EINVAL;
@@ -2875,6 +2984,12 @@ lwip_setsockopt_impl(int s, int level, int optname, const void *optval, socklen_
       } else {
         ip_reset_option(sock->conn->pcb.ip, optname);
       }
+#if LWIP_TCP && LWIP_TCP_PCB_TIMERS
+      if ((optname == SO_KEEPALIVE) &&
+          (NETCONNTYPE_GROUP(sock->conn->type) == NETCONN_TCP)) {
+        tcp_timer_update(sock->conn->pcb.tcp);
+      }
+#endif /* LWIP_TCP && LWIP_TCP_PCB_TIMERS */
       LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_setsockopt(%d, SOL_SOCKET, optname=0x%x, ..) -> %s\n",
                   s, optname, (*(const int*)optval?"on":"off")));
       break;
@@ -2910,12 +3025,40 @@ lwip_setsockopt_impl(int s, int level, int optname, const void *optval, socklen_
         break;
       }
 #endif /* LWIP_SO_RCVTIMEO */
-#if LWIP_SO_RCVBUF
+#if LWIP_SO_RCVBUF || (LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE)
     case SO_RCVBUF:
       LWIP_SOCKOPT_CHECK_OPTLEN_CONN(sock, optlen, int);
+#if LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE
+      if ((NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) &&
+          (sock->conn->pcb.tcp != NULL)) {
+        if (*(const int*)optval < 0) {
+          done_socket(sock);
+          return EINVAL;
+        }
+        /* limits the window the connection may auto-tune to */
+        tcp_set_rcvbuf(sock->conn->pcb.tcp, (u32_t)*(const int*)optval);
+      }
+#endif /* LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE */
+#if LWIP_SO_RCVBUF
       netconn_set_recvbufsize(sock->conn, *(const int*)optval);
-      break;
+#else /* LWIP_SO_RCVBUF */
+      if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) != NETCONN_TCP) {
+        done_socket(sock);
+        return ENOPROTOOPT;
+      }
 #endif /* LWIP_SO_RCVBUF */
+      break;
+#endif /* LWIP_SO_RCVBUF || (LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE) */
+#if LWIP_TCP && LWIP_TCP_SNDBUF_PCB
+    case SO_SNDBUF:
+      LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, optlen, int, NETCONN_TCP);
+      if (*(const int*)optval < 0) {
+        done_socket(sock);
+        return EINVAL;
+      }
+      tcp_set_sndbuf(sock->conn->pcb.tcp, (u32_t)*(const int*)optval);
+      break;
+#endif /* LWIP_TCP && LWIP_TCP_SNDBUF_PCB */
 #if LWIP_SO_LINGER
     case SO_LINGER:
       {
@@ -2954,6 +3097,18 @@ lwip_setsockopt_impl(int s, int level, int optname, const void *optval, socklen_
       }
       break;
 #endif /* LWIP_UDP */
+#if LWIP_TCP && LWIP_TCP_PACING
+    case SO_MAX_PACING_RATE:
+      LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, optlen, u32_t, NETCONN_TCP);
+      if (sock->conn->pcb.tcp->state == LISTEN) {
+        done_socket(sock);
+        return EINVAL;
+      }
+      tcp_set_max_pacing_rate(sock->conn->pcb.tcp, *(const u32_t*)optval);
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_setsockopt(%d, SOL_SOCKET, SO_MAX_PACING_RATE) -> %"U32_F"\n",
+                  s, *(const u32_t*)optval));
+      break;
+#endif /* LWIP_TCP && LWIP_TCP_PACING */
     case SO_BINDTODEVICE:
       {
         const struct ifreq *iface;
@@ -3090,8 +3245,39 @@ lwip_setsockopt_impl(int s, int level, int optname, const void *optval, socklen_
 #if LWIP_TCP
 /* Level: IPPROTO_TCP */
   case IPPROTO_TCP:
-    /* Special case: all IPPROTO_TCP option take an int */
+    if (optname == TCP_CONGESTION) {
+      /* the only IPPROTO_TCP option taking a string (not necessarily terminated) */
+      char name[16];
+      size_t len;
+      LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, optlen, char, NETCONN_TCP);
+      len = LWIP_MIN((size_t)optlen, sizeof(name) - 1);
+      MEMCPY(name, optval, len);
+      name[len] = 0;
+      if (tcp_set_congestion(sock->conn->pcb.tcp, name) != ERR_OK) {
+        err = ENOENT;
+      }
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_setsockopt(%d, IPPROTO_TCP, TCP_CONGESTION) -> %s\n",
+                  s, name));
+      break;
+    }
+    /* Special case: all other IPPROTO_TCP options take an int */
     LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB_TYPE(sock, optlen, int, NETCONN_TCP);
+#if LWIP_TCP_FASTOPEN
+    if (optname == TCP_FASTOPEN) {
+      /* valid for listening sockets, too (which aren't affected by the
+         netconn flag any more) */
+      if (*(const int*)optval) {
+        netconn_set_fastopen(sock->conn, 1);
+        tcp_fastopen_enable(sock->conn->pcb.tcp);
+      } else {
+        netconn_set_fastopen(sock->conn, 0);
+        tcp_fastopen_disable(sock->conn->pcb.tcp);
+      }
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_setsockopt(%d, IPPROTO_TCP, TCP_FASTOPEN) -> %s\n",
+                  s, (*(const int *)optval)?"on":"off") );
+      break;
+    }
+#endif /* LWIP_TCP_FASTOPEN */
     if (sock->conn->pcb.tcp->state == LISTEN) {
       done_socket(sock);
       return EINVAL;
@@ -3135,6 +3321,10 @@ lwip_setsockopt_impl(int s, int level, int optname, const void *optval, socklen_
       err = ENOPROTOOPT;
       break;
     }  /* switch (optname) */
+#if LWIP_TCP_PCB_TIMERS
+    /* keepalive settings may have moved the pcb's next deadline */
+    tcp_timer_update(sock->conn->pcb.tcp);
+#endif /* LWIP_TCP_PCB_TIMERS */
     break;
 #endif /* LWIP_TCP*/
 
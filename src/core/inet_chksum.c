@@ -54,11 +54,18 @@
 #include <string.h>
 
 #ifndef LWIP_CHKSUM
-# define LWIP_CHKSUM lwip_standard_chksum
+# if LWIP_CHKSUM_SIMD
+/* vectorized kernels, lwip_standard_chksum() as fallback */
+#  define LWIP_CHKSUM lwip_chksum_simd
+# else /* LWIP_CHKSUM_SIMD */
+#  define LWIP_CHKSUM lwip_standard_chksum
+# endif /* LWIP_CHKSUM_SIMD */
 # ifndef LWIP_CHKSUM_ALGORITHM
 #  define LWIP_CHKSUM_ALGORITHM 2
 # endif
+# if !LWIP_CHKSUM_SIMD
 u16_t lwip_standard_chksum(const void *dataptr, int len);
+# endif /* !LWIP_CHKSUM_SIMD */
 #endif
 /* If none set: */
 #ifndef LWIP_CHKSUM_ALGORITHM
@@ -541,6 +548,33 @@ ip_chksum_pseudo_partial(struct pbuf *p, u8_t proto, u16_t proto_len,
 #endif /* LWIP_IPV4 */
 }
 
+#if LWIP_CHECKSUM_OFFLOAD
+/**
+ * Complete the TCP/UDP checksum of an outgoing packet that was left to the
+ * netif (p->chksum_offset != 0) in software, e.g. before it is fragmented.
+ *
+ * @param p the packet, p->payload points to the IP header
+ */
+void
+ip_chksum_complete(struct pbuf *p)
+{
+  u16_t chksum;
+
+  LWIP_ASSERT("TCP/UDP header must be in the first pbuf",
+              p->len >= p->chksum_start + p->chksum_offset + sizeof(chksum));
+  pbuf_remove_header(p, p->chksum_start);
+  /* the checksum field holds the pseudo header checksum */
+  chksum = inet_chksum_pbuf(p);
+  if (chksum == 0x0000) {
+    /* the same in one's complement, and required by UDP */
+    chksum = 0xffff;
+  }
+  SMEMCPY((u8_t *)p->payload + p->chksum_offset, &chksum, sizeof(chksum));
+  pbuf_add_header(p, p->chksum_start);
+  p->chksum_offset = 0;
+}
+#endif /* LWIP_CHECKSUM_OFFLOAD */
+
 /* inet_chksum:
  *
  * Calculates the Internet checksum over a portion of memory. Used primarily for IP
@@ -592,6 +626,10 @@ inet_chksum_pbuf(struct pbuf *p)
  * performance-sensitive function, you might want to create your own version
  * in assembly targeted at your hardware by defining it in lwipopts.h:
  *   #define LWIP_CHKSUM_COPY(dst, src, len) your_chksum_copy(dst, src, len)
+ * Version #1 is the default, select another one with
+ *   #define LWIP_CHKSUM_COPY_ALGORITHM 2
+ * With LWIP_CHKSUM_SIMD, LWIP_CHKSUM_COPY is lwip_chksum_copy_simd(), which
+ * uses the version selected here when no vector unit is available.
  */
 
 #if (LWIP_CHKSUM_COPY_ALGORITHM == 1) /* Version #1 */
@@ -606,3 +644,64 @@ lwip_chksum_copy(void *dst, const void *src, u16_t len)
   return LWIP_CHKSUM(dst, len);
 }
 #endif /* (LWIP_CHKSUM_COPY_ALGORITHM == 1) */
+
+#if (LWIP_CHKSUM_COPY_ALGORITHM == 2) /* Version #2 */
+/** Single pass: every word is summed up while it is copied, so the data is
+ * only read once. 32-bit words are used if both buffers are 32-bit aligned
+ * (with the carry added back in on the fly), 16-bit words otherwise.
+ * If either buffer is not 16-bit aligned, this falls back to version #1.
+ */
+u16_t
+lwip_chksum_copy(void *dst, const void *src, u16_t len)
+{
+  const u8_t *ps = (const u8_t *)src;
+  u8_t *pd = (u8_t *)dst;
+  u32_t sum = 0;
+  u32_t w;
+  u16_t t;
+
+  if ((((mem_ptr_t)ps | (mem_ptr_t)pd) & 1) != 0) {
+    MEMCPY(dst, src, len);
+    return LWIP_CHKSUM(dst, len);
+  }
+
+  if ((((mem_ptr_t)ps | (mem_ptr_t)pd) & 3) == 0) {
+    while (len > 3) {
+      w = *(const u32_t *)(const void *)ps;
+      *(u32_t *)(void *)pd = w;
+      sum += w;
+      if (sum < w) {
+        /* end around carry */
+        sum++;
+      }
+      ps += 4;
+      pd += 4;
+      len -= 4;
+    }
+    /* at most 0x1fffe now, so the 16-bit words below can't overflow it */
+    sum = FOLD_U32T(sum);
+  }
+
+  while (len > 1) {
+    t = *(const u16_t *)(const void *)ps;
+    *(u16_t *)(void *)pd = t;
+    sum += t;
+    ps += 2;
+    pd += 2;
+    len -= 2;
+  }
+
+  /* Consume left-over byte, if any */
+  if (len > 0) {
+    t = 0;
+    ((u8_t *)&t)[0] = *ps;
+    *pd = *ps;
+    sum += t;
+  }
+
+  /* Add end bytes */
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+  return (u16_t)sum;
+}
+#endif /* (LWIP_CHKSUM_COPY_ALGORITHM == 2) */
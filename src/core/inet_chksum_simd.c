@@ -0,0 +1,457 @@
+/**
+ * @file
+ * Vectorized Internet checksum kernels (LWIP_CHKSUM_SIMD)
+ *
+ * SSE2 and AVX2 kernels for x86, NEON for ARM (little endian), with the
+ * scalar lwip_standard_chksum() as fallback. The kernel is selected by
+ * lwip_chksum_simd_init() (called from lwip_init()) according to the
+ * features of the CPU the stack runs on; kernels the compiler can't build
+ * are left out. Intrinsics and CPU feature detection are used as provided
+ * by GCC and clang.
+ *
+ * All kernels return the same value as lwip_standard_chksum(): the 16-bit
+ * words of the buffer (in memory order, starting at any address) summed up
+ * in one's complement, not inverted. With LWIP_CHECKSUM_ON_COPY, the same
+ * kernels also copy the data while summing it up (lwip_chksum_copy_simd()),
+ * so it is read only once.
+ */
+
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_CHKSUM_SIMD /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/inet_chksum.h"
+#include "lwip/def.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define CHKSUM_SIMD_SSE2 1
+#include <emmintrin.h>
+#if (defined(__clang__) || (__GNUC__ >= 5))
+/* AVX2 code is compiled with a target attribute, used if the CPU has it */
+#define CHKSUM_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+#if defined(__ARM_NEON) && (BYTE_ORDER == LITTLE_ENDIAN)
+#define CHKSUM_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifndef CHKSUM_SIMD_SSE2
+#define CHKSUM_SIMD_SSE2 0
+#endif
+#ifndef CHKSUM_SIMD_AVX2
+#define CHKSUM_SIMD_AVX2 0
+#endif
+#ifndef CHKSUM_SIMD_NEON
+#define CHKSUM_SIMD_NEON 0
+#endif
+
+/** 16-byte vectors added up into 32-bit lanes before these are folded into
+ * the sum: a lane takes at most 2 * 0xffff per vector (with the accumulators
+ * of a kernel combined), so they can't overflow */
+#define CHKSUM_SIMD_BLOCK 4096
+
+#if LWIP_CHECKSUM_ON_COPY
+#if LWIP_CHKSUM_COPY_ALGORITHM
+#define chksum_simd_copy_scalar lwip_chksum_copy
+#else /* LWIP_CHKSUM_COPY_ALGORITHM */
+/** Scalar fallback of lwip_chksum_copy_simd() */
+static u16_t
+chksum_simd_copy_scalar(void *dst, const void *src, u16_t len)
+{
+  MEMCPY(dst, src, len);
+  return lwip_standard_chksum(dst, len);
+}
+#endif /* LWIP_CHKSUM_COPY_ALGORITHM */
+#endif /* LWIP_CHECKSUM_ON_COPY */
+
+/** The kernels used by lwip_chksum_simd() and lwip_chksum_copy_simd() */
+static u16_t (*chksum_simd_fn)(const void *dataptr, int len) = lwip_standard_chksum;
+#if LWIP_CHECKSUM_ON_COPY
+static u16_t (*chksum_simd_copy_fn)(void *dst, const void *src, u16_t len) = chksum_simd_copy_scalar;
+#endif /* LWIP_CHECKSUM_ON_COPY */
+static u8_t chksum_simd_kernel = LWIP_CHKSUM_KERNEL_SCALAR;
+
+#if CHKSUM_SIMD_SSE2 || CHKSUM_SIMD_AVX2 || CHKSUM_SIMD_NEON
+/** Add the 32-bit lanes of a vector accumulator to 'sum' */
+static u32_t
+chksum_simd_add_lanes(u32_t sum, const u32_t *lanes, int num)
+{
+  int i;
+  for (i = 0; i < num; i++) {
+    sum += FOLD_U32T(lanes[i]);
+    sum = FOLD_U32T(sum);
+  }
+  return sum;
+}
+
+/** Add the bytes left over by a kernel to 'sum' (copying them to 'pd'
+ * unless it is NULL) and fold it to 16 bits */
+static u16_t
+chksum_simd_finish(u32_t sum, u8_t *pd, const u8_t *pb, int len)
+{
+  u16_t w;
+
+  while (len > 1) {
+    SMEMCPY(&w, pb, sizeof(w));
+    if (pd != NULL) {
+      SMEMCPY(pd, &w, sizeof(w));
+      pd += 2;
+    }
+    sum += w;
+    pb += 2;
+    len -= 2;
+  }
+  if (len > 0) {
+    /* the odd byte is the first one of a word */
+    w = 0;
+    ((u8_t *)&w)[0] = *pb;
+    if (pd != NULL) {
+      *pd = *pb;
+    }
+    sum += w;
+  }
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+  return (u16_t)sum;
+}
+#endif /* CHKSUM_SIMD_SSE2 || CHKSUM_SIMD_AVX2 || CHKSUM_SIMD_NEON */
+
+#if CHKSUM_SIMD_SSE2
+/** SSE2 kernel: 16-bit words are widened to 32-bit lanes and added up,
+ * 32 bytes per iteration (unaligned loads, so any start address works).
+ * The data is copied to 'dst' on the way unless it is NULL. */
+static u16_t
+chksum_simd_sse2_copy(void *dst, const void *src, int len)
+{
+  const u8_t *pb = (const u8_t *)src;
+  u8_t *pd = (u8_t *)dst;
+  const __m128i zero = _mm_setzero_si128();
+  u32_t lanes[4];
+  u32_t sum = 0;
+
+  while (len >= 32) {
+    __m128i acc0 = zero, acc1 = zero;
+    int n = LWIP_MIN(len / 32, CHKSUM_SIMD_BLOCK / 2);
+    len -= n * 32;
+    while (n-- > 0) {
+      __m128i v0 = _mm_loadu_si128((const __m128i *)(const void *)pb);
+      __m128i v1 = _mm_loadu_si128((const __m128i *)(const void *)(pb + 16));
+      if (pd != NULL) {
+        _mm_storeu_si128((__m128i *)(void *)pd, v0);
+        _mm_storeu_si128((__m128i *)(void *)(pd + 16), v1);
+        pd += 32;
+      }
+      acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(v0, zero));
+      acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(v0, zero));
+      acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(v1, zero));
+      acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(v1, zero));
+      pb += 32;
+    }
+    _mm_storeu_si128((__m128i *)(void *)lanes, _mm_add_epi32(acc0, acc1));
+    sum = chksum_simd_add_lanes(sum, lanes, 4);
+  }
+  if (len >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(const void *)pb);
+    if (pd != NULL) {
+      _mm_storeu_si128((__m128i *)(void *)pd, v);
+      pd += 16;
+    }
+    v = _mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero));
+    _mm_storeu_si128((__m128i *)(void *)lanes, v);
+    sum = chksum_simd_add_lanes(sum, lanes, 4);
+    pb += 16;
+    len -= 16;
+  }
+  return chksum_simd_finish(sum, pd, pb, len);
+}
+
+static u16_t
+chksum_simd_sse2(const void *dataptr, int len)
+{
+  return chksum_simd_sse2_copy(NULL, dataptr, len);
+}
+#endif /* CHKSUM_SIMD_SSE2 */
+
+#if CHKSUM_SIMD_AVX2
+/** AVX2 kernel: like the SSE2 one with 256-bit vectors, 64 bytes per
+ * iteration */
+__attribute__((target("avx2"))) static u16_t
+chksum_simd_avx2_copy(void *dst, const void *src, int len)
+{
+  const u8_t *pb = (const u8_t *)src;
+  u8_t *pd = (u8_t *)dst;
+  const __m256i zero = _mm256_setzero_si256();
+  __m128i v;
+  u32_t lanes[4];
+  u32_t sum = 0;
+
+  while (len >= 64) {
+    __m256i acc0 = zero, acc1 = zero;
+    int n = LWIP_MIN(len / 64, CHKSUM_SIMD_BLOCK / 4);
+    len -= n * 64;
+    while (n-- > 0) {
+      __m256i v0 = _mm256_loadu_si256((const __m256i *)(const void *)pb);
+      __m256i v1 = _mm256_loadu_si256((const __m256i *)(const void *)(pb + 32));
+      if (pd != NULL) {
+        _mm256_storeu_si256((__m256i *)(void *)pd, v0);
+        _mm256_storeu_si256((__m256i *)(void *)(pd + 32), v1);
+        pd += 64;
+      }
+      acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v0, zero));
+      acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v0, zero));
+      acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v1, zero));
+      acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v1, zero));
+      pb += 64;
+    }
+    acc0 = _mm256_add_epi32(acc0, acc1);
+    v = _mm_add_epi32(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+    _mm_storeu_si128((__m128i *)(void *)lanes, v);
+    sum = chksum_simd_add_lanes(sum, lanes, 4);
+  }
+  if (len >= 32) {
+    __m256i v0 = _mm256_loadu_si256((const __m256i *)(const void *)pb);
+    if (pd != NULL) {
+      _mm256_storeu_si256((__m256i *)(void *)pd, v0);
+      pd += 32;
+    }
+    v0 = _mm256_add_epi32(_mm256_unpacklo_epi16(v0, zero), _mm256_unpackhi_epi16(v0, zero));
+    v = _mm_add_epi32(_mm256_castsi256_si128(v0), _mm256_extracti128_si256(v0, 1));
+    _mm_storeu_si128((__m128i *)(void *)lanes, v);
+    sum = chksum_simd_add_lanes(sum, lanes, 4);
+    pb += 32;
+    len -= 32;
+  }
+  if (len >= 16) {
+    v = _mm_loadu_si128((const __m128i *)(const void *)pb);
+    if (pd != NULL) {
+      _mm_storeu_si128((__m128i *)(void *)pd, v);
+      pd += 16;
+    }
+    v = _mm_add_epi32(_mm_unpacklo_epi16(v, _mm256_castsi256_si128(zero)),
+                      _mm_unpackhi_epi16(v, _mm256_castsi256_si128(zero)));
+    _mm_storeu_si128((__m128i *)(void *)lanes, v);
+    sum = chksum_simd_add_lanes(sum, lanes, 4);
+    pb += 16;
+    len -= 16;
+  }
+  return chksum_simd_finish(sum, pd, pb, len);
+}
+
+static u16_t
+chksum_simd_avx2(const void *dataptr, int len)
+{
+  return chksum_simd_avx2_copy(NULL, dataptr, len);
+}
+#endif /* CHKSUM_SIMD_AVX2 */
+
+#if CHKSUM_SIMD_NEON
+/** NEON kernel: pairs of 16-bit words are added to 32-bit lanes
+ * (vpadalq_u16), 32 bytes per iteration */
+static u16_t
+chksum_simd_neon_copy(void *dst, const void *src, int len)
+{
+  const u8_t *pb = (const u8_t *)src;
+  u8_t *pd = (u8_t *)dst;
+  u32_t lanes[4];
+  u32_t sum = 0;
+
+  while (len >= 32) {
+    uint32x4_t acc0 = vdupq_n_u32(0), acc1 = vdupq_n_u32(0);
+    int n = LWIP_MIN(len / 32, CHKSUM_SIMD_BLOCK / 2);
+    len -= n * 32;
+    while (n-- > 0) {
+      uint8x16_t v0 = vld1q_u8(pb);
+      uint8x16_t v1 = vld1q_u8(pb + 16);
+      if (pd != NULL) {
+        vst1q_u8(pd, v0);
+        vst1q_u8(pd + 16, v1);
+        pd += 32;
+      }
+      acc0 = vpadalq_u16(acc0, vreinterpretq_u16_u8(v0));
+      acc1 = vpadalq_u16(acc1, vreinterpretq_u16_u8(v1));
+      pb += 32;
+    }
+    vst1q_u32(lanes, vaddq_u32(acc0, acc1));
+    sum = chksum_simd_add_lanes(sum, lanes, 4);
+  }
+  if (len >= 16) {
+    uint8x16_t v = vld1q_u8(pb);
+    if (pd != NULL) {
+      vst1q_u8(pd, v);
+      pd += 16;
+    }
+    vst1q_u32(lanes, vpaddlq_u16(vreinterpretq_u16_u8(v)));
+    sum = chksum_simd_add_lanes(sum, lanes, 4);
+    pb += 16;
+    len -= 16;
+  }
+  return chksum_simd_finish(sum, pd, pb, len);
+}
+
+static u16_t
+chksum_simd_neon(const void *dataptr, int len)
+{
+  return chksum_simd_neon_copy(NULL, dataptr, len);
+}
+#endif /* CHKSUM_SIMD_NEON */
+
+#if LWIP_CHECKSUM_ON_COPY
+#if CHKSUM_SIMD_SSE2
+static u16_t
+chksum_simd_sse2_copy16(void *dst, const void *src, u16_t len)
+{
+  return chksum_simd_sse2_copy(dst, src, len);
+}
+#endif /* CHKSUM_SIMD_SSE2 */
+#if CHKSUM_SIMD_AVX2
+static u16_t
+chksum_simd_avx2_copy16(void *dst, const void *src, u16_t len)
+{
+  return chksum_simd_avx2_copy(dst, src, len);
+}
+#endif /* CHKSUM_SIMD_AVX2 */
+#if CHKSUM_SIMD_NEON
+static u16_t
+chksum_simd_neon_copy16(void *dst, const void *src, u16_t len)
+{
+  return chksum_simd_neon_copy(dst, src, len);
+}
+#endif /* CHKSUM_SIMD_NEON */
+#define CHKSUM_SIMD_SET_COPY(fn) chksum_simd_copy_fn = (fn)
+#else /* LWIP_CHECKSUM_ON_COPY */
+#define CHKSUM_SIMD_SET_COPY(fn)
+#endif /* LWIP_CHECKSUM_ON_COPY */
+
+/**
+ * Select the checksum kernel used by lwip_chksum_simd() (and by
+ * lwip_chksum_copy_simd() with LWIP_CHECKSUM_ON_COPY).
+ *
+ * @param kernel one of LWIP_CHKSUM_KERNEL_*
+ * @return 1 if the kernel has been selected, 0 if it is not available
+ *         (not compiled in or not supported by the CPU)
+ */
+u8_t
+lwip_chksum_simd_select(u8_t kernel)
+{
+  switch (kernel) {
+    case LWIP_CHKSUM_KERNEL_SCALAR:
+      chksum_simd_fn = lwip_standard_chksum;
+      CHKSUM_SIMD_SET_COPY(chksum_simd_copy_scalar);
+      break;
+#if CHKSUM_SIMD_SSE2
+    case LWIP_CHKSUM_KERNEL_SSE2:
+      chksum_simd_fn = chksum_simd_sse2;
+      CHKSUM_SIMD_SET_COPY(chksum_simd_sse2_copy16);
+      break;
+#endif /* CHKSUM_SIMD_SSE2 */
+#if CHKSUM_SIMD_AVX2
+    case LWIP_CHKSUM_KERNEL_AVX2:
+      __builtin_cpu_init();
+      if (!__builtin_cpu_supports("avx2")) {
+        return 0;
+      }
+      chksum_simd_fn = chksum_simd_avx2;
+      CHKSUM_SIMD_SET_COPY(chksum_simd_avx2_copy16);
+      break;
+#endif /* CHKSUM_SIMD_AVX2 */
+#if CHKSUM_SIMD_NEON
+    case LWIP_CHKSUM_KERNEL_NEON:
+      chksum_simd_fn = chksum_simd_neon;
+      CHKSUM_SIMD_SET_COPY(chksum_simd_neon_copy16);
+      break;
+#endif /* CHKSUM_SIMD_NEON */
+    default:
+      return 0;
+  }
+  chksum_simd_kernel = kernel;
+  return 1;
+}
+
+/**
+ * Return the checksum kernel currently used by lwip_chksum_simd()
+ * (one of LWIP_CHKSUM_KERNEL_*).
+ */
+u8_t
+lwip_chksum_simd_get(void)
+{
+  return chksum_simd_kernel;
+}
+
+/**
+ * Select the fastest checksum kernel the CPU supports.
+ * Called from lwip_init().
+ */
+void
+lwip_chksum_simd_init(void)
+{
+  if (!lwip_chksum_simd_select(LWIP_CHKSUM_KERNEL_AVX2) &&
+      !lwip_chksum_simd_select(LWIP_CHKSUM_KERNEL_SSE2) &&
+      !lwip_chksum_simd_select(LWIP_CHKSUM_KERNEL_NEON)) {
+    lwip_chksum_simd_select(LWIP_CHKSUM_KERNEL_SCALAR);
+  }
+}
+
+/**
+ * lwip checksum with the kernel selected by lwip_chksum_simd_init() (used as
+ * LWIP_CHKSUM with LWIP_CHKSUM_SIMD)
+ *
+ * @param dataptr points to start of data to be summed at any boundary
+ * @param len length of data to be summed
+ * @return host order (!) lwip checksum (non-inverted Internet sum)
+ */
+u16_t
+lwip_chksum_simd(const void *dataptr, int len)
+{
+  return chksum_simd_fn(dataptr, len);
+}
+
+#if LWIP_CHECKSUM_ON_COPY
+/**
+ * Copy data and calculate its checksum in one pass with the kernel selected
+ * by lwip_chksum_simd_init() (used as LWIP_CHKSUM_COPY with LWIP_CHKSUM_SIMD)
+ *
+ * @param dst where to copy the data to (may overlap with 'src' only if equal)
+ * @param src the data to copy, at any boundary
+ * @param len length of the data
+ * @return host order (!) lwip checksum (non-inverted Internet sum) of the data
+ */
+u16_t
+lwip_chksum_copy_simd(void *dst, const void *src, u16_t len)
+{
+  return chksum_simd_copy_fn(dst, src, len);
+}
+#endif /* LWIP_CHECKSUM_ON_COPY */
+
+#endif /* LWIP_CHKSUM_SIMD */
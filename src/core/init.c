@@ -43,6 +43,7 @@
 #include "lwip/mem.h"
 #include "lwip/memp.h"
 #include "lwip/pbuf.h"
+#include "lwip/inet_chksum.h"
 #include "lwip/netif.h"
 #include "lwip/sockets.h"
 #include "lwip/ip.h"
@@ -167,9 +168,78 @@ PACK_STRUCT_END
 #if (LWIP_TCP && LWIP_TCP_SACK_OUT && !TCP_QUEUE_OOSEQ)
 #error "To use LWIP_TCP_SACK_OUT, TCP_QUEUE_OOSEQ needs to be enabled"
 #endif
+#if (LWIP_TCP && LWIP_TCP_OOSEQ_TREE && !TCP_QUEUE_OOSEQ)
+#error "To use LWIP_TCP_OOSEQ_TREE, TCP_QUEUE_OOSEQ needs to be enabled"
+#endif
+#if (LWIP_TCP && LWIP_TCP_OOSEQ_MEM && !TCP_QUEUE_OOSEQ)
+#error "To use LWIP_TCP_OOSEQ_MEM, TCP_QUEUE_OOSEQ needs to be enabled"
+#endif
+#if (LWIP_TCP && LWIP_TCP_OOSEQ_MEM && (TCP_OOSEQ_MEM_PBUFS < 1))
+#error "TCP_OOSEQ_MEM_PBUFS must be at least 1"
+#endif
+#if (LWIP_TCP && LWIP_TCP_TS_RTTM && !LWIP_TCP_TIMESTAMPS)
+#error "To use LWIP_TCP_TS_RTTM, LWIP_TCP_TIMESTAMPS needs to be enabled"
+#endif
+#if (LWIP_TCP && IP_PMTUD && !TCP_CALCULATE_EFF_SEND_MSS)
+#error "To use IP_PMTUD with TCP, TCP_CALCULATE_EFF_SEND_MSS needs to be enabled"
+#endif
+#if (LWIP_TCP && LWIP_TCP_PLPMTUD && !IP_PMTUD)
+#error "To use LWIP_TCP_PLPMTUD, IP_PMTUD needs to be enabled"
+#endif
+#if (IP_PMTUD && (IP_PMTU_CACHE_SIZE < 1))
+#error "IP_PMTU_CACHE_SIZE must be at least 1"
+#endif
+#if (LWIP_TCP && LWIP_TCP_ZEROCOPY && !LWIP_SUPPORT_CUSTOM_PBUF)
+#error "To use LWIP_TCP_ZEROCOPY, LWIP_SUPPORT_CUSTOM_PBUF needs to be enabled"
+#endif
+#if (LWIP_TCP && LWIP_TCP_ZEROCOPY && LWIP_NETIF_TX_SINGLE_PBUF)
+#error "LWIP_TCP_ZEROCOPY can't be used with LWIP_NETIF_TX_SINGLE_PBUF (tcp_write() always copies)"
+#endif
+#if (LWIP_TCP_TSO && !LWIP_TCP)
+#error "If you want to use LWIP_TCP_TSO, you have to define LWIP_TCP=1 in your lwipopts.h"
+#endif
+#if (LWIP_TCP && LWIP_TCP_TSO && LWIP_NETIF_TX_SINGLE_PBUF)
+#error "LWIP_TCP_TSO can't be used with LWIP_NETIF_TX_SINGLE_PBUF (super-segments are pbuf chains)"
+#endif
+#if (LWIP_CHKSUM_SIMD && defined(LWIP_CHKSUM))
+#error "LWIP_CHKSUM_SIMD provides LWIP_CHKSUM, don't define it in your port"
+#endif
+#if (LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE && (TCP_RCV_AUTOTUNE_MAX < TCP_WND))
+#error "TCP_RCV_AUTOTUNE_MAX must be at least TCP_WND"
+#endif
+#if (LWIP_TCP && LWIP_TCP_SND_AUTOTUNE && !LWIP_TCP_SNDBUF_PCB)
+#error "To use LWIP_TCP_SND_AUTOTUNE, LWIP_TCP_SNDBUF_PCB needs to be enabled"
+#endif
 #if (LWIP_TCP && LWIP_TCP_SACK_OUT && (LWIP_TCP_MAX_SACK_NUM < 1))
 #error "LWIP_TCP_MAX_SACK_NUM must be greater than 0"
 #endif
+#if (LWIP_TCP && LWIP_TCP_SACK_IN && !LWIP_TCP_SACK_OUT)
+#error "To use LWIP_TCP_SACK_IN, LWIP_TCP_SACK_OUT needs to be enabled"
+#endif
+#if (LWIP_TCP && LWIP_TCP_CUBIC && !LWIP_HAVE_INT64)
+#error "LWIP_TCP_CUBIC needs 64-bit integer support (LWIP_HAVE_INT64)"
+#endif
+#if (LWIP_TCP && LWIP_TCP_PCB_HASH && ((TCP_PCB_HASH_SIZE < 1) || (TCP_LISTEN_PCB_HASH_SIZE < 1)))
+#error "TCP_PCB_HASH_SIZE and TCP_LISTEN_PCB_HASH_SIZE must be greater than 0"
+#endif
+#if (LWIP_TIMERS && !LWIP_TIMERS_CUSTOM && LWIP_TIMERS_WHEEL && (LWIP_TIMERS_WHEEL_HASH_SIZE < 1))
+#error "LWIP_TIMERS_WHEEL_HASH_SIZE must be greater than 0"
+#endif
+#if (LWIP_TCP && LWIP_TCP_PCB_TIMERS && (!LWIP_TIMERS || LWIP_TIMERS_CUSTOM || !LWIP_TIMERS_WHEEL))
+#error "LWIP_TCP_PCB_TIMERS needs LWIP_TIMERS and LWIP_TIMERS_WHEEL (and not LWIP_TIMERS_CUSTOM)"
+#endif
+#if (LWIP_TCP && LWIP_TCP_PACING && (!LWIP_TIMERS || LWIP_TIMERS_CUSTOM || !LWIP_TIMERS_WHEEL))
+#error "LWIP_TCP_PACING needs LWIP_TIMERS and LWIP_TIMERS_WHEEL (and not LWIP_TIMERS_CUSTOM)"
+#endif
+#if (LWIP_TCP && LWIP_TCP_PACING && (TCP_PACING_BURST < 1))
+#error "TCP_PACING_BURST must be greater than 0"
+#endif
+#if (LWIP_TCP && LWIP_TCP_RACK && !LWIP_TCP_SACK_IN)
+#error "LWIP_TCP_RACK needs LWIP_TCP_SACK_IN"
+#endif
+#if (LWIP_TCP && LWIP_TCP_RACK && (!LWIP_TIMERS || LWIP_TIMERS_CUSTOM || !LWIP_TIMERS_WHEEL))
+#error "LWIP_TCP_RACK needs LWIP_TIMERS and LWIP_TIMERS_WHEEL (and not LWIP_TIMERS_CUSTOM)"
+#endif
 #if (LWIP_NETIF_API && (NO_SYS==1))
   #error "If you want to use NETIF API, you have to define NO_SYS=0 in your lwipopts.h"
 #endif
@@ -357,6 +427,9 @@ lwip_init(void)
   memp_init();
   pbuf_init();
   netif_init();
+#if LWIP_CHKSUM_SIMD
+  lwip_chksum_simd_init();
+#endif /* LWIP_CHKSUM_SIMD */
 #if LWIP_IPV4
   ip_init();
 #if LWIP_ARP
@@ -1018,6 +1018,19 @@ etharp_query(struct netif *netif, const ip4_addr_t *ipaddr, struct pbuf *q)
           pbuf_free(p);
           p = NULL;
         }
+#if LWIP_TCP_TSO
+        if (p != NULL) {
+          /* still a super-segment to be cut up */
+          p->tso_mss = q->tso_mss;
+        }
+#endif /* LWIP_TCP_TSO */
+#if LWIP_CHECKSUM_OFFLOAD
+        if (p != NULL) {
+          /* the netif still has to complete the checksum of the copy */
+          p->chksum_start = q->chksum_start;
+          p->chksum_offset = q->chksum_offset;
+        }
+#endif /* LWIP_CHECKSUM_OFFLOAD */
       }
     } else {
       /* referencing the old pbuf is enough */
@@ -48,6 +48,9 @@
 #include "lwip/ip.h"
 #include "lwip/def.h"
 #include "lwip/stats.h"
+#if IP_PMTUD && LWIP_TCP
+#include "lwip/priv/tcp_priv.h"
+#endif /* IP_PMTUD && LWIP_TCP */
 
 #include <string.h>
 
@@ -66,6 +69,9 @@
 #define ICMP_DEST_UNREACH_DATASIZE 8
 
 static void icmp_send_response(struct pbuf *p, u8_t type, u8_t code);
+#if IP_PMTUD && LWIP_TCP
+static void icmp_frag_needed(struct pbuf *p, struct netif *inp);
+#endif /* IP_PMTUD && LWIP_TCP */
 
 /**
  * Processes ICMP input packets, called from ip_input().
@@ -255,6 +261,12 @@ icmp_input(struct pbuf *p, struct netif *inp)
   default:
     if (type == ICMP_DUR) {
       MIB2_STATS_INC(mib2.icmpindestunreachs);
+#if IP_PMTUD && LWIP_TCP
+      if (*(((u8_t *)p->payload) + 1) == ICMP_DUR_FRAG) {
+        icmp_frag_needed(p, inp);
+        break;
+      }
+#endif /* IP_PMTUD && LWIP_TCP */
     } else if (type == ICMP_TE) {
       MIB2_STATS_INC(mib2.icmpintimeexcds);
     } else if (type == ICMP_PP) {
@@ -293,6 +305,64 @@ icmperr:
 #endif /* LWIP_ICMP_ECHO_CHECK_INPUT_PBUF_LEN || !LWIP_MULTICAST_PING || !LWIP_BROADCAST_PING */
 }
 
+#if IP_PMTUD && LWIP_TCP
+/**
+ * Process an ICMP "fragmentation needed" message (RFC 1191): the path MTU
+ * is passed on to TCP, which checks that the quoted segment is one of its
+ * segments in flight.
+ *
+ * @param p the icmp message, p->payload pointing to the icmp header
+ * @param inp the netif on which this packet was received
+ */
+static void
+icmp_frag_needed(struct pbuf *p, struct netif *inp)
+{
+  /* the next-hop MTU is in the 'seqno' field (RFC 1191, section 4) */
+  struct icmp_echo_hdr icmphdr;
+  struct ip_hdr iphdr;
+  /* source port, destination port and sequence number of the segment */
+  struct tcp_hdr tcphdr;
+  ip4_addr_t src, dest;
+  u16_t hlen;
+
+  LWIP_UNUSED_ARG(inp);
+  if ((pbuf_copy_partial(p, &icmphdr, sizeof(icmphdr), 0) != sizeof(icmphdr)) ||
+      (pbuf_copy_partial(p, &iphdr, IP_HLEN, sizeof(icmphdr)) != IP_HLEN)) {
+    goto lenerr;
+  }
+  hlen = IPH_HL_BYTES(&iphdr);
+  if ((IPH_V(&iphdr) != 4) || (hlen < IP_HLEN)) {
+    goto lenerr;
+  }
+  if (IPH_PROTO(&iphdr) != IP_PROTO_TCP) {
+    /* only TCP sets DF */
+    return;
+  }
+  if (pbuf_copy_partial(p, &tcphdr, 8, (u16_t)(sizeof(icmphdr) + hlen)) != 8) {
+    goto lenerr;
+  }
+#if CHECKSUM_CHECK_ICMP
+  IF__NETIF_CHECKSUM_ENABLED(inp, NETIF_CHECKSUM_CHECK_ICMP) {
+    if (inet_chksum_pbuf(p) != 0) {
+      LWIP_DEBUGF(ICMP_DEBUG, ("icmp_frag_needed: checksum failed\n"));
+      ICMP_STATS_INC(icmp.chkerr);
+      MIB2_STATS_INC(mib2.icmpinerrors);
+      return;
+    }
+  }
+#endif /* CHECKSUM_CHECK_ICMP */
+  LWIP_DEBUGF(ICMP_DEBUG, ("icmp_frag_needed: next-hop mtu %"U16_F"\n", lwip_ntohs(icmphdr.seqno)));
+  ip4_addr_copy(src, iphdr.src);
+  ip4_addr_copy(dest, iphdr.dest);
+  tcp_pmtu_icmp(&src, &dest, lwip_ntohs(tcphdr.src), lwip_ntohs(tcphdr.dest),
+                lwip_ntohl(tcphdr.seqno), lwip_ntohs(icmphdr.seqno), lwip_ntohs(IPH_LEN(&iphdr)));
+  return;
+lenerr:
+  ICMP_STATS_INC(icmp.lenerr);
+  MIB2_STATS_INC(mib2.icmpinerrors);
+}
+#endif /* IP_PMTUD && LWIP_TCP */
+
 /**
  * Send an icmp 'destination unreachable' packet, called from ip_input() if
  * the transport layer protocol is unknown and from udp_input() if the local
@@ -877,6 +877,9 @@ ip4_output_if_opt_src(struct pbuf *p, const ip4_addr_t *src, const ip4_addr_t *d
     iphdr = (struct ip_hdr *)p->payload;
     LWIP_ASSERT("check that first pbuf can hold struct ip_hdr",
                (p->len >= sizeof(struct ip_hdr)));
+#if LWIP_CHECKSUM_OFFLOAD
+    p->chksum_start = ip_hlen;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
 
     IPH_TTL_SET(iphdr, ttl);
     IPH_PROTO_SET(iphdr, proto);
@@ -900,12 +903,36 @@ ip4_output_if_opt_src(struct pbuf *p, const ip4_addr_t *src, const ip4_addr_t *d
 #if CHECKSUM_GEN_IP_INLINE
     chk_sum += iphdr->_len;
 #endif /* CHECKSUM_GEN_IP_INLINE */
-    IPH_OFFSET_SET(iphdr, 0);
+#if IP_PMTUD
+    /* TCP sizes its segments to the path MTU: have routers report a smaller
+       MTU instead of fragmenting them (RFC 1191) */
+    if ((proto == IP_PROTO_TCP) && ((netif->mtu == 0) || (p->tot_len <= netif->mtu)
+#if LWIP_TCP_TSO
+        /* the segments of a super-segment fit */
+        || (p->tso_mss != 0)
+#endif /* LWIP_TCP_TSO */
+        )) {
+      IPH_OFFSET_SET(iphdr, PP_HTONS(IP_DF));
+    } else
+#endif /* IP_PMTUD */
+    {
+      IPH_OFFSET_SET(iphdr, 0);
+    }
     IPH_ID_SET(iphdr, lwip_htons(ip_id));
 #if CHECKSUM_GEN_IP_INLINE
+    chk_sum += iphdr->_offset;
     chk_sum += iphdr->_id;
 #endif /* CHECKSUM_GEN_IP_INLINE */
     ++ip_id;
+#if LWIP_TCP_TSO
+    if (p->tso_mss != 0) {
+      /* reserve the IDs of the other segments the super-segment is cut into
+         (by the netif or by netif_gso_output_ip4()) */
+      u16_t datalen = (u16_t)(p->tot_len - ip_hlen -
+                              TCPH_HDRLEN_BYTES((struct tcp_hdr *)((u8_t *)p->payload + ip_hlen)));
+      ip_id = (u16_t)(ip_id + (datalen - 1) / p->tso_mss);
+    }
+#endif /* LWIP_TCP_TSO */
 
     if (src == NULL) {
       ip4_addr_copy(iphdr->src, *IP4_ADDR_ANY4);
@@ -970,9 +997,24 @@ ip4_output_if_opt_src(struct pbuf *p, const ip4_addr_t *src, const ip4_addr_t *d
   }
 #endif /* LWIP_MULTICAST_TX_OPTIONS */
 #endif /* ENABLE_LOOPBACK */
+#if LWIP_TCP_TSO
+  if (p->tso_mss != 0) {
+    /* TCP super-segment: cut up by the netif or here, never fragmented */
+    if (!(netif->flags & NETIF_FLAG_TSO) || (p->tot_len > netif->tso_max)) {
+      return netif_gso_output_ip4(netif, p, dest);
+    }
+    return netif->output(netif, p, dest);
+  }
+#endif /* LWIP_TCP_TSO */
 #if IP_FRAG
   /* don't fragment if interface has mtu set to 0 [loopif] */
   if (netif->mtu && (p->tot_len > netif->mtu)) {
+#if LWIP_CHECKSUM_OFFLOAD
+    if (p->chksum_offset != 0) {
+      /* the fragments can't be summed up by the netif */
+      ip_chksum_complete(p);
+    }
+#endif /* LWIP_CHECKSUM_OFFLOAD */
     return ip4_frag(p, netif, dest);
   }
 #endif /* IP_FRAG */
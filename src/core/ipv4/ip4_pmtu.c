@@ -0,0 +1,159 @@
+/**
+ * @file
+ * IPv4 path MTU discovery (RFC 1191): path MTU cache
+ *
+ * The cache holds the path MTU of destinations for which it is smaller than
+ * the MTU of the outgoing netif, as learned from ICMP "fragmentation needed"
+ * messages or by TCP black hole detection. Entries expire after
+ * IP_PMTU_TIMEOUT, so that larger packets are tried again; expired entries
+ * are dropped when they are looked up, no timer is needed.
+ */
+
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_IPV4 && IP_PMTUD /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/ip4_pmtu.h"
+#include "lwip/def.h"
+#include "lwip/sys.h"
+
+struct ip4_pmtu_entry {
+  ip4_addr_t dest;
+  /** sys_now() when the entry was last lowered */
+  u32_t time;
+  /** 0: entry unused */
+  u16_t mtu;
+};
+
+static struct ip4_pmtu_entry ip4_pmtu_cache[IP_PMTU_CACHE_SIZE];
+
+/** MTU plateaus to guess the path MTU from when a router doesn't report
+ * the next-hop MTU (RFC 1191, section 7) */
+static const u16_t ip4_pmtu_plateaus[] = {
+  32000, 17914, 8166, 4352, 2002, 1492, 1006, 508, 296, 68
+};
+
+/** Get the cache entry of a destination, NULL if there is none (or it has
+ * expired) */
+static struct ip4_pmtu_entry *
+ip4_pmtu_find(const ip4_addr_t *dest)
+{
+  u8_t i;
+
+  for (i = 0; i < IP_PMTU_CACHE_SIZE; i++) {
+    struct ip4_pmtu_entry *entry = &ip4_pmtu_cache[i];
+    if ((entry->mtu != 0) && ip4_addr_cmp(&entry->dest, dest)) {
+      if ((u32_t)(sys_now() - entry->time) >= IP_PMTU_TIMEOUT) {
+        /* try larger packets again */
+        entry->mtu = 0;
+        return NULL;
+      }
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Get the path MTU to a destination.
+ *
+ * @param dest the destination address
+ * @return the path MTU, 0 if it is not known to be smaller than the MTU of
+ *         the outgoing netif
+ */
+u16_t
+ip4_pmtu_get(const ip4_addr_t *dest)
+{
+  struct ip4_pmtu_entry *entry = ip4_pmtu_find(dest);
+  return (entry != NULL) ? entry->mtu : 0;
+}
+
+/**
+ * Lower the path MTU to a destination. A larger value than the one cached is
+ * ignored (only expiry raises the path MTU).
+ *
+ * @param dest the destination address
+ * @param mtu the new path MTU
+ */
+void
+ip4_pmtu_set(const ip4_addr_t *dest, u16_t mtu)
+{
+  struct ip4_pmtu_entry *entry = ip4_pmtu_find(dest);
+
+  if (entry == NULL) {
+    u8_t i;
+    /* use a free entry or replace the oldest one */
+    entry = &ip4_pmtu_cache[0];
+    for (i = 0; i < IP_PMTU_CACHE_SIZE; i++) {
+      if (ip4_pmtu_cache[i].mtu == 0) {
+        entry = &ip4_pmtu_cache[i];
+        break;
+      }
+      if ((u32_t)(sys_now() - ip4_pmtu_cache[i].time) > (u32_t)(sys_now() - entry->time)) {
+        entry = &ip4_pmtu_cache[i];
+      }
+    }
+    ip4_addr_copy(entry->dest, *dest);
+  } else if (mtu >= entry->mtu) {
+    return;
+  }
+  LWIP_DEBUGF(IP_DEBUG, ("ip4_pmtu_set: %"U16_F".%"U16_F".%"U16_F".%"U16_F" mtu %"U16_F"\n",
+                         ip4_addr1_16(dest), ip4_addr2_16(dest), ip4_addr3_16(dest), ip4_addr4_16(dest), mtu));
+  entry->mtu = mtu;
+  entry->time = sys_now();
+}
+
+/**
+ * Calculate the path MTU from an ICMP "fragmentation needed" message.
+ *
+ * @param mtu the next-hop MTU reported in the message (0 from routers that
+ *        predate RFC 1191)
+ * @param len the total length of the datagram that was too big
+ * @return the new path MTU, at least IP_PMTU_MIN
+ */
+u16_t
+ip4_pmtu_estimate(u16_t mtu, u16_t len)
+{
+  if ((mtu == 0) || (mtu >= len)) {
+    /* no (or a bogus) next-hop MTU: use the next lower plateau */
+    u8_t i;
+    mtu = 0;
+    for (i = 0; i < LWIP_ARRAYSIZE(ip4_pmtu_plateaus); i++) {
+      if (ip4_pmtu_plateaus[i] < len) {
+        mtu = ip4_pmtu_plateaus[i];
+        break;
+      }
+    }
+  }
+  return LWIP_MAX(mtu, IP_PMTU_MIN);
+}
+
+#endif /* LWIP_IPV4 && IP_PMTUD */
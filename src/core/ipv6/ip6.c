@@ -59,6 +59,7 @@
 #include "lwip/mld6.h"
 #include "lwip/debug.h"
 #include "lwip/stats.h"
+#include "lwip/inet_chksum.h"
 
 #ifdef LWIP_HOOK_FILENAME
 #include LWIP_HOOK_FILENAME
@@ -1005,6 +1006,9 @@ ip6_output_if_src(struct pbuf *p, const ip6_addr_t *src, const ip6_addr_t *dest,
     ip6hdr = (struct ip6_hdr *)p->payload;
     LWIP_ASSERT("check that first pbuf can hold struct ip6_hdr",
                (p->len >= sizeof(struct ip6_hdr)));
+#if LWIP_CHECKSUM_OFFLOAD
+    p->chksum_start = IP6_HLEN;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
 
     IP6H_HOPLIM_SET(ip6hdr, hl);
     IP6H_NEXTH_SET(ip6hdr, nexth);
@@ -1057,9 +1061,24 @@ ip6_output_if_src(struct pbuf *p, const ip6_addr_t *src, const ip6_addr_t *dest,
   }
 #endif /* LWIP_MULTICAST_TX_OPTIONS */
 #endif /* ENABLE_LOOPBACK */
+#if LWIP_TCP_TSO
+  if (p->tso_mss != 0) {
+    /* TCP super-segment: cut up by the netif or here, never fragmented */
+    if (!(netif->flags & NETIF_FLAG_TSO) || (p->tot_len > netif->tso_max)) {
+      return netif_gso_output_ip6(netif, p, dest);
+    }
+    return netif->output_ip6(netif, p, dest);
+  }
+#endif /* LWIP_TCP_TSO */
 #if LWIP_IPV6_FRAG
   /* don't fragment if interface has mtu set to 0 [loopif] */
   if (netif->mtu && (p->tot_len > nd6_get_destination_mtu(dest, netif))) {
+#if LWIP_CHECKSUM_OFFLOAD
+    if (p->chksum_offset != 0) {
+      /* the fragments can't be summed up by the netif */
+      ip_chksum_complete(p);
+    }
+#endif /* LWIP_CHECKSUM_OFFLOAD */
     return ip6_frag(p, netif, dest);
   }
 #endif /* LWIP_IPV6_FRAG */
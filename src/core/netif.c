@@ -215,6 +215,11 @@ netif_input(struct pbuf *p, struct netif *inp)
     return ethernet_input(p, inp);
   } else
 #endif /* LWIP_ETHERNET */
+#if LWIP_NETIF_GRO
+  if (inp->gro_max != 0) {
+    return netif_gro_input(p, inp);
+  }
+#endif /* LWIP_NETIF_GRO */
   return ip_input(p, inp);
 }
 
@@ -309,7 +314,17 @@ netif_add(struct netif *netif,
   netif->output_ip6 = netif_null_output_ip6;
 #endif /* LWIP_IPV6 */
   NETIF_SET_CHECKSUM_CTRL(netif, NETIF_CHECKSUM_ENABLE_ALL);
+#if LWIP_CHECKSUM_OFFLOAD
+  netif->chksum_partial = 0;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
   netif->flags = 0;
+#if LWIP_TCP_TSO
+  netif->tso_max = 0;
+#endif /* LWIP_TCP_TSO */
+#if LWIP_NETIF_GRO
+  netif->gro_max = 0;
+  netif->gro_num = 0;
+#endif /* LWIP_NETIF_GRO */
 #ifdef netif_get_client_data
   memset(netif->client_data, 0, sizeof(netif->client_data));
 #endif /* LWIP_NUM_NETIF_CLIENT_DATA */
@@ -525,6 +540,12 @@ netif_remove(struct netif *netif)
     /* set netif down before removing (call callback function) */
     netif_set_down(netif);
   }
+#if LWIP_NETIF_GRO
+  /* drop the segments held back for merging */
+  while (netif->gro_num > 0) {
+    pbuf_free(netif->gro_pkts[--netif->gro_num]);
+  }
+#endif /* LWIP_NETIF_GRO */
 
   mib2_remove_ip4(netif);
 
@@ -978,6 +999,12 @@ netif_loop_output(struct netif *netif, struct pbuf *p)
     MIB2_STATS_NETIF_INC(stats_if, ifoutdiscards);
     return err;
   }
+#if LWIP_CHECKSUM_OFFLOAD
+  if (p->chksum_offset != 0) {
+    /* the checksum was left to the hardware, the data can't be corrupted */
+    r->flags |= PBUF_FLAG_CHKSUM_VERIFIED;
+  }
+#endif /* LWIP_CHECKSUM_OFFLOAD */
 
   /* Put the packet on a linked list which gets emptied through calling
      netif_poll(). */
@@ -0,0 +1,435 @@
+/**
+ * @file
+ * Generic receive offload: merging received TCP segments (LWIP_NETIF_GRO)
+ *
+ * For netifs that set netif->gro_max, received IP packets go through
+ * netif_gro_input() instead of straight to ip_input(). TCP segments are
+ * held back (for up to NETIF_GRO_FLOWS flows per netif), and the following
+ * segments of the same flow are appended to them: their headers are
+ * stripped and the data pbufs are chained, nothing is copied. The first
+ * header is kept, with the total length, window and PSH flag updated.
+ * A packet that does not continue its flow's held packet flushes that one
+ * first, so the order within a flow is kept.
+ *
+ * Only plain data segments to an address of the netif itself are merged
+ * (forwarded packets are passed on unchanged): ACK (and PSH on the last one)
+ * set, in sequence, with the same ACK number, TCP options and IP TOS/traffic
+ * class, no IP options or extension headers and no fragments. Checksums are
+ * verified before a segment is merged (unless the netif already did,
+ * PBUF_FLAG_CHKSUM_VERIFIED); tcp_input() does not check those of a merged
+ * packet again. The TCP checksum of a merged packet is updated from the
+ * headers (RFC 1624), so it is still correct for e.g. raw pcbs.
+ *
+ * The driver calls netif_gro_flush() at the end of each receive burst (in
+ * the context of the stack, e.g. with tcpip_callback()), which passes the
+ * held packets on to ip_input().
+ */
+
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_NETIF_GRO /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/netif.h"
+#include "lwip/def.h"
+#include "lwip/ip.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/tcp.h"
+#include "lwip/prot/iana.h"
+
+#include <string.h>
+
+/** The headers of a received TCP segment */
+struct netif_gro_seg {
+  struct tcp_hdr *tcphdr;
+  /** length of the IP header */
+  u16_t iphlen;
+  /** length of the IP and TCP headers */
+  u16_t hlen;
+  /** length of the TCP data */
+  u16_t datalen;
+  /** 1 if this segment may be merged (or merged to) */
+  u8_t mergeable;
+};
+
+/**
+ * Parse the headers of a received IP packet.
+ *
+ * @param p the packet, p->payload points to the IP header
+ * @param inp the netif the packet was received on
+ * @param seg filled in with the headers
+ * @return 1 if 'p' is a TCP segment, 0 if not (or if its headers are not in
+ *         the first pbuf)
+ */
+static u8_t
+netif_gro_parse(struct pbuf *p, struct netif *inp, struct netif_gro_seg *seg)
+{
+  u16_t iplen;
+  u8_t flags;
+
+  if (p->len < 1) {
+    return 0;
+  }
+  switch (*(u8_t *)p->payload >> 4) {
+#if LWIP_IPV4
+    case 4: {
+      struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+      ip4_addr_t dest;
+      if ((p->len < IP_HLEN + TCP_HLEN) || (IPH_PROTO(iphdr) != IP_PROTO_TCP)) {
+        return 0;
+      }
+      seg->iphlen = IPH_HL_BYTES(iphdr);
+      iplen = lwip_ntohs(IPH_LEN(iphdr));
+      ip4_addr_copy(dest, iphdr->dest);
+      /* for us, no options, no fragments */
+      seg->mergeable = ip4_addr_cmp(&dest, netif_ip4_addr(inp)) &&
+                       (seg->iphlen == IP_HLEN) &&
+                       ((IPH_OFFSET(iphdr) & PP_HTONS(IP_OFFMASK | IP_MF)) == 0);
+      break;
+    }
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6
+    case 6: {
+      struct ip6_hdr *ip6hdr = (struct ip6_hdr *)p->payload;
+      ip6_addr_t dest;
+      /* no extension headers */
+      if ((p->len < IP6_HLEN + TCP_HLEN) || (IP6H_NEXTH(ip6hdr) != IP6_NEXTH_TCP)) {
+        return 0;
+      }
+      seg->iphlen = IP6_HLEN;
+      iplen = (u16_t)(IP6H_PLEN(ip6hdr) + IP6_HLEN);
+      ip6_addr_copy_from_packed(dest, ip6hdr->dest);
+      ip6_addr_assign_zone(&dest, IP6_UNKNOWN, inp);
+      /* for us */
+      seg->mergeable = (netif_get_ip6_addr_match(inp, &dest) >= 0);
+      break;
+    }
+#endif /* LWIP_IPV6 */
+    default:
+      return 0;
+  }
+  if ((seg->iphlen > p->len - TCP_HLEN) || (iplen > p->tot_len)) {
+    return 0;
+  }
+  seg->tcphdr = (struct tcp_hdr *)((u8_t *)p->payload + seg->iphlen);
+  seg->hlen = (u16_t)(seg->iphlen + TCPH_HDRLEN_BYTES(seg->tcphdr));
+  if ((TCPH_HDRLEN_BYTES(seg->tcphdr) < TCP_HLEN) || (seg->hlen > p->len) || (seg->hlen > iplen)) {
+    return 0;
+  }
+  seg->datalen = (u16_t)(iplen - seg->hlen);
+  flags = TCPH_FLAGS(seg->tcphdr);
+  if ((seg->datalen == 0) || ((flags & (u8_t)~TCP_PSH) != TCP_ACK)) {
+    seg->mergeable = 0;
+  }
+  if (seg->mergeable && (p->tot_len > iplen)) {
+    /* remove link layer padding */
+    pbuf_realloc(p, iplen);
+  }
+  return 1;
+}
+
+/**
+ * Verify the checksums of a segment before it is held back or merged.
+ *
+ * @return 1 if the checksums are correct (or not checked on this netif)
+ */
+static u8_t
+netif_gro_chksum_ok(struct netif *inp, struct pbuf *p, const struct netif_gro_seg *seg)
+{
+  u8_t ok = 1;
+
+  LWIP_UNUSED_ARG(inp);
+#if LWIP_IPV4
+  if (seg->iphlen == IP_HLEN) {
+#if CHECKSUM_CHECK_IP
+    IF__NETIF_CHECKSUM_ENABLED(inp, NETIF_CHECKSUM_CHECK_IP) {
+      ok = (inet_chksum(p->payload, IP_HLEN) == 0);
+    }
+#endif /* CHECKSUM_CHECK_IP */
+#if CHECKSUM_CHECK_TCP
+    IF__NETIF_CHECKSUM_ENABLED(inp, NETIF_CHECKSUM_CHECK_TCP) {
+      if (ok && !(p->flags & PBUF_FLAG_CHKSUM_VERIFIED)) {
+        struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+        ip4_addr_t src, dst;
+        ip4_addr_copy(src, iphdr->src);
+        ip4_addr_copy(dst, iphdr->dest);
+        pbuf_remove_header(p, IP_HLEN);
+        ok = (inet_chksum_pseudo(p, IP_PROTO_TCP, p->tot_len, &src, &dst) == 0);
+        pbuf_add_header(p, IP_HLEN);
+      }
+    }
+#endif /* CHECKSUM_CHECK_TCP */
+  }
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6 && CHECKSUM_CHECK_TCP
+  if ((seg->iphlen == IP6_HLEN) && !(p->flags & PBUF_FLAG_CHKSUM_VERIFIED)) {
+    IF__NETIF_CHECKSUM_ENABLED(inp, NETIF_CHECKSUM_CHECK_TCP) {
+      struct ip6_hdr *ip6hdr = (struct ip6_hdr *)p->payload;
+      ip6_addr_t src, dst;
+      ip6_addr_copy_from_packed(src, ip6hdr->src);
+      ip6_addr_copy_from_packed(dst, ip6hdr->dest);
+      pbuf_remove_header(p, IP6_HLEN);
+      ok = (ip6_chksum_pseudo(p, IP6_NEXTH_TCP, p->tot_len, &src, &dst) == 0);
+      pbuf_add_header(p, IP6_HLEN);
+    }
+  }
+#endif /* LWIP_IPV6 && CHECKSUM_CHECK_TCP */
+  LWIP_UNUSED_ARG(p);
+  LWIP_UNUSED_ARG(seg);
+  return ok;
+}
+
+/**
+ * The checksum of the TCP data of a segment with a correct TCP checksum,
+ * calculated from its headers only: the pseudo header, TCP header and data
+ * add up to 0xffff.
+ *
+ * @return the (not inverted) sum of the data
+ */
+static u16_t
+netif_gro_data_chksum(struct pbuf *p, const struct netif_gro_seg *seg)
+{
+  u16_t tcplen = (u16_t)(seg->hlen - seg->iphlen + seg->datalen);
+  u16_t tcphlen = (u16_t)(seg->hlen - seg->iphlen);
+  u16_t chksum;
+
+#if LWIP_IPV6
+  if (seg->iphlen == IP6_HLEN) {
+    struct ip6_hdr *ip6hdr = (struct ip6_hdr *)p->payload;
+    ip6_addr_t src, dst;
+    ip6_addr_copy_from_packed(src, ip6hdr->src);
+    ip6_addr_copy_from_packed(dst, ip6hdr->dest);
+    pbuf_remove_header(p, IP6_HLEN);
+    chksum = ip6_chksum_pseudo_partial(p, IP6_NEXTH_TCP, tcplen, tcphlen, &src, &dst);
+    pbuf_add_header(p, IP6_HLEN);
+  } else
+#endif /* LWIP_IPV6 */
+  {
+#if LWIP_IPV4
+    struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+    ip4_addr_t src, dst;
+    ip4_addr_copy(src, iphdr->src);
+    ip4_addr_copy(dst, iphdr->dest);
+    pbuf_remove_header(p, IP_HLEN);
+    chksum = inet_chksum_pseudo_partial(p, IP_PROTO_TCP, tcplen, tcphlen, &src, &dst);
+    pbuf_add_header(p, IP_HLEN);
+#else /* LWIP_IPV4 */
+    chksum = 0;
+#endif /* LWIP_IPV4 */
+  }
+  return chksum;
+}
+
+/** Check if two TCP segments belong to the same flow (addresses and ports) */
+static u8_t
+netif_gro_same_flow(const struct pbuf *h, const struct netif_gro_seg *hseg,
+                    const struct pbuf *p, const struct netif_gro_seg *seg)
+{
+  if (hseg->iphlen != seg->iphlen) {
+    return 0;
+  }
+#if LWIP_IPV6
+  if (seg->iphlen == IP6_HLEN) {
+    if (memcmp(&((const struct ip6_hdr *)h->payload)->src, &((const struct ip6_hdr *)p->payload)->src,
+               2 * sizeof(ip6_addr_p_t)) != 0) {
+      return 0;
+    }
+  } else
+#endif /* LWIP_IPV6 */
+  {
+#if LWIP_IPV4
+    if (memcmp(&((const struct ip_hdr *)h->payload)->src, &((const struct ip_hdr *)p->payload)->src,
+               2 * sizeof(ip4_addr_p_t)) != 0) {
+      return 0;
+    }
+#endif /* LWIP_IPV4 */
+  }
+  return (hseg->tcphdr->src == seg->tcphdr->src) && (hseg->tcphdr->dest == seg->tcphdr->dest);
+}
+
+/**
+ * Append segment 'p' to the held packet 'h' of the same flow if it
+ * continues it.
+ *
+ * @return 1 if 'p' has been merged into 'h' (and must not be used any more)
+ */
+static u8_t
+netif_gro_merge(struct netif *inp, struct pbuf *h, struct netif_gro_seg *hseg,
+                struct pbuf *p, const struct netif_gro_seg *seg)
+{
+  u32_t len = (u32_t)hseg->hlen + hseg->datalen + seg->datalen;
+  u16_t tcphlen = (u16_t)(hseg->hlen - hseg->iphlen);
+  u16_t hdrflags = hseg->tcphdr->_hdrlen_rsvd_flags;
+  u16_t wnd = hseg->tcphdr->wnd;
+  u16_t dsum;
+  u32_t acc;
+
+  if (!hseg->mergeable || !seg->mergeable || (TCPH_FLAGS(hseg->tcphdr) & TCP_PSH) ||
+      (len > inp->gro_max) || (len > 0xFFFF) || (hseg->hlen != seg->hlen) ||
+      (lwip_ntohl(seg->tcphdr->seqno) != lwip_ntohl(hseg->tcphdr->seqno) + hseg->datalen) ||
+      (seg->tcphdr->ackno != hseg->tcphdr->ackno) ||
+      (TCPH_ECN_FLAGS(seg->tcphdr) != TCPH_ECN_FLAGS(hseg->tcphdr)) ||
+      /* same options (timestamps included) */
+      (memcmp(hseg->tcphdr + 1, seg->tcphdr + 1, seg->hlen - seg->iphlen - TCP_HLEN) != 0) ||
+      /* same TOS/traffic class (ECN CE marks must not get lost) */
+      (((u8_t *)h->payload)[0] != ((u8_t *)p->payload)[0]) ||
+      (((u8_t *)h->payload)[1] != ((u8_t *)p->payload)[1]) ||
+      !netif_gro_chksum_ok(inp, p, seg)) {
+    return 0;
+  }
+
+  dsum = netif_gro_data_chksum(p, seg);
+  if (hseg->datalen & 1) {
+    /* appended at an odd offset */
+    dsum = SWAP_BYTES_IN_WORD(dsum);
+  }
+  hseg->tcphdr->wnd = seg->tcphdr->wnd;
+  TCPH_SET_FLAG(hseg->tcphdr, TCPH_FLAGS(seg->tcphdr) & TCP_PSH);
+  /* update the TCP checksum (RFC 1624: HC' = ~(~HC + ~m + m')) for the data
+     appended, the TCP length in the pseudo header and window and flags */
+  acc = (u16_t)~hseg->tcphdr->chksum;
+  acc += dsum;
+  acc += (u16_t)~lwip_htons((u16_t)(tcphlen + hseg->datalen));
+  acc += lwip_htons((u16_t)(tcphlen + hseg->datalen + seg->datalen));
+  acc += (u16_t)~wnd;
+  acc += hseg->tcphdr->wnd;
+  acc += (u16_t)~hdrflags;
+  acc += hseg->tcphdr->_hdrlen_rsvd_flags;
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+  hseg->tcphdr->chksum = (u16_t)~acc;
+  hseg->datalen = (u16_t)(hseg->datalen + seg->datalen);
+#if LWIP_IPV6
+  if (hseg->iphlen == IP6_HLEN) {
+    IP6H_PLEN_SET((struct ip6_hdr *)h->payload, (u16_t)(len - IP6_HLEN));
+  } else
+#endif /* LWIP_IPV6 */
+  {
+#if LWIP_IPV4
+    IPH_LEN_SET((struct ip_hdr *)h->payload, lwip_htons((u16_t)len));
+#endif /* LWIP_IPV4 */
+  }
+  h->flags |= PBUF_FLAG_GRO | PBUF_FLAG_CHKSUM_VERIFIED;
+  /* keep the data only */
+  p = pbuf_free_header(p, seg->hlen);
+  if (p != NULL) {
+    pbuf_cat(h, p);
+  }
+  return 1;
+}
+
+/** Pass on a held packet to ip_input() */
+static void
+netif_gro_deliver(struct netif *inp, u8_t i)
+{
+  struct pbuf *p = inp->gro_pkts[i];
+
+  inp->gro_num--;
+  for (; i < inp->gro_num; i++) {
+    inp->gro_pkts[i] = inp->gro_pkts[i + 1];
+  }
+#if LWIP_IPV4
+  if ((p->flags & PBUF_FLAG_GRO) && ((*(u8_t *)p->payload >> 4) == 4)) {
+    /* the header has changed */
+    struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+    IPH_CHKSUM_SET(iphdr, 0);
+    IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+  }
+#endif /* LWIP_IPV4 */
+  if (ip_input(p, inp) != ERR_OK) {
+    pbuf_free(p);
+  }
+}
+
+/**
+ * @ingroup netif
+ * Input function for received IP packets on netifs with netif->gro_max set:
+ * TCP segments are held back to be merged with the following segments of
+ * their flow (LWIP_NETIF_GRO), other packets are passed on to ip_input().
+ * Called by ethernet_input() and netif_input(), so drivers don't need to
+ * call it directly. netif_gro_flush() must be called at the end of a receive
+ * burst.
+ *
+ * @param p the received packet, p->payload points to the IP header
+ * @param inp the netif the packet was received on
+ * @return ERR_OK if the packet was processed or held back, another err_t if
+ *         ip_input() did not take it (the caller frees it then)
+ */
+err_t
+netif_gro_input(struct pbuf *p, struct netif *inp)
+{
+  struct netif_gro_seg seg, hseg;
+  u8_t i;
+
+  if (!netif_gro_parse(p, inp, &seg)) {
+    return ip_input(p, inp);
+  }
+  for (i = 0; i < inp->gro_num; i++) {
+    struct pbuf *h = inp->gro_pkts[i];
+    if (netif_gro_parse(h, inp, &hseg) && netif_gro_same_flow(h, &hseg, p, &seg)) {
+      if (netif_gro_merge(inp, h, &hseg, p, &seg)) {
+        if (TCPH_FLAGS(hseg.tcphdr) & TCP_PSH) {
+          /* nothing is merged after PSH */
+          netif_gro_deliver(inp, i);
+        }
+        return ERR_OK;
+      }
+      /* keep the order within the flow */
+      netif_gro_deliver(inp, i);
+      break;
+    }
+  }
+  if (seg.mergeable && !(TCPH_FLAGS(seg.tcphdr) & TCP_PSH) && netif_gro_chksum_ok(inp, p, &seg)) {
+    if (inp->gro_num == NETIF_GRO_FLOWS) {
+      netif_gro_deliver(inp, 0);
+    }
+    inp->gro_pkts[inp->gro_num++] = p;
+    return ERR_OK;
+  }
+  return ip_input(p, inp);
+}
+
+/**
+ * @ingroup netif
+ * Pass on all TCP segments held back by GRO (LWIP_NETIF_GRO) to ip_input().
+ * To be called by the driver at the end of each receive burst, in the
+ * context of the stack (i.e. the same way as netif->input).
+ *
+ * @param netif the netif to flush
+ */
+void
+netif_gro_flush(struct netif *netif)
+{
+  while (netif->gro_num > 0) {
+    netif_gro_deliver(netif, 0);
+  }
+}
+
+#endif /* LWIP_NETIF_GRO */
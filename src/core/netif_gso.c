@@ -0,0 +1,231 @@
+/**
+ * @file
+ * Generic segmentation offload: software fallback for TCP segmentation
+ * offload (LWIP_TCP_TSO)
+ *
+ * tcp_output() sends super-segments (p->tso_mss != 0) to netifs that set
+ * netif->tso_max. Netifs with NETIF_FLAG_TSO cut them into segments
+ * themselves. For other netifs, the IP layer calls the functions here right
+ * before netif->output: each segment is built from a copy of the headers,
+ * with sequence number, IP length and ID and the checksums fixed up,
+ * followed by PBUF_REF pbufs pointing to the next p->tso_mss bytes of the
+ * data. The data is not copied, but the TCP checksum of each segment is
+ * still calculated in software (one pass over the data) unless the netif
+ * does it.
+ */
+
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_TSO /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/netif.h"
+#include "lwip/def.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/ip.h"
+#include "lwip/prot/tcp.h"
+#include "lwip/prot/iana.h"
+
+/**
+ * Build the next segment of a super-segment: a copy of the IP and TCP
+ * headers followed by the next p->tso_mss bytes of data (PBUF_REF pbufs
+ * pointing into 'p', which must not be freed before the segment). The TCP
+ * sequence number and flags are fixed up, lengths and checksums are left
+ * to the caller.
+ *
+ * @param p the super-segment, p->payload points to the IP header
+ * @param hlen length of the IP and TCP headers
+ * @param iphlen length of the IP header
+ * @param off offset of the segment's data in the data of 'p', advanced past it
+ * @return the segment or NULL if out of memory
+ */
+static struct pbuf *
+netif_gso_segment(struct pbuf *p, u16_t hlen, u16_t iphlen, u16_t *off)
+{
+  struct pbuf *q, *r, *d;
+  struct tcp_hdr *tcphdr;
+  u16_t datalen = (u16_t)(p->tot_len - hlen);
+  u16_t len = (u16_t)LWIP_MIN(p->tso_mss, datalen - *off);
+  u16_t left = len;
+  u16_t pos = (u16_t)(hlen + *off);
+  u16_t clear = 0;
+
+  q = pbuf_alloc(PBUF_IP, hlen, PBUF_RAM);
+  if (q == NULL) {
+    return NULL;
+  }
+  pbuf_copy_partial(p, q->payload, hlen, 0);
+  /* reference the data */
+  for (d = p; pos >= d->len; d = d->next) {
+    pos = (u16_t)(pos - d->len);
+  }
+  while (left > 0) {
+    u16_t n = (u16_t)LWIP_MIN(left, d->len - pos);
+    if (n > 0) {
+      r = pbuf_alloc(PBUF_RAW, n, PBUF_REF);
+      if (r == NULL) {
+        pbuf_free(q);
+        return NULL;
+      }
+      r->payload = (u8_t *)d->payload + pos;
+      pbuf_cat(q, r);
+      left = (u16_t)(left - n);
+    }
+    pos = 0;
+    d = d->next;
+  }
+
+  tcphdr = (struct tcp_hdr *)((u8_t *)q->payload + iphlen);
+  tcphdr->seqno = lwip_htonl(lwip_ntohl(tcphdr->seqno) + *off);
+  if (*off != 0) {
+    /* only the first segment signals a window reduction (RFC 3168) */
+    clear = TCP_CWR;
+  }
+  *off = (u16_t)(*off + len);
+  if (*off < datalen) {
+    /* PSH and FIN go with the end of the data */
+    clear |= TCP_PSH | TCP_FIN;
+  }
+  TCPH_UNSET_FLAG(tcphdr, clear);
+  return q;
+}
+
+#if LWIP_IPV4
+/**
+ * Cut a TCP super-segment into segments and send them with netif->output.
+ * Called by ip4_output_if() for netifs without NETIF_FLAG_TSO.
+ *
+ * @param netif the netif to send on
+ * @param p the super-segment, p->payload points to the IP header (not freed)
+ * @param dest the next hop address
+ * @return ERR_OK if all segments were sent
+ */
+err_t
+netif_gso_output_ip4(struct netif *netif, struct pbuf *p, const ip4_addr_t *dest)
+{
+  struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+  struct pbuf *q;
+  u16_t iphlen = IPH_HL_BYTES(iphdr);
+  u16_t hlen = (u16_t)(iphlen + TCPH_HDRLEN_BYTES((struct tcp_hdr *)((u8_t *)p->payload + iphlen)));
+  u16_t id = lwip_ntohs(IPH_ID(iphdr));
+  u16_t off = 0;
+  err_t err;
+
+  LWIP_ASSERT("netif_gso_output_ip4: headers not in first pbuf", p->len >= hlen);
+  LWIP_ASSERT("netif_gso_output_ip4: not a super-segment", p->tso_mss != 0);
+
+  do {
+    q = netif_gso_segment(p, hlen, iphlen, &off);
+    if (q == NULL) {
+      return ERR_MEM;
+    }
+    iphdr = (struct ip_hdr *)q->payload;
+    IPH_LEN_SET(iphdr, lwip_htons(q->tot_len));
+    /* consecutive IDs as a NIC would use them (RFC 6864: atomic datagrams),
+       ip4_output_if() has reserved them */
+    IPH_ID_SET(iphdr, lwip_htons(id));
+    id++;
+    IPH_CHKSUM_SET(iphdr, 0);
+#if CHECKSUM_GEN_IP
+    IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_IP) {
+      IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, iphlen));
+    }
+#endif /* CHECKSUM_GEN_IP */
+#if CHECKSUM_GEN_TCP
+    IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_TCP) {
+      struct tcp_hdr *tcphdr = (struct tcp_hdr *)((u8_t *)q->payload + iphlen);
+      ip4_addr_t src, dst;
+      ip4_addr_copy(src, iphdr->src);
+      ip4_addr_copy(dst, iphdr->dest);
+      tcphdr->chksum = 0;
+      pbuf_remove_header(q, iphlen);
+      tcphdr->chksum = inet_chksum_pseudo(q, IP_PROTO_TCP, q->tot_len, &src, &dst);
+      pbuf_add_header(q, iphlen);
+    }
+#endif /* CHECKSUM_GEN_TCP */
+    err = netif->output(netif, q, dest);
+    pbuf_free(q);
+  } while ((err == ERR_OK) && (off < p->tot_len - hlen));
+  return err;
+}
+#endif /* LWIP_IPV4 */
+
+#if LWIP_IPV6
+/**
+ * Cut a TCP super-segment into segments and send them with
+ * netif->output_ip6. Called by ip6_output_if() for netifs without
+ * NETIF_FLAG_TSO.
+ *
+ * @param netif the netif to send on
+ * @param p the super-segment, p->payload points to the IPv6 header (not freed)
+ * @param dest the next hop address
+ * @return ERR_OK if all segments were sent
+ */
+err_t
+netif_gso_output_ip6(struct netif *netif, struct pbuf *p, const ip6_addr_t *dest)
+{
+  struct ip6_hdr *ip6hdr;
+  struct pbuf *q;
+  u16_t hlen = (u16_t)(IP6_HLEN + TCPH_HDRLEN_BYTES((struct tcp_hdr *)((u8_t *)p->payload + IP6_HLEN)));
+  u16_t off = 0;
+  err_t err;
+
+  LWIP_ASSERT("netif_gso_output_ip6: headers not in first pbuf", p->len >= hlen);
+  LWIP_ASSERT("netif_gso_output_ip6: not a super-segment", p->tso_mss != 0);
+  LWIP_ASSERT("netif_gso_output_ip6: no extension headers",
+              IP6H_NEXTH((struct ip6_hdr *)p->payload) == IP6_NEXTH_TCP);
+
+  do {
+    q = netif_gso_segment(p, hlen, IP6_HLEN, &off);
+    if (q == NULL) {
+      return ERR_MEM;
+    }
+    ip6hdr = (struct ip6_hdr *)q->payload;
+    IP6H_PLEN_SET(ip6hdr, (u16_t)(q->tot_len - IP6_HLEN));
+#if CHECKSUM_GEN_TCP
+    IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_TCP) {
+      struct tcp_hdr *tcphdr = (struct tcp_hdr *)((u8_t *)q->payload + IP6_HLEN);
+      ip6_addr_t src, dst;
+      ip6_addr_copy_from_packed(src, ip6hdr->src);
+      ip6_addr_copy_from_packed(dst, ip6hdr->dest);
+      tcphdr->chksum = 0;
+      pbuf_remove_header(q, IP6_HLEN);
+      tcphdr->chksum = ip6_chksum_pseudo(q, IP6_NEXTH_TCP, q->tot_len, &src, &dst);
+      pbuf_add_header(q, IP6_HLEN);
+    }
+#endif /* CHECKSUM_GEN_TCP */
+    err = netif->output_ip6(netif, q, dest);
+    pbuf_free(q);
+  } while ((err == ERR_OK) && (off < p->tot_len - hlen));
+  return err;
+}
+#endif /* LWIP_IPV6 */
+
+#endif /* LWIP_TCP && LWIP_TCP_TSO */
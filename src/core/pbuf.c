@@ -114,6 +114,8 @@ volatile u8_t pbuf_free_ooseq_pending;
  * Attempt to reclaim some memory from queued out-of-sequence TCP segments
  * if we run out of pool pbufs. It's better to give priority to new packets
  * if we're running out.
+ * With LWIP_TCP_OOSEQ_MEM, half of the queued pbufs are pruned, starting at
+ * the end of the largest queue. Otherwise the queue of one PCB is freed.
  *
  * This must be done in the correct thread context therefore this function
  * can only be used with NO_SYS=0 and through tcpip_callback.
@@ -124,9 +126,21 @@ static
 void
 pbuf_free_ooseq(void)
 {
+#if !LWIP_TCP_OOSEQ_MEM
   struct tcp_pcb* pcb;
+#endif /* !LWIP_TCP_OOSEQ_MEM */
   SYS_ARCH_SET(pbuf_free_ooseq_pending, 0);
 
+#if LWIP_TCP_RCV_AUTOTUNE
+  /* stop inviting more data than we can hold */
+  tcp_rcv_autotune_reclaim();
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+
+#if LWIP_TCP_OOSEQ_MEM
+  /* prune the least valuable data of all PCBs */
+  LWIP_DEBUGF(PBUF_DEBUG | LWIP_DBG_TRACE, ("pbuf_free_ooseq: pruning out-of-sequence pbufs\n"));
+  tcp_ooseq_mem_reclaim();
+#else /* LWIP_TCP_OOSEQ_MEM */
   for (pcb = tcp_active_pcbs; NULL != pcb; pcb = pcb->next) {
     if (pcb->ooseq != NULL) {
       /** Free the ooseq pbufs of one PCB only */
@@ -135,6 +149,7 @@ pbuf_free_ooseq(void)
       return;
     }
   }
+#endif /* LWIP_TCP_OOSEQ_MEM */
 }
 
 #if !NO_SYS
@@ -183,6 +198,13 @@ pbuf_init_alloced_pbuf(struct pbuf *p, void* payload, u16_t tot_len, u16_t len,
   p->flags = flags;
   p->ref = 1;
   p->if_idx = NETIF_NO_INDEX;
+#if LWIP_TCP_TSO
+  p->tso_mss = 0;
+#endif /* LWIP_TCP_TSO */
+#if LWIP_CHECKSUM_OFFLOAD
+  p->chksum_start = 0;
+  p->chksum_offset = 0;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
 }
 
 /**
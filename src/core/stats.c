@@ -100,6 +100,20 @@ stats_display_igmp(struct stats_igmp *igmp, const char *name)
 }
 #endif /* IGMP_STATS || MLD6_STATS */
 
+#if TCP_STATS && LWIP_TCP_OOSEQ_MEM
+void
+stats_display_tcp_ooseq(struct stats_tcp_ooseq *ooseq)
+{
+  LWIP_PLATFORM_DIAG(("\nTCP OOSEQ\n\t"));
+  LWIP_PLATFORM_DIAG(("used: %"STAT_COUNTER_F"\n\t", ooseq->used));
+  LWIP_PLATFORM_DIAG(("max: %"STAT_COUNTER_F"\n\t", ooseq->max));
+  LWIP_PLATFORM_DIAG(("pressure: %"STAT_COUNTER_F"\n\t", ooseq->pressure));
+  LWIP_PLATFORM_DIAG(("reclaim: %"STAT_COUNTER_F"\n\t", ooseq->reclaim));
+  LWIP_PLATFORM_DIAG(("pruned_segs: %"STAT_COUNTER_F"\n\t", ooseq->pruned_segs));
+  LWIP_PLATFORM_DIAG(("pruned_pbufs: %"STAT_COUNTER_F"\n", ooseq->pruned_pbufs));
+}
+#endif /* TCP_STATS && LWIP_TCP_OOSEQ_MEM */
+
 #if MEM_STATS || MEMP_STATS
 void
 stats_display_mem(struct stats_mem *mem, const char *name)
@@ -157,6 +171,7 @@ stats_display(void)
   ICMP6_STATS_DISPLAY();
   UDP_STATS_DISPLAY();
   TCP_STATS_DISPLAY();
+  TCP_OOSEQ_STATS_DISPLAY();
   MEM_STATS_DISPLAY();
   for (i = 0; i < MEMP_MAX; i++) {
     MEMP_STATS_DISPLAY(i);
@@ -59,6 +59,8 @@
 #include "lwip/ip6.h"
 #include "lwip/ip6_addr.h"
 #include "lwip/nd6.h"
+#include "lwip/ip4_pmtu.h"
+#include "lwip/sys.h"
 
 #include <string.h>
 
@@ -82,13 +84,6 @@
 #define TCP_KEEP_INTVL(pcb) TCP_KEEPINTVL_DEFAULT
 #endif /* LWIP_TCP_KEEPALIVE */
 
-/* As initial send MSS, we use TCP_MSS but limit it to 536. */
-#if TCP_MSS > 536
-#define INITIAL_MSS 536
-#else
-#define INITIAL_MSS TCP_MSS
-#endif
-
 static const char * const tcp_state_str[] = {
   "CLOSED",
   "LISTEN",
@@ -125,14 +120,27 @@ struct tcp_pcb *tcp_active_pcbs;
 /** List of all TCP PCBs in TIME-WAIT state */
 struct tcp_pcb *tcp_tw_pcbs;
 
+#if LWIP_TCP_PCB_HASH
+/** Hash table of all PCBs on tcp_active_pcbs and tcp_tw_pcbs (by 4-tuple) */
+struct tcp_pcb *tcp_pcb_hash[TCP_PCB_HASH_SIZE];
+/** Hash table of all PCBs on tcp_listen_pcbs (by local port) */
+struct tcp_pcb_listen *tcp_listen_pcb_hash[TCP_LISTEN_PCB_HASH_SIZE];
+#endif /* LWIP_TCP_PCB_HASH */
+
 /** An array with all (non-temporary) PCB lists, mainly used for smaller code size */
 struct tcp_pcb ** const tcp_pcb_lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcbs,
   &tcp_active_pcbs, &tcp_tw_pcbs};
 
 u8_t tcp_active_pcbs_changed;
 
+#if !LWIP_TCP_PCB_TIMERS
 /** Timer counter to handle calling slow-timer from tcp_tmr() */
 static u8_t tcp_timer;
+#else /* !LWIP_TCP_PCB_TIMERS */
+/** sys_now() when tcp_ticks was last incremented */
+static u32_t tcp_ticks_ms;
+static void tcp_pcb_tmr(void *arg);
+#endif /* !LWIP_TCP_PCB_TIMERS */
 static u8_t tcp_timer_ctr;
 static u16_t tcp_new_port(void);
 
@@ -147,6 +155,15 @@ tcp_init(void)
 #ifdef LWIP_RAND
   tcp_port = TCP_ENSURE_LOCAL_PORT_RANGE(LWIP_RAND());
 #endif /* LWIP_RAND */
+#if LWIP_TCP_PCB_TIMERS
+  tcp_ticks_ms = sys_now();
+#endif /* LWIP_TCP_PCB_TIMERS */
+#if LWIP_TCP_FASTOPEN
+  tcp_fastopen_init();
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_SYNCOOKIES
+  tcp_syncookie_init();
+#endif /* LWIP_TCP_SYNCOOKIES */
 }
 
 /**
@@ -155,6 +172,7 @@ tcp_init(void)
 void
 tcp_tmr(void)
 {
+#if !LWIP_TCP_PCB_TIMERS
   /* Call tcp_fasttmr() every 250 ms */
   tcp_fasttmr();
 
@@ -163,6 +181,7 @@ tcp_tmr(void)
        tcp_tmr() is called. */
     tcp_slowtmr();
   }
+#endif /* !LWIP_TCP_PCB_TIMERS */
 }
 
 #if LWIP_CALLBACK_API || TCP_LISTEN_BACKLOG
@@ -245,6 +264,22 @@ tcp_backlog_accepted(struct tcp_pcb* pcb)
 }
 #endif /* TCP_LISTEN_BACKLOG */
 
+#if LWIP_TCP_TW_COMPACT
+/**
+ * Called when tcp_close() succeeded: from now on, a pcb in TIME_WAIT can be
+ * replaced by a compact record (done by tcp_input() if the pcb is being
+ * processed there).
+ */
+static void
+tcp_close_tw_compact(struct tcp_pcb *pcb)
+{
+  tcp_set_flags(pcb, TF_APPCLOSED);
+  if ((pcb->state == TIME_WAIT) && (tcp_input_pcb != pcb)) {
+    tcp_tw_compact(pcb);
+  }
+}
+#endif /* LWIP_TCP_TW_COMPACT */
+
 /**
  * Closes the TX side of a connection held by the PCB.
  * For tcp_close(), a RST is sent if the application didn't receive all data
@@ -281,13 +316,17 @@ tcp_close_shutdown(struct tcp_pcb *pcb, u8_t rst_on_unacked_data)
         /* move to TIME_WAIT since we close actively */
         pcb->state = TIME_WAIT;
         TCP_REG(&tcp_tw_pcbs, pcb);
+        TCP_TIMER_UPDATE(pcb);
+#if LWIP_TCP_TW_COMPACT
+        tcp_close_tw_compact(pcb);
+#endif /* LWIP_TCP_TW_COMPACT */
       } else {
         /* CLOSE_WAIT: deallocate the pcb since we already sent a RST for it */
         if (tcp_input_pcb == pcb) {
           /* prevent using a deallocated pcb: free it from tcp_input later */
           tcp_trigger_input_pcb_close();
         } else {
-          memp_free(MEMP_TCP_PCB, pcb);
+          tcp_free(pcb);
         }
       }
       return ERR_OK;
@@ -308,19 +347,31 @@ tcp_close_shutdown(struct tcp_pcb *pcb, u8_t rst_on_unacked_data)
     if (pcb->local_port != 0) {
       TCP_RMV(&tcp_bound_pcbs, pcb);
     }
-    memp_free(MEMP_TCP_PCB, pcb);
+    tcp_free(pcb);
     break;
   case LISTEN:
     tcp_listen_closed(pcb);
+#if LWIP_TCP_SYN_REQ
+    tcp_syn_req_free_all((struct tcp_pcb_listen *)pcb);
+#endif /* LWIP_TCP_SYN_REQ */
     tcp_pcb_remove(&tcp_listen_pcbs.pcbs, pcb);
     memp_free(MEMP_TCP_PCB_LISTEN, pcb);
     break;
   case SYN_SENT:
     TCP_PCB_REMOVE_ACTIVE(pcb);
-    memp_free(MEMP_TCP_PCB, pcb);
+    tcp_free(pcb);
     MIB2_STATS_INC(mib2.tcpattemptfails);
     break;
   default:
+#if LWIP_TCP_TW_COMPACT
+    if (rst_on_unacked_data) {
+      err_t err = tcp_close_shutdown_fin(pcb);
+      if (err == ERR_OK) {
+        tcp_close_tw_compact(pcb);
+      }
+      return err;
+    }
+#endif /* LWIP_TCP_TW_COMPACT */
     return tcp_close_shutdown_fin(pcb);
   }
   return ERR_OK;
@@ -337,6 +388,7 @@ tcp_close_shutdown_fin(struct tcp_pcb *pcb)
     err = tcp_send_fin(pcb);
     if (err == ERR_OK) {
       tcp_backlog_accepted(pcb);
+      TCP_SYN_RCVD_DONE(pcb);
       MIB2_STATS_INC(mib2.tcpattemptfails);
       pcb->state = FIN_WAIT_1;
     }
@@ -370,6 +422,7 @@ tcp_close_shutdown_fin(struct tcp_pcb *pcb)
   } else if (err == ERR_MEM) {
     /* Mark this pcb for closing. Closing is retried from tcp_tmr. */
     tcp_set_flags(pcb, TF_CLOSEPEND);
+    TCP_TIMER_UPDATE(pcb);
   }
   return err;
 }
@@ -477,7 +530,7 @@ tcp_abandon(struct tcp_pcb *pcb, int reset)
      the PCB with a NULL argument, and send an RST to the remote end. */
   if (pcb->state == TIME_WAIT) {
     tcp_pcb_remove(&tcp_tw_pcbs, pcb);
-    memp_free(MEMP_TCP_PCB, pcb);
+    tcp_free(pcb);
   } else {
     int send_rst = 0;
     u16_t local_port = 0;
@@ -515,7 +568,7 @@ tcp_abandon(struct tcp_pcb *pcb, int reset)
       tcp_rst(pcb, seqno, ackno, &pcb->local_ip, &pcb->remote_ip, local_port, pcb->remote_port);
     }
     last_state = pcb->state;
-    memp_free(MEMP_TCP_PCB, pcb);
+    tcp_free(pcb);
     TCP_EVENT_ERR(last_state, errf, errf_arg, ERR_ABRT);
   }
 }
@@ -628,6 +681,20 @@ tcp_bind(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
         }
       }
     }
+#if LWIP_TCP_TW_COMPACT
+    if (max_pcb_list == NUM_TCP_PCB_LISTS) {
+      struct tcp_pcb_tw *tw;
+      for (tw = tcp_tw_records; tw != NULL; tw = tw->next) {
+        if ((tw->local_port == port) &&
+            (IP_IS_V6(ipaddr) == IP_IS_V6_VAL(tw->local_ip)) &&
+            (ip_addr_isany(&tw->local_ip) ||
+            ip_addr_isany(ipaddr) ||
+            ip_addr_cmp(&tw->local_ip, ipaddr))) {
+          return ERR_USE;
+        }
+      }
+    }
+#endif /* LWIP_TCP_TW_COMPACT */
   }
 
   if (!ip_addr_isany(ipaddr)) {
@@ -752,6 +819,16 @@ tcp_listen_with_backlog_and_err(struct tcp_pcb *pcb, u8_t backlog, err_t *err)
   lpcb->local_port = pcb->local_port;
   lpcb->state = LISTEN;
   lpcb->prio = pcb->prio;
+  lpcb->cc = pcb->cc;
+#if LWIP_TCP_FASTOPEN
+  lpcb->fastopen = pcb->fastopen & TCP_FASTOPEN_ENABLED;
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_RCV_AUTOTUNE
+  lpcb->rcv_buf_max = pcb->rcv_buf_max;
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+#if LWIP_TCP_SNDBUF_PCB
+  lpcb->snd_buf_max = pcb->snd_buf_max;
+#endif /* LWIP_TCP_SNDBUF_PCB */
   lpcb->so_options = pcb->so_options;
   lpcb->netif_idx = NETIF_NO_INDEX;
   lpcb->ttl = pcb->ttl;
@@ -763,7 +840,7 @@ tcp_listen_with_backlog_and_err(struct tcp_pcb *pcb, u8_t backlog, err_t *err)
   if (pcb->local_port != 0) {
     TCP_RMV(&tcp_bound_pcbs, pcb);
   }
-  memp_free(MEMP_TCP_PCB, pcb);
+  tcp_free(pcb);
 #if LWIP_CALLBACK_API
   lpcb->accept = tcp_accept_null;
 #endif /* LWIP_CALLBACK_API */
@@ -771,6 +848,9 @@ tcp_listen_with_backlog_and_err(struct tcp_pcb *pcb, u8_t backlog, err_t *err)
   lpcb->accepts_pending = 0;
   tcp_backlog_set(lpcb, backlog);
 #endif /* TCP_LISTEN_BACKLOG */
+#if LWIP_TCP_SYN_REQ
+  memset(lpcb->syn_reqs, 0, sizeof(lpcb->syn_reqs));
+#endif /* LWIP_TCP_SYN_REQ */
   TCP_REG(&tcp_listen_pcbs.pcbs, (struct tcp_pcb *)lpcb);
   res = ERR_OK;
 done:
@@ -844,6 +924,7 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
       LWIP_ASSERT("tcp_recved: len wrapped rcv_wnd\n", 0);
     }
   }
+  TCP_RCV_AUTOTUNE(pcb, len);
 
   wnd_inflation = tcp_update_rcv_ann_wnd(pcb);
 
@@ -871,6 +952,9 @@ tcp_new_port(void)
   u8_t i;
   u16_t n = 0;
   struct tcp_pcb *pcb;
+#if LWIP_TCP_TW_COMPACT
+  struct tcp_pcb_tw *tw;
+#endif /* LWIP_TCP_TW_COMPACT */
 
 again:
   tcp_port++;
@@ -889,6 +973,17 @@ again:
       }
     }
   }
+#if LWIP_TCP_TW_COMPACT
+  for (tw = tcp_tw_records; tw != NULL; tw = tw->next) {
+    if (tw->local_port == tcp_port) {
+      n++;
+      if (n > (TCP_LOCAL_PORT_RANGE_END - TCP_LOCAL_PORT_RANGE_START)) {
+        return 0;
+      }
+      goto again;
+    }
+  }
+#endif /* LWIP_TCP_TW_COMPACT */
   return tcp_port;
 }
 
@@ -979,6 +1074,11 @@ tcp_connect(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port,
           }
         }
       }
+#if LWIP_TCP_TW_COMPACT
+      if (tcp_tw_lookup(&pcb->local_ip, pcb->local_port, ipaddr, port, NULL) != NULL) {
+        return ERR_USE;
+      }
+#endif /* LWIP_TCP_TW_COMPACT */
     }
 #endif /* SO_REUSE */
   }
@@ -992,6 +1092,7 @@ tcp_connect(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port,
   /* Start with a window that does not need scaling. When window scaling is
      enabled and used, the window is enlarged when both sides agree on scaling. */
   pcb->rcv_wnd = pcb->rcv_ann_wnd = TCPWND_MIN16(TCP_WND);
+  TCP_RCV_AUTOTUNE_INIT(pcb);
   pcb->rcv_ann_right_edge = pcb->rcv_nxt;
   pcb->snd_wnd = TCP_WND;
   /* As initial send MSS, we use TCP_MSS but limit it to 536.
@@ -1018,11 +1119,175 @@ tcp_connect(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port,
     TCP_REG_ACTIVE(pcb);
     MIB2_STATS_INC(mib2.tcpactiveopens);
 
+#if LWIP_TCP_FASTOPEN
+    if (pcb->unsent->flags & TF_SEG_OPTS_FASTOPEN) {
+      /* A cookie is cached for this server: the SYN is sent by the next
+         tcp_output(), with the data written until then */
+      return ERR_OK;
+    }
+#endif /* LWIP_TCP_FASTOPEN */
     tcp_output(pcb);
   }
   return ret;
 }
 
+/**
+ * Does the tcp_slowtmr() work for one active pcb: retransmission and persist
+ * timers, keepalive and the timeouts of the various states.
+ *
+ * @param pcb the tcp_pcb to process
+ * @param pcb_reset set to 1 if a RST should be sent when removing the pcb
+ * @return != 0 if the pcb should be removed (this is not done here)
+ */
+static u8_t
+tcp_slowtmr_pcb(struct tcp_pcb *pcb, u8_t *pcb_reset)
+{
+  u8_t pcb_remove = 0;
+  err_t err;
+
+  if (pcb->state == SYN_SENT && pcb->nrtx >= TCP_SYNMAXRTX) {
+    ++pcb_remove;
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: max SYN retries reached\n"));
+  }
+  else if (pcb->nrtx >= TCP_MAXRTX) {
+    ++pcb_remove;
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: max DATA retries reached\n"));
+  } else {
+    if (pcb->persist_backoff > 0) {
+      if (pcb->persist_probe >= TCP_MAXRTX) {
+        ++pcb_remove; /* max probes reached */
+      } else {
+        /* If snd_wnd is zero, use persist timer to send 1 byte probes
+         * instead of using the standard retransmission mechanism. */
+        u8_t backoff_cnt = tcp_persist_backoff[pcb->persist_backoff-1];
+        if (pcb->persist_cnt < backoff_cnt) {
+          pcb->persist_cnt++;
+        }
+        if (pcb->persist_cnt >= backoff_cnt) {
+          if (tcp_zero_window_probe(pcb) == ERR_OK) {
+            pcb->persist_cnt = 0;
+            if (pcb->persist_backoff < sizeof(tcp_persist_backoff)) {
+              pcb->persist_backoff++;
+            }
+          }
+        }
+      }
+    } else {
+      /* Increase the retransmission timer if it is running */
+      if (pcb->rtime >= 0) {
+        ++pcb->rtime;
+      }
+
+      if (pcb->unacked != NULL && pcb->rtime >= pcb->rto) {
+        /* Time for a retransmission. */
+        LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_slowtmr: rtime %"S16_F
+                                    " pcb->rto %"S16_F"\n",
+                                    pcb->rtime, pcb->rto));
+        if (tcp_rexmit_rto_prepare(pcb) == ERR_OK) {
+          TCP_INFO_INC(pcb, info_rto);
+#if LWIP_TCP_PLPMTUD
+          if (pcb->nrtx + 1 == TCP_PMTU_BLACKHOLE_RTX) {
+            tcp_pmtu_blackhole(pcb);
+          }
+#endif /* LWIP_TCP_PLPMTUD */
+          /* Double retransmission time-out unless we are trying to
+           * connect to somebody (i.e., we are in SYN_SENT). */
+          if (pcb->state != SYN_SENT) {
+            u8_t backoff_idx = LWIP_MIN(pcb->nrtx, sizeof(tcp_backoff)-1);
+            int calc_rto = ((pcb->sa >> 3) + pcb->sv) << tcp_backoff[backoff_idx];
+            pcb->rto = (s16_t)LWIP_MIN(calc_rto, 0x7FFF);
+          }
+
+          /* Reset the retransmission timer. */
+          pcb->rtime = 0;
+
+          /* Reduce congestion window and ssthresh. */
+          pcb->cc->rto(pcb);
+#if LWIP_TCP_ECN
+          pcb->ecn_recover = pcb->snd_nxt;
+#endif /* LWIP_TCP_ECN */
+          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"TCPWNDSIZE_F
+                                       " ssthresh %"TCPWNDSIZE_F"\n",
+                                       pcb->cwnd, pcb->ssthresh));
+          pcb->bytes_acked = 0;
+
+          /* The following needs to be called AFTER cwnd is set to one
+             mss - STJ */
+          tcp_rexmit_rto_commit(pcb);
+        }
+      }
+    }
+  }
+  /* Check if this PCB has stayed too long in FIN-WAIT-2 */
+  if (pcb->state == FIN_WAIT_2) {
+    /* If this PCB is in FIN_WAIT_2 because of SHUT_WR don't let it time out. */
+    if (pcb->flags & TF_RXCLOSED) {
+      /* PCB was fully closed (either through close() or SHUT_RDWR):
+         normal FIN-WAIT timeout handling. */
+      if ((u32_t)(tcp_ticks - pcb->tmr) >
+          TCP_FIN_WAIT_TIMEOUT / TCP_SLOW_INTERVAL) {
+        ++pcb_remove;
+        LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: removing pcb stuck in FIN-WAIT-2\n"));
+      }
+    }
+  }
+
+  /* Check if KEEPALIVE should be sent */
+  if (ip_get_option(pcb, SOF_KEEPALIVE) &&
+     ((pcb->state == ESTABLISHED) ||
+      (pcb->state == CLOSE_WAIT))) {
+    if ((u32_t)(tcp_ticks - pcb->tmr) >
+       (pcb->keep_idle + TCP_KEEP_DUR(pcb)) / TCP_SLOW_INTERVAL)
+    {
+      LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: KEEPALIVE timeout. Aborting connection to "));
+      ip_addr_debug_print_val(TCP_DEBUG, pcb->remote_ip);
+      LWIP_DEBUGF(TCP_DEBUG, ("\n"));
+
+      ++pcb_remove;
+      *pcb_reset = 1;
+    } else if ((u32_t)(tcp_ticks - pcb->tmr) >
+              (pcb->keep_idle + pcb->keep_cnt_sent * TCP_KEEP_INTVL(pcb))
+              / TCP_SLOW_INTERVAL)
+    {
+      err = tcp_keepalive(pcb);
+      if (err == ERR_OK) {
+        pcb->keep_cnt_sent++;
+      }
+    }
+  }
+
+  /* If this PCB has queued out of sequence data, but has been
+     inactive for too long, will drop the data (it will eventually
+     be retransmitted). */
+#if TCP_QUEUE_OOSEQ
+  if (pcb->ooseq != NULL &&
+      (tcp_ticks - pcb->tmr >= (u32_t)pcb->rto * TCP_OOSEQ_TIMEOUT)) {
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: dropping OOSEQ queued data\n"));
+    tcp_free_ooseq(pcb);
+  }
+#endif /* TCP_QUEUE_OOSEQ */
+
+  /* Check if this PCB has stayed too long in SYN-RCVD */
+  if (pcb->state == SYN_RCVD) {
+    if ((u32_t)(tcp_ticks - pcb->tmr) >
+        TCP_SYN_RCVD_TIMEOUT / TCP_SLOW_INTERVAL) {
+      ++pcb_remove;
+      LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: removing pcb stuck in SYN-RCVD\n"));
+    }
+  }
+
+  /* Check if this PCB has stayed too long in LAST-ACK */
+  if (pcb->state == LAST_ACK) {
+    if ((u32_t)(tcp_ticks - pcb->tmr) > 2 * TCP_MSL / TCP_SLOW_INTERVAL) {
+      ++pcb_remove;
+      LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: removing pcb stuck in LAST-ACK\n"));
+    }
+  }
+
+  return pcb_remove;
+}
+
+#if !LWIP_TCP_PCB_TIMERS
 /**
  * Called every 500 ms and implements the retransmission timer and the timer that
  * removes PCBs that have been in TIME-WAIT for enough time. It also increments
@@ -1034,7 +1299,6 @@ void
 tcp_slowtmr(void)
 {
   struct tcp_pcb *pcb, *prev;
-  tcpwnd_size_t eff_wnd;
   u8_t pcb_remove;      /* flag if a PCB should be removed */
   u8_t pcb_reset;       /* flag if a RST should be sent when removing */
   err_t err;
@@ -1063,143 +1327,8 @@ tcp_slowtmr_start:
     }
     pcb->last_timer = tcp_timer_ctr;
 
-    pcb_remove = 0;
     pcb_reset = 0;
-
-    if (pcb->state == SYN_SENT && pcb->nrtx >= TCP_SYNMAXRTX) {
-      ++pcb_remove;
-      LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: max SYN retries reached\n"));
-    }
-    else if (pcb->nrtx >= TCP_MAXRTX) {
-      ++pcb_remove;
-      LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: max DATA retries reached\n"));
-    } else {
-      if (pcb->persist_backoff > 0) {
-        if (pcb->persist_probe >= TCP_MAXRTX) {
-          ++pcb_remove; /* max probes reached */
-        } else {
-          /* If snd_wnd is zero, use persist timer to send 1 byte probes
-           * instead of using the standard retransmission mechanism. */
-          u8_t backoff_cnt = tcp_persist_backoff[pcb->persist_backoff-1];
-          if (pcb->persist_cnt < backoff_cnt) {
-            pcb->persist_cnt++;
-          }
-          if (pcb->persist_cnt >= backoff_cnt) {
-            if (tcp_zero_window_probe(pcb) == ERR_OK) {
-              pcb->persist_cnt = 0;
-              if (pcb->persist_backoff < sizeof(tcp_persist_backoff)) {
-                pcb->persist_backoff++;
-              }
-            }
-          }
-        }
-      } else {
-        /* Increase the retransmission timer if it is running */
-        if (pcb->rtime >= 0) {
-          ++pcb->rtime;
-        }
-
-        if (pcb->unacked != NULL && pcb->rtime >= pcb->rto) {
-          /* Time for a retransmission. */
-          LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_slowtmr: rtime %"S16_F
-                                      " pcb->rto %"S16_F"\n",
-                                      pcb->rtime, pcb->rto));
-          if (tcp_rexmit_rto_prepare(pcb) == ERR_OK) {
-            /* Double retransmission time-out unless we are trying to
-             * connect to somebody (i.e., we are in SYN_SENT). */
-            if (pcb->state != SYN_SENT) {
-              u8_t backoff_idx = LWIP_MIN(pcb->nrtx, sizeof(tcp_backoff)-1);
-              int calc_rto = ((pcb->sa >> 3) + pcb->sv) << tcp_backoff[backoff_idx];
-              pcb->rto = (s16_t)LWIP_MIN(calc_rto, 0x7FFF);
-            }
-
-            /* Reset the retransmission timer. */
-            pcb->rtime = 0;
-
-            /* Reduce congestion window and ssthresh. */
-            eff_wnd = LWIP_MIN(pcb->cwnd, pcb->snd_wnd);
-            pcb->ssthresh = eff_wnd >> 1;
-            if (pcb->ssthresh < (tcpwnd_size_t)(pcb->mss << 1)) {
-              pcb->ssthresh = (tcpwnd_size_t)(pcb->mss << 1);
-            }
-            pcb->cwnd = pcb->mss;
-            LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"TCPWNDSIZE_F
-                                         " ssthresh %"TCPWNDSIZE_F"\n",
-                                         pcb->cwnd, pcb->ssthresh));
-            pcb->bytes_acked = 0;
-
-            /* The following needs to be called AFTER cwnd is set to one
-               mss - STJ */
-            tcp_rexmit_rto_commit(pcb);
-          }
-        }
-      }
-    }
-    /* Check if this PCB has stayed too long in FIN-WAIT-2 */
-    if (pcb->state == FIN_WAIT_2) {
-      /* If this PCB is in FIN_WAIT_2 because of SHUT_WR don't let it time out. */
-      if (pcb->flags & TF_RXCLOSED) {
-        /* PCB was fully closed (either through close() or SHUT_RDWR):
-           normal FIN-WAIT timeout handling. */
-        if ((u32_t)(tcp_ticks - pcb->tmr) >
-            TCP_FIN_WAIT_TIMEOUT / TCP_SLOW_INTERVAL) {
-          ++pcb_remove;
-          LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: removing pcb stuck in FIN-WAIT-2\n"));
-        }
-      }
-    }
-
-    /* Check if KEEPALIVE should be sent */
-    if (ip_get_option(pcb, SOF_KEEPALIVE) &&
-       ((pcb->state == ESTABLISHED) ||
-        (pcb->state == CLOSE_WAIT))) {
-      if ((u32_t)(tcp_ticks - pcb->tmr) >
-         (pcb->keep_idle + TCP_KEEP_DUR(pcb)) / TCP_SLOW_INTERVAL)
-      {
-        LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: KEEPALIVE timeout. Aborting connection to "));
-        ip_addr_debug_print_val(TCP_DEBUG, pcb->remote_ip);
-        LWIP_DEBUGF(TCP_DEBUG, ("\n"));
-
-        ++pcb_remove;
-        ++pcb_reset;
-      } else if ((u32_t)(tcp_ticks - pcb->tmr) >
-                (pcb->keep_idle + pcb->keep_cnt_sent * TCP_KEEP_INTVL(pcb))
-                / TCP_SLOW_INTERVAL)
-      {
-        err = tcp_keepalive(pcb);
-        if (err == ERR_OK) {
-          pcb->keep_cnt_sent++;
-        }
-      }
-    }
-
-    /* If this PCB has queued out of sequence data, but has been
-       inactive for too long, will drop the data (it will eventually
-       be retransmitted). */
-#if TCP_QUEUE_OOSEQ
-    if (pcb->ooseq != NULL &&
-        (tcp_ticks - pcb->tmr >= (u32_t)pcb->rto * TCP_OOSEQ_TIMEOUT)) {
-      LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: dropping OOSEQ queued data\n"));
-      tcp_free_ooseq(pcb);
-    }
-#endif /* TCP_QUEUE_OOSEQ */
-
-    /* Check if this PCB has stayed too long in SYN-RCVD */
-    if (pcb->state == SYN_RCVD) {
-      if ((u32_t)(tcp_ticks - pcb->tmr) >
-          TCP_SYN_RCVD_TIMEOUT / TCP_SLOW_INTERVAL) {
-        ++pcb_remove;
-        LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: removing pcb stuck in SYN-RCVD\n"));
-      }
-    }
-
-    /* Check if this PCB has stayed too long in LAST-ACK */
-    if (pcb->state == LAST_ACK) {
-      if ((u32_t)(tcp_ticks - pcb->tmr) > 2 * TCP_MSL / TCP_SLOW_INTERVAL) {
-        ++pcb_remove;
-        LWIP_DEBUGF(TCP_DEBUG, ("tcp_slowtmr: removing pcb stuck in LAST-ACK\n"));
-      }
-    }
+    pcb_remove = tcp_slowtmr_pcb(pcb, &pcb_reset);
 
     /* If the PCB should be removed, do it. */
     if (pcb_remove) {
@@ -1211,6 +1340,7 @@ tcp_slowtmr_start:
       enum tcp_state last_state;
       tcp_pcb_purge(pcb);
       /* Remove PCB from tcp_active_pcbs list. */
+      TCP_PCB_HASH_RMV(&tcp_active_pcbs, pcb);
       if (prev != NULL) {
         LWIP_ASSERT("tcp_slowtmr: middle tcp != tcp_active_pcbs", pcb != tcp_active_pcbs);
         prev->next = pcb->next;
@@ -1229,7 +1359,7 @@ tcp_slowtmr_start:
       last_state = pcb->state;
       pcb2 = pcb;
       pcb = pcb->next;
-      memp_free(MEMP_TCP_PCB, pcb2);
+      tcp_free(pcb2);
 
       tcp_active_pcbs_changed = 0;
       TCP_EVENT_ERR(last_state, err_fn, err_arg, ERR_ABRT);
@@ -1277,6 +1407,7 @@ tcp_slowtmr_start:
       struct tcp_pcb *pcb2;
       tcp_pcb_purge(pcb);
       /* Remove PCB from tcp_tw_pcbs list. */
+      TCP_PCB_HASH_RMV(&tcp_tw_pcbs, pcb);
       if (prev != NULL) {
         LWIP_ASSERT("tcp_slowtmr: middle tcp != tcp_tw_pcbs", pcb != tcp_tw_pcbs);
         prev->next = pcb->next;
@@ -1287,12 +1418,22 @@ tcp_slowtmr_start:
       }
       pcb2 = pcb;
       pcb = pcb->next;
-      memp_free(MEMP_TCP_PCB, pcb2);
+      tcp_free(pcb2);
     } else {
       prev = pcb;
       pcb = pcb->next;
     }
   }
+
+#if LWIP_TCP_TW_COMPACT
+  /* Remove expired compact TIME-WAIT records. */
+  tcp_tw_tmr();
+#endif /* LWIP_TCP_TW_COMPACT */
+
+#if LWIP_TCP_SYN_REQ
+  /* Retransmit SYN-ACKs and time out half-open connections */
+  tcp_syn_req_tmr();
+#endif /* LWIP_TCP_SYN_REQ */
 }
 
 /**
@@ -1331,6 +1472,18 @@ tcp_fasttmr_start:
 
       next = pcb->next;
 
+#if LWIP_TCP_ZEROCOPY
+      /* report tcp_write_ref() buffers completed after their ACK */
+      if (pcb->zc_pending) {
+        tcp_active_pcbs_changed = 0;
+        tcp_zc_report(pcb);
+        if (tcp_active_pcbs_changed) {
+          /* application callback has changed the pcb list: restart the loop */
+          goto tcp_fasttmr_start;
+        }
+      }
+#endif /* LWIP_TCP_ZEROCOPY */
+
       /* If there is data which was previously "refused" by upper layer */
       if (pcb->refused_data != NULL) {
         tcp_active_pcbs_changed = 0;
@@ -1345,8 +1498,22 @@ tcp_fasttmr_start:
       pcb = pcb->next;
     }
   }
+
+#if LWIP_TCP_ZEROCOPY
+  /* TIME-WAIT pcbs may still have buffers held by a netif */
+tcp_fasttmr_tw_start:
+  for (pcb = tcp_tw_pcbs; pcb != NULL; pcb = pcb->next) {
+    if (pcb->zc_pending) {
+      if (tcp_zc_report(pcb) == ERR_ABRT) {
+        goto tcp_fasttmr_tw_start;
+      }
+    }
+  }
+#endif /* LWIP_TCP_ZEROCOPY */
 }
 
+#endif /* !LWIP_TCP_PCB_TIMERS */
+
 /** Call tcp_output for all active pcbs that have TF_NAGLEMEMERR set */
 void
 tcp_txnow(void)
@@ -1360,6 +1527,253 @@ tcp_txnow(void)
   }
 }
 
+#if LWIP_TCP_PCB_TIMERS
+/**
+ * Advance tcp_ticks to sys_now(). Called when entering TCP so that tcp_ticks
+ * is as current as if tcp_slowtmr() was running.
+ */
+void
+tcp_ticks_update(void)
+{
+  u32_t diff = sys_now() - tcp_ticks_ms;
+  if (diff >= TCP_SLOW_INTERVAL) {
+    u32_t ticks = diff / TCP_SLOW_INTERVAL;
+    tcp_ticks += ticks;
+    tcp_ticks_ms += ticks * TCP_SLOW_INTERVAL;
+  }
+}
+
+/** The pcb tcp_pcb_tmr() is calling back to the application for, reset to
+ * NULL by tcp_free() if the callback frees it */
+static struct tcp_pcb *tcp_timer_pcb;
+
+#if LWIP_EVENT_API
+#define TCP_PCB_POLLING(pcb) 1
+#elif LWIP_CALLBACK_API
+#define TCP_PCB_POLLING(pcb) ((pcb)->poll != NULL)
+#else
+#define TCP_PCB_POLLING(pcb) 0
+#endif
+
+/* Don't arm timeouts further away than this (the timeout is re-armed when it fires) */
+#define TCP_TIMER_MAX_TICKS  (0x7fffffffUL / TCP_SLOW_INTERVAL)
+
+/** Update 'next' (ticks from now) with a deadline given as tcp_ticks value */
+static void
+tcp_timer_deadline(u32_t *next, u32_t deadline)
+{
+  u32_t ticks = deadline - tcp_ticks;
+  if ((s32_t)ticks < 1) {
+    /* overdue: check on the next tick, like tcp_slowtmr() would */
+    ticks = 1;
+  }
+  if ((*next == 0) || (ticks < *next)) {
+    *next = ticks;
+  }
+}
+
+/**
+ * Return the number of slow timer ticks from now until tcp_slowtmr_pcb() work
+ * is due for a pcb, or 0 if nothing is pending.
+ */
+static u32_t
+tcp_timer_slow_ticks(struct tcp_pcb *pcb)
+{
+  u32_t next = 0;
+
+  if (pcb->state == TIME_WAIT) {
+    tcp_timer_deadline(&next, pcb->tmr + 2 * TCP_MSL / TCP_SLOW_INTERVAL + 1);
+    return next;
+  }
+
+  /* the retransmission and persist timers count slow timer ticks */
+  if (((pcb->rtime >= 0) && (pcb->unacked != NULL)) || (pcb->unsent != NULL) ||
+      (pcb->persist_backoff > 0) || (pcb->nrtx >= TCP_MAXRTX) ||
+      ((pcb->state == SYN_SENT) && (pcb->nrtx >= TCP_SYNMAXRTX))) {
+    return 1;
+  }
+
+  if (TCP_PCB_POLLING(pcb)) {
+    /* the application is polled even if the connection is idle */
+    tcp_timer_deadline(&next, pcb->timer_poll + pcb->pollinterval);
+  }
+
+  if ((pcb->state == FIN_WAIT_2) && (pcb->flags & TF_RXCLOSED)) {
+    tcp_timer_deadline(&next, pcb->tmr + TCP_FIN_WAIT_TIMEOUT / TCP_SLOW_INTERVAL + 1);
+  }
+  if (ip_get_option(pcb, SOF_KEEPALIVE) &&
+      ((pcb->state == ESTABLISHED) || (pcb->state == CLOSE_WAIT))) {
+    tcp_timer_deadline(&next, pcb->tmr +
+      (pcb->keep_idle + TCP_KEEP_DUR(pcb)) / TCP_SLOW_INTERVAL + 1);
+    tcp_timer_deadline(&next, pcb->tmr +
+      (pcb->keep_idle + pcb->keep_cnt_sent * TCP_KEEP_INTVL(pcb)) / TCP_SLOW_INTERVAL + 1);
+  }
+#if TCP_QUEUE_OOSEQ
+  if (pcb->ooseq != NULL) {
+    tcp_timer_deadline(&next, pcb->tmr + (u32_t)pcb->rto * TCP_OOSEQ_TIMEOUT);
+  }
+#endif /* TCP_QUEUE_OOSEQ */
+  if (pcb->state == SYN_RCVD) {
+    tcp_timer_deadline(&next, pcb->tmr + TCP_SYN_RCVD_TIMEOUT / TCP_SLOW_INTERVAL + 1);
+  }
+  if (pcb->state == LAST_ACK) {
+    tcp_timer_deadline(&next, pcb->tmr + 2 * TCP_MSL / TCP_SLOW_INTERVAL + 1);
+  }
+  return next;
+}
+
+/**
+ * @ingroup tcp_raw
+ * (Re-)arm the timeout of a pcb for its next deadline (LWIP_TCP_PCB_TIMERS).
+ * The stack does this itself whenever the timer state of a pcb changes; call
+ * it after changing the keepalive settings of a connected pcb.
+ *
+ * @param pcb the tcp_pcb to update
+ */
+void
+tcp_timer_update(struct tcp_pcb *pcb)
+{
+  u32_t now, due, ticks;
+  u8_t fast;
+
+  if ((pcb->state == CLOSED) || (pcb->state == LISTEN)) {
+    return;
+  }
+  tcp_ticks_update();
+  now = sys_now();
+
+  ticks = tcp_timer_slow_ticks(pcb);
+  fast = (pcb->state != TIME_WAIT) &&
+         ((pcb->flags & (TF_ACK_DELAY | TF_CLOSEPEND)) || (pcb->refused_data != NULL));
+#if LWIP_TCP_ZEROCOPY
+  fast = fast || pcb->zc_pending;
+#endif /* LWIP_TCP_ZEROCOPY */
+  if ((ticks == 0) && !fast) {
+    pcb->timer_slow = 0;
+    sys_untimeout_static(&pcb->timer);
+    return;
+  }
+
+  due = 0xffffffff;
+  pcb->timer_slow = 0;
+  if (ticks != 0) {
+    ticks = LWIP_MIN(ticks, TCP_TIMER_MAX_TICKS);
+    pcb->timer_slow = 1;
+    pcb->timer_tick = tcp_ticks + ticks;
+    /* slow timer work is done on (virtual) tcp_slowtmr() ticks */
+    due = tcp_ticks_ms + ticks * TCP_SLOW_INTERVAL - now;
+  }
+  if (fast && (due > TCP_FAST_INTERVAL)) {
+    due = TCP_FAST_INTERVAL;
+  }
+  if (sys_timeout_static_pending(&pcb->timer) &&
+      ((s32_t)(pcb->timer_due - now) <= (s32_t)due)) {
+    /* already armed for an earlier time, re-evaluated when it fires */
+    return;
+  }
+  pcb->timer_due = now + due;
+  sys_timeout_static(&pcb->timer, due, tcp_pcb_tmr, pcb);
+}
+
+/**
+ * Timeout handler of a pcb's timer: does the tcp_fasttmr() and tcp_slowtmr()
+ * work of this pcb and re-arms the timer.
+ */
+static void
+tcp_pcb_tmr(void *arg)
+{
+  struct tcp_pcb *pcb = (struct tcp_pcb *)arg;
+  err_t err = ERR_OK;
+
+  tcp_ticks_update();
+
+#if LWIP_TCP_ZEROCOPY
+  /* report tcp_write_ref() buffers completed after their ACK */
+  if (pcb->zc_pending) {
+    tcp_timer_pcb = pcb;
+    if ((tcp_zc_report(pcb) == ERR_ABRT) || (tcp_timer_pcb == NULL)) {
+      return;
+    }
+  }
+#endif /* LWIP_TCP_ZEROCOPY */
+
+  if (pcb->state == TIME_WAIT) {
+    if ((u32_t)(tcp_ticks - pcb->tmr) > 2 * TCP_MSL / TCP_SLOW_INTERVAL) {
+      tcp_pcb_purge(pcb);
+      TCP_RMV(&tcp_tw_pcbs, pcb);
+      tcp_free(pcb);
+      return;
+    }
+    tcp_timer_update(pcb);
+    return;
+  }
+  LWIP_ASSERT("tcp_pcb_tmr: pcb->state != CLOSED", pcb->state != CLOSED);
+  LWIP_ASSERT("tcp_pcb_tmr: pcb->state != LISTEN", pcb->state != LISTEN);
+
+  /* send delayed ACKs */
+  if (pcb->flags & TF_ACK_DELAY) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_pcb_tmr: delayed ACK\n"));
+    tcp_ack_now(pcb);
+    tcp_output(pcb);
+    tcp_clear_flags(pcb, TF_ACK_DELAY | TF_ACK_NOW);
+  }
+  /* send pending FIN */
+  if (pcb->flags & TF_CLOSEPEND) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_pcb_tmr: pending FIN\n"));
+    tcp_clear_flags(pcb, TF_CLOSEPEND);
+    tcp_close_shutdown_fin(pcb);
+  }
+
+  if (pcb->timer_slow && ((s32_t)(tcp_ticks - pcb->timer_tick) >= 0)) {
+    u8_t pcb_reset = 0;
+    pcb->timer_slow = 0;
+    if (tcp_slowtmr_pcb(pcb, &pcb_reset)) {
+#if LWIP_CALLBACK_API
+      tcp_err_fn err_fn = pcb->errf;
+#endif /* LWIP_CALLBACK_API */
+      void *err_arg;
+      enum tcp_state last_state;
+      tcp_pcb_purge(pcb);
+      TCP_RMV_ACTIVE(pcb);
+      if (pcb_reset) {
+        tcp_rst(pcb, pcb->snd_nxt, pcb->rcv_nxt, &pcb->local_ip, &pcb->remote_ip,
+                pcb->local_port, pcb->remote_port);
+      }
+      err_arg = pcb->callback_arg;
+      last_state = pcb->state;
+      tcp_free(pcb);
+      TCP_EVENT_ERR(last_state, err_fn, err_arg, ERR_ABRT);
+      return;
+    }
+
+    /* We check if we should poll the connection. */
+    if ((s32_t)(tcp_ticks - (pcb->timer_poll + pcb->pollinterval)) >= 0) {
+      pcb->timer_poll = tcp_ticks;
+      LWIP_DEBUGF(TCP_DEBUG, ("tcp_pcb_tmr: polling application\n"));
+      tcp_timer_pcb = pcb;
+      TCP_EVENT_POLL(pcb, err);
+      /* if err == ERR_ABRT, 'pcb' is already deallocated */
+      if ((err == ERR_ABRT) || (tcp_timer_pcb == NULL)) {
+        return;
+      }
+      if (err == ERR_OK) {
+        tcp_output(pcb);
+      }
+    }
+  }
+
+  /* If there is data which was previously "refused" by upper layer */
+  if ((pcb->state != TIME_WAIT) && (pcb->refused_data != NULL)) {
+    tcp_timer_pcb = pcb;
+    if ((tcp_process_refused_data(pcb) == ERR_ABRT) || (tcp_timer_pcb == NULL)) {
+      return;
+    }
+  }
+
+  tcp_timer_update(pcb);
+}
+#endif /* LWIP_TCP_PCB_TIMERS */
+
 /** Pass pcb->refused_data to the recv callback */
 err_t
 tcp_process_refused_data(struct tcp_pcb *pcb)
@@ -1586,7 +2000,7 @@ tcp_kill_timewait(void)
 
   inactivity = 0;
   inactive = NULL;
-  /* Go through the list of TIME_WAIT pcbs and get the oldest pcb. */
+  /* Go through the list of TIME_WAIT pcbs and get the oldest pcb */
   for (pcb = tcp_tw_pcbs; pcb != NULL; pcb = pcb->next) {
     if ((u32_t)(tcp_ticks - pcb->tmr) >= inactivity) {
       inactivity = tcp_ticks - pcb->tmr;
@@ -1611,6 +2025,7 @@ tcp_alloc(u8_t prio)
 {
   struct tcp_pcb *pcb;
 
+  TCP_TICKS_UPDATE();
   pcb = (struct tcp_pcb *)memp_malloc(MEMP_TCP_PCB);
   if (pcb == NULL) {
     /* Try killing oldest connection in TIME-WAIT. */
@@ -1657,13 +2072,29 @@ tcp_alloc(u8_t prio)
     }
   }
   if (pcb != NULL) {
+#if LWIP_TCP_SYNCOOKIES
+    tcp_pcbs_used++;
+#endif /* LWIP_TCP_SYNCOOKIES */
     /* zero out the whole pcb, so there is no need to initialize members to zero */
     memset(pcb, 0, sizeof(struct tcp_pcb));
     pcb->prio = prio;
     pcb->snd_buf = TCP_SND_BUF;
+#if LWIP_TCP_SNDBUF_PCB
+    pcb->snd_buf_size = TCP_SND_BUF;
+    pcb->snd_queuelen_max = TCP_SND_QUEUELEN;
+#if LWIP_TCP_SND_AUTOTUNE
+    pcb->snd_buf_max = TCP_SND_AUTOTUNE_MAX;
+#else /* LWIP_TCP_SND_AUTOTUNE */
+    pcb->snd_buf_max = TCP_SND_BUF;
+#endif /* LWIP_TCP_SND_AUTOTUNE */
+#endif /* LWIP_TCP_SNDBUF_PCB */
     /* Start with a window that does not need scaling. When window scaling is
        enabled and used, the window is enlarged when both sides agree on scaling. */
     pcb->rcv_wnd = pcb->rcv_ann_wnd = TCPWND_MIN16(TCP_WND);
+#if LWIP_TCP_RCV_AUTOTUNE
+    pcb->rcv_buf = pcb->rcv_wnd;
+    pcb->rcv_buf_max = TCP_RCV_AUTOTUNE_MAX;
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
     pcb->ttl = TCP_TTL;
     /* As initial send MSS, we use TCP_MSS but limit it to 536.
        The send MSS is updated when an MSS option is received. */
@@ -1682,6 +2113,7 @@ tcp_alloc(u8_t prio)
     connection is established. To avoid these complications, we set ssthresh to the
     largest effective cwnd (amount of in-flight data) that the sender can have. */
     pcb->ssthresh = TCP_SND_BUF;
+    pcb->cc = &LWIP_TCP_CC_DEFAULT;
 
 #if LWIP_CALLBACK_API
     pcb->recv = tcp_recv_null;
@@ -1843,6 +2275,10 @@ tcp_accept(struct tcp_pcb *pcb, tcp_accept_fn accept)
  * from TCP. The interval is specified in terms of the TCP coarse
  * timer interval, which is called twice a second.
  *
+ * With LWIP_TCP_PCB_TIMERS, a poll callback wakes the pcb up every
+ * 'interval' even while the connection is idle: set it only while the
+ * application has something to retry (as the netconn API does) and reset
+ * it to NULL afterwards.
  */
 void
 tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interval)
@@ -1854,6 +2290,43 @@ tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interval)
   LWIP_UNUSED_ARG(poll);
 #endif /* LWIP_CALLBACK_API */
   pcb->pollinterval = interval;
+#if LWIP_TCP_PCB_TIMERS
+  tcp_ticks_update();
+  pcb->timer_poll = tcp_ticks;
+#endif /* LWIP_TCP_PCB_TIMERS */
+  TCP_TIMER_UPDATE(pcb);
+}
+
+/**
+ * Free a tcp pcb (not a listen pcb) and stop its timer.
+ *
+ * @param pcb the tcp_pcb to free
+ */
+void
+tcp_free(struct tcp_pcb *pcb)
+{
+  LWIP_ASSERT("tcp_free: LISTEN", pcb->state != LISTEN);
+#if LWIP_TCP_PCB_TIMERS
+  sys_untimeout_static(&pcb->timer);
+  if (pcb == tcp_timer_pcb) {
+    tcp_timer_pcb = NULL;
+  }
+#endif /* LWIP_TCP_PCB_TIMERS */
+#if LWIP_TCP_PACING
+  sys_untimeout_static(&pcb->pacing_timer);
+#endif /* LWIP_TCP_PACING */
+#if LWIP_TCP_RACK
+  sys_untimeout_static(&pcb->rack_timer);
+#endif /* LWIP_TCP_RACK */
+#if LWIP_TCP_SYNCOOKIES
+  tcp_pcbs_used--;
+#endif /* LWIP_TCP_SYNCOOKIES */
+  TCP_RCV_AUTOTUNE_FREE(pcb);
+  TCP_SNDBUF_FREE(pcb);
+#if LWIP_TCP_ZEROCOPY
+  tcp_zc_free(pcb);
+#endif /* LWIP_TCP_ZEROCOPY */
+  memp_free(MEMP_TCP_PCB, pcb);
 }
 
 /**
@@ -1872,6 +2345,7 @@ tcp_pcb_purge(struct tcp_pcb *pcb)
     LWIP_DEBUGF(TCP_DEBUG, ("tcp_pcb_purge\n"));
 
     tcp_backlog_accepted(pcb);
+    TCP_SYN_RCVD_DONE(pcb);
 
     if (pcb->refused_data != NULL) {
       LWIP_DEBUGF(TCP_DEBUG, ("tcp_pcb_purge: data left on ->refused_data\n"));
@@ -1931,6 +2405,16 @@ tcp_pcb_remove(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
 #if TCP_QUEUE_OOSEQ
     LWIP_ASSERT("ooseq segments leaking", pcb->ooseq == NULL);
 #endif /* TCP_QUEUE_OOSEQ */
+#if LWIP_TCP_PCB_TIMERS
+    /* (listen pcbs have no timer) */
+    sys_untimeout_static(&pcb->timer);
+#endif /* LWIP_TCP_PCB_TIMERS */
+#if LWIP_TCP_PACING
+    sys_untimeout_static(&pcb->pacing_timer);
+#endif /* LWIP_TCP_PACING */
+#if LWIP_TCP_RACK
+    sys_untimeout_static(&pcb->rack_timer);
+#endif /* LWIP_TCP_RACK */
   }
 
   pcb->state = CLOSED;
@@ -1940,6 +2424,177 @@ tcp_pcb_remove(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
   LWIP_ASSERT("tcp_pcb_remove: tcp_pcbs_sane()", tcp_pcbs_sane());
 }
 
+#if LWIP_TCP_PCB_HASH
+/** Fold an IP address into 32 bits for hashing */
+static u32_t
+tcp_pcb_hash_ip(const ip_addr_t *addr)
+{
+#if LWIP_IPV6
+  if (IP_IS_V6(addr)) {
+    const ip6_addr_t *addr6 = ip_2_ip6(addr);
+    return addr6->addr[0] ^ addr6->addr[1] ^ addr6->addr[2] ^ addr6->addr[3];
+  }
+#endif /* LWIP_IPV6 */
+#if LWIP_IPV4
+  return ip4_addr_get_u32(ip_2_ip4(addr));
+#else /* LWIP_IPV4 */
+  return 0;
+#endif /* LWIP_IPV4 */
+}
+
+/**
+ * Calculates the bucket of a connection in tcp_pcb_hash.
+ *
+ * @return index into tcp_pcb_hash
+ */
+u32_t
+tcp_pcb_hash_idx(const ip_addr_t *local_ip, u16_t local_port,
+                 const ip_addr_t *remote_ip, u16_t remote_port)
+{
+  u32_t h = tcp_pcb_hash_ip(local_ip) ^ tcp_pcb_hash_ip(remote_ip);
+  h ^= ((u32_t)local_port << 16) | remote_port;
+  /* mix all bits into the lower ones used for the bucket index */
+  h ^= h >> 16;
+  h *= 0x45d9f3bUL;
+  h ^= h >> 16;
+  return h % TCP_PCB_HASH_SIZE;
+}
+
+/**
+ * Inserts a PCB into the hash table matching the list it is registered with.
+ * Called by TCP_REG, PCBs on tcp_bound_pcbs are not hashed.
+ *
+ * @param pcbs the PCB list the PCB has been added to
+ * @param pcb the tcp_pcb to insert
+ */
+void
+tcp_pcb_hash_add(struct tcp_pcb **pcbs, struct tcp_pcb *pcb)
+{
+  if (pcbs == &tcp_listen_pcbs.pcbs) {
+    struct tcp_pcb_listen *lpcb = (struct tcp_pcb_listen *)pcb;
+    u32_t idx = lpcb->local_port % TCP_LISTEN_PCB_HASH_SIZE;
+    lpcb->hash_next = tcp_listen_pcb_hash[idx];
+    tcp_listen_pcb_hash[idx] = lpcb;
+  } else if ((pcbs == &tcp_active_pcbs) || (pcbs == &tcp_tw_pcbs)) {
+    u32_t idx = tcp_pcb_hash_idx(&pcb->local_ip, pcb->local_port,
+                                 &pcb->remote_ip, pcb->remote_port);
+    pcb->hash_next = tcp_pcb_hash[idx];
+    tcp_pcb_hash[idx] = pcb;
+  }
+}
+
+/**
+ * Removes a PCB from the hash table matching the list it is removed from.
+ * Called by TCP_RMV, does nothing if the PCB is not hashed.
+ *
+ * @param pcbs the PCB list the PCB has been removed from
+ * @param pcb the tcp_pcb to remove
+ */
+void
+tcp_pcb_hash_remove(struct tcp_pcb **pcbs, struct tcp_pcb *pcb)
+{
+  if (pcbs == &tcp_listen_pcbs.pcbs) {
+    struct tcp_pcb_listen *lpcb = (struct tcp_pcb_listen *)pcb;
+    struct tcp_pcb_listen **pp = &tcp_listen_pcb_hash[lpcb->local_port % TCP_LISTEN_PCB_HASH_SIZE];
+    for (; *pp != NULL; pp = &(*pp)->hash_next) {
+      if (*pp == lpcb) {
+        *pp = lpcb->hash_next;
+        break;
+      }
+    }
+    lpcb->hash_next = NULL;
+  } else if ((pcbs == &tcp_active_pcbs) || (pcbs == &tcp_tw_pcbs)) {
+    struct tcp_pcb **pp = &tcp_pcb_hash[tcp_pcb_hash_idx(&pcb->local_ip, pcb->local_port,
+                                                         &pcb->remote_ip, pcb->remote_port)];
+    for (; *pp != NULL; pp = &(*pp)->hash_next) {
+      if (*pp == pcb) {
+        *pp = pcb->hash_next;
+        break;
+      }
+    }
+    pcb->hash_next = NULL;
+  }
+}
+
+/**
+ * Finds the active or TIME-WAIT PCB an incoming segment belongs to.
+ *
+ * @param local_ip destination address of the segment
+ * @param local_port destination port of the segment
+ * @param remote_ip source address of the segment
+ * @param remote_port source port of the segment
+ * @param inp netif the segment was received on
+ * @return the matching tcp_pcb or NULL if there is none
+ */
+struct tcp_pcb *
+tcp_pcb_hash_lookup(const ip_addr_t *local_ip, u16_t local_port,
+                    const ip_addr_t *remote_ip, u16_t remote_port,
+                    const struct netif *inp)
+{
+  struct tcp_pcb *pcb;
+
+  for (pcb = tcp_pcb_hash[tcp_pcb_hash_idx(local_ip, local_port, remote_ip, remote_port)];
+       pcb != NULL; pcb = pcb->hash_next) {
+    /* check if PCB is bound to specific netif */
+    if ((pcb->netif_idx != NETIF_NO_INDEX) && (pcb->netif_idx != netif_get_index(inp))) {
+      continue;
+    }
+    if ((pcb->remote_port == remote_port) &&
+        (pcb->local_port == local_port) &&
+        ip_addr_cmp(&pcb->remote_ip, remote_ip) &&
+        ip_addr_cmp(&pcb->local_ip, local_ip)) {
+      return pcb;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Finds the listening PCB for an incoming segment. A PCB listening on the
+ * specific destination address is preferred over one listening on ANY.
+ *
+ * @param local_ip destination address of the segment
+ * @param local_port destination port of the segment
+ * @param inp netif the segment was received on
+ * @return the matching tcp_pcb_listen or NULL if there is none
+ */
+struct tcp_pcb_listen *
+tcp_listen_pcb_hash_lookup(const ip_addr_t *local_ip, u16_t local_port,
+                           const struct netif *inp)
+{
+  struct tcp_pcb_listen *lpcb;
+  struct tcp_pcb_listen *lpcb_any = NULL;
+
+  for (lpcb = tcp_listen_pcb_hash[local_port % TCP_LISTEN_PCB_HASH_SIZE];
+       lpcb != NULL; lpcb = lpcb->hash_next) {
+    /* check if PCB is bound to specific netif */
+    if ((lpcb->netif_idx != NETIF_NO_INDEX) && (lpcb->netif_idx != netif_get_index(inp))) {
+      continue;
+    }
+    if (lpcb->local_port != local_port) {
+      continue;
+    }
+    if (IP_IS_ANY_TYPE_VAL(lpcb->local_ip)) {
+      /* found an ANY TYPE (IPv4/IPv6) match */
+      if (lpcb_any == NULL) {
+        lpcb_any = lpcb;
+      }
+    } else if (IP_ADDR_PCB_VERSION_MATCH_EXACT(lpcb, local_ip)) {
+      if (ip_addr_cmp(&lpcb->local_ip, local_ip)) {
+        /* found an exact match */
+        return lpcb;
+      } else if (ip_addr_isany(&lpcb->local_ip)) {
+        /* found an ANY-match */
+        if (lpcb_any == NULL) {
+          lpcb_any = lpcb;
+        }
+      }
+    }
+  }
+  return lpcb_any;
+}
+#endif /* LWIP_TCP_PCB_HASH */
+
 /**
  * Calculates a new initial sequence number for new connections.
  *
@@ -1955,11 +2610,104 @@ tcp_next_iss(struct tcp_pcb *pcb)
 
   LWIP_UNUSED_ARG(pcb);
 
+  TCP_TICKS_UPDATE();
   iss += tcp_ticks;       /* XXX */
   return iss;
 #endif /* LWIP_HOOK_TCP_ISN */
 }
 
+#if LWIP_TCP_SYN_REQ
+/**
+ * Calculates a new initial sequence number for a connection that has no
+ * pcb (yet), given by its addresses and ports.
+ *
+ * @return u32_t pseudo random sequence number
+ */
+u32_t
+tcp_next_iss_addr(const ip_addr_t *local_ip, u16_t local_port,
+                  const ip_addr_t *remote_ip, u16_t remote_port)
+{
+#ifdef LWIP_HOOK_TCP_ISN
+  return LWIP_HOOK_TCP_ISN(local_ip, local_port, remote_ip, remote_port);
+#else /* LWIP_HOOK_TCP_ISN */
+  LWIP_UNUSED_ARG(local_ip);
+  LWIP_UNUSED_ARG(local_port);
+  LWIP_UNUSED_ARG(remote_ip);
+  LWIP_UNUSED_ARG(remote_port);
+  return tcp_next_iss(NULL);
+#endif /* LWIP_HOOK_TCP_ISN */
+}
+#endif /* LWIP_TCP_SYN_REQ */
+
+#if LWIP_TCP_FASTOPEN || LWIP_TCP_SYNCOOKIES
+#define SIPHASH_CONST(hi, lo) (((u64_t)(hi) << 32) | (u64_t)(lo))
+#define SIPHASH_ROTL(x, b) (u64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define SIPHASH_ROUND(v0, v1, v2, v3) do { \
+  v0 += v1; v1 = SIPHASH_ROTL(v1, 13); v1 ^= v0; v0 = SIPHASH_ROTL(v0, 32); \
+  v2 += v3; v3 = SIPHASH_ROTL(v3, 16); v3 ^= v2; \
+  v0 += v3; v3 = SIPHASH_ROTL(v3, 21); v3 ^= v0; \
+  v2 += v1; v1 = SIPHASH_ROTL(v1, 17); v1 ^= v2; v2 = SIPHASH_ROTL(v2, 32); } while(0)
+
+/** Read 8 bytes as little endian 64 bit word */
+static u64_t
+tcp_siphash_get_u64(const u8_t *data)
+{
+  u64_t ret = 0;
+  int i;
+  for (i = 7; i >= 0; i--) {
+    ret = (ret << 8) | data[i];
+  }
+  return ret;
+}
+
+/**
+ * Keyed hash (SipHash-2-4) for the stateless cookies (TCP Fast Open and
+ * SYN cookies).
+ *
+ * @param key 16 bytes of secret key
+ * @param data the data to hash
+ * @param len length of data
+ * @return 64 bit hash value
+ */
+u64_t
+tcp_siphash(const u8_t *key, const u8_t *data, u16_t len)
+{
+  u64_t k0 = tcp_siphash_get_u64(key);
+  u64_t k1 = tcp_siphash_get_u64(key + 8);
+  u64_t v0 = k0 ^ SIPHASH_CONST(0x736f6d65UL, 0x70736575UL);
+  u64_t v1 = k1 ^ SIPHASH_CONST(0x646f7261UL, 0x6e646f6dUL);
+  u64_t v2 = k0 ^ SIPHASH_CONST(0x6c796765UL, 0x6e657261UL);
+  u64_t v3 = k1 ^ SIPHASH_CONST(0x74656462UL, 0x79746573UL);
+  u64_t m;
+  u16_t left = len;
+  u8_t last[8];
+
+  for (; left >= 8; left -= 8, data += 8) {
+    m = tcp_siphash_get_u64(data);
+    v3 ^= m;
+    SIPHASH_ROUND(v0, v1, v2, v3);
+    SIPHASH_ROUND(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+  /* last block: remaining bytes and the message length in the top byte */
+  memset(last, 0, sizeof(last));
+  MEMCPY(last, data, left);
+  last[7] = (u8_t)len;
+  m = tcp_siphash_get_u64(last);
+  v3 ^= m;
+  SIPHASH_ROUND(v0, v1, v2, v3);
+  SIPHASH_ROUND(v0, v1, v2, v3);
+  v0 ^= m;
+
+  v2 ^= 0xff;
+  SIPHASH_ROUND(v0, v1, v2, v3);
+  SIPHASH_ROUND(v0, v1, v2, v3);
+  SIPHASH_ROUND(v0, v1, v2, v3);
+  SIPHASH_ROUND(v0, v1, v2, v3);
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+#endif /* LWIP_TCP_FASTOPEN || LWIP_TCP_SYNCOOKIES */
+
 #if TCP_CALCULATE_EFF_SEND_MSS
 /**
  * Calculates the effective send mss that can be used for a specific IP address
@@ -1992,6 +2740,15 @@ tcp_eff_send_mss_netif(u16_t sendmss, struct netif *outif, const ip_addr_t *dest
       return sendmss;
     }
     mtu = outif->mtu;
+#if IP_PMTUD
+    {
+      /* a smaller path MTU might be known for the destination */
+      u16_t pmtu = ip4_pmtu_get(ip_2_ip4(dest));
+      if ((pmtu != 0) && ((mtu == 0) || (pmtu < mtu))) {
+        mtu = pmtu;
+      }
+    }
+#endif /* IP_PMTUD */
   }
 #endif /* LWIP_IPV4 */
 
@@ -2024,6 +2781,36 @@ tcp_eff_send_mss_netif(u16_t sendmss, struct netif *outif, const ip_addr_t *dest
 }
 #endif /* TCP_CALCULATE_EFF_SEND_MSS */
 
+/**
+ * The smoothed RTT of a connection in milliseconds, from the most precise
+ * estimate available: echoed timestamps (LWIP_TCP_TS_RTTM), RACK, the
+ * millisecond samples taken for pacing, or sa (slow timer ticks).
+ *
+ * @param pcb the tcp_pcb to check
+ * @return smoothed RTT in milliseconds, 0 if there is no estimate yet
+ */
+u32_t
+tcp_srtt_ms(const struct tcp_pcb *pcb)
+{
+#if LWIP_TCP_TS_RTTM
+  if (pcb->ts_srtt != 0) {
+    return LWIP_MAX(pcb->ts_srtt >> 3, 1);
+  }
+#endif /* LWIP_TCP_TS_RTTM */
+#if LWIP_TCP_RACK
+  if (pcb->rack_flags & TCP_RACK_RTT_VALID) {
+    return LWIP_MAX(pcb->rack_srtt, 1);
+  }
+#endif /* LWIP_TCP_RACK */
+#if LWIP_TCP_PACING
+  if (pcb->pacing_srtt != 0) {
+    return LWIP_MAX(pcb->pacing_srtt >> 3, 1);
+  }
+#endif /* LWIP_TCP_PACING */
+  /* sa is the smoothed RTT in slow timer ticks, scaled by 8 */
+  return (pcb->sa > 0) ? ((u32_t)pcb->sa * TCP_SLOW_INTERVAL / 8) : 0;
+}
+
 /** Helper function for tcp_netif_ip_addr_changed() that iterates a pcb list */
 static void
 tcp_netif_ip_addr_changed_pcblist(const ip_addr_t* old_addr, struct tcp_pcb* pcb_list)
@@ -2108,6 +2895,94 @@ tcp_tcp_get_tcp_addrinfo(struct tcp_pcb *pcb, int local, ip_addr_t *addr, u16_t
   return ERR_VAL;
 }
 
+#if LWIP_TCP_INFO
+/**
+ * @ingroup tcp_raw
+ * Get a snapshot of the state and the counters of a connection, e.g. for
+ * telemetry. For a listening pcb, only the state is set.
+ *
+ * @param pcb the tcp_pcb to query
+ * @param info where to store the snapshot
+ * @return ERR_OK, or ERR_ARG for invalid arguments
+ */
+err_t
+tcp_get_info(const struct tcp_pcb *pcb, struct tcp_info *info)
+{
+  LWIP_ERROR("tcp_get_info: invalid pcb", pcb != NULL, return ERR_ARG);
+  LWIP_ERROR("tcp_get_info: invalid info", info != NULL, return ERR_ARG);
+
+  memset(info, 0, sizeof(struct tcp_info));
+  info->state = (u8_t)pcb->state;
+  if (pcb->state == LISTEN) {
+    /* a tcp_pcb_listen has none of the other fields */
+    return ERR_OK;
+  }
+
+#if LWIP_TCP_TIMESTAMPS
+  if (pcb->flags & TF_TIMESTAMP) {
+    info->options |= TCP_INFO_OPT_TIMESTAMPS;
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+#if LWIP_TCP_SACK_OUT
+  if (pcb->flags & TF_SACK) {
+    info->options |= TCP_INFO_OPT_SACK;
+  }
+#endif /* LWIP_TCP_SACK_OUT */
+#if LWIP_WND_SCALE
+  if (pcb->flags & TF_WND_SCALE) {
+    info->options |= TCP_INFO_OPT_WSCALE;
+    info->snd_wscale = pcb->snd_scale;
+    info->rcv_wscale = pcb->rcv_scale;
+  }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_ECN
+  if (pcb->ecn & TCP_ECN_ON) {
+    info->options |= TCP_INFO_OPT_ECN;
+  }
+#endif /* LWIP_TCP_ECN */
+  info->retransmits = pcb->nrtx;
+  info->dupacks = pcb->dupacks;
+  info->mss = pcb->mss;
+
+  /* sa is the smoothed RTT * 8, sv the RTT variation * 4 (in slow timer ticks) */
+  info->rto = (u32_t)pcb->rto * TCP_SLOW_INTERVAL;
+  info->rtt = tcp_srtt_ms(pcb);
+  info->rttvar = (u32_t)(pcb->sv >> 2) * TCP_SLOW_INTERVAL;
+#if LWIP_TCP_TS_RTTM
+  if (pcb->ts_srtt != 0) {
+    /* measured with timestamps: take the millisecond variation */
+    info->rttvar = pcb->ts_rttvar >> 2;
+  }
+#endif /* LWIP_TCP_TS_RTTM */
+
+  info->cwnd = pcb->cwnd;
+  info->ssthresh = pcb->ssthresh;
+  info->snd_wnd = pcb->snd_wnd;
+  info->rcv_wnd = pcb->rcv_wnd;
+  info->snd_buf = pcb->snd_buf;
+  if (pcb->state >= SYN_SENT) {
+    info->unacked = pcb->snd_nxt - pcb->lastack;
+    info->unsent = pcb->snd_lbb - pcb->snd_nxt;
+  }
+  info->snd_queuelen = pcb->snd_queuelen;
+#if TCP_QUEUE_OOSEQ
+  {
+    const struct tcp_seg *seg;
+    for (seg = pcb->ooseq; seg != NULL; seg = seg->next) {
+      info->ooseq_segs++;
+      info->ooseq_bytes += seg->len;
+    }
+  }
+#endif /* TCP_QUEUE_OOSEQ */
+
+  info->total_retrans = pcb->info_retrans;
+  info->fast_retrans = pcb->info_fast_retrans;
+  info->rto_events = pcb->info_rto;
+  info->bytes_acked = pcb->info_bytes_acked;
+  return ERR_OK;
+}
+#endif /* LWIP_TCP_INFO */
+
 #if TCP_QUEUE_OOSEQ
 /* Free all ooseq pbufs (and possibly reset SACK state) */
 void
@@ -2116,6 +2991,8 @@ tcp_free_ooseq(struct tcp_pcb *pcb)
   if (pcb->ooseq) {
     tcp_segs_free(pcb->ooseq);
     pcb->ooseq = NULL;
+    TCP_OOSEQ_TREE_CLEAR(pcb);
+    TCP_OOSEQ_MEM_SUB(pcb, pcb->ooseq_pbufs);
 #if LWIP_TCP_SACK_OUT
     memset(pcb->rcv_sacks, 0, sizeof(pcb->rcv_sacks));
 #endif /* LWIP_TCP_SACK_OUT */
@@ -2236,6 +3113,17 @@ tcp_debug_print_pcbs(void)
                        pcb->snd_nxt, pcb->rcv_nxt));
     tcp_debug_print_state(pcb->state);
   }
+#if LWIP_TCP_TW_COMPACT
+  {
+    struct tcp_pcb_tw *tw;
+    LWIP_DEBUGF(TCP_DEBUG, ("TIME-WAIT records:\n"));
+    for (tw = tcp_tw_records; tw != NULL; tw = tw->next) {
+      LWIP_DEBUGF(TCP_DEBUG, ("Local port %"U16_F", foreign port %"U16_F" snd_nxt %"U32_F" rcv_nxt %"U32_F" expires %"U32_F"\n",
+                         tw->local_port, tw->remote_port,
+                         tw->snd_nxt, tw->rcv_nxt, tw->expires));
+    }
+  }
+#endif /* LWIP_TCP_TW_COMPACT */
 }
 
 /**
@@ -0,0 +1,264 @@
+/**
+ * @file
+ * Transmission Control Protocol, receive buffer auto-tuning
+ *
+ * With LWIP_TCP_RCV_AUTOTUNE, the receive window of a connection is not
+ * fixed to TCP_WND. It starts there and grows when the application consumes
+ * more data per round-trip time than the current window lets the peer send:
+ * - the round-trip time is measured on the receive side as the time it takes
+ *   to receive one window of data after it has been announced,
+ * - once per round-trip time, tcp_recved() compares the amount of data the
+ *   application consumed in that period with the previous best and grows the
+ *   window to twice that amount,
+ * - the window never grows beyond the limit of the pcb (tcp_set_rcvbuf(),
+ *   SO_RCVBUF) and the extra window of all pcbs together is limited by
+ *   TCP_RCV_AUTOTUNE_MEM,
+ * - when PBUF_POOL runs empty, tcp_rcv_autotune_reclaim() takes back the
+ *   extra window of all connections and blocks growing for a while.
+ *
+ * Window that has already been announced to the peer is never taken back,
+ * so shrinking the window may take effect only after the application has
+ * consumed more data.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/sys.h"
+
+/** After running out of memory, windows are not grown for this long (ms) */
+#define TCP_RCV_AUTOTUNE_PRESSURE_HOLD 1000
+
+/** Bytes of receive window all pcbs have grown beyond their default */
+static u32_t tcp_rcv_autotune_mem;
+/** sys_now() of the last memory shortage */
+static u32_t tcp_rcv_pressure_time;
+static u8_t tcp_rcv_pressure;
+
+/** The largest window a pcb can announce */
+static u32_t
+tcp_rcv_buf_limit(const struct tcp_pcb *pcb)
+{
+  u32_t limit = 0xFFFF;
+#if LWIP_WND_SCALE
+  if (pcb->flags & TF_WND_SCALE) {
+    limit = (u32_t)0xFFFF << pcb->rcv_scale;
+  }
+#endif /* LWIP_WND_SCALE */
+  return LWIP_MIN(limit, pcb->rcv_buf_max);
+}
+
+/** Grow the window of a pcb to 'target' bytes (as far as the limits allow) */
+static void
+tcp_rcv_buf_grow(struct tcp_pcb *pcb, u32_t target)
+{
+  u32_t delta;
+
+  target = LWIP_MIN(target, tcp_rcv_buf_limit(pcb));
+  if (target <= pcb->rcv_buf) {
+    return;
+  }
+  delta = LWIP_MIN(target - pcb->rcv_buf, TCP_RCV_AUTOTUNE_MEM - tcp_rcv_autotune_mem);
+  if (delta == 0) {
+    return;
+  }
+  tcp_rcv_autotune_mem += delta;
+  pcb->rcv_buf = (tcpwnd_size_t)(pcb->rcv_buf + delta);
+  pcb->rcv_wnd = (tcpwnd_size_t)(pcb->rcv_wnd + delta);
+  LWIP_DEBUGF(TCP_WND_DEBUG, ("tcp_rcv_buf_grow: window %"TCPWNDSIZE_F"\n", pcb->rcv_buf));
+}
+
+/** Shrink the window of a pcb to 'target' bytes (but not below the default
+ * and not by the part already announced to the peer) */
+static void
+tcp_rcv_buf_shrink(struct tcp_pcb *pcb, u32_t target)
+{
+  u32_t announced = 0;
+  u32_t delta;
+
+  target = LWIP_MAX(target, TCP_WND_DEFAULT(pcb));
+  if (target >= pcb->rcv_buf) {
+    return;
+  }
+  if (TCP_SEQ_GT(pcb->rcv_ann_right_edge, pcb->rcv_nxt)) {
+    announced = pcb->rcv_ann_right_edge - pcb->rcv_nxt;
+  }
+  if (pcb->rcv_wnd <= announced) {
+    return;
+  }
+  delta = LWIP_MIN(pcb->rcv_buf - target, pcb->rcv_wnd - announced);
+  LWIP_ASSERT("tcp_rcv_buf_shrink: accounting", tcp_rcv_autotune_mem >= delta);
+  tcp_rcv_autotune_mem -= delta;
+  pcb->rcv_buf = (tcpwnd_size_t)(pcb->rcv_buf - delta);
+  pcb->rcv_wnd = (tcpwnd_size_t)(pcb->rcv_wnd - delta);
+  tcp_update_rcv_ann_wnd(pcb);
+  LWIP_DEBUGF(TCP_WND_DEBUG, ("tcp_rcv_buf_shrink: window %"TCPWNDSIZE_F"\n", pcb->rcv_buf));
+}
+
+/**
+ * Reset the window of a pcb to the default (called when the window is
+ * (re-)initialized before the connection is established).
+ */
+void
+tcp_rcv_autotune_init(struct tcp_pcb *pcb)
+{
+  LWIP_ASSERT("tcp_rcv_autotune_init: window grown", pcb->rcv_buf <= TCP_WND_DEFAULT(pcb));
+  pcb->rcv_buf = TCP_WND_DEFAULT(pcb);
+}
+
+/**
+ * Measure the round-trip time on the receive side: called after in-sequence
+ * data advanced rcv_nxt. A measurement ends when data beyond the window
+ * available at its start arrives, which the peer can only send after it has
+ * seen a later window update.
+ */
+void
+tcp_rcv_rtt_measure(struct tcp_pcb *pcb)
+{
+  u32_t now = sys_now();
+
+  if (pcb->rcv_rtt_time != 0) {
+    u32_t sample;
+    if (TCP_SEQ_LEQ(pcb->rcv_nxt, pcb->rcv_rtt_seq)) {
+      return;
+    }
+    sample = LWIP_MAX(now - pcb->rcv_rtt_time, 1);
+    if ((pcb->rcv_rtt == 0) || (sample < pcb->rcv_rtt)) {
+      /* the sender may have been limited by something else than our window,
+         so trust smaller samples more */
+      pcb->rcv_rtt = sample;
+    } else {
+      pcb->rcv_rtt += (sample - pcb->rcv_rtt) >> 3;
+    }
+  }
+  pcb->rcv_rtt_seq = pcb->rcv_nxt + pcb->rcv_wnd;
+  pcb->rcv_rtt_time = now;
+}
+
+/**
+ * Account data consumed by the application (called by tcp_recved() after
+ * rcv_wnd has been updated) and resize the window once per round-trip time.
+ */
+void
+tcp_rcv_autotune(struct tcp_pcb *pcb, u16_t len)
+{
+  u32_t now = sys_now();
+
+  if (pcb->rcv_buf > pcb->rcv_buf_max) {
+    /* limit lowered, possibly not completely done by tcp_set_rcvbuf() */
+    tcp_rcv_buf_shrink(pcb, pcb->rcv_buf_max);
+  }
+  if (tcp_rcv_pressure) {
+    if ((u32_t)(now - tcp_rcv_pressure_time) < TCP_RCV_AUTOTUNE_PRESSURE_HOLD) {
+      tcp_rcv_buf_shrink(pcb, 0);
+      pcb->rcv_copied = 0;
+      pcb->rcv_space_time = now;
+      return;
+    }
+    tcp_rcv_pressure = 0;
+  }
+
+  pcb->rcv_copied += len;
+  if ((pcb->rcv_rtt == 0) || ((u32_t)(now - pcb->rcv_space_time) < pcb->rcv_rtt)) {
+    return;
+  }
+  if (pcb->rcv_copied > pcb->rcv_space) {
+    /* the application keeps up with the peer: give the peer room to send
+       twice as much in the next round-trip time */
+    pcb->rcv_space = pcb->rcv_copied;
+    tcp_rcv_buf_grow(pcb, 2 * pcb->rcv_copied);
+  }
+  pcb->rcv_copied = 0;
+  pcb->rcv_space_time = now;
+}
+
+/**
+ * Give back the extra window of a pcb that is deallocated.
+ */
+void
+tcp_rcv_autotune_free(struct tcp_pcb *pcb)
+{
+  if (pcb->rcv_buf > TCP_WND_DEFAULT(pcb)) {
+    u32_t extra = pcb->rcv_buf - TCP_WND_DEFAULT(pcb);
+    LWIP_ASSERT("tcp_rcv_autotune_free: accounting", tcp_rcv_autotune_mem >= extra);
+    tcp_rcv_autotune_mem -= extra;
+    pcb->rcv_buf = TCP_WND_DEFAULT(pcb);
+  }
+}
+
+/**
+ * Memory is short: shrink the window of all connections back to the default
+ * (as far as it has not been announced) and don't grow any window for
+ * TCP_RCV_AUTOTUNE_PRESSURE_HOLD milliseconds. Windows that can only be
+ * shrunk partially now are shrunk further when the application reads.
+ */
+void
+tcp_rcv_autotune_reclaim(void)
+{
+  struct tcp_pcb *pcb;
+
+  tcp_rcv_pressure = 1;
+  tcp_rcv_pressure_time = sys_now();
+  for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+    tcp_rcv_buf_shrink(pcb, 0);
+    pcb->rcv_space = 0;
+  }
+}
+
+/**
+ * @ingroup tcp_raw
+ * Set the limit of the receive window of a pcb (the equivalent of
+ * SO_RCVBUF). The window starts at TCP_WND and grows up to this limit if the
+ * application keeps up with the data. Limits smaller than TCP_WND are
+ * raised to TCP_WND. Connections accepted on a listening pcb inherit its
+ * limit.
+ *
+ * @param pcb the tcp_pcb (may be a listening pcb)
+ * @param size the limit in bytes
+ */
+void
+tcp_set_rcvbuf(struct tcp_pcb *pcb, u32_t size)
+{
+  LWIP_ERROR("tcp_set_rcvbuf: invalid pcb", pcb != NULL, return);
+
+  size = LWIP_MAX(size, TCP_WND);
+  if (pcb->state == LISTEN) {
+    ((struct tcp_pcb_listen *)pcb)->rcv_buf_max = size;
+    return;
+  }
+  pcb->rcv_buf_max = size;
+  /* start over with the consumption history */
+  pcb->rcv_space = 0;
+  tcp_rcv_buf_shrink(pcb, size);
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_RCV_AUTOTUNE */
@@ -0,0 +1,329 @@
+/**
+ * @file
+ * Transmission Control Protocol, congestion control
+ *
+ * The congestion control algorithms a tcp_pcb can use (see struct tcp_cc_ops):
+ * - Reno/NewReno (RFC 5681 with appropriate byte counting, RFC 3465)
+ * - CUBIC (RFC 9438), if LWIP_TCP_CUBIC is enabled
+ *
+ * tcp_in.c and tcp_out.c call the hooks of pcb->cc when data is acked, when
+ * loss is detected by fast retransmit, on retransmission timeouts and when
+ * sending restarts after the connection was idle.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/sys.h"
+
+#include <string.h>
+
+/** All algorithms selectable by name */
+static const struct tcp_cc_ops *const tcp_cc_algos[] = {
+  &tcp_cc_reno,
+#if LWIP_TCP_CUBIC
+  &tcp_cc_cubic,
+#endif /* LWIP_TCP_CUBIC */
+};
+
+/**
+ * @ingroup tcp_raw
+ * Select the congestion control algorithm of a connection by name
+ * ("reno" or "cubic"). Listening pcbs pass their algorithm on to the
+ * connections they accept.
+ *
+ * @param pcb tcp_pcb (connection or listen pcb) to change
+ * @param name name of the algorithm
+ * @return ERR_OK on success, ERR_VAL if no such algorithm is compiled in
+ */
+err_t
+tcp_set_congestion(struct tcp_pcb *pcb, const char *name)
+{
+  size_t i;
+
+  LWIP_ERROR("tcp_set_congestion: invalid pcb", pcb != NULL, return ERR_ARG);
+  LWIP_ERROR("tcp_set_congestion: invalid name", name != NULL, return ERR_ARG);
+
+  for (i = 0; i < LWIP_ARRAYSIZE(tcp_cc_algos); i++) {
+    if (strcmp(tcp_cc_algos[i]->name, name) == 0) {
+      tcp_set_congestion_ops(pcb, tcp_cc_algos[i]);
+      return ERR_OK;
+    }
+  }
+  return ERR_VAL;
+}
+
+/**
+ * @ingroup tcp_raw
+ * Set the congestion control algorithm of a connection. This can be used
+ * to plug in an application-provided algorithm.
+ *
+ * @param pcb tcp_pcb (connection or listen pcb) to change
+ * @param ops the algorithm (must stay valid while the pcb uses it)
+ */
+void
+tcp_set_congestion_ops(struct tcp_pcb *pcb, const struct tcp_cc_ops *ops)
+{
+  LWIP_ERROR("tcp_set_congestion_ops: invalid pcb", pcb != NULL, return);
+  LWIP_ERROR("tcp_set_congestion_ops: invalid ops",
+             (ops != NULL) && (ops->ack != NULL) && (ops->loss != NULL) && (ops->rto != NULL),
+             return);
+
+  pcb->cc = ops;
+  if (pcb->state >= ESTABLISHED) {
+    /* switching algorithms on a running connection keeps cwnd and ssthresh */
+    TCP_CC_EVENT(pcb, init);
+  }
+}
+
+/**
+ * Slow start (RFC 3465 section 2.2), shared by all algorithms: grow cwnd by
+ * the number of bytes acked, limited to 2 SMSS per ACK (1 SMSS after an RTO).
+ *
+ * @param pcb the tcp_pcb in slow start
+ * @param acked number of bytes acked by the current ACK
+ */
+void
+tcp_cc_slow_start(struct tcp_pcb *pcb, tcpwnd_size_t acked)
+{
+  tcpwnd_size_t increase;
+  /* limit to 1 SMSS segment during period following RTO */
+  u8_t num_seg = (pcb->flags & TF_RTO) ? 1 : 2;
+
+  increase = LWIP_MIN(acked, (tcpwnd_size_t)(num_seg * pcb->mss));
+  TCP_WND_INC(pcb->cwnd, increase);
+  LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: slow start cwnd %"TCPWNDSIZE_F"\n", pcb->cwnd));
+}
+
+static void
+tcp_reno_ack(struct tcp_pcb *pcb, tcpwnd_size_t acked)
+{
+  if (pcb->cwnd < pcb->ssthresh) {
+    tcp_cc_slow_start(pcb, acked);
+  } else {
+    /* RFC 3465, section 2.1 Congestion Avoidance */
+    TCP_WND_INC(pcb->bytes_acked, acked);
+    if (pcb->bytes_acked >= pcb->cwnd) {
+      pcb->bytes_acked = (tcpwnd_size_t)(pcb->bytes_acked - pcb->cwnd);
+      TCP_WND_INC(pcb->cwnd, pcb->mss);
+    }
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: congestion avoidance cwnd %"TCPWNDSIZE_F"\n", pcb->cwnd));
+  }
+}
+
+static void
+tcp_reno_loss(struct tcp_pcb *pcb)
+{
+  /* Set ssthresh to half of the minimum of the current
+   * cwnd and the advertised window */
+  pcb->ssthresh = LWIP_MIN(pcb->cwnd, pcb->snd_wnd) / 2;
+
+  /* The minimum value for ssthresh should be 2 MSS */
+  if (pcb->ssthresh < (2U * pcb->mss)) {
+    LWIP_DEBUGF(TCP_FR_DEBUG,
+                ("tcp_receive: The minimum value for ssthresh %"TCPWNDSIZE_F
+                 " should be min 2 mss %"U16_F"...\n",
+                 pcb->ssthresh, (u16_t)(2*pcb->mss)));
+    pcb->ssthresh = 2 * pcb->mss;
+  }
+}
+
+static void
+tcp_reno_rto(struct tcp_pcb *pcb)
+{
+  tcpwnd_size_t eff_wnd = LWIP_MIN(pcb->cwnd, pcb->snd_wnd);
+  pcb->ssthresh = eff_wnd >> 1;
+  if (pcb->ssthresh < (tcpwnd_size_t)(pcb->mss << 1)) {
+    pcb->ssthresh = (tcpwnd_size_t)(pcb->mss << 1);
+  }
+  pcb->cwnd = pcb->mss;
+}
+
+/** Reno/NewReno, the default algorithm */
+const struct tcp_cc_ops tcp_cc_reno = {
+  "reno",
+  NULL,
+  tcp_reno_ack,
+  tcp_reno_loss,
+  tcp_reno_rto,
+  NULL
+};
+
+#if LWIP_TCP_CUBIC
+
+/* Multiplicative decrease factor beta_cubic = 0.7, scaled by 1024 */
+#define TCP_CUBIC_BETA        717
+/* Reno-friendly additive increase alpha_cubic = 3 * (1 - beta) / (1 + beta), scaled by 1024 */
+#define TCP_CUBIC_ALPHA       542
+/* Limit for |t - K| in ms: keeps t^3 within 64 bits */
+#define TCP_CUBIC_MAX_DELTA_T 0xFFFFFU
+
+/** Integer cube root (bitwise, one result bit per round) */
+static u32_t
+tcp_cubic_cbrt(u64_t a)
+{
+  u32_t y = 0;
+  int s;
+
+  for (s = 63; s >= 0; s -= 3) {
+    u64_t b;
+    y = 2 * y;
+    b = 3 * (u64_t)y * (y + 1) + 1;
+    if ((a >> s) >= b) {
+      a -= b << s;
+      y++;
+    }
+  }
+  return y;
+}
+
+static void
+tcp_cubic_init(struct tcp_pcb *pcb)
+{
+  memset(&pcb->cubic, 0, sizeof(pcb->cubic));
+}
+
+static void
+tcp_cubic_ack(struct tcp_pcb *pcb, tcpwnd_size_t acked)
+{
+  struct tcp_cubic *c = &pcb->cubic;
+  u32_t now = sys_now();
+  u32_t t, dt, cnt;
+  u64_t delta, target;
+
+  c->last_ack = now;
+  if (pcb->cwnd < pcb->ssthresh) {
+    tcp_cc_slow_start(pcb, acked);
+    return;
+  }
+
+  if (c->origin == 0) {
+    /* first ACK in congestion avoidance after a reduction: start an epoch */
+    c->epoch_start = now;
+    c->w_est = pcb->cwnd;
+    pcb->bytes_acked = 0;
+    if (pcb->cwnd < c->w_max) {
+      /* K = cbrt((W_max - cwnd) / C) in seconds with C = 0.4 segments/s^3, here in ms */
+      c->k = tcp_cubic_cbrt((u64_t)(c->w_max - pcb->cwnd) * 2500000000UL / pcb->mss);
+      c->origin = c->w_max;
+    } else {
+      c->k = 0;
+      c->origin = pcb->cwnd;
+    }
+  }
+
+  /* target = W_cubic(t + RTT) = C * (t + RTT - K)^3 + W_max */
+  t = now - c->epoch_start + tcp_srtt_ms(pcb);
+  dt = (t > c->k) ? (t - c->k) : (c->k - t);
+  dt = LWIP_MIN(dt, TCP_CUBIC_MAX_DELTA_T);
+  delta = ((u64_t)dt * dt * dt / 1000000) * 4 * pcb->mss / 10000;
+  if (t >= c->k) {
+    target = c->origin + delta;
+  } else {
+    target = (delta < c->origin) ? (c->origin - delta) : 0;
+  }
+
+  /* Reno-friendly region (RFC 9438 4.3): never grow slower than Reno would */
+  delta = (u64_t)acked * pcb->mss * TCP_CUBIC_ALPHA / ((u64_t)pcb->cwnd * 1024);
+  TCP_WND_INC(c->w_est, (tcpwnd_size_t)delta);
+  if (c->w_est > target) {
+    target = c->w_est;
+  }
+
+  /* grow by at most 50% per RTT (RFC 9438 4.2) */
+  target = LWIP_MIN(target, (u64_t)pcb->cwnd + (pcb->cwnd >> 1));
+  if (target > pcb->cwnd) {
+    /* one SMSS for every 'cnt' bytes acked reaches target in one RTT */
+    cnt = (u32_t)((u64_t)pcb->cwnd * pcb->mss / (target - pcb->cwnd));
+    TCP_WND_INC(pcb->bytes_acked, acked);
+    if (pcb->bytes_acked >= cnt) {
+      pcb->bytes_acked = (tcpwnd_size_t)(pcb->bytes_acked - cnt);
+      TCP_WND_INC(pcb->cwnd, pcb->mss);
+    }
+  }
+  LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: cubic cwnd %"TCPWNDSIZE_F" target %"U32_F"\n",
+                               pcb->cwnd, (u32_t)target));
+}
+
+/** Multiplicative decrease shared by loss and RTO */
+static void
+tcp_cubic_reduce(struct tcp_pcb *pcb)
+{
+  struct tcp_cubic *c = &pcb->cubic;
+  tcpwnd_size_t eff_wnd = LWIP_MIN(pcb->cwnd, pcb->snd_wnd);
+
+  if (eff_wnd < c->w_max) {
+    /* fast convergence: the window shrank since the last loss, release bandwidth */
+    c->w_max = (tcpwnd_size_t)((u64_t)eff_wnd * (1024 + TCP_CUBIC_BETA) / 2048);
+  } else {
+    c->w_max = eff_wnd;
+  }
+  c->origin = 0;
+  pcb->ssthresh = (tcpwnd_size_t)((u64_t)eff_wnd * TCP_CUBIC_BETA / 1024);
+  if (pcb->ssthresh < (2U * pcb->mss)) {
+    pcb->ssthresh = (tcpwnd_size_t)(2U * pcb->mss);
+  }
+}
+
+static void
+tcp_cubic_rto(struct tcp_pcb *pcb)
+{
+  tcp_cubic_reduce(pcb);
+  pcb->cwnd = pcb->mss;
+}
+
+static void
+tcp_cubic_idle(struct tcp_pcb *pcb)
+{
+  struct tcp_cubic *c = &pcb->cubic;
+
+  if (c->origin != 0) {
+    /* the idle period does not count as growth time: shift the epoch */
+    u32_t now = sys_now();
+    c->epoch_start += now - c->last_ack;
+    c->last_ack = now;
+  }
+}
+
+/** CUBIC (RFC 9438) */
+const struct tcp_cc_ops tcp_cc_cubic = {
+  "cubic",
+  tcp_cubic_init,
+  tcp_cubic_ack,
+  tcp_cubic_reduce,
+  tcp_cubic_rto,
+  tcp_cubic_idle
+};
+
+#endif /* LWIP_TCP_CUBIC */
+
+#endif /* LWIP_TCP */
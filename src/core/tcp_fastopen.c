@@ -0,0 +1,228 @@
+/**
+ * @file
+ * Transmission Control Protocol, TCP Fast Open cookies
+ *
+ * TCP Fast Open (RFC 7413) lets a client send data in its SYN once it has
+ * obtained a cookie from the server. This file implements both sides of
+ * the cookie handling:
+ * - servers generate the cookie from the client's IP address with a keyed
+ *   hash (tcp_siphash()) and validate cookies received in a SYN the same way,
+ * - clients keep the cookies (and the MSS) of the last
+ *   TCP_FASTOPEN_CACHE_SIZE servers in a small LRU cache.
+ *
+ * The option handling and the SYN/data processing are in tcp_in.c and
+ * tcp_out.c.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_FASTOPEN /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+
+#include <string.h>
+
+/** One entry of the client cookie cache */
+struct tcp_fastopen_cache_entry {
+  ip_addr_t addr;
+  /** last use of this entry (tcp_fastopen_cache_ctr) for LRU replacement */
+  u32_t used;
+  u16_t mss;
+  /** 0: entry unused */
+  u8_t cookie_len;
+  u8_t cookie[TCP_FASTOPEN_COOKIE_LEN];
+};
+
+static struct tcp_fastopen_cache_entry tcp_fastopen_cache[TCP_FASTOPEN_CACHE_SIZE];
+static u32_t tcp_fastopen_cache_ctr;
+
+/** secret key of the cookie hash */
+static u8_t tcp_fastopen_key[TCP_FASTOPEN_KEY_LEN];
+
+/**
+ * Initialize the cookie key from LWIP_RAND() (called by tcp_init()).
+ */
+void
+tcp_fastopen_init(void)
+{
+#ifdef LWIP_RAND
+  u8_t key[TCP_FASTOPEN_KEY_LEN];
+  u8_t i;
+  for (i = 0; i < TCP_FASTOPEN_KEY_LEN; i += 4) {
+    u32_t r = LWIP_RAND();
+    MEMCPY(&key[i], &r, sizeof(r));
+  }
+  tcp_fastopen_set_key(key);
+#endif /* LWIP_RAND */
+}
+
+/**
+ * @ingroup tcp_raw
+ * Set the secret key used to generate and validate TCP Fast Open cookies.
+ * Cookies handed out with the previous key become invalid (clients fall
+ * back to a normal handshake and get a new cookie).
+ *
+ * @param key TCP_FASTOPEN_KEY_LEN bytes of secret random data
+ */
+void
+tcp_fastopen_set_key(const u8_t *key)
+{
+  LWIP_ERROR("tcp_fastopen_set_key: invalid key", key != NULL, return);
+
+  MEMCPY(tcp_fastopen_key, key, TCP_FASTOPEN_KEY_LEN);
+}
+
+/**
+ * Server: generate the cookie for a client address.
+ *
+ * @param addr IP address of the client
+ * @param cookie TCP_FASTOPEN_COOKIE_LEN bytes to store the cookie to
+ */
+void
+tcp_fastopen_cookie_gen(const ip_addr_t *addr, u8_t *cookie)
+{
+  u64_t hash;
+  u8_t i;
+
+#if LWIP_IPV6
+  if (IP_IS_V6(addr)) {
+    hash = tcp_siphash(tcp_fastopen_key, (const u8_t *)ip_2_ip6(addr)->addr, 16);
+  }
+#endif /* LWIP_IPV6 */
+#if LWIP_IPV4 && LWIP_IPV6
+  else
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
+#if LWIP_IPV4
+  {
+    hash = tcp_siphash(tcp_fastopen_key, (const u8_t *)&ip_2_ip4(addr)->addr, 4);
+  }
+#endif /* LWIP_IPV4 */
+  for (i = 0; i < TCP_FASTOPEN_COOKIE_LEN; i++) {
+    cookie[i] = (u8_t)(hash >> (8 * i));
+  }
+}
+
+/**
+ * Server: check a cookie received from a client.
+ *
+ * @param addr IP address of the client
+ * @param cookie the cookie received
+ * @param len length of the cookie
+ * @return 1 if the cookie is valid, 0 otherwise
+ */
+u8_t
+tcp_fastopen_cookie_valid(const ip_addr_t *addr, const u8_t *cookie, u8_t len)
+{
+  u8_t expected[TCP_FASTOPEN_COOKIE_LEN];
+
+  if (len != TCP_FASTOPEN_COOKIE_LEN) {
+    return 0;
+  }
+  tcp_fastopen_cookie_gen(addr, expected);
+  return memcmp(cookie, expected, TCP_FASTOPEN_COOKIE_LEN) == 0;
+}
+
+static struct tcp_fastopen_cache_entry *
+tcp_fastopen_cache_find(const ip_addr_t *addr)
+{
+  u8_t i;
+  for (i = 0; i < TCP_FASTOPEN_CACHE_SIZE; i++) {
+    if ((tcp_fastopen_cache[i].cookie_len != 0) &&
+        ip_addr_cmp(&tcp_fastopen_cache[i].addr, addr)) {
+      return &tcp_fastopen_cache[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Client: look up the cookie cached for a server.
+ *
+ * @param addr IP address of the server
+ * @param cookie TCP_FASTOPEN_COOKIE_LEN bytes to store the cookie to
+ * @param mss receives the MSS the server announced with that cookie
+ * @return the length of the cookie (0 if none is cached)
+ */
+u8_t
+tcp_fastopen_cookie_get(const ip_addr_t *addr, u8_t *cookie, u16_t *mss)
+{
+  struct tcp_fastopen_cache_entry *entry = tcp_fastopen_cache_find(addr);
+  if (entry == NULL) {
+    return 0;
+  }
+  entry->used = ++tcp_fastopen_cache_ctr;
+  MEMCPY(cookie, entry->cookie, entry->cookie_len);
+  *mss = entry->mss;
+  return entry->cookie_len;
+}
+
+/**
+ * Client: store the cookie received from a server, replacing the least
+ * recently used entry if the cache is full. Cookies that don't fit the
+ * option space we reserve for them are not cached.
+ *
+ * @param addr IP address of the server
+ * @param cookie the cookie received
+ * @param len length of the cookie (0 removes the entry)
+ * @param mss the MSS the server announced
+ */
+void
+tcp_fastopen_cookie_set(const ip_addr_t *addr, const u8_t *cookie, u8_t len, u16_t mss)
+{
+  struct tcp_fastopen_cache_entry *entry = tcp_fastopen_cache_find(addr);
+  u8_t i;
+
+  if ((len < 4) || (len > TCP_FASTOPEN_COOKIE_LEN) || (len & 1)) {
+    /* invalid, too long for us or removal: forget this server */
+    if (entry != NULL) {
+      entry->cookie_len = 0;
+    }
+    return;
+  }
+  if (entry == NULL) {
+    entry = &tcp_fastopen_cache[0];
+    for (i = 0; i < TCP_FASTOPEN_CACHE_SIZE; i++) {
+      if (tcp_fastopen_cache[i].cookie_len == 0) {
+        entry = &tcp_fastopen_cache[i];
+        break;
+      }
+      if ((s32_t)(tcp_fastopen_cache[i].used - entry->used) < 0) {
+        entry = &tcp_fastopen_cache[i];
+      }
+    }
+    ip_addr_copy(entry->addr, *addr);
+  }
+  entry->used = ++tcp_fastopen_cache_ctr;
+  entry->mss = mss;
+  entry->cookie_len = len;
+  MEMCPY(entry->cookie, cookie, len);
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_FASTOPEN */
@@ -58,6 +58,9 @@
 #if LWIP_ND6_TCP_REACHABILITY_HINTS
 #include "lwip/nd6.h"
 #endif /* LWIP_ND6_TCP_REACHABILITY_HINTS */
+#if LWIP_TCP_PACING || LWIP_TCP_TS_RTTM || IP_PMTUD
+#include "lwip/sys.h"
+#endif /* LWIP_TCP_PACING || LWIP_TCP_TS_RTTM || IP_PMTUD */
 
 #include <string.h>
 
@@ -77,6 +80,32 @@ static u32_t seqno, ackno;
 static tcpwnd_size_t recv_acked;
 static u16_t tcplen;
 static u8_t flags;
+#if LWIP_TCP_SACK_IN
+/* 40 bytes of options hold at most 4 SACK blocks */
+#define TCP_SACK_IN_MAX_BLOCKS 4
+/* SACK blocks of the current segment, filled by tcp_parseopt() */
+static struct tcp_sack_range tcp_in_sacks[TCP_SACK_IN_MAX_BLOCKS];
+static u8_t tcp_in_sack_num;
+#endif /* LWIP_TCP_SACK_IN */
+#if LWIP_TCP_FASTOPEN
+/* TCP Fast Open option of the current segment, filled by tcp_parseopt()
+   (longer cookies are truncated, the length is kept) */
+#define TCP_IN_FASTOPEN_NONE 0xFF
+static u8_t tcp_in_fastopen_cookie[TCP_FASTOPEN_COOKIE_LEN];
+static u8_t tcp_in_fastopen_len;
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_TS_RTTM
+/* Echoed timestamp of the current segment (0: none), filled by tcp_parseopt() */
+static u32_t tcp_in_tsecr;
+#endif /* LWIP_TCP_TS_RTTM */
+#if LWIP_TCP_ECN
+/* ECE and CWR flags of the current segment and TCP_IN_ECN_CE if the IP
+   header is marked CE */
+static u8_t tcp_in_ecn;
+#define TCP_IN_ECN_CE 0x01U
+/* An ECN-setup SYN has both ECE and CWR set */
+#define TCP_IN_ECN_SETUP_SYN() ((tcp_in_ecn & (TCP_ECE | TCP_CWR)) == (TCP_ECE | TCP_CWR))
+#endif /* LWIP_TCP_ECN */
 
 static u8_t recv_flags;
 static struct pbuf *recv_data;
@@ -87,17 +116,33 @@ struct tcp_pcb *tcp_input_pcb;
 static err_t tcp_process(struct tcp_pcb *pcb);
 static void tcp_receive(struct tcp_pcb *pcb);
 static void tcp_parseopt(struct tcp_pcb *pcb);
+#if LWIP_TCP_FASTOPEN
+static struct tcp_seg *tcp_free_acked_segments(struct tcp_pcb *pcb, struct tcp_seg *seg_list,
+                                               const char* dbg_list_name, struct tcp_seg *dbg_other_seg_list);
+#endif /* LWIP_TCP_FASTOPEN */
 
-static void tcp_listen_input(struct tcp_pcb_listen *pcb);
+static struct tcp_pcb *tcp_listen_input(struct tcp_pcb_listen *pcb, struct pbuf *p);
 static void tcp_timewait_input(struct tcp_pcb *pcb);
+#if LWIP_TCP_TW_COMPACT
+static void tcp_timewait_input_compact(struct tcp_pcb_tw *tw);
+#endif /* LWIP_TCP_TW_COMPACT */
 
 #if LWIP_TCP_SACK_OUT
 static void tcp_add_sack(struct tcp_pcb *pcb, u32_t left, u32_t right);
 static void tcp_remove_sacks_lt(struct tcp_pcb *pcb, u32_t seq);
-#if TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS
+#if TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS || LWIP_TCP_OOSEQ_MEM
 static void tcp_remove_sacks_gt(struct tcp_pcb *pcb, u32_t seq);
-#endif /* TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS */
+#endif /* TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS || LWIP_TCP_OOSEQ_MEM */
 #endif /* LWIP_TCP_SACK_OUT */
+#if LWIP_TCP_SACK_IN
+static void tcp_sack_update(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_SACK_IN */
+#if LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ
+static void tcp_parseopt_syn(struct tcp_syn_opts *opts);
+#endif /* LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ */
+#if LWIP_TCP_TS_RTTM
+static void tcp_ts_rttm(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_TS_RTTM */
 
 /**
  * The initial input processing of TCP. It verifies the TCP header, demultiplexes
@@ -111,12 +156,15 @@ static void tcp_remove_sacks_gt(struct tcp_pcb *pcb, u32_t seq);
 void
 tcp_input(struct pbuf *p, struct netif *inp)
 {
-  struct tcp_pcb *pcb, *prev;
+  struct tcp_pcb *pcb;
   struct tcp_pcb_listen *lpcb;
+#if !LWIP_TCP_PCB_HASH
+  struct tcp_pcb *prev;
 #if SO_REUSE
   struct tcp_pcb *lpcb_prev = NULL;
   struct tcp_pcb_listen *lpcb_any = NULL;
 #endif /* SO_REUSE */
+#endif /* !LWIP_TCP_PCB_HASH */
   u8_t hdrlen_bytes;
   err_t err;
 
@@ -126,6 +174,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
 
   TCP_STATS_INC(tcp.recv);
   MIB2_STATS_INC(mib2.tcpinsegs);
+  TCP_TICKS_UPDATE();
 
   tcphdr = (struct tcp_hdr *)p->payload;
 
@@ -149,6 +198,10 @@ tcp_input(struct pbuf *p, struct netif *inp)
   }
 
 #if CHECKSUM_CHECK_TCP
+#if LWIP_CHECKSUM_OFFLOAD || LWIP_NETIF_GRO
+  /* already verified by the netif (or one by one by GRO) */
+  if (!(p->flags & PBUF_FLAG_CHKSUM_VERIFIED))
+#endif /* LWIP_CHECKSUM_OFFLOAD || LWIP_NETIF_GRO */
   IF__NETIF_CHECKSUM_ENABLED(inp, NETIF_CHECKSUM_CHECK_TCP) {
     /* Verify TCP checksum. */
     u16_t chksum = ip_chksum_pseudo(p, IP_PROTO_TCP, p->tot_len,
@@ -224,6 +277,12 @@ tcp_input(struct pbuf *p, struct netif *inp)
   tcphdr->wnd = lwip_ntohs(tcphdr->wnd);
 
   flags = TCPH_FLAGS(tcphdr);
+#if LWIP_TCP_ECN
+  tcp_in_ecn = TCPH_ECN_FLAGS(tcphdr);
+  if (ip_current_ecn() == IP_ECN_CE) {
+    tcp_in_ecn |= TCP_IN_ECN_CE;
+  }
+#endif /* LWIP_TCP_ECN */
   tcplen = p->tot_len;
   if (flags & (TCP_FIN | TCP_SYN)) {
     tcplen++;
@@ -235,6 +294,46 @@ tcp_input(struct pbuf *p, struct netif *inp)
     }
   }
 
+#if LWIP_TCP_PCB_HASH
+  /* Demultiplex an incoming segment through the hash tables: active and
+     TIME-WAIT connections share one table, LISTENing PCBs have their own. */
+  pcb = tcp_pcb_hash_lookup(ip_current_dest_addr(), tcphdr->dest,
+                            ip_current_src_addr(), tcphdr->src,
+                            ip_data.current_input_netif);
+  if (pcb != NULL) {
+    LWIP_ASSERT("tcp_input: hashed pcb->state != CLOSED", pcb->state != CLOSED);
+    LWIP_ASSERT("tcp_input: hashed pcb->state != LISTEN", pcb->state != LISTEN);
+    if (pcb->state == TIME_WAIT) {
+      LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for TIME_WAITing connection.\n"));
+      tcp_timewait_input(pcb);
+      pbuf_free(p);
+      return;
+    }
+  } else {
+#if LWIP_TCP_TW_COMPACT
+    struct tcp_pcb_tw *tw = tcp_tw_lookup(ip_current_dest_addr(), tcphdr->dest,
+                                          ip_current_src_addr(), tcphdr->src,
+                                          ip_data.current_input_netif);
+    if (tw != NULL) {
+      LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for TIME_WAIT record.\n"));
+      tcp_timewait_input_compact(tw);
+      pbuf_free(p);
+      return;
+    }
+#endif /* LWIP_TCP_TW_COMPACT */
+    lpcb = tcp_listen_pcb_hash_lookup(ip_current_dest_addr(), tcphdr->dest,
+                                      ip_data.current_input_netif);
+    if (lpcb != NULL) {
+      LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for LISTENing connection.\n"));
+      pcb = tcp_listen_input(lpcb, p);
+      if (pcb == NULL) {
+        pbuf_free(p);
+        return;
+      }
+      /* SYN cookie returned: go on with the new connection pcb */
+    }
+  }
+#else /* LWIP_TCP_PCB_HASH */
   /* Demultiplex an incoming segment. First, we check if it is destined
      for an active connection. */
   prev = NULL;
@@ -297,6 +396,20 @@ tcp_input(struct pbuf *p, struct netif *inp)
       }
     }
 
+#if LWIP_TCP_TW_COMPACT
+    {
+      struct tcp_pcb_tw *tw = tcp_tw_lookup(ip_current_dest_addr(), tcphdr->dest,
+                                            ip_current_src_addr(), tcphdr->src,
+                                            ip_data.current_input_netif);
+      if (tw != NULL) {
+        LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for TIME_WAIT record.\n"));
+        tcp_timewait_input_compact(tw);
+        pbuf_free(p);
+        return;
+      }
+    }
+#endif /* LWIP_TCP_TW_COMPACT */
+
     /* Finally, if we still did not get a match, we check all PCBs that
        are LISTENing for incoming connections. */
     prev = NULL;
@@ -356,11 +469,15 @@ tcp_input(struct pbuf *p, struct netif *inp)
       }
 
       LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for LISTENing connection.\n"));
-      tcp_listen_input(lpcb);
-      pbuf_free(p);
-      return;
+      pcb = tcp_listen_input(lpcb, p);
+      if (pcb == NULL) {
+        pbuf_free(p);
+        return;
+      }
+      /* SYN cookie returned: go on with the new connection pcb */
     }
   }
+#endif /* LWIP_TCP_PCB_HASH */
 
 #if TCP_INPUT_DEBUG
   LWIP_DEBUGF(TCP_INPUT_DEBUG, ("+-+-+-+-+-+-+-+-+-+-+-+-+-+- tcp_input: flags "));
@@ -417,7 +534,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
            deallocate the PCB. */
         TCP_EVENT_ERR(pcb->state, pcb->errf, pcb->callback_arg, ERR_RST);
         tcp_pcb_remove(&tcp_active_pcbs, pcb);
-        memp_free(MEMP_TCP_PCB, pcb);
+        tcp_free(pcb);
       } else {
         err = ERR_OK;
         /* If the application has registered a "sent" function to be
@@ -443,6 +560,12 @@ tcp_input(struct pbuf *p, struct netif *inp)
           }
           recv_acked = 0;
         }
+#if LWIP_TCP_ZEROCOPY
+        /* report the tcp_write_ref() buffers this ACK completed */
+        if (tcp_zc_report(pcb) == ERR_ABRT) {
+          goto aborted;
+        }
+#endif /* LWIP_TCP_ZEROCOPY */
         if (recv_flags & TF_CLOSED) {
           /* The connection has been closed and we will deallocate the
              PCB. */
@@ -453,7 +576,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
             TCP_EVENT_ERR(pcb->state, pcb->errf, pcb->callback_arg, ERR_CLSD);
           }
           tcp_pcb_remove(&tcp_active_pcbs, pcb);
-          memp_free(MEMP_TCP_PCB, pcb);
+          tcp_free(pcb);
           goto aborted;
         }
 #if TCP_QUEUE_OOSEQ && LWIP_WND_SCALE
@@ -529,11 +652,18 @@ tcp_input(struct pbuf *p, struct netif *inp)
         tcp_input_pcb = NULL;
         /* Try to send something out. */
         tcp_output(pcb);
+        TCP_TIMER_UPDATE(pcb);
 #if TCP_INPUT_DEBUG
 #if TCP_DEBUG
         tcp_debug_print_state(pcb->state);
 #endif /* TCP_DEBUG */
 #endif /* TCP_INPUT_DEBUG */
+#if LWIP_TCP_TW_COMPACT
+        if ((pcb->state == TIME_WAIT) && (pcb->flags & TF_APPCLOSED)) {
+          /* closed by the application: only a compact record is needed now */
+          tcp_tw_compact(pcb);
+        }
+#endif /* LWIP_TCP_TW_COMPACT */
       }
     }
     /* Jump target if pcb has been aborted in a callback (by calling tcp_abort()).
@@ -570,30 +700,249 @@ dropped:
   pbuf_free(p);
 }
 
+/**
+ * Allocate a pcb in state SYN_RCVD for a connection request to a listening
+ * pcb (addresses, ports and settings inherited from the listener are set).
+ *
+ * @param pcb the tcp_pcb_listen for which a segment arrived
+ * @return the new pcb or NULL if out of memory
+ */
+static struct tcp_pcb *
+tcp_listen_pcb_alloc(struct tcp_pcb_listen *pcb)
+{
+  struct tcp_pcb *npcb = tcp_alloc(pcb->prio);
+  /* If a new PCB could not be created (probably due to lack of memory),
+     we don't do anything, but rely on the sender will retransmit the
+     SYN at a time when we have more memory available. */
+  if (npcb == NULL) {
+    err_t err;
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_listen_input: could not allocate PCB\n"));
+    TCP_STATS_INC(tcp.memerr);
+    TCP_EVENT_ACCEPT(pcb, NULL, pcb->callback_arg, ERR_MEM, err);
+    LWIP_UNUSED_ARG(err); /* err not useful here */
+    return NULL;
+  }
+#if TCP_LISTEN_BACKLOG
+  pcb->accepts_pending++;
+  tcp_set_flags(npcb, TF_BACKLOGPEND);
+#endif /* TCP_LISTEN_BACKLOG */
+  /* Set up the new PCB. */
+  ip_addr_copy(npcb->local_ip, *ip_current_dest_addr());
+  ip_addr_copy(npcb->remote_ip, *ip_current_src_addr());
+  npcb->local_port = pcb->local_port;
+  npcb->remote_port = tcphdr->src;
+  npcb->state = SYN_RCVD;
+#if LWIP_TCP_SYNCOOKIES
+  tcp_syn_rcvd_pending++;
+#endif /* LWIP_TCP_SYNCOOKIES */
+  npcb->callback_arg = pcb->callback_arg;
+#if LWIP_CALLBACK_API || TCP_LISTEN_BACKLOG
+  npcb->listener = pcb;
+#endif /* LWIP_CALLBACK_API || TCP_LISTEN_BACKLOG */
+  /* inherit socket options */
+  npcb->so_options = pcb->so_options & SOF_INHERITED;
+  npcb->netif_idx = pcb->netif_idx;
+  npcb->cc = pcb->cc;
+#if LWIP_TCP_RCV_AUTOTUNE
+  npcb->rcv_buf_max = pcb->rcv_buf_max;
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+#if LWIP_TCP_SNDBUF_PCB
+  npcb->snd_buf_max = pcb->snd_buf_max;
+  tcp_sndbuf_update(npcb);
+#endif /* LWIP_TCP_SNDBUF_PCB */
+  return npcb;
+}
+
+#if LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ
+/**
+ * Create the pcb for a connection whose SYN-ACK was sent without a pcb (a
+ * SYN cookie or a request entry) when the final ACK of the handshake
+ * arrives. The pcb is left in state SYN_RCVD with the SYN-ACK sent, so that
+ * tcp_process() completes the handshake.
+ *
+ * @param pcb the tcp_pcb_listen for which the ACK arrived
+ * @param rcv_nxt sequence number of the SYN + 1
+ * @param opts the options of the SYN
+ * @return the new pcb or NULL if out of memory
+ */
+static struct tcp_pcb *
+tcp_listen_syn_pcb(struct tcp_pcb_listen *pcb, u32_t rcv_nxt, const struct tcp_syn_opts *opts)
+{
+  u32_t iss = ackno - 1;
+  struct tcp_pcb *npcb = tcp_listen_pcb_alloc(pcb);
+  if (npcb == NULL) {
+    return NULL;
+  }
+  npcb->rcv_nxt = rcv_nxt;
+  npcb->rcv_ann_right_edge = npcb->rcv_nxt;
+  npcb->snd_wl2 = iss;
+  npcb->lastack = iss;
+  npcb->snd_nxt = iss + 1;
+  npcb->snd_lbb = iss + 1;
+  npcb->snd_wl1 = rcv_nxt - 1;/* initialise to seqno-1 to force window update */
+  TCP_REG_ACTIVE(npcb);
+
+  /* Apply the options of the SYN */
+  npcb->mss = opts->mss;
+#if LWIP_WND_SCALE
+  if (opts->snd_scale != TCP_SYN_OPTS_NO_WS) {
+    npcb->snd_scale = opts->snd_scale;
+    npcb->rcv_scale = TCP_RCV_SCALE;
+    tcp_set_flags(npcb, TF_WND_SCALE);
+    npcb->rcv_wnd = npcb->rcv_ann_wnd = TCP_WND;
+    TCP_RCV_AUTOTUNE_INIT(npcb);
+  }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+  if (opts->sack_perm) {
+    tcp_set_flags(npcb, TF_SACK);
+  }
+#endif /* LWIP_TCP_SACK_OUT */
+#if LWIP_TCP_TIMESTAMPS
+  if (opts->ts) {
+    tcp_set_flags(npcb, TF_TIMESTAMP);
+    npcb->ts_recent = opts->tsval;
+    npcb->ts_lastacksent = npcb->rcv_nxt;
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+#if LWIP_TCP_ECN
+  if (opts->ecn) {
+    npcb->ecn = TCP_ECN_ON;
+    npcb->ecn_recover = npcb->snd_nxt;
+  }
+#endif /* LWIP_TCP_ECN */
+  npcb->snd_wnd = SND_WND_SCALE(npcb, tcphdr->wnd);
+  npcb->snd_wnd_max = npcb->snd_wnd;
+
+#if TCP_CALCULATE_EFF_SEND_MSS
+#if IP_PMTUD
+  npcb->snd_mss_max = npcb->mss;
+#endif /* IP_PMTUD */
+  npcb->mss = tcp_eff_send_mss(npcb->mss, &npcb->local_ip, &npcb->remote_ip);
+#endif /* TCP_CALCULATE_EFF_SEND_MSS */
+  return npcb;
+}
+#endif /* LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ */
+
+#if LWIP_TCP_SYNCOOKIES
+/**
+ * Answer a SYN to a listening pcb with a SYN cookie.
+ *
+ * @param pcb the tcp_pcb_listen for which the SYN arrived
+ * @param opts the options of the SYN
+ */
+static void
+tcp_listen_syncookie(struct tcp_pcb_listen *pcb, struct tcp_syn_opts *opts)
+{
+  u32_t iss;
+  u32_t tsval = 0;
+
+  if (!opts->ts) {
+    /* window scale, SACK permitted and ECN can only be restored from the
+       timestamp echoed in the final ACK */
+    opts->snd_scale = TCP_SYN_OPTS_NO_WS;
+    opts->sack_perm = 0;
+#if LWIP_TCP_ECN
+    opts->ecn = 0;
+#endif /* LWIP_TCP_ECN */
+  }
+  iss = tcp_syncookie_gen(ip_current_dest_addr(), ip_current_src_addr(), tcphdr->dest,
+                          tcphdr->src, seqno, opts);
+#if LWIP_TCP_TIMESTAMPS
+  if (opts->ts) {
+    tsval = tcp_syncookie_tsval(opts);
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+  tcp_synack(pcb, iss, seqno + 1, ip_current_dest_addr(), ip_current_src_addr(),
+             tcphdr->src, opts, tsval);
+}
+#endif /* LWIP_TCP_SYNCOOKIES */
+
 /**
  * Called by tcp_input() when a segment arrives for a listening
  * connection (from tcp_input()).
  *
  * @param pcb the tcp_pcb_listen for which a segment arrived
+ * @param p the segment (used for data in a TCP Fast Open SYN)
+ * @return a new connection pcb in state SYN_RCVD if the segment is the
+ *         final ACK of a handshake whose SYN-ACK was sent without a pcb
+ *         (SYN cookie or request entry; this segment has to be processed
+ *         for it by tcp_input()), NULL otherwise
  *
  * @note the segment which arrived is saved in global variables, therefore only the pcb
  *       involved is passed as a parameter to this function
  */
-static void
-tcp_listen_input(struct tcp_pcb_listen *pcb)
+static struct tcp_pcb *
+tcp_listen_input(struct tcp_pcb_listen *pcb, struct pbuf *p)
 {
   struct tcp_pcb *npcb;
   u32_t iss;
   err_t rc;
+#if LWIP_TCP_FASTOPEN
+  u8_t fastopen_data = 0;
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_SYN_REQ
+  struct tcp_syn_req *req = tcp_syn_req_find(pcb, ip_current_dest_addr(),
+                                             ip_current_src_addr(), tcphdr->src);
+#endif /* LWIP_TCP_SYN_REQ */
+
+  LWIP_UNUSED_ARG(p);
 
   if (flags & TCP_RST) {
+#if LWIP_TCP_SYN_REQ
+    /* A RST for a half-open connection removes it (only with the exact
+       sequence number, see RFC 5961) */
+    if ((req != NULL) && (seqno == req->rcv_nxt)) {
+      LWIP_DEBUGF(TCP_DEBUG, ("tcp_listen_input: connection request reset\n"));
+      tcp_syn_req_free(pcb, req);
+    }
+#endif /* LWIP_TCP_SYN_REQ */
     /* An incoming RST should be ignored. Return. */
-    return;
+    return NULL;
   }
 
   /* In the LISTEN state, we check for incoming SYN segments,
      creates a new PCB, and responds with a SYN|ACK. */
   if (flags & TCP_ACK) {
+#if LWIP_TCP_SYN_REQ
+    if ((req != NULL) && !(flags & TCP_SYN) && (ackno == req->iss + 1)) {
+      /* Final ACK of the handshake: promote the request entry to a pcb.
+         The entry is kept if that fails: its SYN-ACK retransmission makes
+         the peer repeat the ACK. */
+#if TCP_LISTEN_BACKLOG
+      if (pcb->accepts_pending >= pcb->backlog) {
+        LWIP_DEBUGF(TCP_DEBUG, ("tcp_listen_input: listen backlog exceeded for port %"U16_F"\n", tcphdr->dest));
+        return NULL;
+      }
+#endif /* TCP_LISTEN_BACKLOG */
+      npcb = tcp_listen_syn_pcb(pcb, req->rcv_nxt, &req->opts);
+      if (npcb != NULL) {
+        tcp_syn_req_free(pcb, req);
+      }
+      return npcb;
+    }
+#endif /* LWIP_TCP_SYN_REQ */
+#if LWIP_TCP_SYNCOOKIES
+    if (!(flags & TCP_SYN)) {
+      struct tcp_syn_opts opts;
+      tcp_parseopt_syn(&opts);
+      if (tcp_syncookie_check(ip_current_dest_addr(), ip_current_src_addr(), tcphdr->dest,
+                              tcphdr->src, seqno - 1, ackno - 1, &opts)) {
+#if TCP_LISTEN_BACKLOG
+        if (pcb->accepts_pending >= pcb->backlog) {
+          LWIP_DEBUGF(TCP_DEBUG, ("tcp_listen_input: listen backlog exceeded for port %"U16_F"\n", tcphdr->dest));
+          return NULL;
+        }
+#endif /* TCP_LISTEN_BACKLOG */
+        npcb = tcp_listen_syn_pcb(pcb, seqno, &opts);
+        if (npcb != NULL) {
+          MIB2_STATS_INC(mib2.tcppassiveopens);
+          LWIP_DEBUGF(TCP_DEBUG, ("tcp_listen_input: valid SYN cookie from port %"U16_F"\n", tcphdr->src));
+        }
+        return npcb;
+      }
+    }
+#endif /* LWIP_TCP_SYNCOOKIES */
     /* For incoming segments with the ACK flag set, respond with a
        RST. */
     LWIP_DEBUGF(TCP_RST_DEBUG, ("tcp_listen_input: ACK in LISTEN, sending reset\n"));
@@ -604,31 +953,60 @@ tcp_listen_input(struct tcp_pcb_listen *pcb)
 #if TCP_LISTEN_BACKLOG
     if (pcb->accepts_pending >= pcb->backlog) {
       LWIP_DEBUGF(TCP_DEBUG, ("tcp_listen_input: listen backlog exceeded for port %"U16_F"\n", tcphdr->dest));
-      return;
+      return NULL;
     }
 #endif /* TCP_LISTEN_BACKLOG */
-    npcb = tcp_alloc(pcb->prio);
-    /* If a new PCB could not be created (probably due to lack of memory),
-       we don't do anything, but rely on the sender will retransmit the
-       SYN at a time when we have more memory available. */
+#if LWIP_TCP_SYN_REQ
+    if (req != NULL) {
+      if (seqno + 1 == req->rcv_nxt) {
+        /* retransmitted SYN: retransmit the SYN-ACK */
+        tcp_syn_req_synack(pcb, req);
+        return NULL;
+      }
+      /* a new SYN from the same port: forget the old attempt */
+      tcp_syn_req_free(pcb, req);
+    }
+#endif /* LWIP_TCP_SYN_REQ */
+#if LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ
+    {
+      struct tcp_syn_opts opts;
+      tcp_parseopt_syn(&opts);
+#if LWIP_TCP_SYNCOOKIES
+      if (tcp_syncookie_needed()) {
+        /* Too many half-open connections or too few free pcbs: answer with a
+           SYN cookie and create the pcb when the handshake completes */
+        tcp_listen_syncookie(pcb, &opts);
+        return NULL;
+      }
+#endif /* LWIP_TCP_SYNCOOKIES */
+#if LWIP_TCP_SYN_REQ
+#if LWIP_TCP_FASTOPEN
+      /* TCP Fast Open needs a pcb to send the cookie or to accept data */
+      if (!(opts.fastopen && (pcb->fastopen & TCP_FASTOPEN_ENABLED)))
+#endif /* LWIP_TCP_FASTOPEN */
+      {
+        /* Keep the half-open connection as a request entry and create the
+           pcb when the handshake completes */
+        req = tcp_syn_req_new(pcb, ip_current_dest_addr(), ip_current_src_addr(),
+                              tcphdr->src, seqno + 1, &opts);
+        if (req != NULL) {
+          tcp_syn_req_synack(pcb, req);
+          MIB2_STATS_INC(mib2.tcppassiveopens);
+        }
+#if LWIP_TCP_SYNCOOKIES
+        else {
+          tcp_listen_syncookie(pcb, &opts);
+        }
+#endif /* LWIP_TCP_SYNCOOKIES */
+        return NULL;
+      }
+#endif /* LWIP_TCP_SYN_REQ */
+    }
+#endif /* LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ */
+    npcb = tcp_listen_pcb_alloc(pcb);
     if (npcb == NULL) {
-      err_t err;
-      LWIP_DEBUGF(TCP_DEBUG, ("tcp_listen_input: could not allocate PCB\n"));
-      TCP_STATS_INC(tcp.memerr);
-      TCP_EVENT_ACCEPT(pcb, NULL, pcb->callback_arg, ERR_MEM, err);
-      LWIP_UNUSED_ARG(err); /* err not useful here */
-      return;
+      return NULL;
     }
-#if TCP_LISTEN_BACKLOG
-    pcb->accepts_pending++;
-    tcp_set_flags(npcb, TF_BACKLOGPEND);
-#endif /* TCP_LISTEN_BACKLOG */
-    /* Set up the new PCB. */
-    ip_addr_copy(npcb->local_ip, *ip_current_dest_addr());
-    ip_addr_copy(npcb->remote_ip, *ip_current_src_addr());
-    npcb->local_port = pcb->local_port;
-    npcb->remote_port = tcphdr->src;
-    npcb->state = SYN_RCVD;
     npcb->rcv_nxt = seqno + 1;
     npcb->rcv_ann_right_edge = npcb->rcv_nxt;
     iss = tcp_next_iss(npcb);
@@ -637,37 +1015,90 @@ tcp_listen_input(struct tcp_pcb_listen *pcb)
     npcb->lastack = iss;
     npcb->snd_lbb = iss;
     npcb->snd_wl1 = seqno - 1;/* initialise to seqno-1 to force window update */
-    npcb->callback_arg = pcb->callback_arg;
-#if LWIP_CALLBACK_API || TCP_LISTEN_BACKLOG
-    npcb->listener = pcb;
-#endif /* LWIP_CALLBACK_API || TCP_LISTEN_BACKLOG */
-    /* inherit socket options */
-    npcb->so_options = pcb->so_options & SOF_INHERITED;
-    npcb->netif_idx = pcb->netif_idx;
     /* Register the new PCB so that we can begin receiving segments
        for it. */
     TCP_REG_ACTIVE(npcb);
 
     /* Parse any options in the SYN. */
     tcp_parseopt(npcb);
+#if LWIP_TCP_ECN
+    if (TCP_IN_ECN_SETUP_SYN()) {
+      /* answered with ECE in the SYN-ACK */
+      npcb->ecn = TCP_ECN_ON;
+      npcb->ecn_recover = iss + 1;
+    }
+#endif /* LWIP_TCP_ECN */
     npcb->snd_wnd = tcphdr->wnd;
     npcb->snd_wnd_max = npcb->snd_wnd;
 
 #if TCP_CALCULATE_EFF_SEND_MSS
+#if IP_PMTUD
+    npcb->snd_mss_max = npcb->mss;
+#endif /* IP_PMTUD */
     npcb->mss = tcp_eff_send_mss(npcb->mss, &npcb->local_ip, &npcb->remote_ip);
 #endif /* TCP_CALCULATE_EFF_SEND_MSS */
 
     MIB2_STATS_INC(mib2.tcppassiveopens);
 
+#if LWIP_TCP_FASTOPEN
+    if ((pcb->fastopen & TCP_FASTOPEN_ENABLED) && (tcp_in_fastopen_len != TCP_IN_FASTOPEN_NONE)) {
+      if (tcp_fastopen_cookie_valid(&npcb->remote_ip, tcp_in_fastopen_cookie, tcp_in_fastopen_len)) {
+        /* Valid cookie: accept the data (but not a FIN) right away */
+        if ((p->tot_len > 0) && !(flags & TCP_FIN) && (p->tot_len <= npcb->rcv_wnd)) {
+          fastopen_data = 1;
+          npcb->rcv_nxt = seqno + tcplen;
+          npcb->rcv_ann_right_edge = npcb->rcv_nxt;
+          npcb->rcv_wnd = (tcpwnd_size_t)(npcb->rcv_wnd - p->tot_len);
+          npcb->rcv_ann_wnd = npcb->rcv_wnd;
+          /* the server may send data before the handshake completes */
+          npcb->cwnd = LWIP_TCP_CALC_INITIAL_CWND(npcb->mss);
+        }
+      } else {
+        /* Cookie request or invalid cookie: send a (new) cookie */
+        npcb->fastopen = TCP_FASTOPEN_COOKIE;
+      }
+    }
+#endif /* LWIP_TCP_FASTOPEN */
+
     /* Send a SYN|ACK together with the MSS option. */
     rc = tcp_enqueue_flags(npcb, TCP_SYN | TCP_ACK);
     if (rc != ERR_OK) {
       tcp_abandon(npcb, 0);
-      return;
+      return NULL;
     }
     tcp_output(npcb);
+
+#if LWIP_TCP_FASTOPEN
+    if (fastopen_data) {
+      /* Accept the connection now to pass the data to the application.
+         It stays on the listen backlog until the handshake completes, so
+         SYNs with a valid cookie can't open more than 'backlog' connections
+         that are not established yet. */
+      npcb->fastopen |= TCP_FASTOPEN_ACCEPTED;
+      TCP_EVENT_ACCEPT(pcb, npcb, npcb->callback_arg, ERR_OK, rc);
+      if (rc != ERR_OK) {
+        /* If the accept function returns with an error, we abort
+         * the connection. */
+        if (rc != ERR_ABRT) {
+          tcp_abort(npcb);
+        }
+        return NULL;
+      }
+      /* The caller frees p, so take a reference for the application */
+      pbuf_ref(p);
+      TCP_EVENT_RECV(npcb, p, ERR_OK, rc);
+      if (rc == ERR_ABRT) {
+        return NULL;
+      }
+      if (rc != ERR_OK) {
+        npcb->refused_data = p;
+      }
+      /* send data written by the application in the callbacks */
+      tcp_output(npcb);
+    }
+#endif /* LWIP_TCP_FASTOPEN */
   }
-  return;
+  return NULL;
 }
 
 /**
@@ -714,6 +1145,38 @@ tcp_timewait_input(struct tcp_pcb *pcb)
   return;
 }
 
+#if LWIP_TCP_TW_COMPACT
+/**
+ * tcp_timewait_input() for a connection kept as a compact TIME_WAIT record
+ * (found by tcp_tw_lookup()).
+ *
+ * @param tw the compact record for which a segment arrived
+ */
+static void
+tcp_timewait_input_compact(struct tcp_pcb_tw *tw)
+{
+  if (flags & TCP_RST) {
+    return;
+  }
+  if (flags & TCP_SYN) {
+    if (TCP_SEQ_BETWEEN(seqno, tw->rcv_nxt, tw->rcv_nxt + tw->rcv_wnd)) {
+      /* If the SYN is in the window it is an error, send a reset */
+      tcp_rst(NULL, ackno, seqno + tcplen, ip_current_dest_addr(),
+        ip_current_src_addr(), tcphdr->dest, tcphdr->src);
+      return;
+    }
+  } else if (flags & TCP_FIN) {
+    /* Restart the 2 MSL time-wait timeout */
+    tcp_tw_restart(tw);
+  }
+
+  if ((tcplen > 0)) {
+    /* Acknowledge data, FIN or out-of-window SYN */
+    tcp_tw_ack(tw);
+  }
+}
+#endif /* LWIP_TCP_TW_COMPACT */
+
 /**
  * Implements the TCP state machine. Called by tcp_input. In some
  * states tcp_receive() is called to receive data. The tcp_seg
@@ -788,6 +1251,20 @@ tcp_process(struct tcp_pcb *pcb)
 
   tcp_parseopt(pcb);
 
+#if LWIP_TCP_ECN
+  if (pcb->ecn & TCP_ECN_ON) {
+    if (tcp_in_ecn & TCP_CWR) {
+      /* the remote host has reacted to our ECE */
+      pcb->ecn &= (u8_t)~TCP_ECN_ECE;
+    }
+    if ((tcp_in_ecn & TCP_IN_ECN_CE) && (tcplen > 0)) {
+      /* congestion experienced: echo it in all ACKs until CWR arrives */
+      pcb->ecn |= TCP_ECN_ECE;
+      tcp_ack_now(pcb);
+    }
+  }
+#endif /* LWIP_TCP_ECN */
+
   /* Do different things depending on the TCP state. */
   switch (pcb->state) {
   case SYN_SENT:
@@ -795,7 +1272,7 @@ tcp_process(struct tcp_pcb *pcb)
      pcb->snd_nxt, lwip_ntohl(pcb->unacked->tcphdr->seqno)));
     /* received SYN ACK with expected sequence number? */
     if ((flags & TCP_ACK) && (flags & TCP_SYN)
-        && (ackno == pcb->lastack + 1)) {
+        && TCP_SEQ_BETWEEN(ackno, pcb->lastack + 1, pcb->snd_nxt)) {
       pcb->rcv_nxt = seqno + 1;
       pcb->rcv_ann_right_edge = pcb->rcv_nxt;
       pcb->lastack = ackno;
@@ -803,12 +1280,28 @@ tcp_process(struct tcp_pcb *pcb)
       pcb->snd_wnd_max = pcb->snd_wnd;
       pcb->snd_wl1 = seqno - 1; /* initialise to seqno - 1 to force window update */
       pcb->state = ESTABLISHED;
+#if LWIP_TCP_TS_RTTM
+      tcp_ts_rttm(pcb);
+#endif /* LWIP_TCP_TS_RTTM */
+#if LWIP_TCP_ECN
+      /* ECN is agreed by an ECN-setup SYN-ACK (ECE without CWR) */
+      if ((pcb->ecn & TCP_ECN_SYN) && ((tcp_in_ecn & (TCP_ECE | TCP_CWR)) == TCP_ECE)) {
+        pcb->ecn = TCP_ECN_ON;
+        pcb->ecn_recover = ackno;
+      } else {
+        pcb->ecn = 0;
+      }
+#endif /* LWIP_TCP_ECN */
 
 #if TCP_CALCULATE_EFF_SEND_MSS
+#if IP_PMTUD
+      pcb->snd_mss_max = pcb->mss;
+#endif /* IP_PMTUD */
       pcb->mss = tcp_eff_send_mss(pcb->mss, &pcb->local_ip, &pcb->remote_ip);
 #endif /* TCP_CALCULATE_EFF_SEND_MSS */
 
       pcb->cwnd = LWIP_TCP_CALC_INITIAL_CWND(pcb->mss);
+      TCP_CC_EVENT(pcb, init);
       LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_process (SENT): cwnd %"TCPWNDSIZE_F
                                    " ssthresh %"TCPWNDSIZE_F"\n",
                                    pcb->cwnd, pcb->ssthresh));
@@ -827,6 +1320,27 @@ tcp_process(struct tcp_pcb *pcb)
       }
       tcp_seg_free(rseg);
 
+#if LWIP_TCP_FASTOPEN
+      if (pcb->fastopen & TCP_FASTOPEN_ENABLED) {
+        /* remember the cookie (or forget it if the server sent none) */
+        tcp_fastopen_cookie_set(&pcb->remote_ip, tcp_in_fastopen_cookie,
+          (tcp_in_fastopen_len == TCP_IN_FASTOPEN_NONE) ? 0 : tcp_in_fastopen_len, pcb->mss);
+      }
+      if (pcb->unacked != NULL) {
+        /* The SYN carried data: free the acknowledged segments and send
+           the rest as normal segments */
+        pcb->unacked = tcp_free_acked_segments(pcb, pcb->unacked, "unacked", pcb->unsent);
+        pcb->snd_buf = (tcpwnd_size_t)(pcb->snd_buf + recv_acked);
+        TCP_SNDBUF_UPDATE(pcb);
+        if (pcb->unacked != NULL) {
+          for (rseg = pcb->unacked; rseg->next != NULL; rseg = rseg->next);
+          rseg->next = pcb->unsent;
+          pcb->unsent = pcb->unacked;
+          pcb->unacked = NULL;
+        }
+      }
+#endif /* LWIP_TCP_FASTOPEN */
+
       /* If there's nothing left to acknowledge, stop the retransmit
          timer, otherwise reset it to start again */
       if (pcb->unacked == NULL) {
@@ -862,8 +1376,15 @@ tcp_process(struct tcp_pcb *pcb)
     if (flags & TCP_ACK) {
       /* expected ACK number? */
       if (TCP_SEQ_BETWEEN(ackno, pcb->lastack+1, pcb->snd_nxt)) {
+        TCP_SYN_RCVD_DONE(pcb);
         pcb->state = ESTABLISHED;
         LWIP_DEBUGF(TCP_DEBUG, ("TCP connection established %"U16_F" -> %"U16_F".\n", inseg.tcphdr->src, inseg.tcphdr->dest));
+#if LWIP_TCP_FASTOPEN
+        if (pcb->fastopen & TCP_FASTOPEN_ACCEPTED) {
+          /* already accepted when the SYN with data was received */
+          tcp_backlog_accepted(pcb);
+        } else
+#endif /* LWIP_TCP_FASTOPEN */
 #if LWIP_CALLBACK_API || TCP_LISTEN_BACKLOG
         if (pcb->listener == NULL) {
           /* listen pcb might be closed by now */
@@ -897,6 +1418,7 @@ tcp_process(struct tcp_pcb *pcb)
         }
 
         pcb->cwnd = LWIP_TCP_CALC_INITIAL_CWND(pcb->mss);
+        TCP_CC_EVENT(pcb, init);
         LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_process (SYN_RCVD): cwnd %"TCPWNDSIZE_F
                                      " ssthresh %"TCPWNDSIZE_F"\n",
                                      pcb->cwnd, pcb->ssthresh));
@@ -910,7 +1432,12 @@ tcp_process(struct tcp_pcb *pcb)
         tcp_rst(pcb, ackno, seqno + tcplen, ip_current_dest_addr(),
           ip_current_src_addr(), tcphdr->dest, tcphdr->src);
       }
-    } else if ((flags & TCP_SYN) && (seqno == pcb->rcv_nxt - 1)) {
+    } else if ((flags & TCP_SYN) && ((seqno == pcb->rcv_nxt - 1)
+#if LWIP_TCP_FASTOPEN
+               /* the SYN we received carried data */
+               || ((pcb->fastopen & TCP_FASTOPEN_ACCEPTED) && TCP_SEQ_LT(seqno, pcb->rcv_nxt))
+#endif /* LWIP_TCP_FASTOPEN */
+              )) {
       /* Looks like another copy of the SYN - retransmit our SYN-ACK */
       tcp_rexmit(pcb);
     }
@@ -981,19 +1508,128 @@ tcp_process(struct tcp_pcb *pcb)
 }
 
 #if TCP_QUEUE_OOSEQ
+/**
+ * Trim a segment on pcb->ooseq to 'len' bytes of data (accounting the pbufs
+ * freed by that with LWIP_TCP_OOSEQ_MEM).
+ */
+static void
+tcp_oos_trim(struct tcp_pcb *pcb, struct tcp_seg *seg, u16_t len)
+{
+#if LWIP_TCP_OOSEQ_MEM
+  u16_t clen = pbuf_clen(seg->p);
+#endif /* LWIP_TCP_OOSEQ_MEM */
+
+  LWIP_UNUSED_ARG(pcb);
+
+  seg->len = len;
+  pbuf_realloc(seg->p, len);
+  TCP_OOSEQ_MEM_SUB(pcb, (u16_t)(clen - pbuf_clen(seg->p)));
+}
+
+/** Free a segment that has been unlinked from pcb->ooseq */
+static void
+tcp_oos_seg_free(struct tcp_pcb *pcb, struct tcp_seg *seg)
+{
+  LWIP_UNUSED_ARG(pcb);
+
+  TCP_OOSEQ_TREE_REMOVE(pcb, seg);
+  TCP_OOSEQ_MEM_SUB(pcb, pbuf_clen(seg->p));
+  tcp_seg_free(seg);
+}
+
+/**
+ * Free a segment and all segments following it on pcb->ooseq
+ * (the caller unlinks them from the list).
+ */
+static void
+tcp_oos_free_segs(struct tcp_pcb *pcb, struct tcp_seg *seg)
+{
+  struct tcp_seg *next;
+
+  while (seg != NULL) {
+    next = seg->next;
+    tcp_oos_seg_free(pcb, seg);
+    seg = next;
+  }
+}
+
+#if LWIP_TCP_OOSEQ_MEM
+/**
+ * Free 'pbufs' pbufs (or all, if there are less) from the end of pcb->ooseq,
+ * i.e. the data with the highest sequence numbers, which is needed last.
+ * The last segment is only trimmed if freeing some of its pbufs is enough.
+ *
+ * @param pcb the tcp_pcb whose ooseq to prune
+ * @param pbufs the number of pbufs to free
+ * @return the number of pbufs freed
+ */
+u16_t
+tcp_ooseq_prune(struct tcp_pcb *pcb, u16_t pbufs)
+{
+  u16_t freed = 0;
+
+  while ((pcb->ooseq != NULL) && (freed < pbufs)) {
+    struct tcp_seg *prev = NULL;
+    struct tcp_seg *last;
+    u16_t clen;
+
+    for (last = pcb->ooseq; last->next != NULL; last = last->next) {
+      prev = last;
+    }
+    clen = pbuf_clen(last->p);
+    TCP_OOSEQ_STATS_INC(pruned_segs);
+    if (clen > pbufs - freed) {
+      /* keep the first pbufs of the segment */
+      u16_t keep_pbufs = (u16_t)(clen - (pbufs - freed));
+      u16_t keep = 0;
+      struct pbuf *p;
+      for (p = last->p; keep_pbufs > 0; p = p->next, keep_pbufs--) {
+        keep = (u16_t)(keep + p->len);
+      }
+      if (keep > 0) {
+        TCPH_FLAGS_SET(last->tcphdr, TCPH_FLAGS(last->tcphdr) & ~TCP_FIN);
+        tcp_oos_trim(pcb, last, keep);
+        freed = (u16_t)(freed + clen - pbuf_clen(last->p));
+#if LWIP_TCP_SACK_OUT
+        if (pcb->flags & TF_SACK) {
+          tcp_remove_sacks_gt(pcb, last->tcphdr->seqno + keep);
+        }
+#endif /* LWIP_TCP_SACK_OUT */
+        break;
+      }
+    }
+    /* drop the whole segment */
+#if LWIP_TCP_SACK_OUT
+    if (pcb->flags & TF_SACK) {
+      tcp_remove_sacks_gt(pcb, last->tcphdr->seqno);
+    }
+#endif /* LWIP_TCP_SACK_OUT */
+    if (prev == NULL) {
+      pcb->ooseq = NULL;
+    } else {
+      prev->next = NULL;
+    }
+    tcp_oos_free_segs(pcb, last);
+    freed = (u16_t)(freed + clen);
+  }
+  LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_ooseq_prune: freed %"U16_F" pbufs\n", freed));
+  return freed;
+}
+#endif /* LWIP_TCP_OOSEQ_MEM */
+
 /**
  * Insert segment into the list (segments covered with new one will be deleted)
  *
  * Called from tcp_receive()
  */
 static void
-tcp_oos_insert_segment(struct tcp_seg *cseg, struct tcp_seg *next)
+tcp_oos_insert_segment(struct tcp_pcb *pcb, struct tcp_seg *cseg, struct tcp_seg *next)
 {
   struct tcp_seg *old_seg;
 
   if (TCPH_FLAGS(cseg->tcphdr) & TCP_FIN) {
     /* received segment overlaps all following segments */
-    tcp_segs_free(next);
+    tcp_oos_free_segs(pcb, next);
     next = NULL;
   } else {
     /* delete some following segments
@@ -1007,17 +1643,134 @@ tcp_oos_insert_segment(struct tcp_seg *cseg, struct tcp_seg *next)
       }
       old_seg = next;
       next = next->next;
-      tcp_seg_free(old_seg);
+      tcp_oos_seg_free(pcb, old_seg);
     }
     if (next &&
         TCP_SEQ_GT(seqno + cseg->len, next->tcphdr->seqno)) {
       /* We need to trim the incoming segment. */
-      cseg->len = (u16_t)(next->tcphdr->seqno - seqno);
-      pbuf_realloc(cseg->p, cseg->len);
+      tcp_oos_trim(pcb, cseg, (u16_t)(next->tcphdr->seqno - seqno));
     }
   }
   cseg->next = next;
 }
+
+#if LWIP_TCP_OOSEQ_TREE
+/**
+ * Merge 'next' into 'seg' if it directly follows it and the result still
+ * fits into a segment. 'next' must be the segment after 'seg' on pcb->ooseq.
+ *
+ * @return 1 if the segments have been merged, 0 otherwise
+ */
+static u8_t
+tcp_oos_coalesce(struct tcp_pcb *pcb, struct tcp_seg *seg, struct tcp_seg *next)
+{
+  if ((seg->tcphdr->seqno + seg->len != next->tcphdr->seqno) ||
+      (TCPH_FLAGS(seg->tcphdr) & TCP_FIN) ||
+      ((u32_t)seg->len + next->len > 0xFFFF)) {
+    return 0;
+  }
+  if (next->len > 0) {
+    pbuf_cat(seg->p, next->p);
+    next->p = NULL;
+  }
+  seg->len = (u16_t)(seg->len + next->len);
+  if (TCPH_FLAGS(next->tcphdr) & TCP_FIN) {
+    TCPH_SET_FLAG(seg->tcphdr, TCP_FIN);
+  }
+  seg->next = next->next;
+  tcp_oos_seg_free(pcb, next);
+  return 1;
+}
+
+/**
+ * Queue the incoming out-of-sequence segment on pcb->ooseq. The segments
+ * before and after it are found through the search tree instead of walking
+ * the list. Data already on ooseq is kept, so a segment that brings nothing
+ * new is dropped. Otherwise the previous segment is trimmed, the segments
+ * covered by the new one are freed and the new one is trimmed to fit; then
+ * it is coalesced with its neighbours.
+ *
+ * Called from tcp_receive()
+ */
+static void
+tcp_oos_queue(struct tcp_pcb *pcb)
+{
+  struct tcp_seg *prev, *next, *cseg;
+
+  prev = tcp_ooseq_tree_lookup(pcb, seqno);
+  next = (prev != NULL) ? prev->next : pcb->ooseq;
+
+  if ((prev != NULL) &&
+      ((TCPH_FLAGS(prev->tcphdr) & TCP_FIN) ||
+       TCP_SEQ_GEQ(prev->tcphdr->seqno + TCP_TCPLEN(prev), seqno + tcplen))) {
+    /* segment "prev" already contains all data */
+    cseg = prev;
+  } else if ((next != NULL) && (next->tcphdr->seqno == seqno) &&
+             (TCP_TCPLEN(next) >= tcplen)) {
+    /* segment "next" already contains all data */
+    cseg = next;
+  } else {
+    cseg = tcp_seg_copy(&inseg);
+    if (cseg == NULL) {
+      return;
+    }
+    TCP_OOSEQ_MEM_ADD(pcb, pbuf_clen(cseg->p));
+    if (prev != NULL) {
+      if (TCP_SEQ_GT(prev->tcphdr->seqno + prev->len, seqno)) {
+        /* We need to trim the prev segment. */
+        tcp_oos_trim(pcb, prev, (u16_t)(seqno - prev->tcphdr->seqno));
+      }
+      prev->next = cseg;
+    } else {
+      pcb->ooseq = cseg;
+    }
+    tcp_oos_insert_segment(pcb, cseg, next);
+    /* check if the remote side overruns our receive window */
+    if ((cseg->next == NULL) &&
+        TCP_SEQ_GT((u32_t)tcplen + seqno, pcb->rcv_nxt + (u32_t)pcb->rcv_wnd)) {
+      LWIP_DEBUGF(TCP_INPUT_DEBUG,
+                  ("tcp_receive: other end overran receive window"
+                   "seqno %"U32_F" len %"U16_F" right edge %"U32_F"\n",
+                   seqno, tcplen, pcb->rcv_nxt + pcb->rcv_wnd));
+      if (TCPH_FLAGS(cseg->tcphdr) & TCP_FIN) {
+        /* Must remove the FIN from the header as we're trimming
+         * that byte of sequence-space from the packet */
+        TCPH_FLAGS_SET(cseg->tcphdr, TCPH_FLAGS(cseg->tcphdr) & ~TCP_FIN);
+      }
+      /* Adjust length of segment to fit in the window. */
+      tcp_oos_trim(pcb, cseg, (u16_t)(pcb->rcv_nxt + pcb->rcv_wnd - seqno));
+      tcplen = TCP_TCPLEN(cseg);
+      LWIP_ASSERT("tcp_receive: segment not trimmed correctly to rcv_wnd\n",
+                  (seqno + tcplen) == (pcb->rcv_nxt + pcb->rcv_wnd));
+    }
+    tcp_ooseq_tree_insert(pcb, cseg);
+    if ((prev != NULL) && tcp_oos_coalesce(pcb, prev, cseg)) {
+      cseg = prev;
+    }
+    if (cseg->next != NULL) {
+      tcp_oos_coalesce(pcb, cseg, cseg->next);
+    }
+  }
+
+#if LWIP_TCP_SACK_OUT
+  if (pcb->flags & TF_SACK) {
+    /* SACK the contiguous range of ooseq data the segment went to */
+    u32_t sackbeg, sackend;
+    for (prev = cseg; (next = tcp_ooseq_tree_lookup(pcb, prev->tcphdr->seqno)) != NULL; prev = next) {
+      if (next->tcphdr->seqno + next->len != prev->tcphdr->seqno) {
+        break;
+      }
+    }
+    sackbeg = prev->tcphdr->seqno;
+    sackend = cseg->tcphdr->seqno;
+    for (next = cseg; (next != NULL) && (sackend == next->tcphdr->seqno); next = next->next) {
+      sackend += next->len;
+    }
+    tcp_add_sack(pcb, sackbeg, sackend);
+  }
+#endif /* LWIP_TCP_SACK_OUT */
+}
+#endif /* LWIP_TCP_OOSEQ_TREE */
 #endif /* TCP_QUEUE_OOSEQ */
 
 /** Remove segments from a list if the incoming ACK acknowledges them */
@@ -1049,6 +1802,11 @@ tcp_free_acked_segments(struct tcp_pcb *pcb, struct tcp_seg *seg_list, const cha
 
     pcb->snd_queuelen = (u16_t)(pcb->snd_queuelen - clen);
     recv_acked = (tcpwnd_size_t)(recv_acked + next->len);
+#if LWIP_TCP_RACK
+    if (!(next->flags & TF_SEG_SACKED)) {
+      tcp_rack_update(pcb, next);
+    }
+#endif /* LWIP_TCP_RACK */
     tcp_seg_free(next);
 
     LWIP_DEBUGF(TCP_QLEN_DEBUG, ("%"TCPWNDSIZE_F" (after freeing %s)\n",
@@ -1092,12 +1850,21 @@ tcp_receive(struct tcp_pcb *pcb)
   u32_t ooseq_blen;
   u16_t ooseq_qlen;
 #endif /* TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS */
+#if LWIP_TCP_ECN
+  u8_t ecn_reduced = 0;
+#endif /* LWIP_TCP_ECN */
 
   LWIP_ASSERT("tcp_receive: wrong state", pcb->state >= ESTABLISHED);
 
   if (flags & TCP_ACK) {
     right_wnd_edge = pcb->snd_wnd + pcb->snd_wl2;
 
+#if LWIP_TCP_SACK_IN
+    if (tcp_in_sack_num > 0) {
+      tcp_sack_update(pcb);
+    }
+#endif /* LWIP_TCP_SACK_IN */
+
     /* Update window. */
     if (TCP_SEQ_LT(pcb->snd_wl1, seqno) ||
        (pcb->snd_wl1 == seqno && TCP_SEQ_LT(pcb->snd_wl2, ackno)) ||
@@ -1167,6 +1934,12 @@ tcp_receive(struct tcp_pcb *pcb)
               if ((u8_t)(pcb->dupacks + 1) > pcb->dupacks) {
                 ++pcb->dupacks;
               }
+#if LWIP_TCP_SACK_IN
+              if (pcb->flags & TF_SACK_RECOVERY) {
+                /* SACK-based recovery: retransmit holes as the pipe allows */
+                tcp_rexmit_sack(pcb, 0);
+              } else
+#endif /* LWIP_TCP_SACK_IN */
               if (pcb->dupacks > 3) {
                 /* Inflate the congestion window */
                 TCP_WND_INC(pcb->cwnd, pcb->mss);
@@ -1190,8 +1963,16 @@ tcp_receive(struct tcp_pcb *pcb)
       /* Reset the "IN Fast Retransmit" flag, since we are no longer
          in fast retransmit. Also reset the congestion window to the
          slow start threshold. */
+#if LWIP_TCP_SACK_IN
+      if ((pcb->flags & TF_SACK_RECOVERY) && TCP_SEQ_LT(ackno, pcb->sack_recover)) {
+        /* Partial ACK in SACK-based recovery: stay in recovery (RFC 6675) */
+      } else
+#endif /* LWIP_TCP_SACK_IN */
       if (pcb->flags & TF_INFR) {
         tcp_clear_flags(pcb, TF_INFR);
+#if LWIP_TCP_SACK_IN
+        tcp_clear_flags(pcb, TF_SACK_RECOVERY);
+#endif /* LWIP_TCP_SACK_IN */
         pcb->cwnd = pcb->ssthresh;
         pcb->bytes_acked = 0;
       }
@@ -1199,36 +1980,53 @@ tcp_receive(struct tcp_pcb *pcb)
       /* Reset the number of retransmissions. */
       pcb->nrtx = 0;
 
+#if LWIP_TCP_TS_RTTM
+      /* Every ACK for new data is an RTT sample if it echoes a timestamp */
+      tcp_ts_rttm(pcb);
+#endif /* LWIP_TCP_TS_RTTM */
+
+#if LWIP_TCP_ECN
+      /* ECN-Echo: reduce cwnd like for a loss, but at most once per window
+         (RFC 3168, 6.1.2), and don't grow it with this ACK */
+      if ((pcb->ecn & TCP_ECN_ON) && (tcp_in_ecn & TCP_ECE) &&
+          !(pcb->flags & TF_INFR) && TCP_SEQ_GT(ackno, pcb->ecn_recover)) {
+        pcb->cc->loss(pcb);
+        pcb->cwnd = pcb->ssthresh;
+        pcb->bytes_acked = 0;
+        pcb->ecn_recover = pcb->snd_nxt;
+        pcb->ecn |= TCP_ECN_CWR;
+        ecn_reduced = 1;
+        LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: ECE, cwnd %"TCPWNDSIZE_F"\n", pcb->cwnd));
+      }
+#endif /* LWIP_TCP_ECN */
+
+#if IP_PMTUD
+      /* try a larger MSS again when the path MTU estimate has expired */
+      if ((pcb->mss < pcb->snd_mss_max) &&
+          ((u32_t)(sys_now() - pcb->pmtu_time) >= IP_PMTU_TIMEOUT)) {
+        tcp_pmtu_probe(pcb);
+      }
+#endif /* IP_PMTUD */
+
       /* Reset the retransmission time-out. */
       pcb->rto = (s16_t)((pcb->sa >> 3) + pcb->sv);
 
       /* Record how much data this ACK acks */
       acked = (tcpwnd_size_t)(ackno - pcb->lastack);
+      TCP_INFO_ADD(pcb, info_bytes_acked, acked);
 
       /* Reset the fast retransmit variables. */
       pcb->dupacks = 0;
       pcb->lastack = ackno;
 
-      /* Update the congestion control variables (cwnd and
-         ssthresh). */
-      if (pcb->state >= ESTABLISHED) {
-        if (pcb->cwnd < pcb->ssthresh) {
-          tcpwnd_size_t increase;
-          /* limit to 1 SMSS segment during period following RTO */
-          u8_t num_seg = (pcb->flags & TF_RTO) ? 1 : 2;
-          /* RFC 3465, section 2.2 Slow Start */
-          increase = LWIP_MIN(acked, (tcpwnd_size_t)(num_seg * pcb->mss));
-          TCP_WND_INC(pcb->cwnd, increase);
-          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: slow start cwnd %"TCPWNDSIZE_F"\n", pcb->cwnd));
-        } else {
-          /* RFC 3465, section 2.1 Congestion Avoidance */
-          TCP_WND_INC(pcb->bytes_acked, acked);
-          if (pcb->bytes_acked >= pcb->cwnd) {
-            pcb->bytes_acked = (tcpwnd_size_t)(pcb->bytes_acked - pcb->cwnd);
-            TCP_WND_INC(pcb->cwnd, pcb->mss);
-          }
-          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: congestion avoidance cwnd %"TCPWNDSIZE_F"\n", pcb->cwnd));
-        }
+      /* Let the congestion control update cwnd and ssthresh.
+         cwnd does not grow during (SACK-based) recovery. */
+      if ((pcb->state >= ESTABLISHED) && !(pcb->flags & TF_INFR)
+#if LWIP_TCP_ECN
+          && !ecn_reduced
+#endif /* LWIP_TCP_ECN */
+         ) {
+        pcb->cc->ack(pcb, acked);
       }
       LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_receive: ACK for %"U32_F", unacked->seqno %"U32_F":%"U32_F"\n",
                                     ackno,
@@ -1257,6 +2055,16 @@ tcp_receive(struct tcp_pcb *pcb)
       }
 
       pcb->polltmr = 0;
+#if LWIP_TCP_PCB_TIMERS
+      pcb->timer_poll = tcp_ticks;
+#endif /* LWIP_TCP_PCB_TIMERS */
+
+#if LWIP_TCP_SACK_IN
+      if (pcb->flags & TF_SACK_RECOVERY) {
+        /* partial ACK: retransmit the next holes */
+        tcp_rexmit_sack(pcb, 0);
+      }
+#endif /* LWIP_TCP_SACK_IN */
 
 #if TCP_OVERSIZE
       if (pcb->unsent == NULL) {
@@ -1272,6 +2080,7 @@ tcp_receive(struct tcp_pcb *pcb)
 #endif /* LWIP_IPV6 && LWIP_ND6_TCP_REACHABILITY_HINTS*/
 
       pcb->snd_buf = (tcpwnd_size_t)(pcb->snd_buf + recv_acked);
+      TCP_SNDBUF_UPDATE(pcb);
       /* check if this ACK ends our retransmission of in-flight data */
       if (pcb->flags & TF_RTO) {
         /* RTO is done if
@@ -1299,6 +2108,12 @@ tcp_receive(struct tcp_pcb *pcb)
     /* RTT estimation calculations. This is done by checking if the
        incoming segment acknowledges the segment we use to take a
        round-trip time measurement. */
+#if LWIP_TCP_TS_RTTM
+    /* once timestamps gave a sample, they are the only source */
+    if (pcb->ts_srtt != 0) {
+      pcb->rttest = 0;
+    }
+#endif /* LWIP_TCP_TS_RTTM */
     if (pcb->rttest && TCP_SEQ_LT(pcb->rtseq, ackno)) {
       /* diff between this shouldn't exceed 32K since this are tcp timer ticks
          and a round-trip shouldn't be that long... */
@@ -1320,8 +2135,23 @@ tcp_receive(struct tcp_pcb *pcb)
       LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_receive: RTO %"U16_F" (%"U16_F" milliseconds)\n",
                                   pcb->rto, (u16_t)(pcb->rto * TCP_SLOW_INTERVAL)));
 
+#if LWIP_TCP_PACING
+      {
+        /* sa has slow timer resolution, the pacing rate needs milliseconds */
+        u32_t rtt_ms = sys_now() - pcb->pacing_rtt_time;
+        if (pcb->pacing_srtt == 0) {
+          pcb->pacing_srtt = LWIP_MAX(rtt_ms, 1) << 3;
+        } else {
+          pcb->pacing_srtt = pcb->pacing_srtt - (pcb->pacing_srtt >> 3) + rtt_ms;
+        }
+      }
+#endif /* LWIP_TCP_PACING */
+
       pcb->rttest = 0;
     }
+#if LWIP_TCP_RACK
+    tcp_rack_ack(pcb);
+#endif /* LWIP_TCP_RACK */
   }
 
   /* If the incoming segment contains data, we must process it
@@ -1467,6 +2297,8 @@ tcp_receive(struct tcp_pcb *pcb)
               pcb->ooseq = pcb->ooseq->next;
               tcp_seg_free(old_ooseq);
             }
+            TCP_OOSEQ_TREE_CLEAR(pcb);
+            TCP_OOSEQ_MEM_SUB(pcb, pcb->ooseq_pbufs);
           } else {
             next = pcb->ooseq;
             /* Remove all segments on ooseq that are covered by inseg already.
@@ -1482,7 +2314,7 @@ tcp_receive(struct tcp_pcb *pcb)
               }
               prev = next;
               next = next->next;
-              tcp_seg_free(prev);
+              tcp_oos_seg_free(pcb, prev);
             }
             /* Now trim right side of inseg if it overlaps with the first
              * segment on ooseq */
@@ -1563,6 +2395,7 @@ tcp_receive(struct tcp_pcb *pcb)
           tcp_update_rcv_ann_wnd(pcb);
 
           if (cseg->p->tot_len > 0) {
+            TCP_OOSEQ_MEM_SUB(pcb, pbuf_clen(cseg->p));
             /* Chain this pbuf onto the pbuf that we will pass to
                the application. */
             /* With window scaling, this can overflow recv_data->tot_len, but
@@ -1584,10 +2417,11 @@ tcp_receive(struct tcp_pcb *pcb)
           }
 
           pcb->ooseq = cseg->next;
-          tcp_seg_free(cseg);
+          tcp_oos_seg_free(pcb, cseg);
         }
 #endif /* TCP_QUEUE_OOSEQ */
 
+        TCP_RCV_RTT_MEASURE(pcb);
 
         /* Acknowledge the segment(s). */
         tcp_ack(pcb);
@@ -1614,8 +2448,14 @@ tcp_receive(struct tcp_pcb *pcb)
 
 #if TCP_QUEUE_OOSEQ
         /* We queue the segment on the ->ooseq queue. */
+#if LWIP_TCP_OOSEQ_TREE
+        tcp_oos_queue(pcb);
+#else /* LWIP_TCP_OOSEQ_TREE */
         if (pcb->ooseq == NULL) {
           pcb->ooseq = tcp_seg_copy(&inseg);
+          if (pcb->ooseq != NULL) {
+            TCP_OOSEQ_MEM_ADD(pcb, pbuf_clen(pcb->ooseq->p));
+          }
 #if LWIP_TCP_SACK_OUT
           if (pcb->flags & TF_SACK) {
             /* All the SACKs should be invalid, so we can simply store the most recent one: */
@@ -1654,12 +2494,13 @@ tcp_receive(struct tcp_pcb *pcb)
                    one. */
                 cseg = tcp_seg_copy(&inseg);
                 if (cseg != NULL) {
+                  TCP_OOSEQ_MEM_ADD(pcb, pbuf_clen(cseg->p));
                   if (prev != NULL) {
                     prev->next = cseg;
                   } else {
                     pcb->ooseq = cseg;
                   }
-                  tcp_oos_insert_segment(cseg, next);
+                  tcp_oos_insert_segment(pcb, cseg, next);
                 }
                 break;
               } else {
@@ -1677,8 +2518,9 @@ tcp_receive(struct tcp_pcb *pcb)
                      queue. */
                   cseg = tcp_seg_copy(&inseg);
                   if (cseg != NULL) {
+                    TCP_OOSEQ_MEM_ADD(pcb, pbuf_clen(cseg->p));
                     pcb->ooseq = cseg;
-                    tcp_oos_insert_segment(cseg, next);
+                    tcp_oos_insert_segment(pcb, cseg, next);
                   }
                   break;
                 }
@@ -1693,13 +2535,13 @@ tcp_receive(struct tcp_pcb *pcb)
                      and trim received, if needed. */
                   cseg = tcp_seg_copy(&inseg);
                   if (cseg != NULL) {
+                    TCP_OOSEQ_MEM_ADD(pcb, pbuf_clen(cseg->p));
                     if (TCP_SEQ_GT(prev->tcphdr->seqno + prev->len, seqno)) {
                       /* We need to trim the prev segment. */
-                      prev->len = (u16_t)(seqno - prev->tcphdr->seqno);
-                      pbuf_realloc(prev->p, prev->len);
+                      tcp_oos_trim(pcb, prev, (u16_t)(seqno - prev->tcphdr->seqno));
                     }
                     prev->next = cseg;
-                    tcp_oos_insert_segment(cseg, next);
+                    tcp_oos_insert_segment(pcb, cseg, next);
                   }
                   break;
                 }
@@ -1729,10 +2571,10 @@ tcp_receive(struct tcp_pcb *pcb)
                 }
                 next->next = tcp_seg_copy(&inseg);
                 if (next->next != NULL) {
+                  TCP_OOSEQ_MEM_ADD(pcb, pbuf_clen(next->next->p));
                   if (TCP_SEQ_GT(next->tcphdr->seqno + next->len, seqno)) {
                     /* We need to trim the last segment. */
-                    next->len = (u16_t)(seqno - next->tcphdr->seqno);
-                    pbuf_realloc(next->p, next->len);
+                    tcp_oos_trim(pcb, next, (u16_t)(seqno - next->tcphdr->seqno));
                   }
                   /* check if the remote side overruns our receive window */
                   if (TCP_SEQ_GT((u32_t)tcplen + seqno, pcb->rcv_nxt + (u32_t)pcb->rcv_wnd)) {
@@ -1746,8 +2588,7 @@ tcp_receive(struct tcp_pcb *pcb)
                       TCPH_FLAGS_SET(next->next->tcphdr, TCPH_FLAGS(next->next->tcphdr) & ~TCP_FIN);
                     }
                     /* Adjust length of segment to fit in the window. */
-                    next->next->len = (u16_t)(pcb->rcv_nxt + pcb->rcv_wnd - seqno);
-                    pbuf_realloc(next->next->p, next->next->len);
+                    tcp_oos_trim(pcb, next->next, (u16_t)(pcb->rcv_nxt + pcb->rcv_wnd - seqno));
                     tcplen = TCP_TCPLEN(next->next);
                     LWIP_ASSERT("tcp_receive: segment not trimmed correctly to rcv_wnd\n",
                                 (seqno + tcplen) == (pcb->rcv_nxt + pcb->rcv_wnd));
@@ -1784,6 +2625,7 @@ tcp_receive(struct tcp_pcb *pcb)
           }
 #endif /* LWIP_TCP_SACK_OUT */
         }
+#endif /* LWIP_TCP_OOSEQ_TREE */
 #if TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS
         /* Check that the data on ooseq doesn't exceed one of the limits
            and throw away everything above that limit. */
@@ -1792,18 +2634,49 @@ tcp_receive(struct tcp_pcb *pcb)
         prev = NULL;
         for (next = pcb->ooseq; next != NULL; prev = next, next = next->next) {
           struct pbuf *p = next->p;
+#if LWIP_TCP_OOSEQ_TREE
+          u16_t keep = 0;
+#endif /* LWIP_TCP_OOSEQ_TREE */
           ooseq_blen += p->tot_len;
           ooseq_qlen += pbuf_clen(p);
           if ((ooseq_blen > TCP_OOSEQ_MAX_BYTES) ||
               (ooseq_qlen > TCP_OOSEQ_MAX_PBUFS)) {
-#if LWIP_TCP_SACK_OUT
-             if (pcb->flags & TF_SACK) {
-               /* Let's remove all SACKs from next's seqno up. */
-               tcp_remove_sacks_gt(pcb, next->tcphdr->seqno);
+#if LWIP_TCP_OOSEQ_TREE
+             /* 'next' may be a big coalesced segment: keep those of its
+                pbufs that are still within the limits */
+             ooseq_blen -= p->tot_len;
+             ooseq_qlen = (u16_t)(ooseq_qlen - pbuf_clen(p));
+             for (; p != NULL; p = p->next) {
+               ooseq_blen += p->len;
+               ooseq_qlen++;
+               if ((ooseq_blen > TCP_OOSEQ_MAX_BYTES) ||
+                   (ooseq_qlen > TCP_OOSEQ_MAX_PBUFS)) {
+                 break;
+               }
+               keep = (u16_t)(keep + p->len);
              }
+             if (keep > 0) {
+               TCPH_FLAGS_SET(next->tcphdr, TCPH_FLAGS(next->tcphdr) & ~TCP_FIN);
+               tcp_oos_trim(pcb, next, keep);
+#if LWIP_TCP_SACK_OUT
+               if (pcb->flags & TF_SACK) {
+                 tcp_remove_sacks_gt(pcb, next->tcphdr->seqno + keep);
+               }
+#endif /* LWIP_TCP_SACK_OUT */
+               prev = next;
+               next = next->next;
+             } else
+#endif /* LWIP_TCP_OOSEQ_TREE */
+             {
+#if LWIP_TCP_SACK_OUT
+               if (pcb->flags & TF_SACK) {
+                 /* Let's remove all SACKs from next's seqno up. */
+                 tcp_remove_sacks_gt(pcb, next->tcphdr->seqno);
+               }
 #endif /* LWIP_TCP_SACK_OUT */
+             }
              /* too much ooseq data, dump this and everything after it */
-             tcp_segs_free(next);
+             tcp_oos_free_segs(pcb, next);
              if (prev == NULL) {
                /* first ooseq segment is too much, dump the whole queue */
                pcb->ooseq = NULL;
@@ -1815,6 +2688,8 @@ tcp_receive(struct tcp_pcb *pcb)
           }
         }
 #endif /* TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS */
+        /* the new segment may exceed the budget, this may prune it again */
+        TCP_OOSEQ_MEM_CHECK();
 #endif /* TCP_QUEUE_OOSEQ */
 
         /* We send the ACK packet after we've (potentially) dealt with SACKs,
@@ -1847,6 +2722,19 @@ tcp_get_next_optbyte(void)
   }
 }
 
+#if LWIP_TCP_SACK_IN || LWIP_TCP_TS_RTTM || ((LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ) && LWIP_TCP_TIMESTAMPS)
+/** Read a 32-bit option value in network byte order */
+static u32_t
+tcp_get_next_optu32(void)
+{
+  u32_t val = (u32_t)tcp_get_next_optbyte() << 24;
+  val |= (u32_t)tcp_get_next_optbyte() << 16;
+  val |= (u32_t)tcp_get_next_optbyte() << 8;
+  val |= tcp_get_next_optbyte();
+  return val;
+}
+#endif /* LWIP_TCP_SACK_IN || LWIP_TCP_TS_RTTM || ((LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ) && LWIP_TCP_TIMESTAMPS) */
+
 /**
  * Parses the options contained in the incoming segment.
  *
@@ -1864,6 +2752,16 @@ tcp_parseopt(struct tcp_pcb *pcb)
   u32_t tsval;
 #endif
 
+#if LWIP_TCP_SACK_IN
+  tcp_in_sack_num = 0;
+#endif /* LWIP_TCP_SACK_IN */
+#if LWIP_TCP_TS_RTTM
+  tcp_in_tsecr = 0;
+#endif /* LWIP_TCP_TS_RTTM */
+#if LWIP_TCP_FASTOPEN
+  tcp_in_fastopen_len = TCP_IN_FASTOPEN_NONE;
+#endif /* LWIP_TCP_FASTOPEN */
+
   /* Parse the TCP MSS option, if present. */
   if (tcphdr_optlen != 0) {
     for (tcp_optidx = 0; tcp_optidx < tcphdr_optlen; ) {
@@ -1913,6 +2811,7 @@ tcp_parseopt(struct tcp_pcb *pcb)
           LWIP_ASSERT("window not at default value", pcb->rcv_wnd == TCPWND_MIN16(TCP_WND));
           LWIP_ASSERT("window not at default value", pcb->rcv_ann_wnd == TCPWND_MIN16(TCP_WND));
           pcb->rcv_wnd = pcb->rcv_ann_wnd = TCP_WND;
+          TCP_RCV_AUTOTUNE_INIT(pcb);
         }
         break;
 #endif /* LWIP_WND_SCALE */
@@ -1937,6 +2836,12 @@ tcp_parseopt(struct tcp_pcb *pcb)
         } else if (TCP_SEQ_BETWEEN(pcb->ts_lastacksent, seqno, seqno+tcplen)) {
           pcb->ts_recent = lwip_ntohl(tsval);
         }
+#if LWIP_TCP_TS_RTTM
+        if (flags & TCP_ACK) {
+          tcp_in_tsecr = tcp_get_next_optu32();
+          break;
+        }
+#endif /* LWIP_TCP_TS_RTTM */
         /* Advance to next option (6 bytes already read) */
         tcp_optidx += LWIP_TCP_OPT_LEN_TS - 6;
         break;
@@ -1956,6 +2861,47 @@ tcp_parseopt(struct tcp_pcb *pcb)
         }
         break;
 #endif /* LWIP_TCP_SACK_OUT */
+#if LWIP_TCP_SACK_IN
+      case LWIP_TCP_OPT_SACK:
+        LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: SACK\n"));
+        data = tcp_get_next_optbyte();
+        if ((data < 10) || (((data - 2) % 8) != 0) || (tcp_optidx - 2 + data) > tcphdr_optlen) {
+          /* Bad length */
+          LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: bad length\n"));
+          return;
+        }
+        /* TCP SACK option with valid length: read the blocks */
+        for (data = (u8_t)((data - 2) / 8); data > 0; data--) {
+          u32_t left = tcp_get_next_optu32();
+          u32_t right = tcp_get_next_optu32();
+          if ((tcp_in_sack_num < TCP_SACK_IN_MAX_BLOCKS) && TCP_SEQ_LT(left, right)) {
+            tcp_in_sacks[tcp_in_sack_num].left = left;
+            tcp_in_sacks[tcp_in_sack_num].right = right;
+            tcp_in_sack_num++;
+          }
+        }
+        break;
+#endif /* LWIP_TCP_SACK_IN */
+#if LWIP_TCP_FASTOPEN
+      case LWIP_TCP_OPT_FASTOPEN:
+        LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: FASTOPEN\n"));
+        data = tcp_get_next_optbyte();
+        if ((data < 2) || (tcp_optidx - 2 + data) > tcphdr_optlen) {
+          /* Bad length */
+          LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: bad length\n"));
+          return;
+        }
+        /* TCP Fast Open option with valid length: cookie request (no
+           cookie) or cookie, only used in SYN segments */
+        tcp_in_fastopen_len = (u8_t)(data - 2);
+        for (data = 0; data < tcp_in_fastopen_len; data++) {
+          u8_t b = tcp_get_next_optbyte();
+          if (data < TCP_FASTOPEN_COOKIE_LEN) {
+            tcp_in_fastopen_cookie[data] = b;
+          }
+        }
+        break;
+#endif /* LWIP_TCP_FASTOPEN */
       default:
         LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: other\n"));
         data = tcp_get_next_optbyte();
@@ -1973,12 +2919,203 @@ tcp_parseopt(struct tcp_pcb *pcb)
   }
 }
 
+#if LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ
+/**
+ * Parses the options of a segment to a listening pcb (a SYN or the ACK
+ * returning a SYN cookie) without a pcb: only MSS, window scale, SACK
+ * permitted and timestamp options are evaluated (and the presence of a
+ * TCP Fast Open option).
+ *
+ * Called from tcp_listen_input().
+ *
+ * @param opts receives the options
+ */
+static void
+tcp_parseopt_syn(struct tcp_syn_opts *opts)
+{
+  u8_t data;
+  u16_t mss;
+
+  opts->mss = INITIAL_MSS;
+  opts->snd_scale = TCP_SYN_OPTS_NO_WS;
+  opts->sack_perm = 0;
+  opts->ts = 0;
+#if LWIP_TCP_FASTOPEN
+  opts->fastopen = 0;
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_ECN
+  opts->ecn = (u8_t)((flags & TCP_SYN) && TCP_IN_ECN_SETUP_SYN());
+#endif /* LWIP_TCP_ECN */
+
+  for (tcp_optidx = 0; tcp_optidx < tcphdr_optlen; ) {
+    u8_t opt = tcp_get_next_optbyte();
+    switch (opt) {
+    case LWIP_TCP_OPT_EOL:
+      return;
+    case LWIP_TCP_OPT_NOP:
+      break;
+    case LWIP_TCP_OPT_MSS:
+      if (tcp_get_next_optbyte() != LWIP_TCP_OPT_LEN_MSS || (tcp_optidx - 2 + LWIP_TCP_OPT_LEN_MSS) > tcphdr_optlen) {
+        return;
+      }
+      mss = (u16_t)(tcp_get_next_optbyte() << 8);
+      mss |= tcp_get_next_optbyte();
+      opts->mss = ((mss > TCP_MSS) || (mss == 0)) ? TCP_MSS : mss;
+      break;
+#if LWIP_WND_SCALE
+    case LWIP_TCP_OPT_WS:
+      if (tcp_get_next_optbyte() != LWIP_TCP_OPT_LEN_WS || (tcp_optidx - 2 + LWIP_TCP_OPT_LEN_WS) > tcphdr_optlen) {
+        return;
+      }
+      data = tcp_get_next_optbyte();
+      opts->snd_scale = LWIP_MIN(data, 14);
+      break;
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_TIMESTAMPS
+    case LWIP_TCP_OPT_TS:
+      if (tcp_get_next_optbyte() != LWIP_TCP_OPT_LEN_TS || (tcp_optidx - 2 + LWIP_TCP_OPT_LEN_TS) > tcphdr_optlen) {
+        return;
+      }
+      opts->tsval = tcp_get_next_optu32();
+      opts->tsecr = tcp_get_next_optu32();
+      opts->ts = 1;
+      break;
+#endif /* LWIP_TCP_TIMESTAMPS */
+#if LWIP_TCP_SACK_OUT
+    case LWIP_TCP_OPT_SACK_PERM:
+      if (tcp_get_next_optbyte() != LWIP_TCP_OPT_LEN_SACK_PERM || (tcp_optidx - 2 + LWIP_TCP_OPT_LEN_SACK_PERM) > tcphdr_optlen) {
+        return;
+      }
+      opts->sack_perm = 1;
+      break;
+#endif /* LWIP_TCP_SACK_OUT */
+    default:
+      data = tcp_get_next_optbyte();
+      if (data < 2) {
+        /* malformed options */
+        return;
+      }
+#if LWIP_TCP_FASTOPEN
+      if (opt == LWIP_TCP_OPT_FASTOPEN) {
+        opts->fastopen = 1;
+      }
+#endif /* LWIP_TCP_FASTOPEN */
+      tcp_optidx += data - 2;
+    }
+  }
+}
+#endif /* LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ */
+
+#if LWIP_TCP_TS_RTTM
+/**
+ * Update the RTT estimator with the timestamp echoed by an ACK for new data
+ * (RFC 7323, section 4). The echoed value is the time our segment that
+ * triggered the ACK was sent, so retransmitted segments give valid samples
+ * too. As there are up to one sample per two segments, the gains of RFC 6298
+ * are divided by the number of samples expected per window (appendix G).
+ * The result is kept in milliseconds and copied to sa/sv/rto in slow timer
+ * ticks, so that the classic measurement with rttest is not needed. sa is
+ * rounded up so that a sub-tick RTT does not read as "no estimate"; users
+ * that need the RTT itself take it from tcp_srtt_ms().
+ *
+ * @param pcb the tcp_pcb that received an ACK for new data
+ */
+static void
+tcp_ts_rttm(struct tcp_pcb *pcb)
+{
+  u32_t m, samples, rto;
+  s32_t delta;
+
+  if (!(pcb->flags & TF_TIMESTAMP) || (tcp_in_tsecr == 0)) {
+    return;
+  }
+  m = sys_now() - tcp_in_tsecr;
+  if (m > 0x7FFF * TCP_SLOW_INTERVAL) {
+    /* not a timestamp we sent (or far too old to be useful) */
+    return;
+  }
+
+  if (pcb->ts_srtt == 0) {
+    /* first measurement (RFC 6298, 2.2) */
+    pcb->ts_srtt = LWIP_MAX(m, 1) << 3;
+    pcb->ts_rttvar = m << 1;
+  } else {
+    samples = (u32_t)(pcb->snd_nxt - pcb->lastack) / (2 * (u32_t)pcb->mss);
+    samples = LWIP_MAX(samples, 1);
+    delta = (s32_t)(m - (pcb->ts_srtt >> 3));
+    pcb->ts_srtt = (u32_t)((s32_t)pcb->ts_srtt + delta / (s32_t)samples);
+    pcb->ts_srtt = LWIP_MAX(pcb->ts_srtt, 1);
+    if (delta < 0) {
+      delta = -delta;
+    }
+    delta -= (s32_t)(pcb->ts_rttvar >> 2);
+    pcb->ts_rttvar = (u32_t)((s32_t)pcb->ts_rttvar + delta / (s32_t)samples);
+  }
+
+  /* RTO = SRTT + max(G, 4 * RTTVAR), G being the timer granularity,
+     rounded up to timer ticks */
+  rto = (pcb->ts_srtt >> 3) + LWIP_MAX(pcb->ts_rttvar, TCP_SLOW_INTERVAL);
+  rto = (rto + TCP_SLOW_INTERVAL - 1) / TCP_SLOW_INTERVAL;
+  rto = LWIP_MIN(rto, 0x7FFF);
+  pcb->sa = (s16_t)LWIP_MIN((pcb->ts_srtt + TCP_SLOW_INTERVAL - 1) / TCP_SLOW_INTERVAL, 0x7FFF);
+  pcb->sv = (s16_t)(rto - (u32_t)(pcb->sa >> 3));
+  pcb->rto = (s16_t)rto;
+  pcb->rttest = 0;
+
+  LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_ts_rttm: rtt %"U32_F" ms, srtt %"U32_F" ms, rto %"U32_F" ms\n",
+                              m, pcb->ts_srtt >> 3, rto * TCP_SLOW_INTERVAL));
+}
+#endif /* LWIP_TCP_TS_RTTM */
+
 void
 tcp_trigger_input_pcb_close(void)
 {
   recv_flags |= TF_CLOSED;
 }
 
+#if LWIP_TCP_SACK_IN
+/**
+ * Called by tcp_receive() to update the SACK scoreboard: mark all segments on
+ * the unacked queue that are completely covered by one of the SACK blocks of
+ * the incoming segment.
+ *
+ * @param pcb the tcp_pcb for which a segment arrived
+ */
+static void
+tcp_sack_update(struct tcp_pcb *pcb)
+{
+  struct tcp_seg *seg;
+  u8_t i;
+
+  if ((pcb->flags & TF_SACK) == 0) {
+    return;
+  }
+  for (i = 0; i < tcp_in_sack_num; i++) {
+    u32_t left = tcp_in_sacks[i].left;
+    u32_t right = tcp_in_sacks[i].right;
+    /* ignore D-SACKs and blocks beyond what we have sent */
+    if (TCP_SEQ_LEQ(right, pcb->lastack) || TCP_SEQ_GT(right, pcb->snd_nxt)) {
+      continue;
+    }
+    /* the unacked queue is sorted */
+    for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+      u32_t seg_seqno = lwip_ntohl(seg->tcphdr->seqno);
+      if (TCP_SEQ_GEQ(seg_seqno, right)) {
+        break;
+      }
+      if (TCP_SEQ_GEQ(seg_seqno, left) &&
+          TCP_SEQ_LEQ(seg_seqno + TCP_TCPLEN(seg), right) &&
+          !(seg->flags & TF_SEG_SACKED)) {
+        seg->flags |= TF_SEG_SACKED;
+#if LWIP_TCP_RACK
+        tcp_rack_update(pcb, seg);
+#endif /* LWIP_TCP_RACK */
+      }
+    }
+  }
+}
+#endif /* LWIP_TCP_SACK_IN */
+
 #if LWIP_TCP_SACK_OUT
 /**
  * Called by tcp_receive() to add new SACK entry.
@@ -2080,7 +3217,7 @@ tcp_remove_sacks_lt(struct tcp_pcb *pcb, u32_t seq)
   }
 }
 
-#if TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS
+#if TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS || LWIP_TCP_OOSEQ_MEM
 /**
  * Called to remove a range of SACKs.
  *
@@ -2119,7 +3256,7 @@ tcp_remove_sacks_gt(struct tcp_pcb *pcb, u32_t seq)
     pcb->rcv_sacks[i].left = pcb->rcv_sacks[i].right = 0;
   }
 }
-#endif /* TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS */
+#endif /* TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS || LWIP_TCP_OOSEQ_MEM */
 
 #endif /* LWIP_TCP_SACK_OUT */
 
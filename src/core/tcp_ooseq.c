@@ -0,0 +1,164 @@
+/**
+ * @file
+ * Transmission Control Protocol, search tree over the out-of-sequence queue
+ *
+ * pcb->ooseq stays a list sorted by sequence number. With
+ * LWIP_TCP_OOSEQ_TREE, its segments are also linked into a treap keyed by
+ * sequence number (pcb->ooseq_root, tcp_seg->oos_left/oos_right), so that
+ * tcp_receive() finds the place of an incoming segment in O(log n) instead of
+ * walking the list. The priority of a node is a hash of its address, so no
+ * extra memory is needed per segment besides the two child pointers.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_OOSEQ_TREE /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+
+#define TCP_OOSEQ_KEY(seg) ((seg)->tcphdr->seqno)
+
+/** Heap priority of a node: a hash of its address */
+static u32_t
+tcp_ooseq_prio(const struct tcp_seg *seg)
+{
+  u32_t h = (u32_t)(mem_ptr_t)seg;
+  h ^= h >> 16;
+  h *= 0x7feb352dUL;
+  h ^= h >> 15;
+  h *= 0x846ca68bUL;
+  h ^= h >> 16;
+  return h;
+}
+
+/**
+ * Link a segment into the tree. The segment must already be on pcb->ooseq
+ * and no other segment on ooseq may have the same sequence number.
+ */
+void
+tcp_ooseq_tree_insert(struct tcp_pcb *pcb, struct tcp_seg *seg)
+{
+  struct tcp_seg **link = &pcb->ooseq_root;
+  struct tcp_seg **left, **right;
+  struct tcp_seg *t;
+  u32_t key = TCP_OOSEQ_KEY(seg);
+  u32_t prio = tcp_ooseq_prio(seg);
+
+  /* descend to where seg belongs by its priority... */
+  while ((*link != NULL) && (tcp_ooseq_prio(*link) >= prio)) {
+    LWIP_ASSERT("duplicate ooseq seqno", TCP_OOSEQ_KEY(*link) != key);
+    if (TCP_SEQ_LT(key, TCP_OOSEQ_KEY(*link))) {
+      link = &(*link)->oos_left;
+    } else {
+      link = &(*link)->oos_right;
+    }
+  }
+  /* ...and split the subtree found there into seg's children */
+  t = *link;
+  left = &seg->oos_left;
+  right = &seg->oos_right;
+  while (t != NULL) {
+    if (TCP_SEQ_LT(TCP_OOSEQ_KEY(t), key)) {
+      *left = t;
+      left = &t->oos_right;
+      t = t->oos_right;
+    } else {
+      *right = t;
+      right = &t->oos_left;
+      t = t->oos_left;
+    }
+  }
+  *left = NULL;
+  *right = NULL;
+  *link = seg;
+}
+
+/**
+ * Unlink a segment from the tree (before it is removed from pcb->ooseq).
+ */
+void
+tcp_ooseq_tree_remove(struct tcp_pcb *pcb, struct tcp_seg *seg)
+{
+  struct tcp_seg **link = &pcb->ooseq_root;
+  struct tcp_seg *a, *b;
+  u32_t key = TCP_OOSEQ_KEY(seg);
+
+  while (*link != seg) {
+    if (*link == NULL) {
+      LWIP_ASSERT("tcp_ooseq_tree_remove: segment not found", 0);
+      return;
+    }
+    if (TCP_SEQ_LT(key, TCP_OOSEQ_KEY(*link))) {
+      link = &(*link)->oos_left;
+    } else {
+      link = &(*link)->oos_right;
+    }
+  }
+  /* replace seg by the merge of its children */
+  a = seg->oos_left;
+  b = seg->oos_right;
+  while ((a != NULL) && (b != NULL)) {
+    if (tcp_ooseq_prio(a) >= tcp_ooseq_prio(b)) {
+      *link = a;
+      link = &a->oos_right;
+      a = a->oos_right;
+    } else {
+      *link = b;
+      link = &b->oos_left;
+      b = b->oos_left;
+    }
+  }
+  *link = (a != NULL) ? a : b;
+}
+
+/**
+ * Find the segment on pcb->ooseq with the highest sequence number below
+ * seqno.
+ *
+ * @return that segment or NULL if all segments start at or after seqno
+ */
+struct tcp_seg *
+tcp_ooseq_tree_lookup(struct tcp_pcb *pcb, u32_t seqno)
+{
+  struct tcp_seg *t = pcb->ooseq_root;
+  struct tcp_seg *found = NULL;
+
+  while (t != NULL) {
+    if (TCP_SEQ_LT(TCP_OOSEQ_KEY(t), seqno)) {
+      found = t;
+      t = t->oos_right;
+    } else {
+      t = t->oos_left;
+    }
+  }
+  return found;
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_OOSEQ_TREE */
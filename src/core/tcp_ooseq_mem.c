@@ -0,0 +1,153 @@
+/**
+ * @file
+ * Transmission Control Protocol, out-of-sequence queue memory
+ *
+ * With LWIP_TCP_OOSEQ_MEM, the pbufs queued on ooseq of all pcbs are
+ * accounted against one budget, TCP_OOSEQ_MEM_PBUFS. Each pcb counts its own
+ * pbufs (pcb->ooseq_pbufs): tcp_receive() adds the pbufs of every segment it
+ * queues and subtracts those it trims, frees or delivers, so the queues are
+ * never walked for accounting. The pcbs are only scanned while the budget
+ * is exceeded.
+ *
+ * Memory is taken back in this order:
+ * - from the pcb holding the most pbufs: it has the most data queued that
+ *   can't be delivered until its holes are filled, while small queues are
+ *   often just one segment away from being delivered,
+ * - from the end of its queue: the data with the highest sequence numbers is
+ *   needed last and the peer retransmits it last.
+ * The largest holder is only pruned down to the next largest one, so a pcb
+ * holding no more than its share of the budget (the budget divided by the
+ * number of pcbs with ooseq data) is never pruned because of the budget.
+ *
+ * When PBUF_POOL runs empty, pbuf_free_ooseq() calls tcp_ooseq_mem_reclaim(),
+ * which frees half of all ooseq pbufs the same way instead of dropping the
+ * whole queue of one pcb.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_OOSEQ_MEM /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/stats.h"
+
+/** pbufs queued on ooseq of all pcbs */
+static u32_t tcp_ooseq_mem_used;
+
+/** Account 'pbufs' more pbufs queued on ooseq of a pcb */
+void
+tcp_ooseq_mem_add(struct tcp_pcb *pcb, u16_t pbufs)
+{
+  pcb->ooseq_pbufs = (u16_t)(pcb->ooseq_pbufs + pbufs);
+  tcp_ooseq_mem_used += pbufs;
+  TCP_OOSEQ_STATS_SET_USED(tcp_ooseq_mem_used);
+}
+
+/** Account 'pbufs' pbufs trimmed, freed or delivered from ooseq of a pcb */
+void
+tcp_ooseq_mem_sub(struct tcp_pcb *pcb, u16_t pbufs)
+{
+  LWIP_ASSERT("tcp_ooseq_mem_sub: accounting", pcb->ooseq_pbufs >= pbufs);
+  LWIP_ASSERT("tcp_ooseq_mem_sub: accounting", tcp_ooseq_mem_used >= pbufs);
+  pcb->ooseq_pbufs = (u16_t)(pcb->ooseq_pbufs - pbufs);
+  tcp_ooseq_mem_used -= pbufs;
+  TCP_OOSEQ_STATS_SET_USED(tcp_ooseq_mem_used);
+}
+
+/**
+ * Free at least 'pbufs' pbufs (or all) from ooseq, taking them from the
+ * largest holder first, but never more than needed to bring it down to the
+ * next largest one.
+ */
+static void
+tcp_ooseq_mem_release(u32_t pbufs)
+{
+  u32_t freed = 0;
+
+  while (freed < pbufs) {
+    struct tcp_pcb *pcb;
+    struct tcp_pcb *largest = NULL;
+    u16_t second = 0;
+    u32_t amount;
+    u16_t n;
+
+    for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+      if ((largest == NULL) || (pcb->ooseq_pbufs > largest->ooseq_pbufs)) {
+        if (largest != NULL) {
+          second = largest->ooseq_pbufs;
+        }
+        largest = pcb;
+      } else if (pcb->ooseq_pbufs > second) {
+        second = pcb->ooseq_pbufs;
+      }
+    }
+    if ((largest == NULL) || (largest->ooseq_pbufs == 0)) {
+      break;
+    }
+    amount = LWIP_MIN(pbufs - freed, (u32_t)(largest->ooseq_pbufs - second) + 1);
+    /* tcp_ooseq_prune() accounts the pbufs it frees */
+    n = tcp_ooseq_prune(largest, (u16_t)LWIP_MIN(amount, largest->ooseq_pbufs));
+    if (n == 0) {
+      break;
+    }
+    freed += n;
+  }
+  TCP_OOSEQ_STATS_ADD(pruned_pbufs, freed);
+  LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_ooseq_mem_release: freed %"U32_F" pbufs, %"U32_F" left\n",
+                                freed, tcp_ooseq_mem_used));
+}
+
+/**
+ * Enforce the budget (TCP_OOSEQ_MEM_PBUFS) after a segment has been queued.
+ * This may prune the queue of the pcb that queued it or of other pcbs.
+ */
+void
+tcp_ooseq_mem_check(void)
+{
+  if (tcp_ooseq_mem_used > TCP_OOSEQ_MEM_PBUFS) {
+    TCP_OOSEQ_STATS_INC(pressure);
+    tcp_ooseq_mem_release(tcp_ooseq_mem_used - TCP_OOSEQ_MEM_PBUFS);
+  }
+}
+
+/**
+ * Memory is short (PBUF_POOL is empty): free half of the pbufs on ooseq
+ * (at least one), from the largest holders first.
+ */
+void
+tcp_ooseq_mem_reclaim(void)
+{
+  if (tcp_ooseq_mem_used > 0) {
+    TCP_OOSEQ_STATS_INC(reclaim);
+    tcp_ooseq_mem_release((tcp_ooseq_mem_used + 1) / 2);
+  }
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_OOSEQ_MEM */
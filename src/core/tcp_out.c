@@ -52,7 +52,7 @@
 #include "lwip/stats.h"
 #include "lwip/ip6.h"
 #include "lwip/ip6_addr.h"
-#if LWIP_TCP_TIMESTAMPS
+#if LWIP_TCP_TIMESTAMPS || LWIP_TCP_RACK
 #include "lwip/sys.h"
 #endif
 
@@ -91,8 +91,24 @@
 #endif
 #endif
 
+#if LWIP_TCP_ZEROCOPY
+/* tcp_write() data referenced for tcp_write_ref() */
+#define TCP_WRITE_ZC_PARAM , struct tcp_zc *zc
+#define TCP_WRITE_ZC_ARG(zc) , zc
+#else /* LWIP_TCP_ZEROCOPY */
+#define TCP_WRITE_ZC_PARAM
+#define TCP_WRITE_ZC_ARG(zc)
+#endif /* LWIP_TCP_ZEROCOPY */
+
 /* Forward declarations.*/
+static err_t tcp_write_queue(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags TCP_WRITE_ZC_PARAM);
 static err_t tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif);
+#if LWIP_TCP_FASTOPEN
+static err_t tcp_output_fastopen(struct tcp_pcb *pcb, struct netif *netif);
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_TSO
+static int tcp_output_segment_busy(struct tcp_seg *seg);
+#endif /* LWIP_TCP_TSO */
 
 /* tcp_route: common code that returns a fixed bound netif or calls ip_route */
 static struct netif *
@@ -132,6 +148,11 @@ tcp_output_alloc_header(struct tcp_pcb *pcb, u16_t optlen, u16_t datalen,
     tcphdr->seqno = seqno_be;
     tcphdr->ackno = lwip_htonl(pcb->rcv_nxt);
     TCPH_HDRLEN_FLAGS_SET(tcphdr, (5 + optlen / 4), TCP_ACK);
+#if LWIP_TCP_ECN
+    if (pcb->ecn & TCP_ECN_ECE) {
+      TCPH_SET_FLAG(tcphdr, TCP_ECE);
+    }
+#endif /* LWIP_TCP_ECN */
     tcphdr->wnd = lwip_htons(TCPWND_MIN16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
     tcphdr->chksum = 0;
     tcphdr->urgp = 0;
@@ -183,7 +204,7 @@ tcp_send_fin(struct tcp_pcb *pcb)
  * p is freed on failure.
  */
 static struct tcp_seg *
-tcp_create_segment(struct tcp_pcb *pcb, struct pbuf *p, u8_t flags, u32_t seqno, u8_t optflags)
+tcp_create_segment(struct tcp_pcb *pcb, struct pbuf *p, u8_t flags, u32_t seqno, u16_t optflags)
 {
   struct tcp_seg *seg;
   u8_t optlen = LWIP_TCP_OPT_LENGTH(optflags);
@@ -308,6 +329,27 @@ tcp_seg_add_chksum(u16_t chksum, u16_t len, u16_t *seg_chksum,
   }
   *seg_chksum = chksum;
 }
+
+#if IP_PMTUD || LWIP_TCP_TSO
+/** Checksum the data of a segment again after it has been split */
+static void
+tcp_seg_chksum_data(struct tcp_seg *seg)
+{
+  struct pbuf *q;
+  /* headers in front of the data (IP header too if it has been sent) */
+  u16_t offset = (u16_t)(seg->p->tot_len - seg->len);
+
+  seg->chksum = 0;
+  seg->chksum_swapped = 0;
+  for (q = seg->p; (q != NULL) && (offset >= q->len); q = q->next) {
+    offset = (u16_t)(offset - q->len);
+  }
+  for (; q != NULL; q = q->next, offset = 0) {
+    tcp_seg_add_chksum((u16_t)~inet_chksum((u8_t *)q->payload + offset, (u16_t)(q->len - offset)),
+                       (u16_t)(q->len - offset), &seg->chksum, &seg->chksum_swapped);
+  }
+}
+#endif /* IP_PMTUD || LWIP_TCP_TSO */
 #endif /* TCP_CHECKSUM_ON_COPY */
 
 /** Checks if tcp_write is allowed or not (checks state, snd_buf and snd_queuelen).
@@ -343,9 +385,9 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
   /* If total number of pbufs on the unsent/unacked queues exceeds the
    * configured maximum, return an error */
   /* check for configured max queuelen and possible overflow */
-  if ((pcb->snd_queuelen >= TCP_SND_QUEUELEN) || (pcb->snd_queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
+  if ((pcb->snd_queuelen >= TCP_SND_QUEUELEN_MAX(pcb)) || (pcb->snd_queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
     LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SEVERE, ("tcp_write: too long queue %"U16_F" (max %"U16_F")\n",
-      pcb->snd_queuelen, (u16_t)TCP_SND_QUEUELEN));
+      pcb->snd_queuelen, (u16_t)TCP_SND_QUEUELEN_MAX(pcb)));
     TCP_STATS_INC(tcp.memerr);
     tcp_set_flags(pcb, TF_NAGLEMEMERR);
     return ERR_MEM;
@@ -379,13 +421,99 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
  */
 err_t
 tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
+{
+  return tcp_write_queue(pcb, arg, len, apiflags TCP_WRITE_ZC_ARG(NULL));
+}
+
+#if LWIP_TCP_ZEROCOPY
+/**
+ * @ingroup tcp_raw
+ * Write data for sending without copying it, like tcp_write() without
+ * TCP_WRITE_FLAG_COPY, and report when the stack is done with the buffer:
+ * the callback set with tcp_zc_done() is called with 'cookie' once all of the
+ * data has been acknowledged and no pbuf references the buffer any more. Until
+ * then, the buffer must not be changed or freed.
+ *
+ * Buffers are reported in the order they were written. If the pcb is freed
+ * first, buffers are reported with tpcb == NULL.
+ *
+ * @param pcb Protocol control block for the TCP connection to enqueue data for.
+ * @param arg Pointer to the data to be enqueued for sending.
+ * @param len Data length in bytes (must not be 0)
+ * @param apiflags TCP_WRITE_FLAG_MORE or 0 (TCP_WRITE_FLAG_COPY is ignored)
+ * @param cookie passed to the callback to identify the buffer
+ * @return ERR_OK if enqueued, another err_t on error (the callback won't be
+ *         called for the buffer then)
+ */
+err_t
+tcp_write_ref(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags, void *cookie)
+{
+  struct tcp_zc *zc, **tail;
+  err_t err;
+
+  LWIP_ERROR("tcp_write_ref: invalid pcb", pcb != NULL, return ERR_ARG;);
+  LWIP_ERROR("tcp_write_ref: arg == NULL (programmer violates API)",
+             arg != NULL, return ERR_ARG;);
+  LWIP_ERROR("tcp_write_ref: len == 0 (programmer violates API)",
+             len != 0, return ERR_ARG;);
+
+  zc = (struct tcp_zc *)memp_malloc(MEMP_TCP_ZC);
+  if (zc == NULL) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("tcp_write_ref: out of zero-copy buffers\n"));
+    tcp_set_flags(pcb, TF_NAGLEMEMERR);
+    TCP_STATS_INC(tcp.memerr);
+    return ERR_MEM;
+  }
+  memset(zc, 0, sizeof(struct tcp_zc));
+  /* not freed by tcp_zc_pbuf_free() if tcp_write_queue() fails */
+  zc->pcb = pcb;
+  zc->cookie = cookie;
+  zc->len = len;
+
+  err = tcp_write_queue(pcb, arg, len, (u8_t)(apiflags & ~TCP_WRITE_FLAG_COPY), zc);
+  if (err != ERR_OK) {
+    /* the pbufs referencing the buffer have been freed again */
+    LWIP_ASSERT("tcp_write_ref: buffer still referenced", zc->refs == 0);
+    memp_free(MEMP_TCP_ZC, zc);
+    return err;
+  }
+  /* if all of the data went into the oversized tail of the last segment
+     (TCP_OVERSIZE), the buffer is complete already (refs == 0) */
+  for (tail = &pcb->zc; *tail != NULL; tail = &(*tail)->next);
+  *tail = zc;
+  return ERR_OK;
+}
+#endif /* LWIP_TCP_ZEROCOPY */
+
+/** Allocate a pbuf referencing 'len' bytes of non-volatile data */
+static struct pbuf *
+tcp_pbuf_alloc_ref(pbuf_layer layer, const u8_t *data, u16_t len TCP_WRITE_ZC_PARAM)
+{
+  struct pbuf *p;
+
+#if LWIP_TCP_ZEROCOPY
+  if (zc != NULL) {
+    return tcp_zc_pbuf_alloc(zc, data, len);
+  }
+#endif /* LWIP_TCP_ZEROCOPY */
+  p = pbuf_alloc(layer, len, PBUF_ROM);
+  if (p != NULL) {
+    /* reference the non-volatile payload data */
+    ((struct pbuf_rom*)p)->payload = data;
+  }
+  return p;
+}
+
+/** tcp_write(), referencing the data with tcp_zc_pbufs if zc != NULL */
+static err_t
+tcp_write_queue(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags TCP_WRITE_ZC_PARAM)
 {
   struct pbuf *concat_p = NULL;
   struct tcp_seg *last_unsent = NULL, *seg = NULL, *prev_seg = NULL, *queue = NULL;
   u16_t pos = 0; /* position in 'arg' data */
   u16_t queuelen;
   u8_t optlen = 0;
-  u8_t optflags = 0;
+  u16_t optflags = 0;
 #if TCP_OVERSIZE
   u16_t oversize = 0;
   u16_t oversize_used = 0;
@@ -465,8 +593,17 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 
     /* Usable space at the end of the last unsent segment */
     unsent_optlen = LWIP_TCP_OPT_LENGTH(last_unsent->flags);
+#if LWIP_TCP_TSO
+    /* a super-segment (tcp_tso_merge()) that could not be sent is larger */
+    if (mss_local < last_unsent->len + unsent_optlen) {
+      space = 0;
+    } else
+#else /* LWIP_TCP_TSO */
     LWIP_ASSERT("mss_local is too small", mss_local >= last_unsent->len + unsent_optlen);
-    space = mss_local - (last_unsent->len + unsent_optlen);
+#endif /* LWIP_TCP_TSO */
+    {
+      space = mss_local - (last_unsent->len + unsent_optlen);
+    }
 
     /*
      * Phase 1: Copy data directly into an oversized pbuf.
@@ -539,17 +676,19 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
         struct pbuf *p;
         for (p = last_unsent->p; p->next != NULL; p = p->next);
         if (((p->type_internal & (PBUF_TYPE_FLAG_STRUCT_DATA_CONTIGUOUS|PBUF_TYPE_FLAG_DATA_VOLATILE)) == 0) &&
+#if LWIP_TCP_ZEROCOPY
+            /* tcp_write_ref() data must be referenced by its own pbufs */
+            (zc == NULL) &&
+#endif /* LWIP_TCP_ZEROCOPY */
             (const u8_t *)p->payload + p->len == (const u8_t *)arg) {
           LWIP_ASSERT("tcp_write: ROM pbufs cannot be oversized", pos == 0);
           extendlen = seglen;
         } else {
-          if ((concat_p = pbuf_alloc(PBUF_RAW, seglen, PBUF_ROM)) == NULL) {
+          if ((concat_p = tcp_pbuf_alloc_ref(PBUF_RAW, (const u8_t*)arg + pos, seglen TCP_WRITE_ZC_ARG(zc))) == NULL) {
             LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS,
                         ("tcp_write: could not allocate memory for zero-copy pbuf\n"));
             goto memerr;
           }
-          /* reference the non-volatile payload data */
-          ((struct pbuf_rom*)concat_p)->payload = (const u8_t*)arg + pos;
           queuelen += pbuf_clen(concat_p);
         }
 #if TCP_CHECKSUM_ON_COPY
@@ -606,7 +745,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 #if TCP_OVERSIZE
       LWIP_ASSERT("oversize == 0", oversize == 0);
 #endif /* TCP_OVERSIZE */
-      if ((p2 = pbuf_alloc(PBUF_TRANSPORT, seglen, PBUF_ROM)) == NULL) {
+      if ((p2 = tcp_pbuf_alloc_ref(PBUF_TRANSPORT, (const u8_t*)arg + pos, seglen TCP_WRITE_ZC_ARG(zc))) == NULL) {
         LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("tcp_write: could not allocate memory for zero-copy pbuf\n"));
         goto memerr;
       }
@@ -618,8 +757,6 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
         chksum = SWAP_BYTES_IN_WORD(chksum);
       }
 #endif /* TCP_CHECKSUM_ON_COPY */
-      /* reference the non-volatile payload data */
-      ((struct pbuf_rom*)p2)->payload = (const u8_t*)arg + pos;
 
       /* Second, allocate a pbuf for the headers. */
       if ((p = pbuf_alloc(PBUF_TRANSPORT, optlen, PBUF_RAM)) == NULL) {
@@ -638,9 +775,9 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
     /* Now that there are more segments queued, we check again if the
      * length of the queue exceeds the configured maximum or
      * overflows. */
-    if ((queuelen > TCP_SND_QUEUELEN) || (queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
+    if ((queuelen > TCP_SND_QUEUELEN_MAX(pcb)) || (queuelen > TCP_SNDQUEUELEN_OVERFLOW)) {
       LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("tcp_write: queue too long %"U16_F" (%d)\n",
-        queuelen, (int)TCP_SND_QUEUELEN));
+        queuelen, (int)TCP_SND_QUEUELEN_MAX(pcb)));
       pbuf_free(p);
       goto memerr;
     }
@@ -806,8 +943,12 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
 {
   struct pbuf *p;
   struct tcp_seg *seg;
-  u8_t optflags = 0;
+  u16_t optflags = 0;
   u8_t optlen = 0;
+#if LWIP_TCP_FASTOPEN
+  u8_t cookie[TCP_FASTOPEN_COOKIE_LEN];
+  u8_t cookie_len = 0;
+#endif /* LWIP_TCP_FASTOPEN */
 
   LWIP_DEBUGF(TCP_QLEN_DEBUG, ("tcp_enqueue_flags: queuelen: %"U16_F"\n", (u16_t)pcb->snd_queuelen));
 
@@ -815,10 +956,10 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
               (flags & (TCP_SYN | TCP_FIN)) != 0);
 
   /* check for configured max queuelen and possible overflow (FIN flag should always come through!) */
-  if (((pcb->snd_queuelen >= TCP_SND_QUEUELEN) || (pcb->snd_queuelen > TCP_SNDQUEUELEN_OVERFLOW)) &&
+  if (((pcb->snd_queuelen >= TCP_SND_QUEUELEN_MAX(pcb)) || (pcb->snd_queuelen > TCP_SNDQUEUELEN_OVERFLOW)) &&
       ((flags & TCP_FIN) == 0)) {
     LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SEVERE, ("tcp_enqueue_flags: too long queue %"U16_F" (max %"U16_F")\n",
-                                       pcb->snd_queuelen, (u16_t)TCP_SND_QUEUELEN));
+                                       pcb->snd_queuelen, (u16_t)TCP_SND_QUEUELEN_MAX(pcb)));
     TCP_STATS_INC(tcp.memerr);
     tcp_set_flags(pcb, TF_NAGLEMEMERR);
     return ERR_MEM;
@@ -840,6 +981,30 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
       optflags |= TF_SEG_OPTS_SACK_PERM;
     }
 #endif /* LWIP_TCP_SACK_OUT */
+#if LWIP_TCP_FASTOPEN
+    if (pcb->state == SYN_RCVD) {
+      if (pcb->fastopen & TCP_FASTOPEN_COOKIE) {
+        /* <SYN,ACK> to a client that sent a cookie (request) */
+        tcp_fastopen_cookie_gen(&pcb->remote_ip, cookie);
+        cookie_len = TCP_FASTOPEN_COOKIE_LEN;
+        optflags |= TF_SEG_OPTS_FASTOPEN;
+      }
+    } else if (pcb->fastopen & TCP_FASTOPEN_ENABLED) {
+      u16_t mss;
+      cookie_len = tcp_fastopen_cookie_get(&pcb->remote_ip, cookie, &mss);
+      if (cookie_len != 0) {
+        /* Data in the SYN is sent before the server's MSS option is
+           received: use the MSS it announced along with the cookie */
+#if TCP_CALCULATE_EFF_SEND_MSS
+        mss = tcp_eff_send_mss(mss, &pcb->local_ip, &pcb->remote_ip);
+#endif /* TCP_CALCULATE_EFF_SEND_MSS */
+        pcb->mss = mss;
+        optflags |= TF_SEG_OPTS_FASTOPEN;
+      } else {
+        optflags |= TF_SEG_OPTS_FASTOPEN_REQ;
+      }
+    }
+#endif /* LWIP_TCP_FASTOPEN */
   }
 #if LWIP_TCP_TIMESTAMPS
   if ((pcb->flags & TF_TIMESTAMP) || ((flags & TCP_SYN) && (pcb->state != SYN_RCVD))) {
@@ -867,6 +1032,27 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
   }
   LWIP_ASSERT("seg->tcphdr not aligned", ((mem_ptr_t)seg->tcphdr % LWIP_MIN(MEM_ALIGNMENT, 4)) == 0);
   LWIP_ASSERT("tcp_enqueue_flags: invalid segment length", seg->len == 0);
+#if LWIP_TCP_FASTOPEN
+  if (optflags & (TF_SEG_OPTS_FASTOPEN | TF_SEG_OPTS_FASTOPEN_REQ)) {
+    /* The TFO option is the last one: tcp_output_segment() fills in the
+       others in front of it */
+    u8_t *opt = (u8_t *)(seg->tcphdr + 1) + optlen;
+    if (optflags & TF_SEG_OPTS_FASTOPEN) {
+      opt -= LWIP_TCP_OPT_LEN_FASTOPEN_OUT;
+      memset(opt, LWIP_TCP_OPT_NOP, LWIP_TCP_OPT_LEN_FASTOPEN_OUT - 2 - cookie_len);
+      opt += LWIP_TCP_OPT_LEN_FASTOPEN_OUT - 2 - cookie_len;
+      opt[0] = LWIP_TCP_OPT_FASTOPEN;
+      opt[1] = (u8_t)(2 + cookie_len);
+      MEMCPY(&opt[2], cookie, cookie_len);
+    } else {
+      opt -= LWIP_TCP_OPT_LEN_FASTOPEN_REQ_OUT;
+      opt[0] = LWIP_TCP_OPT_NOP;
+      opt[1] = LWIP_TCP_OPT_NOP;
+      opt[2] = LWIP_TCP_OPT_FASTOPEN;
+      opt[3] = 2;
+    }
+  }
+#endif /* LWIP_TCP_FASTOPEN */
 
   LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_TRACE,
               ("tcp_enqueue_flags: queueing %"U32_F":%"U32_F" (0x%"X16_F")\n",
@@ -1031,6 +1217,7 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   if (p == NULL) {
     /* let tcp_fasttmr retry sending this ACK */
     tcp_set_flags(pcb, TF_ACK_DELAY | TF_ACK_NOW);
+    TCP_TIMER_UPDATE(pcb);
     LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_output: (ACK) could not allocate pbuf\n"));
     return ERR_BUF;
   }
@@ -1084,6 +1271,7 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   if (err != ERR_OK) {
     /* let tcp_fasttmr retry sending this ACK */
     tcp_set_flags(pcb, TF_ACK_DELAY | TF_ACK_NOW);
+    TCP_TIMER_UPDATE(pcb);
   } else {
     /* remove ACK flags from the PCB, as we sent an empty ACK now */
     tcp_clear_flags(pcb, TF_ACK_DELAY | TF_ACK_NOW);
@@ -1092,6 +1280,305 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   return err;
 }
 
+#if LWIP_TCP_PACING
+/**
+ * @ingroup tcp_raw
+ * The current pacing rate of a connection: cwnd per smoothed RTT (scaled up to
+ * 200% in slow start and 120% in congestion avoidance to leave room for
+ * growth), limited by pcb->max_pacing_rate.
+ * Connections with an RTT of up to 2 ms are not paced: the burst allowed
+ * (2 ms at the pacing rate) covers all of cwnd anyway.
+ *
+ * @param pcb the tcp_pcb to check
+ * @return pacing rate in bytes/s, 0 if not paced (no RTT estimate and no limit)
+ */
+u32_t
+tcp_pacing_rate(const struct tcp_pcb *pcb)
+{
+  u32_t rate = 0;
+  u32_t srtt_ms = tcp_srtt_ms(pcb);
+
+  if (srtt_ms > 2) {
+    /* cwnd * 1000 / srtt without overflowing */
+    rate = (pcb->cwnd / srtt_ms) * 1000 + ((pcb->cwnd % srtt_ms) * 1000) / srtt_ms;
+    if (pcb->cwnd < pcb->ssthresh) {
+      rate = (rate > 0x7fffffffUL) ? 0xffffffffUL : (rate * 2);
+    } else {
+      rate = (rate > 0xffffffffUL - rate / 5) ? 0xffffffffUL : (rate + rate / 5);
+    }
+  }
+  if ((pcb->max_pacing_rate != 0) && ((rate == 0) || (rate > pcb->max_pacing_rate))) {
+    rate = pcb->max_pacing_rate;
+  }
+  return rate;
+}
+
+/** Pacing timeout: send what became due */
+static void
+tcp_pacing_tmr(void *arg)
+{
+  tcp_output((struct tcp_pcb *)arg);
+}
+
+/**
+ * Check if a segment of 'len' bytes may be sent now. Send credit accumulates
+ * at the pacing rate, limited to a small burst. If it does not suffice, the
+ * pacing timer is armed for when it will.
+ *
+ * @param pcb the tcp_pcb sending
+ * @param len length of the segment
+ * @return 1 if the segment can be sent now, 0 if it has to wait
+ */
+static u8_t
+tcp_pacing_allow(struct tcp_pcb *pcb, u16_t len)
+{
+  u32_t rate, now, elapsed, burst, add, need, ms;
+
+  rate = tcp_pacing_rate(pcb);
+  if (rate == 0) {
+    return 1;
+  }
+  now = sys_now();
+  elapsed = now - pcb->pacing_time;
+  pcb->pacing_time = now;
+  burst = LWIP_MAX((u32_t)TCP_PACING_BURST * pcb->mss, rate / 500);
+  if (elapsed >= 1000) {
+    add = burst;
+    pcb->pacing_frac = 0;
+  } else {
+    /* elapsed * rate / 1000 without overflowing, carrying the remainder */
+    u32_t frac = (rate % 1000) * elapsed + pcb->pacing_frac;
+    add = (rate / 1000) * elapsed + frac / 1000;
+    pcb->pacing_frac = (u16_t)(frac % 1000);
+  }
+  if ((add >= burst) || (pcb->pacing_credit >= burst - add)) {
+    pcb->pacing_credit = burst;
+  } else {
+    pcb->pacing_credit += add;
+  }
+
+  if (pcb->pacing_credit >= len) {
+    pcb->pacing_credit -= len;
+    return 1;
+  }
+  if (!sys_timeout_static_pending(&pcb->pacing_timer)) {
+    need = len - pcb->pacing_credit;
+    ms = (need * 1000) / rate;
+    if ((ms == 0) || (ms * rate < need * 1000)) {
+      ms++;
+    }
+    sys_timeout_static(&pcb->pacing_timer, ms, tcp_pacing_tmr, pcb);
+  }
+  return 0;
+}
+#endif /* LWIP_TCP_PACING */
+
+#if LWIP_TCP_TSO
+/**
+ * Called by tcp_output() to merge the unsent segments following 'seg' into
+ * it, making it a super-segment that the netif (or the software fallback in
+ * the IP layer) cuts into MSS-sized segments again (LWIP_TCP_TSO).
+ * Only data segments in sequence with the same options are merged, up to
+ * netif->tso_max and the send window.
+ *
+ * @param pcb the tcp_pcb sending
+ * @param seg the first unsent segment, fits into the send window
+ * @param netif the netif used to send the segment
+ * @param wnd the send window (offered window or cwnd)
+ */
+static void
+tcp_tso_merge(struct tcp_pcb *pcb, struct tcp_seg *seg, struct netif *netif, u32_t wnd)
+{
+  struct tcp_seg *next;
+  u32_t maxlen;
+  u16_t seglen = seg->len;
+  u16_t hdrlen = TCPH_HDRLEN_BYTES(seg->tcphdr);
+
+  if ((seg->len == 0) || (TCPH_FLAGS(seg->tcphdr) & (TCP_SYN | TCP_FIN)) ||
+      tcp_output_segment_busy(seg)) {
+    return;
+  }
+#if LWIP_IPV4 && LWIP_IPV6
+  hdrlen = (u16_t)(hdrlen + (IP_IS_V6(&pcb->remote_ip) ? IP6_HLEN : IP_HLEN));
+#elif LWIP_IPV4
+  hdrlen = (u16_t)(hdrlen + IP_HLEN);
+#else
+  hdrlen = (u16_t)(hdrlen + IP6_HLEN);
+#endif
+  if (netif->tso_max <= hdrlen) {
+    return;
+  }
+  maxlen = LWIP_MIN((u32_t)(netif->tso_max - hdrlen),
+                    wnd - (lwip_ntohl(seg->tcphdr->seqno) - pcb->lastack));
+#if LWIP_TCP_PACING
+  if (tcp_pacing_rate(pcb) != 0) {
+    /* stay within the smallest burst the pacing allows */
+    maxlen = LWIP_MIN(maxlen, (u32_t)TCP_PACING_BURST * pcb->mss);
+  }
+#endif /* LWIP_TCP_PACING */
+
+  for (next = seg->next; next != NULL; next = seg->next) {
+    struct pbuf *p;
+    u16_t clen;
+
+    if ((next->len == 0) || (TCPH_FLAGS(next->tcphdr) & (TCP_SYN | TCP_RST)) ||
+        ((next->flags ^ seg->flags) & (TF_SEG_OPTS_TS | TF_SEG_DATA_CHECKSUMMED | TF_SEG_SACKED)) ||
+        (lwip_ntohl(next->tcphdr->seqno) != lwip_ntohl(seg->tcphdr->seqno) + seg->len) ||
+        ((u32_t)seg->len + next->len > maxlen) ||
+        tcp_output_segment_busy(next)) {
+      break;
+    }
+    /* strip the headers, keep the data */
+    clen = pbuf_clen(next->p);
+    p = pbuf_free_header(next->p, (u16_t)(next->p->tot_len - next->len));
+    pcb->snd_queuelen = (u16_t)(pcb->snd_queuelen - (clen - pbuf_clen(p)));
+    pbuf_cat(seg->p, p);
+    next->p = NULL;
+#if TCP_CHECKSUM_ON_COPY
+    if (seg->flags & TF_SEG_DATA_CHECKSUMMED) {
+      if (next->chksum_swapped) {
+        next->chksum = SWAP_BYTES_IN_WORD(next->chksum);
+      }
+      tcp_seg_add_chksum(next->chksum, next->len, &seg->chksum, &seg->chksum_swapped);
+    }
+#endif /* TCP_CHECKSUM_ON_COPY */
+    seg->len = (u16_t)(seg->len + next->len);
+    TCPH_SET_FLAG(seg->tcphdr, TCPH_FLAGS(next->tcphdr) & (TCP_PSH | TCP_FIN));
+    seg->next = next->next;
+    tcp_seg_free(next);
+    if (TCPH_FLAGS(seg->tcphdr) & TCP_FIN) {
+      break;
+    }
+  }
+#if TCP_OVERSIZE
+  if ((seg->len != seglen) && (seg->next == NULL)) {
+    /* the oversized last pbuf of the last unsent segment is not at the end
+       of a segment's data any more */
+    pcb->unsent_oversize = 0;
+#if TCP_OVERSIZE_DBGCHECK
+    seg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+  }
+#endif /* TCP_OVERSIZE */
+  LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_tso_merge: %"U16_F" -> %"U16_F" bytes\n", seglen, seg->len));
+}
+
+/**
+ * Split a super-segment (tcp_tso_merge()) again so that the first part has
+ * at most 'limit' bytes of data. It is split at a pbuf boundary (which the
+ * merged segments end at) and the data is not copied: the rest gets a new
+ * header and goes into a new segment queued after 'seg'. If the first pbuf
+ * of data is larger than 'limit', the split is after that pbuf.
+ *
+ * @param pcb the tcp_pcb the segment belongs to
+ * @param seg the segment to split (on the unsent or unacked queue)
+ * @param limit the maximum number of data bytes to keep in 'seg'
+ * @return ERR_OK, or ERR_MEM if the new segment could not be allocated
+ *         ('seg' is left unchanged then)
+ */
+static err_t
+tcp_tso_split(struct tcp_pcb *pcb, struct tcp_seg *seg, u16_t limit)
+{
+  struct tcp_seg *rest;
+  struct pbuf *p, *q;
+  u16_t len, restlen;
+  u8_t flags = TCPH_FLAGS(seg->tcphdr);
+
+  /* find the last pbuf to keep, the headers are in the first one */
+  q = seg->p;
+  len = (u16_t)(q->len - (q->tot_len - seg->len));
+  while ((q->next != NULL) && ((len == 0) || ((u32_t)len + q->next->len <= limit))) {
+    q = q->next;
+    len = (u16_t)(len + q->len);
+  }
+  if ((q->next == NULL) || (len == 0)) {
+    /* nothing to split */
+    return ERR_OK;
+  }
+  restlen = (u16_t)(seg->len - len);
+
+  p = pbuf_alloc(PBUF_TRANSPORT, LWIP_TCP_OPT_LENGTH(seg->flags), PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  /* PSH and FIN go with the end of the data */
+  rest = tcp_create_segment(pcb, p, (u8_t)(flags & (TCP_PSH | TCP_FIN)),
+                            lwip_ntohl(seg->tcphdr->seqno) + len,
+                            (u16_t)(seg->flags & ~TF_SEG_DATA_CHECKSUMMED));
+  if (rest == NULL) {
+    return ERR_MEM;
+  }
+  pbuf_cat(rest->p, q->next);
+  rest->len = restlen;
+  q->next = NULL;
+  for (p = seg->p; p != NULL; p = p->next) {
+    p->tot_len = (u16_t)(p->tot_len - restlen);
+  }
+  seg->len = len;
+  TCPH_UNSET_FLAG(seg->tcphdr, TCP_PSH | TCP_FIN);
+  pcb->snd_queuelen++;
+#if TCP_CHECKSUM_ON_COPY
+  if (seg->flags & TF_SEG_DATA_CHECKSUMMED) {
+    tcp_seg_chksum_data(seg);
+    tcp_seg_chksum_data(rest);
+    rest->flags |= TF_SEG_DATA_CHECKSUMMED;
+  }
+#endif /* TCP_CHECKSUM_ON_COPY */
+#if TCP_OVERSIZE_DBGCHECK
+  /* the last pbuf moved */
+  rest->oversize_left = seg->oversize_left;
+  seg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+#if LWIP_TCP_RACK
+  rest->xmit_time = seg->xmit_time;
+#endif /* LWIP_TCP_RACK */
+  rest->next = seg->next;
+  seg->next = rest;
+  LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_tso_split: %"U16_F" + %"U16_F" bytes\n", len, restlen));
+  return ERR_OK;
+}
+
+/**
+ * Split the first unsent segment if it is a super-segment that does not fit
+ * into the send window (any more, e.g. after a retransmission timeout).
+ * It is split where the window ends, but not into parts smaller than an MSS
+ * that could not be sent right away anyway.
+ *
+ * @param pcb the tcp_pcb sending
+ * @param wnd the send window (offered window or cwnd)
+ */
+static void
+tcp_tso_fit(struct tcp_pcb *pcb, u32_t wnd)
+{
+  struct tcp_seg *seg = pcb->unsent;
+  u16_t mss = (u16_t)(pcb->mss - LWIP_TCP_OPT_LENGTH(seg->flags));
+  u32_t inflight = lwip_ntohl(seg->tcphdr->seqno) - pcb->lastack;
+
+  if ((seg->len > mss) && (inflight + seg->len > wnd) && !tcp_output_segment_busy(seg)) {
+    u32_t limit = (wnd > inflight) ? wnd - inflight : 0;
+    if ((limit >= mss) || (inflight == 0)) {
+      tcp_tso_split(pcb, seg, (u16_t)LWIP_MAX(limit, mss));
+    }
+  }
+}
+
+/**
+ * Split off the first MSS of a super-segment to retransmit it alone.
+ *
+ * @param pcb the tcp_pcb the segment belongs to
+ * @param seg the segment to be retransmitted
+ */
+static void
+tcp_tso_rexmit(struct tcp_pcb *pcb, struct tcp_seg *seg)
+{
+  u16_t mss = (u16_t)(pcb->mss - LWIP_TCP_OPT_LENGTH(seg->flags));
+
+  if (seg->len > mss) {
+    tcp_tso_split(pcb, seg, mss);
+  }
+}
+#endif /* LWIP_TCP_TSO */
+
 /**
  * @ingroup tcp_raw
  * Find out what we can send and send it
@@ -1110,6 +1597,9 @@ tcp_output(struct tcp_pcb *pcb)
 #if TCP_CWND_DEBUG
   s16_t i = 0;
 #endif /* TCP_CWND_DEBUG */
+#if LWIP_TCP_RACK
+  u8_t sent = 0;
+#endif /* LWIP_TCP_RACK */
 
   /* pcb->state LISTEN not allowed here */
   LWIP_ASSERT("don't call tcp_output for listen-pcbs",
@@ -1122,6 +1612,7 @@ tcp_output(struct tcp_pcb *pcb)
   if (tcp_input_pcb == pcb) {
     return ERR_OK;
   }
+  TCP_TICKS_UPDATE();
 
   wnd = LWIP_MIN(pcb->snd_wnd, pcb->cwnd);
 
@@ -1165,6 +1656,8 @@ tcp_output(struct tcp_pcb *pcb)
 
   netif = tcp_route(pcb, &pcb->local_ip, &pcb->remote_ip);
   if (netif == NULL) {
+    /* unsent data is retried from the tcp timers */
+    TCP_TIMER_UPDATE(pcb);
     return ERR_RTE;
   }
 
@@ -1172,11 +1665,29 @@ tcp_output(struct tcp_pcb *pcb)
   if (ip_addr_isany(&pcb->local_ip)) {
     const ip_addr_t *local_ip = ip_netif_get_local_ip(netif, &pcb->remote_ip);
     if (local_ip == NULL) {
+      TCP_TIMER_UPDATE(pcb);
       return ERR_RTE;
     }
     ip_addr_copy(pcb->local_ip, *local_ip);
   }
 
+#if LWIP_TCP_FASTOPEN
+  if ((pcb->state == SYN_SENT) && (seg->flags & TF_SEG_OPTS_FASTOPEN)) {
+    /* (re)transmit the SYN, with data if this is the first one */
+    err = tcp_output_fastopen(pcb, netif);
+    if (err != ERR_OK) {
+      tcp_set_flags(pcb, TF_NAGLEMEMERR);
+      TCP_TIMER_UPDATE(pcb);
+      return err;
+    }
+    goto output_done;
+  }
+#endif /* LWIP_TCP_FASTOPEN */
+
+#if LWIP_TCP_TSO
+  tcp_tso_fit(pcb, wnd);
+#endif /* LWIP_TCP_TSO */
+
   /* Check if we need to start the persistent timer when the next unsent segment
    * does not fit within the remaining send window and RTO timer is not running (we
    * have no in-flight data). A traditional approach would fill the remaining window
@@ -1211,6 +1722,24 @@ tcp_output(struct tcp_pcb *pcb)
       ((pcb->flags & (TF_NAGLEMEMERR | TF_FIN)) == 0)) {
       break;
     }
+    if (pcb->unacked == NULL) {
+      /* nothing in flight: (re)starting after an idle period */
+      TCP_CC_EVENT(pcb, idle);
+    }
+#if LWIP_TCP_TSO
+    if (netif->tso_max != 0) {
+      tcp_tso_merge(pcb, seg, netif, wnd);
+    }
+#endif /* LWIP_TCP_TSO */
+#if LWIP_TCP_PACING
+    if ((seg->len > 0) && !tcp_pacing_allow(pcb, seg->len)) {
+      /* released by the pacing timer, but don't hold back a pending ACK */
+      if (pcb->flags & TF_ACK_NOW) {
+        tcp_send_empty_ack(pcb);
+      }
+      break;
+    }
+#endif /* LWIP_TCP_PACING */
 #if TCP_CWND_DEBUG
     LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
                             pcb->snd_wnd, pcb->cwnd, wnd,
@@ -1231,9 +1760,13 @@ tcp_output(struct tcp_pcb *pcb)
     if (err != ERR_OK) {
       /* segment could not be sent, for whatever reason */
       tcp_set_flags(pcb, TF_NAGLEMEMERR);
+      TCP_TIMER_UPDATE(pcb);
       return err;
     }
     pcb->unsent = seg->next;
+#if LWIP_TCP_RACK
+    sent = 1;
+#endif /* LWIP_TCP_RACK */
     if (pcb->state != SYN_SENT) {
       tcp_clear_flags(pcb, TF_ACK_DELAY | TF_ACK_NOW);
     }
@@ -1273,6 +1806,11 @@ tcp_output(struct tcp_pcb *pcb)
       tcp_seg_free(seg);
     }
     seg = pcb->unsent;
+#if LWIP_TCP_TSO
+    if (seg != NULL) {
+      tcp_tso_fit(pcb, wnd);
+    }
+#endif /* LWIP_TCP_TSO */
   }
 #if TCP_OVERSIZE
   if (pcb->unsent == NULL) {
@@ -1280,12 +1818,122 @@ tcp_output(struct tcp_pcb *pcb)
     pcb->unsent_oversize = 0;
   }
 #endif /* TCP_OVERSIZE */
+#if LWIP_TCP_RACK
+  if (sent) {
+    /* restart the loss probe timeout */
+    tcp_rack_sent(pcb);
+  }
+#endif /* LWIP_TCP_RACK */
 
 output_done:
   tcp_clear_flags(pcb, TF_NAGLEMEMERR);
+  TCP_TIMER_UPDATE(pcb);
   return ERR_OK;
 }
 
+#if LWIP_TCP_FASTOPEN
+/**
+ * Called by tcp_output() to send a SYN carrying a TCP Fast Open cookie.
+ *
+ * The data of the segments queued behind the SYN is copied into it (whole
+ * segments only, up to one MSS). These segments are moved to the unacked
+ * queue along with the SYN without being sent themselves, so they are freed
+ * or retransmitted on their own depending on what the <SYN,ACK> acknowledges.
+ * A retransmitted SYN carries no data.
+ *
+ * @param pcb the tcp_pcb in state SYN_SENT, the SYN is the first unsent segment
+ * @param netif the netif used to send the segment
+ */
+static err_t
+tcp_output_fastopen(struct tcp_pcb *pcb, struct netif *netif)
+{
+  struct tcp_seg *syn = pcb->unsent;
+  struct tcp_seg *seg, *last = syn;
+  u16_t hdrlen = TCPH_HDRLEN_BYTES(syn->tcphdr);
+  u16_t datalen = 0;
+  u16_t off;
+  u32_t snd_nxt;
+  struct pbuf *p;
+  err_t err;
+
+  if (pcb->nrtx == 0) {
+    /* the options of the SYN reduce the space available for data */
+    u16_t maxlen = (u16_t)(pcb->mss - (hdrlen - TCP_HLEN));
+    for (seg = syn->next; (seg != NULL) && ((TCPH_FLAGS(seg->tcphdr) & TCP_FIN) == 0) &&
+         (datalen + seg->len <= maxlen); seg = seg->next) {
+      datalen = (u16_t)(datalen + seg->len);
+      last = seg;
+    }
+  }
+
+  /* (re)build the SYN: its header followed by a copy of the data */
+  p = pbuf_alloc(PBUF_IP, (u16_t)(hdrlen + datalen), PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  MEMCPY(p->payload, syn->tcphdr, hdrlen);
+#if TCP_CHECKSUM_ON_COPY
+  syn->chksum = 0;
+  syn->chksum_swapped = 0;
+  syn->flags &= (u16_t)~TF_SEG_DATA_CHECKSUMMED;
+  if (datalen > 0) {
+    syn->flags |= TF_SEG_DATA_CHECKSUMMED;
+  }
+#endif /* TCP_CHECKSUM_ON_COPY */
+  off = hdrlen;
+  for (seg = syn; seg != last; ) {
+    struct pbuf *q;
+    u16_t skip;
+    seg = seg->next;
+    skip = (u16_t)(((u8_t *)seg->tcphdr - (u8_t *)seg->p->payload) + TCPH_HDRLEN_BYTES(seg->tcphdr));
+    for (q = seg->p; q != NULL; q = q->next) {
+      if (skip >= q->len) {
+        skip = (u16_t)(skip - q->len);
+        continue;
+      }
+      TCP_DATA_COPY2((u8_t *)p->payload + off, (u8_t *)q->payload + skip, (u16_t)(q->len - skip),
+        &syn->chksum, &syn->chksum_swapped);
+      off = (u16_t)(off + q->len - skip);
+      skip = 0;
+    }
+  }
+  pbuf_free(syn->p);
+  syn->p = p;
+  syn->tcphdr = (struct tcp_hdr *)p->payload;
+
+#if TCP_OVERSIZE_DBGCHECK
+  syn->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+  err = tcp_output_segment(syn, pcb, netif);
+  if (err != ERR_OK) {
+    return err;
+  }
+
+  /* the SYN and the segments it carries the data of are in flight now */
+  pcb->unsent = last->next;
+  last->next = NULL;
+  pcb->unacked = syn;
+  for (seg = syn->next; seg != NULL; seg = seg->next) {
+#if TCP_OVERSIZE_DBGCHECK
+    seg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+#if LWIP_TCP_RACK
+    seg->xmit_time = syn->xmit_time;
+#endif /* LWIP_TCP_RACK */
+  }
+#if TCP_OVERSIZE
+  if (pcb->unsent == NULL) {
+    pcb->unsent_oversize = 0;
+  }
+#endif /* TCP_OVERSIZE */
+  snd_nxt = lwip_ntohl(last->tcphdr->seqno) + TCP_TCPLEN(last);
+  if (TCP_SEQ_LT(pcb->snd_nxt, snd_nxt)) {
+    pcb->snd_nxt = snd_nxt;
+  }
+  return ERR_OK;
+}
+#endif /* LWIP_TCP_FASTOPEN */
+
 /** Check if a segment's pbufs are used by someone else than TCP.
  * This can happen on retransmission if the pbuf of this segment is still
  * referenced by the netif driver due to deferred transmission.
@@ -1322,6 +1970,7 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif
   err_t err;
   u16_t len;
   u32_t *opts;
+  u8_t tos = pcb->tos;
 
   if (tcp_output_segment_busy(seg)) {
     /* This should not happen: rexmit functions should have checked this.
@@ -1393,9 +2042,55 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif
     pcb->rtime = 0;
   }
 
+#if LWIP_TCP_RACK
+  seg->xmit_time = sys_now();
+#endif /* LWIP_TCP_RACK */
+#if LWIP_TCP_RACK || LWIP_TCP_INFO
+  if (TCP_SEQ_LT(lwip_ntohl(seg->tcphdr->seqno), pcb->snd_nxt)) {
+    /* sent before */
+#if LWIP_TCP_RACK
+    seg->flags |= TF_SEG_REXMIT;
+#endif /* LWIP_TCP_RACK */
+    TCP_INFO_INC(pcb, info_retrans);
+  }
+#endif /* LWIP_TCP_RACK || LWIP_TCP_INFO */
+#if LWIP_TCP_ECN
+  TCPH_UNSET_FLAG(seg->tcphdr, TCP_ECE | TCP_CWR);
+  if (TCPH_FLAGS(seg->tcphdr) & TCP_SYN) {
+    if (pcb->state == SYN_SENT) {
+      /* ECN-setup SYN, but a retransmitted SYN goes without ECN in case
+         the first one was dropped because of it (RFC 3168, 6.1.1.1) */
+      if (pcb->nrtx > 0) {
+        pcb->ecn = 0;
+      } else {
+        pcb->ecn = TCP_ECN_SYN;
+        TCPH_SET_FLAG(seg->tcphdr, TCP_ECE | TCP_CWR);
+      }
+    } else if (pcb->ecn & TCP_ECN_ON) {
+      /* ECN-setup SYN-ACK */
+      TCPH_SET_FLAG(seg->tcphdr, TCP_ECE);
+    }
+  } else if (pcb->ecn & TCP_ECN_ON) {
+    if (pcb->ecn & TCP_ECN_ECE) {
+      TCPH_SET_FLAG(seg->tcphdr, TCP_ECE);
+    }
+    /* only new data is ECN-capable (RFC 3168, 6.1.5) */
+    if ((seg->len > 0) && !TCP_SEQ_LT(lwip_ntohl(seg->tcphdr->seqno), pcb->snd_nxt)) {
+      tos = (u8_t)((tos & ~IP_ECN_MASK) | IP_ECN_ECT0);
+      if (pcb->ecn & TCP_ECN_CWR) {
+        TCPH_SET_FLAG(seg->tcphdr, TCP_CWR);
+        pcb->ecn &= (u8_t)~TCP_ECN_CWR;
+      }
+    }
+  }
+#endif /* LWIP_TCP_ECN */
+
   if (pcb->rttest == 0) {
     pcb->rttest = tcp_ticks;
     pcb->rtseq = lwip_ntohl(seg->tcphdr->seqno);
+#if LWIP_TCP_PACING
+    pcb->pacing_rtt_time = sys_now();
+#endif /* LWIP_TCP_PACING */
 
     LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_output_segment: rtseq %"U32_F"\n", pcb->rtseq));
   }
@@ -1416,6 +2111,15 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif
 
   seg->tcphdr->chksum = 0;
 #if CHECKSUM_GEN_TCP
+#if LWIP_CHECKSUM_OFFLOAD
+  seg->p->chksum_offset = 0;
+  if (netif->chksum_partial & NETIF_CHKSUM_PARTIAL_TCP) {
+    /* the netif sums up the segment, starting from the pseudo header */
+    seg->tcphdr->chksum = (u16_t)~ip_chksum_pseudo_partial(seg->p, IP_PROTO_TCP,
+      seg->p->tot_len, 0, &pcb->local_ip, &pcb->remote_ip);
+    seg->p->chksum_offset = TCP_CHKSUM_OFFSET;
+  } else
+#endif /* LWIP_CHECKSUM_OFFLOAD */
   IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_TCP) {
 #if TCP_CHECKSUM_ON_COPY
     u32_t acc;
@@ -1453,10 +2157,17 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif
   }
 #endif /* CHECKSUM_GEN_TCP */
   TCP_STATS_INC(tcp.xmit);
+#if LWIP_TCP_TSO
+  {
+    /* payload per segment if this is a super-segment (tcp_tso_merge()) */
+    u16_t mss = (u16_t)(pcb->mss - (TCPH_HDRLEN_BYTES(seg->tcphdr) - TCP_HLEN));
+    seg->p->tso_mss = (seg->len > mss) ? mss : 0;
+  }
+#endif /* LWIP_TCP_TSO */
 
   NETIF_SET_HINTS(netif, &(pcb->netif_hints));
   err = ip_output_if(seg->p, &pcb->local_ip, &pcb->remote_ip, pcb->ttl,
-    pcb->tos, IP_PROTO_TCP, netif);
+    tos, IP_PROTO_TCP, netif);
   NETIF_RESET_HINTS(netif);
   return err;
 }
@@ -1530,6 +2241,291 @@ tcp_rst(const struct tcp_pcb *pcb, u32_t seqno, u32_t ackno,
   LWIP_DEBUGF(TCP_RST_DEBUG, ("tcp_rst: seqno %"U32_F" ackno %"U32_F".\n", seqno, ackno));
 }
 
+#if LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ
+/**
+ * Send a SYN-ACK for a connection request to a listening pcb: like tcp_rst(),
+ * this is sent without a connection pcb.
+ *
+ * Called by tcp_listen_input() for SYN cookies and request entries.
+ *
+ * @param lpcb the listening pcb which received the SYN
+ * @param iss our initial sequence number (or the SYN cookie)
+ * @param ackno the acknowledge number (seqno of the SYN + 1)
+ * @param local_ip the local IP address to send the segment from
+ * @param remote_ip the remote IP address to send the segment to
+ * @param remote_port the remote TCP port to send the segment to
+ * @param opts the options received with the SYN
+ * @param tsval the timestamp value to send (if opts->ts)
+ */
+void
+tcp_synack(const struct tcp_pcb_listen *lpcb, u32_t iss, u32_t ackno,
+  const ip_addr_t *local_ip, const ip_addr_t *remote_ip,
+  u16_t remote_port, const struct tcp_syn_opts *opts, u32_t tsval)
+{
+  struct pbuf *p;
+  struct tcp_hdr *tcphdr;
+  struct netif *netif;
+  u32_t *optp;
+  u16_t optlen = LWIP_TCP_OPT_LEN_MSS;
+  u16_t mss;
+
+#if LWIP_TCP_TIMESTAMPS
+  if (opts->ts) {
+    optlen += LWIP_TCP_OPT_LEN_TS_OUT;
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+#if LWIP_WND_SCALE
+  if (opts->snd_scale != TCP_SYN_OPTS_NO_WS) {
+    optlen += LWIP_TCP_OPT_LEN_WS_OUT;
+  }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+  if (opts->sack_perm) {
+    optlen += LWIP_TCP_OPT_LEN_SACK_PERM_OUT;
+  }
+#endif /* LWIP_TCP_SACK_OUT */
+
+  netif = tcp_route((const struct tcp_pcb *)lpcb, local_ip, remote_ip);
+  if (netif == NULL) {
+    return;
+  }
+  p = pbuf_alloc(PBUF_IP, TCP_HLEN + optlen, PBUF_RAM);
+  if (p == NULL) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_synack: could not allocate memory for pbuf\n"));
+    return;
+  }
+  LWIP_ASSERT("check that first pbuf can hold struct tcp_hdr",
+              (p->len >= TCP_HLEN + optlen));
+
+  tcphdr = (struct tcp_hdr *)p->payload;
+  tcphdr->src = lwip_htons(lpcb->local_port);
+  tcphdr->dest = lwip_htons(remote_port);
+  tcphdr->seqno = lwip_htonl(iss);
+  tcphdr->ackno = lwip_htonl(ackno);
+  TCPH_HDRLEN_FLAGS_SET(tcphdr, (5 + optlen / 4), TCP_SYN | TCP_ACK);
+#if LWIP_TCP_ECN
+  if (opts->ecn) {
+    TCPH_SET_FLAG(tcphdr, TCP_ECE);
+  }
+#endif /* LWIP_TCP_ECN */
+  /* The window field of a SYN segment is never scaled */
+  tcphdr->wnd = PP_HTONS(TCPWND_MIN16(TCP_WND));
+  tcphdr->chksum = 0;
+  tcphdr->urgp = 0;
+
+  /* cast through void* to get rid of alignment warnings */
+  optp = (u32_t *)(void *)(tcphdr + 1);
+#if TCP_CALCULATE_EFF_SEND_MSS
+  mss = tcp_eff_send_mss_netif(TCP_MSS, netif, remote_ip);
+#else /* TCP_CALCULATE_EFF_SEND_MSS */
+  mss = TCP_MSS;
+#endif /* TCP_CALCULATE_EFF_SEND_MSS */
+  *(optp++) = TCP_BUILD_MSS_OPTION(mss);
+#if LWIP_TCP_TIMESTAMPS
+  if (opts->ts) {
+    *(optp++) = PP_HTONL(0x0101080A);
+    *(optp++) = lwip_htonl(tsval);
+    *(optp++) = lwip_htonl(opts->tsval);
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+#if LWIP_WND_SCALE
+  if (opts->snd_scale != TCP_SYN_OPTS_NO_WS) {
+    tcp_build_wnd_scale_option(optp++);
+  }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+  if (opts->sack_perm) {
+    *(optp++) = PP_HTONL(0x01010402);
+  }
+#endif /* LWIP_TCP_SACK_OUT */
+  LWIP_UNUSED_ARG(optp);
+  LWIP_UNUSED_ARG(tsval);
+
+  TCP_STATS_INC(tcp.xmit);
+#if CHECKSUM_GEN_TCP
+  IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_TCP) {
+    tcphdr->chksum = ip_chksum_pseudo(p, IP_PROTO_TCP, p->tot_len,
+                                      local_ip, remote_ip);
+  }
+#endif
+  ip_output_if(p, local_ip, remote_ip, lpcb->ttl, lpcb->tos, IP_PROTO_TCP, netif);
+  pbuf_free(p);
+  LWIP_DEBUGF(TCP_DEBUG, ("tcp_synack: iss %"U32_F" ackno %"U32_F".\n", iss, ackno));
+}
+#endif /* LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ */
+
+#if LWIP_TCP_TW_COMPACT
+/**
+ * Send an ACK for a connection in TIME_WAIT kept as a compact record: like
+ * tcp_send_empty_ack(), but built from the record instead of a tcp_pcb.
+ *
+ * Called by tcp_timewait_input() for retransmitted FINs and other segments
+ * that need to be acknowledged.
+ *
+ * @param tw the compact TIME_WAIT record
+ */
+void
+tcp_tw_ack(const struct tcp_pcb_tw *tw)
+{
+  struct pbuf *p;
+  struct tcp_hdr *tcphdr;
+  struct netif *netif;
+  u16_t optlen = 0;
+
+#if LWIP_TCP_TIMESTAMPS
+  if (tw->ts) {
+    optlen = LWIP_TCP_OPT_LENGTH(TF_SEG_OPTS_TS);
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+
+  if (tw->netif_idx != NETIF_NO_INDEX) {
+    netif = netif_get_by_index(tw->netif_idx);
+  } else {
+    netif = ip_route(&tw->local_ip, &tw->remote_ip);
+  }
+  if (netif == NULL) {
+    return;
+  }
+  p = pbuf_alloc(PBUF_IP, TCP_HLEN + optlen, PBUF_RAM);
+  if (p == NULL) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_tw_ack: could not allocate memory for pbuf\n"));
+    return;
+  }
+  LWIP_ASSERT("check that first pbuf can hold struct tcp_hdr",
+              (p->len >= TCP_HLEN + optlen));
+
+  tcphdr = (struct tcp_hdr *)p->payload;
+  tcphdr->src = lwip_htons(tw->local_port);
+  tcphdr->dest = lwip_htons(tw->remote_port);
+  tcphdr->seqno = lwip_htonl(tw->snd_nxt);
+  tcphdr->ackno = lwip_htonl(tw->rcv_nxt);
+  TCPH_HDRLEN_FLAGS_SET(tcphdr, (5 + optlen / 4), TCP_ACK);
+  tcphdr->wnd = lwip_htons(tw->wnd);
+  tcphdr->chksum = 0;
+  tcphdr->urgp = 0;
+#if LWIP_TCP_TIMESTAMPS
+  if (tw->ts) {
+    /* cast through void* to get rid of alignment warnings */
+    u32_t *opts = (u32_t *)(void *)(tcphdr + 1);
+    opts[0] = PP_HTONL(0x0101080A);
+    opts[1] = lwip_htonl(sys_now());
+    opts[2] = lwip_htonl(tw->ts_recent);
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+
+  TCP_STATS_INC(tcp.xmit);
+#if CHECKSUM_GEN_TCP
+  IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_TCP) {
+    tcphdr->chksum = ip_chksum_pseudo(p, IP_PROTO_TCP, p->tot_len,
+                                      &tw->local_ip, &tw->remote_ip);
+  }
+#endif
+  ip_output_if(p, &tw->local_ip, &tw->remote_ip, tw->ttl, tw->tos, IP_PROTO_TCP, netif);
+  pbuf_free(p);
+  LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_tw_ack: sending ACK for %"U32_F"\n", tw->rcv_nxt));
+}
+#endif /* LWIP_TCP_TW_COMPACT */
+
+#if IP_PMTUD
+/**
+ * Split a segment on the unsent queue after 'split' bytes of data. The data
+ * after that is copied into a new segment, which is queued after it.
+ *
+ * @param pcb the tcp_pcb the segment belongs to
+ * @param useg the segment to split
+ * @param split the number of data bytes to keep in 'useg'
+ * @return ERR_OK, or ERR_MEM if the new segment could not be allocated
+ *         ('useg' is left unchanged then)
+ */
+static err_t
+tcp_split_seg(struct tcp_pcb *pcb, struct tcp_seg *useg, u16_t split)
+{
+  struct tcp_seg *seg;
+  struct pbuf *p;
+  u8_t optlen = LWIP_TCP_OPT_LENGTH(useg->flags);
+  u16_t remainder = (u16_t)(useg->len - split);
+  /* headers in front of the data (IP header too if it has been sent) */
+  u16_t offset = (u16_t)(useg->p->tot_len - useg->len + split);
+  u8_t split_flags = TCPH_FLAGS(useg->tcphdr);
+  u8_t remainder_flags;
+
+  p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(remainder + optlen), PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  if (pbuf_copy_partial(useg->p, (u8_t *)p->payload + optlen, remainder, offset) != remainder) {
+    pbuf_free(p);
+    return ERR_MEM;
+  }
+  /* PSH and FIN go with the end of the data */
+  remainder_flags = (u8_t)(split_flags & (TCP_PSH | TCP_FIN));
+  split_flags &= (u8_t)~(TCP_PSH | TCP_FIN);
+  seg = tcp_create_segment(pcb, p, remainder_flags, lwip_ntohl(useg->tcphdr->seqno) + split,
+                           (u16_t)(useg->flags & ~TF_SEG_DATA_CHECKSUMMED));
+  if (seg == NULL) {
+    return ERR_MEM;
+  }
+#if TCP_CHECKSUM_ON_COPY
+  tcp_seg_add_chksum((u16_t)~inet_chksum((u8_t *)p->payload + TCP_HLEN + optlen, remainder),
+                     remainder, &seg->chksum, &seg->chksum_swapped);
+  seg->flags |= TF_SEG_DATA_CHECKSUMMED;
+#endif /* TCP_CHECKSUM_ON_COPY */
+#if LWIP_TCP_RACK
+  seg->xmit_time = useg->xmit_time;
+#endif /* LWIP_TCP_RACK */
+
+  /* trim the original segment */
+  pcb->snd_queuelen = (u16_t)(pcb->snd_queuelen - pbuf_clen(useg->p));
+  pbuf_realloc(useg->p, (u16_t)(useg->p->tot_len - remainder));
+  useg->len = split;
+  TCPH_FLAGS_SET(useg->tcphdr, split_flags);
+#if TCP_OVERSIZE_DBGCHECK
+  useg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+  pcb->snd_queuelen = (u16_t)(pcb->snd_queuelen + pbuf_clen(useg->p) + pbuf_clen(seg->p));
+#if TCP_CHECKSUM_ON_COPY
+  if (useg->flags & TF_SEG_DATA_CHECKSUMMED) {
+    /* checksum the data that is left */
+    tcp_seg_chksum_data(useg);
+  }
+#endif /* TCP_CHECKSUM_ON_COPY */
+
+  seg->next = useg->next;
+  useg->next = seg;
+#if TCP_OVERSIZE
+  if (seg->next == NULL) {
+    /* the new last segment has no room for more data */
+    pcb->unsent_oversize = 0;
+  }
+#endif /* TCP_OVERSIZE */
+  return ERR_OK;
+}
+
+/**
+ * Split the segments on the unsent queue that don't fit into pcb->mss any
+ * more, after it has been lowered for the path MTU. Segments that can't be
+ * split for lack of memory are sent as they are.
+ *
+ * @param pcb the tcp_pcb to split the unsent segments of
+ */
+void
+tcp_split_unsent(struct tcp_pcb *pcb)
+{
+  struct tcp_seg *seg;
+
+  for (seg = pcb->unsent; seg != NULL; seg = seg->next) {
+    u16_t optlen = LWIP_TCP_OPT_LENGTH(seg->flags);
+    if (!(TCPH_FLAGS(seg->tcphdr) & TCP_SYN) && (pcb->mss > optlen) &&
+        (seg->len + optlen > pcb->mss)) {
+      if (tcp_split_seg(pcb, seg, (u16_t)(pcb->mss - optlen)) != ERR_OK) {
+        LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("tcp_split_unsent: out of memory\n"));
+        break;
+      }
+    }
+  }
+}
+#endif /* IP_PMTUD */
+
 /**
  * Requeue all unacked segments for retransmission
  *
@@ -1579,6 +2575,20 @@ tcp_rexmit_rto_prepare(struct tcp_pcb *pcb)
   pcb->rto_end = lwip_ntohl(seg->tcphdr->seqno) + TCP_TCPLEN(seg);
   /* Don't take any RTT measurements after retransmitting. */
   pcb->rttest = 0;
+#if LWIP_TCP_SACK_IN
+  /* After an RTO, SACK information is not trusted any more (the receiver may
+     have reneged): forget the scoreboard and leave SACK-based recovery */
+  for (seg = pcb->unsent; seg != NULL; seg = seg->next) {
+    seg->flags &= (u16_t)~(TF_SEG_SACKED | TF_SEG_SACK_REXMIT);
+  }
+#if LWIP_TCP_RACK
+  /* no loss probes or RACK timeouts until the RTO recovery is done */
+  tcp_rack_stop(pcb);
+#endif /* LWIP_TCP_RACK */
+  if (pcb->flags & TF_SACK_RECOVERY) {
+    tcp_clear_flags(pcb, TF_INFR | TF_SACK_RECOVERY);
+  }
+#endif /* LWIP_TCP_SACK_IN */
 
   return ERR_OK;
 }
@@ -1641,6 +2651,9 @@ tcp_rexmit(struct tcp_pcb *pcb)
     LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_rexmit busy\n"));
     return ERR_VAL;
   }
+#if LWIP_TCP_TSO
+  tcp_tso_rexmit(pcb, seg);
+#endif /* LWIP_TCP_TSO */
 
   /* Move the first unacked segment to the unsent queue */
   /* Keep the unsent queue sorted. */
@@ -1684,35 +2697,229 @@ void
 tcp_rexmit_fast(struct tcp_pcb *pcb)
 {
   if (pcb->unacked != NULL && !(pcb->flags & TF_INFR)) {
+    err_t err;
+#if LWIP_TCP_SACK_IN
+    u8_t sack = 0;
+    struct tcp_seg *seg;
+#endif /* LWIP_TCP_SACK_IN */
     /* This is fast retransmit. Retransmit the first unacked segment. */
     LWIP_DEBUGF(TCP_FR_DEBUG,
                 ("tcp_receive: dupacks %"U16_F" (%"U32_F
                  "), fast retransmit %"U32_F"\n",
                  (u16_t)pcb->dupacks, pcb->lastack,
                  lwip_ntohl(pcb->unacked->tcphdr->seqno)));
-    if (tcp_rexmit(pcb) == ERR_OK) {
-      /* Set ssthresh to half of the minimum of the current
-       * cwnd and the advertised window */
-      pcb->ssthresh = LWIP_MIN(pcb->cwnd, pcb->snd_wnd) / 2;
-
-      /* The minimum value for ssthresh should be 2 MSS */
-      if (pcb->ssthresh < (2U * pcb->mss)) {
-        LWIP_DEBUGF(TCP_FR_DEBUG,
-                    ("tcp_receive: The minimum value for ssthresh %"TCPWNDSIZE_F
-                     " should be min 2 mss %"U16_F"...\n",
-                     pcb->ssthresh, (u16_t)(2*pcb->mss)));
-        pcb->ssthresh = 2 * pcb->mss;
+#if LWIP_TCP_SACK_IN
+    /* use SACK-based recovery if the remote host has SACKed anything */
+    for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+      if (seg->flags & TF_SEG_SACKED) {
+        sack = 1;
+        break;
+      }
+    }
+    if (sack) {
+      /* segments are retransmitted in place by tcp_rexmit_sack() below */
+      err = ERR_OK;
+    } else
+#endif /* LWIP_TCP_SACK_IN */
+    {
+      err = tcp_rexmit(pcb);
+    }
+    if (err == ERR_OK) {
+      TCP_INFO_INC(pcb, info_fast_retrans);
+      /* Let the congestion control reduce ssthresh */
+      pcb->cc->loss(pcb);
+#if LWIP_TCP_ECN
+      /* ECE for this window is covered by the reduction */
+      pcb->ecn_recover = pcb->snd_nxt;
+#endif /* LWIP_TCP_ECN */
+
+#if LWIP_TCP_SACK_IN
+      if (sack) {
+        /* RFC 6675: no window inflation, the pipe limits what is sent */
+        pcb->cwnd = pcb->ssthresh;
+        pcb->sack_recover = pcb->snd_nxt;
+        tcp_set_flags(pcb, TF_SACK_RECOVERY);
+      } else
+#endif /* LWIP_TCP_SACK_IN */
+      {
+        pcb->cwnd = pcb->ssthresh + 3 * pcb->mss;
       }
-
-      pcb->cwnd = pcb->ssthresh + 3 * pcb->mss;
       tcp_set_flags(pcb, TF_INFR);
 
       /* Reset the retransmission timer to prevent immediate rto retransmissions */
       pcb->rtime = 0;
+#if LWIP_TCP_SACK_IN
+      if (sack) {
+        tcp_rexmit_sack(pcb, 1);
+      }
+#endif /* LWIP_TCP_SACK_IN */
     }
   }
 }
 
+#if LWIP_TCP_SACK_IN
+/** RFC 6675 IsLost(): DupThresh discontiguous SACKed segments or more than
+ * (DupThresh - 1) * SMSS bytes are SACKed above */
+#define TCP_SACK_IS_LOST(pcb, sacked_above, sacked_segs_above) \
+  (((sacked_segs_above) >= 3) || ((sacked_above) > 2U * (pcb)->mss))
+
+/**
+ * Retransmit segments during SACK-based loss recovery (RFC 6675) as long as
+ * the estimated number of bytes in flight (the "pipe") is below cwnd.
+ * Segments are retransmitted in place on the unacked queue, SACKed segments
+ * are never sent again. Of NextSeg(), rule 1 (lost segments) and rule 3
+ * (other holes below the highest SACKed segment, only if there is no unsent
+ * data) are implemented here; new data (rule 2) is sent by tcp_output().
+ *
+ * Called by tcp_receive() for each ACK received during recovery.
+ *
+ * @param pcb the tcp_pcb in SACK-based recovery
+ * @param force retransmit the first segment that is not SACKed (HighACK + 1),
+ *              whether it is considered lost or not and even if the pipe is
+ *              full or there is new data to send (set when entering recovery)
+ */
+void
+tcp_rexmit_sack(struct tcp_pcb *pcb, u8_t force)
+{
+  struct tcp_seg *seg;
+  struct netif *netif;
+  u32_t sacked = 0, sacked_above, pipe = 0, high_sacked = pcb->lastack;
+  u16_t sacked_segs = 0, sacked_segs_above;
+  u8_t rule;
+
+  /* Walk the scoreboard: count SACKed bytes and segments, find HighSACK and
+     calculate the pipe (RFC 6675 SetPipe()) */
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    if (seg->flags & TF_SEG_SACKED) {
+      sacked += TCP_TCPLEN(seg);
+      sacked_segs++;
+      high_sacked = lwip_ntohl(seg->tcphdr->seqno) + TCP_TCPLEN(seg);
+    }
+  }
+  sacked_above = sacked;
+  sacked_segs_above = sacked_segs;
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    if (seg->flags & TF_SEG_SACKED) {
+      sacked_above -= TCP_TCPLEN(seg);
+      sacked_segs_above--;
+    } else {
+      if (!TCP_SACK_IS_LOST(pcb, sacked_above, sacked_segs_above) && !TCP_RACK_IS_LOST(pcb, seg)) {
+        pipe += TCP_TCPLEN(seg);
+      }
+      if ((seg->flags & TF_SEG_SACK_REXMIT) && !TCP_RACK_IS_LOST(pcb, seg)) {
+        pipe += TCP_TCPLEN(seg);
+      }
+    }
+  }
+
+  netif = tcp_route(pcb, &pcb->local_ip, &pcb->remote_ip);
+  if (netif == NULL) {
+    return;
+  }
+
+  for (rule = 1; rule <= 3; rule += 2) {
+    if ((rule == 3) && (pcb->unsent != NULL)) {
+      /* new data is sent before holes that are not known to be lost */
+      break;
+    }
+    sacked_above = sacked;
+    sacked_segs_above = sacked_segs;
+    for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+      if (seg->flags & TF_SEG_SACKED) {
+        sacked_above -= TCP_TCPLEN(seg);
+        sacked_segs_above--;
+        continue;
+      }
+      if (!TCP_SEQ_LT(lwip_ntohl(seg->tcphdr->seqno), high_sacked)) {
+        /* nothing above HighSACK is a hole */
+        break;
+      }
+      /* (RACK also detects lost retransmissions). When entering recovery,
+         the first hole is retransmitted in any case (RFC 6675 section 5, step 4.3) */
+      if (!force &&
+          (((seg->flags & TF_SEG_SACK_REXMIT) && !TCP_RACK_IS_LOST(pcb, seg)) ||
+           ((rule == 1) && !TCP_SACK_IS_LOST(pcb, sacked_above, sacked_segs_above) &&
+            !TCP_RACK_IS_LOST(pcb, seg)))) {
+        continue;
+      }
+      if (!force && (pipe + pcb->mss > pcb->cwnd)) {
+        return;
+      }
+      if (tcp_output_segment_busy(seg)) {
+        LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_rexmit_sack: segment busy\n"));
+        return;
+      }
+#if LWIP_TCP_TSO
+      tcp_tso_rexmit(pcb, seg);
+#endif /* LWIP_TCP_TSO */
+      LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_rexmit_sack: retransmit %"U32_F" (pipe %"U32_F
+                                 ", cwnd %"TCPWNDSIZE_F")\n",
+                                 lwip_ntohl(seg->tcphdr->seqno), pipe, pcb->cwnd));
+      if (tcp_output_segment(seg, pcb, netif) != ERR_OK) {
+        return;
+      }
+      /* Don't take any rtt measurements after retransmitting. */
+      pcb->rttest = 0;
+      if (force && (pcb->nrtx < 0xFF)) {
+        ++pcb->nrtx;
+      }
+      force = 0;
+      seg->flags |= TF_SEG_SACK_REXMIT;
+      pipe += TCP_TCPLEN(seg);
+      MIB2_STATS_INC(mib2.tcpretranssegs);
+    }
+  }
+}
+#endif /* LWIP_TCP_SACK_IN */
+
+#if LWIP_TCP_RACK
+/**
+ * Retransmit the last segment on the unacked queue in place (used as tail
+ * loss probe by tcp_rack.c).
+ *
+ * @param pcb the tcp_pcb for which to retransmit the last unacked segment
+ * @return ERR_OK if the segment was sent
+ */
+err_t
+tcp_rexmit_last(struct tcp_pcb *pcb)
+{
+  struct tcp_seg *seg;
+  struct netif *netif;
+  err_t err;
+
+  if (pcb->unacked == NULL) {
+    return ERR_VAL;
+  }
+  for (seg = pcb->unacked; seg->next != NULL; seg = seg->next);
+  if (tcp_output_segment_busy(seg)) {
+    LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_rexmit_last: segment busy\n"));
+    return ERR_VAL;
+  }
+#if LWIP_TCP_TSO
+  if (seg->len > pcb->mss - LWIP_TCP_OPT_LENGTH(seg->flags)) {
+    /* probe with the end of a super-segment only */
+    tcp_tso_split(pcb, seg, (u16_t)(seg->len - (pcb->mss - LWIP_TCP_OPT_LENGTH(seg->flags))));
+    if (seg->next != NULL) {
+      seg = seg->next;
+    }
+  }
+#endif /* LWIP_TCP_TSO */
+  netif = tcp_route(pcb, &pcb->local_ip, &pcb->remote_ip);
+  if (netif == NULL) {
+    return ERR_RTE;
+  }
+  LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_rexmit_last: retransmit %"U32_F"\n",
+                             lwip_ntohl(seg->tcphdr->seqno)));
+  err = tcp_output_segment(seg, pcb, netif);
+  if (err == ERR_OK) {
+    /* Don't take any rtt measurements after retransmitting. */
+    pcb->rttest = 0;
+    MIB2_STATS_INC(mib2.tcpretranssegs);
+  }
+  return err;
+}
+#endif /* LWIP_TCP_RACK */
+
 
 /**
  * Send keepalive packets to keep a connection active although
@@ -0,0 +1,161 @@
+/**
+ * @file
+ * Transmission Control Protocol, path MTU discovery
+ *
+ * With IP_PMTUD, TCP segments are sent with the Don't Fragment flag (see
+ * ip4_output_if()). An ICMP "fragmentation needed" message for a segment
+ * in flight lowers the path MTU to its destination in the IPv4 path MTU
+ * cache (RFC 1191); the connection lowers its MSS, splits the segments
+ * already queued and retransmits at once. The congestion window is not
+ * reduced: the segment was not lost to congestion.
+ *
+ * With LWIP_TCP_PLPMTUD, a path MTU black hole (a path that drops segments
+ * that are too big without sending ICMP messages) is assumed after
+ * TCP_PMTU_BLACKHOLE_RTX retransmission timeouts in a row, and the MSS is
+ * lowered to TCP_PMTU_BASE_MSS (RFC 4821). The lower path MTU is cached like
+ * one learned from ICMP, so that new connections to the same destination
+ * start with it.
+ *
+ * Both ways, the larger MSS is tried again (probed for) as data is acked
+ * after IP_PMTU_TIMEOUT, when the cache entry has expired. If the path MTU
+ * is still smaller, this is found out again the same way.
+ */
+
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && IP_PMTUD /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/ip4_pmtu.h"
+#include "lwip/sys.h"
+
+/** Lower the MSS of a pcb for the path MTU and split the unsent segments
+ * that don't fit any more */
+static void
+tcp_pmtu_set_mss(struct tcp_pcb *pcb, u16_t mss)
+{
+  LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_pmtu_set_mss: mss %"U16_F" -> %"U16_F"\n", pcb->mss, mss));
+  pcb->mss = mss;
+  pcb->pmtu_time = sys_now();
+  tcp_split_unsent(pcb);
+}
+
+/**
+ * Handle an ICMP "fragmentation needed" message for a TCP segment sent over
+ * IPv4 (called from icmp_input()).
+ *
+ * @param local_ip source address of the segment
+ * @param remote_ip destination address of the segment
+ * @param local_port source port of the segment
+ * @param remote_port destination port of the segment
+ * @param seqno sequence number of the segment
+ * @param mtu the next-hop MTU reported by the router (may be 0)
+ * @param len total length of the IP datagram that was too big
+ */
+void
+tcp_pmtu_icmp(const ip4_addr_t *local_ip, const ip4_addr_t *remote_ip,
+              u16_t local_port, u16_t remote_port, u32_t seqno, u16_t mtu, u16_t len)
+{
+  struct tcp_pcb *pcb;
+  u16_t mss;
+
+  for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+    if (IP_IS_V4_VAL(pcb->remote_ip) &&
+        (pcb->local_port == local_port) && (pcb->remote_port == remote_port) &&
+        ip4_addr_cmp(ip_2_ip4(&pcb->remote_ip), remote_ip) &&
+        ip4_addr_cmp(ip_2_ip4(&pcb->local_ip), local_ip)) {
+      break;
+    }
+  }
+  /* Only believe messages about data in flight, they are easily forged
+     (RFC 5927, section 5.2) */
+  if ((pcb == NULL) || TCP_SEQ_LT(seqno, pcb->lastack) || !TCP_SEQ_LT(seqno, pcb->snd_nxt)) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_pmtu_icmp: no segment in flight for the message\n"));
+    return;
+  }
+  ip4_pmtu_set(remote_ip, ip4_pmtu_estimate(mtu, len));
+  if (pcb->state < ESTABLISHED) {
+    /* the MSS is set when the connection is established */
+    return;
+  }
+  mss = tcp_eff_send_mss(pcb->snd_mss_max, &pcb->local_ip, &pcb->remote_ip);
+  if (mss < pcb->mss) {
+    /* resend what is in flight in smaller segments; cwnd stays as it is */
+    tcp_rexmit_rto_prepare(pcb);
+    tcp_pmtu_set_mss(pcb, mss);
+    tcp_output(pcb);
+  }
+}
+
+/**
+ * Try a larger MSS again when the path MTU estimate that limited it has
+ * expired. Called as data is acked after IP_PMTU_TIMEOUT.
+ *
+ * @param pcb the tcp_pcb to check
+ */
+void
+tcp_pmtu_probe(struct tcp_pcb *pcb)
+{
+  u16_t mss = tcp_eff_send_mss(pcb->snd_mss_max, &pcb->local_ip, &pcb->remote_ip);
+
+  pcb->pmtu_time = sys_now();
+  if (mss > pcb->mss) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_pmtu_probe: mss %"U16_F" -> %"U16_F"\n", pcb->mss, mss));
+    pcb->mss = mss;
+  }
+}
+
+#if LWIP_TCP_PLPMTUD
+/**
+ * Check for a path MTU black hole after a retransmission timeout: if only
+ * segments larger than TCP_PMTU_BASE_MSS are being lost, lower the MSS to
+ * TCP_PMTU_BASE_MSS. Called by tcp_slowtmr() after the unacked segments
+ * have been requeued.
+ *
+ * @param pcb the tcp_pcb that had a retransmission timeout
+ */
+void
+tcp_pmtu_blackhole(struct tcp_pcb *pcb)
+{
+  if ((pcb->state < ESTABLISHED) || (pcb->mss <= TCP_PMTU_BASE_MSS) ||
+      (pcb->unsent == NULL) || (pcb->unsent->len <= TCP_PMTU_BASE_MSS)) {
+    return;
+  }
+  LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_pmtu_blackhole: %"U16_F" retransmission timeouts, mss %"U16_F"\n",
+                              (u16_t)TCP_PMTU_BLACKHOLE_RTX, (u16_t)TCP_PMTU_BASE_MSS));
+  if (IP_IS_V4_VAL(pcb->remote_ip)) {
+    ip4_pmtu_set(ip_2_ip4(&pcb->remote_ip), (u16_t)(TCP_PMTU_BASE_MSS + IP_HLEN + TCP_HLEN));
+  }
+  tcp_pmtu_set_mss(pcb, TCP_PMTU_BASE_MSS);
+}
+#endif /* LWIP_TCP_PLPMTUD */
+
+#endif /* LWIP_TCP && IP_PMTUD */
@@ -0,0 +1,345 @@
+/**
+ * @file
+ * Transmission Control Protocol, RACK-TLP loss detection
+ *
+ * RACK (RFC 8985) detects lost segments by time instead of by counting
+ * duplicate ACKs: a segment is lost when a segment sent sufficiently later
+ * (by more than a reordering window) has been delivered. Tail Loss Probes
+ * (TLP) trigger an ACK when the last segments of a flight are lost, so that
+ * RACK can repair them by fast recovery instead of waiting for the RTO.
+ *
+ * Lost segments are retransmitted by the SACK-based recovery of tcp_out.c
+ * (tcp_rexmit_sack()), which asks tcp_rack_lost() in addition to the RFC 6675
+ * rules. Both the reordering timer and the probe timeout use pcb->rack_timer.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_RACK /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+
+/** Worst case delayed ACK time added to the PTO if only one segment is in flight */
+#define TCP_TLP_WCDELACKT   200
+/** PTO used before an RTT sample has been taken */
+#define TCP_TLP_PTO_NO_RTT  1000
+/** Lower bound of the PTO (sys_now() granularity, very short RTTs) */
+#define TCP_TLP_PTO_MIN     10
+
+/** RFC 8985 RACK_sent_after(): compare by transmit time, then by sequence */
+#define TCP_RACK_SENT_AFTER(t1, seq1, t2, seq2) \
+  (((s32_t)((t1) - (t2)) > 0) || (((t1) == (t2)) && TCP_SEQ_GT(seq1, seq2)))
+
+static void tcp_rack_timeout(void *arg);
+
+/**
+ * Called by tcp_in.c for each segment that is newly SACKed or cumulatively
+ * acknowledged (without having been SACKed before): take an RTT sample and
+ * remember the most recently sent segment that was delivered.
+ *
+ * @param pcb the tcp_pcb the segment belongs to
+ * @param seg the delivered segment
+ */
+void
+tcp_rack_update(struct tcp_pcb *pcb, const struct tcp_seg *seg)
+{
+  u32_t rtt = sys_now() - seg->xmit_time;
+  u32_t end_seq = lwip_ntohl(seg->tcphdr->seqno) + TCP_TCPLEN(seg);
+
+  if (seg->flags & TF_SEG_REXMIT) {
+    /* The ACK may be for the original transmission: only use it if it
+       cannot be (RFC 8985 step 2) and never as an RTT sample (Karn) */
+    if (!(pcb->rack_flags & TCP_RACK_RTT_VALID) || (rtt < pcb->rack_min_rtt)) {
+      return;
+    }
+  } else if (pcb->rack_flags & TCP_RACK_RTT_VALID) {
+    pcb->rack_srtt = (7 * pcb->rack_srtt + rtt) / 8;
+    pcb->rack_min_rtt = LWIP_MIN(pcb->rack_min_rtt, rtt);
+  } else {
+    pcb->rack_srtt = rtt;
+    pcb->rack_min_rtt = rtt;
+    pcb->rack_flags |= TCP_RACK_RTT_VALID;
+  }
+
+  if (!(pcb->rack_flags & TCP_RACK_VALID) ||
+      TCP_RACK_SENT_AFTER(seg->xmit_time, end_seq, pcb->rack_xmit_time, pcb->rack_end_seq)) {
+    pcb->rack_xmit_time = seg->xmit_time;
+    pcb->rack_end_seq = end_seq;
+    pcb->rack_rtt = rtt;
+    pcb->rack_flags |= TCP_RACK_VALID;
+  }
+}
+
+/** RFC 8985 reordering window: a quarter of the minimum RTT */
+static u32_t
+tcp_rack_reo_wnd(const struct tcp_pcb *pcb)
+{
+  return LWIP_MIN(pcb->rack_min_rtt / 4, pcb->rack_srtt);
+}
+
+/**
+ * Time (in milliseconds, may be negative) until a not SACKed segment is
+ * considered lost, or 0x7fffffff if it was not sent before the most recently
+ * delivered segment.
+ */
+static s32_t
+tcp_rack_remaining(const struct tcp_pcb *pcb, const struct tcp_seg *seg, u32_t now)
+{
+  if (!(pcb->rack_flags & TCP_RACK_VALID) ||
+      TCP_RACK_SENT_AFTER(seg->xmit_time, lwip_ntohl(seg->tcphdr->seqno) + TCP_TCPLEN(seg),
+                          pcb->rack_xmit_time, pcb->rack_end_seq)) {
+    return 0x7fffffff;
+  }
+  if ((seg->flags & TF_SEG_REXMIT) && (seg->xmit_time == pcb->rack_xmit_time)) {
+    /* sequence order says nothing about retransmissions: with millisecond
+       timestamps, one sent in the same millisecond is not known to be lost */
+    return 0x7fffffff;
+  }
+  return (s32_t)(seg->xmit_time + pcb->rack_rtt + tcp_rack_reo_wnd(pcb) - now);
+}
+
+/**
+ * RACK: check if a segment on the unacked queue (that is not SACKed) is lost.
+ * Called by tcp_rexmit_sack() in addition to the RFC 6675 IsLost() check.
+ */
+u8_t
+tcp_rack_lost(const struct tcp_pcb *pcb, const struct tcp_seg *seg)
+{
+  return tcp_rack_remaining(pcb, seg, sys_now()) <= 0;
+}
+
+/**
+ * RFC 8985 RACK_detect_loss(): check the unacked queue for lost segments.
+ *
+ * @param pcb the tcp_pcb to check
+ * @param lost set to 1 if any segment is lost
+ * @return milliseconds until the next segment would be lost (0 if none)
+ */
+static u32_t
+tcp_rack_detect_loss(struct tcp_pcb *pcb, u8_t *lost)
+{
+  struct tcp_seg *seg;
+  u32_t now = sys_now();
+  s32_t timeout = 0;
+
+  *lost = 0;
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    s32_t remaining;
+    if (seg->flags & TF_SEG_SACKED) {
+      continue;
+    }
+    remaining = tcp_rack_remaining(pcb, seg, now);
+    if (remaining <= 0) {
+      *lost = 1;
+    } else if ((remaining != 0x7fffffff) && (remaining > timeout)) {
+      timeout = remaining;
+    }
+  }
+  return (u32_t)timeout;
+}
+
+/**
+ * Probe timeout (RFC 8985 section 7.2), 0 if no probe should be scheduled
+ */
+static u32_t
+tcp_tlp_pto(const struct tcp_pcb *pcb)
+{
+  u32_t pto;
+  s32_t rto_left;
+
+  if ((pcb->state < ESTABLISHED) || !(pcb->flags & TF_SACK) || (pcb->unacked == NULL) ||
+      (pcb->flags & (TF_INFR | TF_RTO)) || (pcb->rack_flags & TCP_RACK_TLP_PENDING)) {
+    return 0;
+  }
+  if (pcb->rack_flags & TCP_RACK_RTT_VALID) {
+    pto = 2 * pcb->rack_srtt;
+    if (pcb->unacked->next == NULL) {
+      /* a single segment might be waiting for the delayed ACK */
+      pto += TCP_TLP_WCDELACKT;
+    }
+    pto = LWIP_MAX(pto, TCP_TLP_PTO_MIN);
+  } else {
+    pto = TCP_TLP_PTO_NO_RTT;
+  }
+  /* no probe if the RTO would fire first */
+  rto_left = pcb->rto;
+  if (pcb->rtime > 0) {
+    rto_left -= pcb->rtime;
+  }
+  rto_left *= TCP_SLOW_INTERVAL;
+  if ((s32_t)pto >= rto_left) {
+    return 0;
+  }
+  return pto;
+}
+
+/** Arm the reordering timer if reo_timeout != 0, the probe timeout otherwise */
+static void
+tcp_rack_set_timer(struct tcp_pcb *pcb, u32_t reo_timeout)
+{
+  if (reo_timeout != 0) {
+    pcb->rack_flags |= TCP_RACK_TIMER_REO;
+    sys_timeout_static(&pcb->rack_timer, reo_timeout, tcp_rack_timeout, pcb);
+  } else {
+    u32_t pto = tcp_tlp_pto(pcb);
+    pcb->rack_flags &= (u8_t)~TCP_RACK_TIMER_REO;
+    if (pto != 0) {
+      sys_timeout_static(&pcb->rack_timer, pto, tcp_rack_timeout, pcb);
+    } else {
+      sys_untimeout_static(&pcb->rack_timer);
+    }
+  }
+}
+
+/**
+ * Called by tcp_receive() after an ACK has been processed: detect lost
+ * segments (entering recovery if necessary) and rearm the timer.
+ *
+ * @param pcb the tcp_pcb that received an ACK
+ */
+void
+tcp_rack_ack(struct tcp_pcb *pcb)
+{
+  u32_t timeout;
+  u8_t lost;
+
+  if ((pcb->rack_flags & TCP_RACK_TLP_PENDING) &&
+      TCP_SEQ_GEQ(pcb->lastack, pcb->tlp_high_seq)) {
+    /* the probe (and everything sent before it) has been acked */
+    pcb->rack_flags &= (u8_t)~TCP_RACK_TLP_PENDING;
+  }
+  if (pcb->unacked == NULL) {
+    sys_untimeout_static(&pcb->rack_timer);
+    return;
+  }
+  if (!(pcb->flags & TF_SACK)) {
+    return;
+  }
+  timeout = tcp_rack_detect_loss(pcb, &lost);
+  if (lost && !(pcb->flags & (TF_INFR | TF_RTO))) {
+    LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_rack_ack: loss detected, entering recovery\n"));
+    tcp_rexmit_fast(pcb);
+  }
+  tcp_rack_set_timer(pcb, timeout);
+}
+
+/**
+ * Called by tcp_output() after new data has been sent: restart the probe
+ * timeout (unless the reordering timer is running).
+ *
+ * @param pcb the tcp_pcb that sent data
+ */
+void
+tcp_rack_sent(struct tcp_pcb *pcb)
+{
+  if (!(pcb->rack_flags & TCP_RACK_TIMER_REO) ||
+      !sys_timeout_static_pending(&pcb->rack_timer)) {
+    tcp_rack_set_timer(pcb, 0);
+  }
+}
+
+/**
+ * Stop the RACK timer (on retransmission timeout and when the pcb is freed)
+ *
+ * @param pcb the tcp_pcb to stop
+ */
+void
+tcp_rack_stop(struct tcp_pcb *pcb)
+{
+  sys_untimeout_static(&pcb->rack_timer);
+  pcb->rack_flags &= (u8_t)~(TCP_RACK_TIMER_REO | TCP_RACK_TLP_PENDING);
+}
+
+/**
+ * Send a loss probe: new data if the receive window allows it, otherwise a
+ * retransmission of the last segment sent. Only one probe is sent until it
+ * is acked or the RTO fires.
+ */
+static void
+tcp_tlp_probe(struct tcp_pcb *pcb)
+{
+  struct tcp_seg *seg;
+  u32_t snd_nxt = pcb->snd_nxt;
+
+  if ((pcb->unacked == NULL) || (pcb->flags & (TF_INFR | TF_RTO))) {
+    return;
+  }
+  /* set before tcp_output() so that no new probe is scheduled */
+  pcb->rack_flags |= TCP_RACK_TLP_PENDING;
+  pcb->tlp_high_seq = snd_nxt;
+
+  seg = pcb->unsent;
+  if ((seg != NULL) &&
+      (lwip_ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len <= pcb->snd_wnd)) {
+    /* let cwnd allow exactly one more segment */
+    tcpwnd_size_t cwnd = pcb->cwnd;
+    pcb->cwnd = (tcpwnd_size_t)(lwip_ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len);
+    tcp_output(pcb);
+    pcb->cwnd = cwnd;
+    if (pcb->snd_nxt != snd_nxt) {
+      LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_tlp_probe: sent new data\n"));
+      pcb->tlp_high_seq = pcb->snd_nxt;
+      return;
+    }
+  }
+
+  tcp_rexmit_last(pcb);
+}
+
+/**
+ * Handler of pcb->rack_timer: reordering window expired or probe timeout
+ */
+static void
+tcp_rack_timeout(void *arg)
+{
+  struct tcp_pcb *pcb = (struct tcp_pcb *)arg;
+
+  if (pcb->rack_flags & TCP_RACK_TIMER_REO) {
+    u32_t timeout;
+    u8_t lost;
+
+    timeout = tcp_rack_detect_loss(pcb, &lost);
+    if (lost) {
+      if (!(pcb->flags & (TF_INFR | TF_RTO))) {
+        tcp_rexmit_fast(pcb);
+      } else if (pcb->flags & TF_SACK_RECOVERY) {
+        tcp_rexmit_sack(pcb, 0);
+      }
+    }
+    tcp_rack_set_timer(pcb, timeout);
+  } else {
+    tcp_tlp_probe(pcb);
+  }
+  tcp_output(pcb);
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_RACK */
@@ -0,0 +1,174 @@
+/**
+ * @file
+ * Transmission Control Protocol, per-pcb send buffer size
+ *
+ * With LWIP_TCP_SNDBUF_PCB, each pcb has its own send buffer size
+ * (pcb->snd_buf_size) instead of TCP_SND_BUF, and its own pbuf limit
+ * (pcb->snd_queuelen_max) instead of TCP_SND_QUEUELEN, scaled by the same
+ * ratio. pcb->snd_buf stays the free space: snd_buf_size minus the bytes
+ * queued on unsent and unacked.
+ *
+ * The size is set with tcp_set_sndbuf() (SO_SNDBUF). With
+ * LWIP_TCP_SND_AUTOTUNE, that size is only the limit: the buffer starts at
+ * TCP_SND_BUF and grows towards twice the congestion window as ACKs come in.
+ *
+ * The bytes by which all send buffers exceed TCP_SND_BUF are limited by
+ * TCP_SND_BUF_MEM. A buffer that can't get all it wants is grown later when
+ * ACKs arrive. A buffer is never shrunk below the data queued on it; the
+ * rest of the shrinking is done as that data gets acknowledged.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_SNDBUF_PCB /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+
+/** Largest send buffer of a pcb (snd_buf must not overflow) */
+#if LWIP_WND_SCALE
+#define TCP_SNDBUF_SIZE_MAX 0x7FFFFFFFUL
+#else /* LWIP_WND_SCALE */
+#define TCP_SNDBUF_SIZE_MAX 0xFFFFU
+#endif /* LWIP_WND_SCALE */
+
+/** Bytes the send buffers of all pcbs exceed TCP_SND_BUF */
+static u32_t tcp_sndbuf_mem;
+
+#define TCP_SNDBUF_EXTRA(size) (((size) > TCP_SND_BUF) ? ((size) - TCP_SND_BUF) : 0)
+
+/** The pbuf limit for a send buffer of 'size' bytes */
+static u16_t
+tcp_sndbuf_queuelen(u32_t size)
+{
+  u32_t queuelen = ((u32_t)TCP_SND_QUEUELEN * size + TCP_SND_BUF - 1) / TCP_SND_BUF;
+  /* no-copy writes need at least 2 pbufs */
+  return (u16_t)LWIP_MIN(LWIP_MAX(queuelen, 2), TCP_SNDQUEUELEN_OVERFLOW);
+}
+
+/** Resize the send buffer of a pcb towards 'target' bytes as far as the
+ * global limit and the data queued allow */
+static void
+tcp_sndbuf_resize(struct tcp_pcb *pcb, u32_t target)
+{
+  u32_t size = pcb->snd_buf_size;
+
+  if (target > size) {
+    u32_t avail = TCP_SND_BUF + TCP_SND_BUF_MEM - tcp_sndbuf_mem + TCP_SNDBUF_EXTRA(size);
+    target = LWIP_MIN(target, avail);
+    if (target <= size) {
+      return;
+    }
+    pcb->snd_buf = (tcpwnd_size_t)(pcb->snd_buf + (target - size));
+  } else if (target < size) {
+    /* queued data stays until it is acknowledged */
+    u32_t reduce = LWIP_MIN(size - target, pcb->snd_buf);
+    if (reduce == 0) {
+      return;
+    }
+    target = size - reduce;
+    pcb->snd_buf = (tcpwnd_size_t)(pcb->snd_buf - reduce);
+  } else {
+    return;
+  }
+  tcp_sndbuf_mem = tcp_sndbuf_mem - TCP_SNDBUF_EXTRA(size) + TCP_SNDBUF_EXTRA(target);
+  LWIP_ASSERT("tcp_sndbuf_resize: accounting", tcp_sndbuf_mem <= TCP_SND_BUF_MEM);
+  pcb->snd_buf_size = (tcpwnd_size_t)target;
+  pcb->snd_queuelen_max = tcp_sndbuf_queuelen(target);
+  LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_sndbuf_resize: size %"TCPWNDSIZE_F", %"U16_F" pbufs\n",
+                                 pcb->snd_buf_size, pcb->snd_queuelen_max));
+}
+
+/**
+ * Move the send buffer size of a pcb towards its target: the size set with
+ * tcp_set_sndbuf() or, with LWIP_TCP_SND_AUTOTUNE, twice the congestion
+ * window (limited by that size). Called when ACKs have freed buffer space.
+ */
+void
+tcp_sndbuf_update(struct tcp_pcb *pcb)
+{
+  u32_t target;
+
+#if LWIP_TCP_SND_AUTOTUNE
+  /* only grow automatically: a collapsed cwnd opens again quickly */
+  target = LWIP_MAX(pcb->snd_buf_size, 2 * (u32_t)pcb->cwnd);
+  target = LWIP_MIN(target, pcb->snd_buf_max);
+#else /* LWIP_TCP_SND_AUTOTUNE */
+  target = pcb->snd_buf_max;
+#endif /* LWIP_TCP_SND_AUTOTUNE */
+  tcp_sndbuf_resize(pcb, target);
+}
+
+/**
+ * Give back the send buffer space of a pcb that is deallocated.
+ */
+void
+tcp_sndbuf_free(struct tcp_pcb *pcb)
+{
+  u32_t extra = TCP_SNDBUF_EXTRA(pcb->snd_buf_size);
+  LWIP_ASSERT("tcp_sndbuf_free: accounting", tcp_sndbuf_mem >= extra);
+  tcp_sndbuf_mem -= extra;
+  pcb->snd_buf_size = TCP_SND_BUF;
+}
+
+/**
+ * @ingroup tcp_raw
+ * Set the send buffer size of a pcb (the equivalent of SO_SNDBUF), which
+ * limits the data tcp_write() accepts before it is acknowledged. The pbuf
+ * limit (TCP_SND_QUEUELEN) scales with the size.
+ * With LWIP_TCP_SND_AUTOTUNE, this is the limit the buffer grows to.
+ * Sizes smaller than TCP_MSS are raised to TCP_MSS. Connections accepted on
+ * a listening pcb inherit its size.
+ *
+ * If the size can't be allocated completely (TCP_SND_BUF_MEM), the buffer
+ * grows later as other pcbs free their buffers. If more data than the new
+ * size is queued, the buffer shrinks as that data is acknowledged.
+ *
+ * @param pcb the tcp_pcb (may be a listening pcb)
+ * @param size the size in bytes
+ */
+void
+tcp_set_sndbuf(struct tcp_pcb *pcb, u32_t size)
+{
+  LWIP_ERROR("tcp_set_sndbuf: invalid pcb", pcb != NULL, return);
+
+  size = LWIP_MIN(LWIP_MAX(size, TCP_MSS), TCP_SNDBUF_SIZE_MAX);
+  if (pcb->state == LISTEN) {
+    ((struct tcp_pcb_listen *)pcb)->snd_buf_max = size;
+    return;
+  }
+  pcb->snd_buf_max = size;
+  if (pcb->snd_buf_size > size) {
+    tcp_sndbuf_resize(pcb, size);
+  } else {
+    tcp_sndbuf_update(pcb);
+  }
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_SNDBUF_PCB */
@@ -0,0 +1,273 @@
+/**
+ * @file
+ * Transmission Control Protocol, SYN cookies
+ *
+ * While many connections are half-open (e.g. during a SYN flood) or the
+ * tcp_pcb pool is (almost) exhausted, listening pcbs answer SYNs with a
+ * SYN-ACK whose initial sequence number encodes the connection instead of
+ * allocating a tcp_pcb for it. The pcb is only created when the final ACK of
+ * the handshake returns a valid cookie.
+ *
+ * The cookie (the ISN) is made of:
+ * - 5 bits: a counter incremented every TCP_SYNCOOKIE_PERIOD milliseconds
+ * - 3 bits: index of the peer's MSS in tcp_syncookie_mss_tab
+ * - 24 bits: keyed hash (tcp_siphash()) of the addresses, ports, the peer's
+ *   ISN, the counter and the MSS index
+ *
+ * With timestamps, window scale and SACK permitted are encoded in the low
+ * bits of the timestamp value of the SYN-ACK (which the peer echoes in the
+ * ACK). Without timestamps, the connection uses neither.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_SYNCOOKIES /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/sys.h"
+
+#include <string.h>
+
+/** Lifetime of a counter value (2^16 ms, about 65 seconds): cookies are
+ * accepted for one to two periods. The period is a power of two so that the
+ * counter wraps together with sys_now() and the 5 bits of it stored in the
+ * cookie count on without a gap across that wrap. */
+#define TCP_SYNCOOKIE_PERIOD_SHIFT 16
+#define TCP_SYNCOOKIE_COUNTER()   ((u32_t)(sys_now() >> TCP_SYNCOOKIE_PERIOD_SHIFT))
+#define TCP_SYNCOOKIE_COUNTER_MASK (0xFFFFFFFFUL >> TCP_SYNCOOKIE_PERIOD_SHIFT)
+#define TCP_SYNCOOKIE_HASH_MASK   0x00FFFFFFUL
+
+/* options encoded in the timestamp value */
+#define TCP_SYNCOOKIE_TS_MASK     0x3FUL
+#define TCP_SYNCOOKIE_TS_WS_MASK  0x0FUL /* 0x0F: no window scaling */
+#define TCP_SYNCOOKIE_TS_SACK     0x10UL
+#define TCP_SYNCOOKIE_TS_ECN      0x20UL
+
+u16_t tcp_syn_rcvd_pending;
+u16_t tcp_pcbs_used;
+
+static u8_t tcp_syncookie_key[TCP_SYNCOOKIE_KEY_LEN];
+
+/** MSS values that can be encoded in a cookie (the peer's MSS is rounded down) */
+static const u16_t tcp_syncookie_mss_tab[] = {
+  536, 1220, 1300, 1360, 1400, 1440, 1452, 1460
+};
+
+/**
+ * Initialize the cookie key from LWIP_RAND() (called by tcp_init()).
+ */
+void
+tcp_syncookie_init(void)
+{
+#ifdef LWIP_RAND
+  u8_t key[TCP_SYNCOOKIE_KEY_LEN];
+  u8_t i;
+  for (i = 0; i < TCP_SYNCOOKIE_KEY_LEN; i += 4) {
+    u32_t r = LWIP_RAND();
+    MEMCPY(&key[i], &r, sizeof(r));
+  }
+  tcp_syncookie_set_key(key);
+#endif /* LWIP_RAND */
+}
+
+/**
+ * @ingroup tcp_raw
+ * Set the secret key used to generate and validate SYN cookies.
+ * Connections with a cookie handed out with the previous key cannot be
+ * completed.
+ *
+ * @param key TCP_SYNCOOKIE_KEY_LEN bytes of secret random data
+ */
+void
+tcp_syncookie_set_key(const u8_t *key)
+{
+  LWIP_ERROR("tcp_syncookie_set_key: invalid key", key != NULL, return);
+
+  MEMCPY(tcp_syncookie_key, key, TCP_SYNCOOKIE_KEY_LEN);
+}
+
+/**
+ * Check whether SYNs should currently be answered with a SYN cookie
+ * instead of allocating a pcb.
+ */
+u8_t
+tcp_syncookie_needed(void)
+{
+  return (tcp_syn_rcvd_pending >= TCP_SYNCOOKIE_SYN_THRESHOLD) ||
+         ((u32_t)tcp_pcbs_used + TCP_SYNCOOKIE_PCB_RESERVE > MEMP_NUM_TCP_PCB);
+}
+
+/** Hash of the connection, counter and MSS index (24 bit) */
+static u32_t
+tcp_syncookie_hash(const ip_addr_t *local_ip, const ip_addr_t *remote_ip,
+                   u16_t local_port, u16_t remote_port, u32_t peer_iss,
+                   u32_t counter, u8_t mss_idx)
+{
+  u8_t buf[2 * 16 + 2 * 2 + 2 * 4 + 1];
+  u16_t len = 0;
+
+#if LWIP_IPV6
+  if (IP_IS_V6(remote_ip)) {
+    MEMCPY(&buf[len], ip_2_ip6(local_ip)->addr, 16);
+    MEMCPY(&buf[len + 16], ip_2_ip6(remote_ip)->addr, 16);
+    len += 32;
+  }
+#endif /* LWIP_IPV6 */
+#if LWIP_IPV4 && LWIP_IPV6
+  else
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
+#if LWIP_IPV4
+  {
+    MEMCPY(&buf[len], &ip_2_ip4(local_ip)->addr, 4);
+    MEMCPY(&buf[len + 4], &ip_2_ip4(remote_ip)->addr, 4);
+    len += 8;
+  }
+#endif /* LWIP_IPV4 */
+  MEMCPY(&buf[len], &local_port, 2);
+  MEMCPY(&buf[len + 2], &remote_port, 2);
+  MEMCPY(&buf[len + 4], &peer_iss, 4);
+  MEMCPY(&buf[len + 8], &counter, 4);
+  buf[len + 12] = mss_idx;
+  len += 13;
+
+  return (u32_t)tcp_siphash(tcp_syncookie_key, buf, len) & TCP_SYNCOOKIE_HASH_MASK;
+}
+
+/**
+ * Generate the SYN cookie (our ISN) for a SYN received by a listening pcb.
+ *
+ * @param local_ip local IP address of the connection
+ * @param remote_ip remote IP address of the connection
+ * @param local_port local port of the connection
+ * @param remote_port remote port of the connection
+ * @param peer_iss the sequence number of the SYN
+ * @param opts the options of the SYN
+ * @return the ISN to use in the SYN-ACK
+ */
+u32_t
+tcp_syncookie_gen(const ip_addr_t *local_ip, const ip_addr_t *remote_ip,
+                  u16_t local_port, u16_t remote_port, u32_t peer_iss,
+                  const struct tcp_syn_opts *opts)
+{
+  u32_t counter = TCP_SYNCOOKIE_COUNTER();
+  u8_t mss_idx;
+
+  for (mss_idx = LWIP_ARRAYSIZE(tcp_syncookie_mss_tab) - 1; mss_idx > 0; mss_idx--) {
+    if (opts->mss >= tcp_syncookie_mss_tab[mss_idx]) {
+      break;
+    }
+  }
+  return ((counter & 0x1F) << 27) | ((u32_t)mss_idx << 24) |
+         tcp_syncookie_hash(local_ip, remote_ip, local_port, remote_port, peer_iss, counter, mss_idx);
+}
+
+/**
+ * Validate the SYN cookie returned in the ACK of a handshake and restore the
+ * options of the SYN.
+ *
+ * @param local_ip local IP address of the connection
+ * @param remote_ip remote IP address of the connection
+ * @param local_port local port of the connection
+ * @param remote_port remote port of the connection
+ * @param peer_iss the sequence number of the SYN (seqno of the ACK - 1)
+ * @param cookie the cookie (ackno of the ACK - 1)
+ * @param opts the options of the ACK, on success the MSS, window scale and
+ *        SACK permitted options of the SYN are restored
+ * @return 1 if the cookie is valid, 0 otherwise
+ */
+u8_t
+tcp_syncookie_check(const ip_addr_t *local_ip, const ip_addr_t *remote_ip,
+                    u16_t local_port, u16_t remote_port, u32_t peer_iss,
+                    u32_t cookie, struct tcp_syn_opts *opts)
+{
+  u32_t counter = TCP_SYNCOOKIE_COUNTER();
+  u32_t age = (counter - (cookie >> 27)) & 0x1F;
+  u8_t mss_idx = (u8_t)((cookie >> 24) & 0x07);
+
+  if (age > 1) {
+    /* expired */
+    return 0;
+  }
+  if (tcp_syncookie_hash(local_ip, remote_ip, local_port, remote_port, peer_iss,
+                         (counter - age) & TCP_SYNCOOKIE_COUNTER_MASK, mss_idx) !=
+      (cookie & TCP_SYNCOOKIE_HASH_MASK)) {
+    return 0;
+  }
+  opts->mss = LWIP_MIN(tcp_syncookie_mss_tab[mss_idx], TCP_MSS);
+  opts->snd_scale = TCP_SYN_OPTS_NO_WS;
+  opts->sack_perm = 0;
+#if LWIP_TCP_TIMESTAMPS
+  if (opts->ts) {
+    /* the peer echoes our timestamp value of the SYN-ACK */
+    u8_t ws = (u8_t)(opts->tsecr & TCP_SYNCOOKIE_TS_WS_MASK);
+    if (ws <= 14) {
+      opts->snd_scale = ws;
+    }
+    opts->sack_perm = (opts->tsecr & TCP_SYNCOOKIE_TS_SACK) != 0;
+#if LWIP_TCP_ECN
+    opts->ecn = (opts->tsecr & TCP_SYNCOOKIE_TS_ECN) != 0;
+#endif /* LWIP_TCP_ECN */
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+  return 1;
+}
+
+#if LWIP_TCP_TIMESTAMPS
+/**
+ * Timestamp value for a SYN-ACK carrying a SYN cookie: encodes the window
+ * scale and SACK permitted options (and ECN) of the SYN in the low bits.
+ *
+ * @param opts the options of the SYN
+ * @return the timestamp value (in host byte order)
+ */
+u32_t
+tcp_syncookie_tsval(const struct tcp_syn_opts *opts)
+{
+  u32_t now = sys_now();
+  u32_t tsval = now & ~TCP_SYNCOOKIE_TS_MASK;
+
+  tsval |= (opts->snd_scale != TCP_SYN_OPTS_NO_WS) ? opts->snd_scale : TCP_SYNCOOKIE_TS_WS_MASK;
+  if (opts->sack_perm) {
+    tsval |= TCP_SYNCOOKIE_TS_SACK;
+  }
+#if LWIP_TCP_ECN
+  if (opts->ecn) {
+    tsval |= TCP_SYNCOOKIE_TS_ECN;
+  }
+#endif /* LWIP_TCP_ECN */
+  if (TCP_SEQ_GT(tsval, now)) {
+    /* don't send a timestamp in the future: the next segments use sys_now() */
+    tsval -= TCP_SYNCOOKIE_TS_MASK + 1;
+  }
+  return tsval;
+}
+#endif /* LWIP_TCP_TIMESTAMPS */
+
+#endif /* LWIP_TCP && LWIP_TCP_SYNCOOKIES */
@@ -0,0 +1,263 @@
+/**
+ * @file
+ * Transmission Control Protocol, request entries for half-open connections
+ *
+ * A connection request to a listening pcb is kept in a struct tcp_syn_req
+ * (addresses, ports, sequence numbers and the options of the SYN) in a small
+ * hash table of the listener instead of a tcp_pcb on tcp_active_pcbs. The
+ * SYN-ACK is sent and retransmitted from the entry. When the final ACK of the
+ * handshake arrives, tcp_listen_input() allocates the connection pcb from the
+ * entry and frees the entry.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_SYN_REQ /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/memp.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+
+/** Initial SYN-ACK retransmission timeout in slow timer ticks (like a new
+ * pcb's rto), doubled for every retransmission */
+#define TCP_SYN_REQ_RTO   (3000 / TCP_SLOW_INTERVAL)
+
+/** number of request entries of all listeners */
+static u16_t tcp_syn_req_num;
+
+#if LWIP_TCP_PCB_TIMERS
+/** runs tcp_syn_req_tmr() while there are request entries */
+static struct sys_timeo tcp_syn_req_timer;
+
+static void
+tcp_syn_req_timeout(void *arg)
+{
+  LWIP_UNUSED_ARG(arg);
+  tcp_ticks_update();
+  tcp_syn_req_tmr();
+  if (tcp_syn_req_num != 0) {
+    sys_timeout_static(&tcp_syn_req_timer, TCP_SLOW_INTERVAL, tcp_syn_req_timeout, NULL);
+  }
+}
+#endif /* LWIP_TCP_PCB_TIMERS */
+
+/** Hash bucket of a request entry */
+static u8_t
+tcp_syn_req_idx(const ip_addr_t *remote_ip, u16_t remote_port)
+{
+  u32_t h = remote_port;
+#if LWIP_IPV6
+  if (IP_IS_V6(remote_ip)) {
+    const ip6_addr_t *addr6 = ip_2_ip6(remote_ip);
+    h ^= addr6->addr[0] ^ addr6->addr[1] ^ addr6->addr[2] ^ addr6->addr[3];
+  } else
+#endif /* LWIP_IPV6 */
+  {
+#if LWIP_IPV4
+    h ^= ip4_addr_get_u32(ip_2_ip4(remote_ip));
+#endif /* LWIP_IPV4 */
+  }
+  h ^= h >> 16;
+  h *= 0x45d9f3bUL;
+  h ^= h >> 16;
+  return (u8_t)(h % TCP_SYN_REQ_HASH_SIZE);
+}
+
+/**
+ * Look up the request entry of a listener for a connection.
+ *
+ * @param lpcb the listening pcb
+ * @param local_ip local IP address of the connection
+ * @param remote_ip remote IP address of the connection
+ * @param remote_port remote TCP port of the connection
+ * @return the request entry or NULL if there is none
+ */
+struct tcp_syn_req *
+tcp_syn_req_find(struct tcp_pcb_listen *lpcb, const ip_addr_t *local_ip,
+                 const ip_addr_t *remote_ip, u16_t remote_port)
+{
+  struct tcp_syn_req *req;
+
+  for (req = lpcb->syn_reqs[tcp_syn_req_idx(remote_ip, remote_port)]; req != NULL; req = req->next) {
+    if ((req->remote_port == remote_port) &&
+        ip_addr_cmp(&req->remote_ip, remote_ip) &&
+        ip_addr_cmp(&req->local_ip, local_ip)) {
+      return req;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Create a request entry for a SYN received by a listener. The caller sends
+ * the SYN-ACK (tcp_syn_req_synack()).
+ *
+ * @param lpcb the listening pcb which received the SYN
+ * @param local_ip local IP address of the connection
+ * @param remote_ip remote IP address of the connection
+ * @param remote_port remote TCP port of the connection
+ * @param rcv_nxt sequence number of the SYN + 1
+ * @param opts the options of the SYN
+ * @return the new entry or NULL if MEMP_NUM_TCP_SYN_REQ are in use
+ */
+struct tcp_syn_req *
+tcp_syn_req_new(struct tcp_pcb_listen *lpcb, const ip_addr_t *local_ip,
+                const ip_addr_t *remote_ip, u16_t remote_port,
+                u32_t rcv_nxt, const struct tcp_syn_opts *opts)
+{
+  u8_t idx;
+  struct tcp_syn_req *req = (struct tcp_syn_req *)memp_malloc(MEMP_TCP_SYN_REQ);
+  if (req == NULL) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_syn_req_new: out of request entries\n"));
+    return NULL;
+  }
+  ip_addr_copy(req->local_ip, *local_ip);
+  ip_addr_copy(req->remote_ip, *remote_ip);
+  req->remote_port = remote_port;
+  req->nrtx = 0;
+  req->iss = tcp_next_iss_addr(local_ip, lpcb->local_port, remote_ip, remote_port);
+  req->rcv_nxt = rcv_nxt;
+  req->tmr = tcp_ticks;
+  req->rtime = tcp_ticks + TCP_SYN_REQ_RTO;
+  req->opts = *opts;
+
+  idx = tcp_syn_req_idx(remote_ip, remote_port);
+  req->next = lpcb->syn_reqs[idx];
+  lpcb->syn_reqs[idx] = req;
+  tcp_syn_req_num++;
+#if LWIP_TCP_SYNCOOKIES
+  tcp_syn_rcvd_pending++;
+#endif /* LWIP_TCP_SYNCOOKIES */
+#if LWIP_TCP_PCB_TIMERS
+  if (!sys_timeout_static_pending(&tcp_syn_req_timer)) {
+    sys_timeout_static(&tcp_syn_req_timer, TCP_SLOW_INTERVAL, tcp_syn_req_timeout, NULL);
+  }
+#endif /* LWIP_TCP_PCB_TIMERS */
+  return req;
+}
+
+/**
+ * Remove a request entry from its listener and free it.
+ *
+ * @param lpcb the listening pcb of the entry
+ * @param req the entry to free
+ */
+void
+tcp_syn_req_free(struct tcp_pcb_listen *lpcb, struct tcp_syn_req *req)
+{
+  struct tcp_syn_req **pp = &lpcb->syn_reqs[tcp_syn_req_idx(&req->remote_ip, req->remote_port)];
+
+  while (*pp != req) {
+    LWIP_ASSERT("tcp_syn_req_free: entry not found", *pp != NULL);
+    pp = &(*pp)->next;
+  }
+  *pp = req->next;
+  memp_free(MEMP_TCP_SYN_REQ, req);
+
+  LWIP_ASSERT("tcp_syn_req_num != 0", tcp_syn_req_num != 0);
+  tcp_syn_req_num--;
+#if LWIP_TCP_SYNCOOKIES
+  LWIP_ASSERT("tcp_syn_rcvd_pending != 0", tcp_syn_rcvd_pending != 0);
+  tcp_syn_rcvd_pending--;
+#endif /* LWIP_TCP_SYNCOOKIES */
+#if LWIP_TCP_PCB_TIMERS
+  if (tcp_syn_req_num == 0) {
+    sys_untimeout_static(&tcp_syn_req_timer);
+  }
+#endif /* LWIP_TCP_PCB_TIMERS */
+}
+
+/**
+ * Free all request entries of a listener (called when it is closed).
+ *
+ * @param lpcb the listening pcb
+ */
+void
+tcp_syn_req_free_all(struct tcp_pcb_listen *lpcb)
+{
+  u8_t i;
+
+  for (i = 0; i < TCP_SYN_REQ_HASH_SIZE; i++) {
+    while (lpcb->syn_reqs[i] != NULL) {
+      tcp_syn_req_free(lpcb, lpcb->syn_reqs[i]);
+    }
+  }
+}
+
+/**
+ * Send (or retransmit) the SYN-ACK of a request entry.
+ *
+ * @param lpcb the listening pcb of the entry
+ * @param req the entry
+ */
+void
+tcp_syn_req_synack(const struct tcp_pcb_listen *lpcb, const struct tcp_syn_req *req)
+{
+  tcp_synack(lpcb, req->iss, req->rcv_nxt, &req->local_ip, &req->remote_ip,
+             req->remote_port, &req->opts, sys_now());
+}
+
+/**
+ * Retransmit SYN-ACKs and remove request entries whose handshake did not
+ * complete within TCP_SYN_RCVD_TIMEOUT (like a pcb in SYN_RCVD).
+ *
+ * Called from tcp_slowtmr() (or its own timeout with LWIP_TCP_PCB_TIMERS).
+ */
+void
+tcp_syn_req_tmr(void)
+{
+  struct tcp_pcb_listen *lpcb;
+  struct tcp_syn_req *req, *next;
+  u8_t i;
+
+  if (tcp_syn_req_num == 0) {
+    return;
+  }
+  for (lpcb = tcp_listen_pcbs.listen_pcbs; lpcb != NULL; lpcb = lpcb->next) {
+    for (i = 0; i < TCP_SYN_REQ_HASH_SIZE; i++) {
+      for (req = lpcb->syn_reqs[i]; req != NULL; req = next) {
+        next = req->next;
+        if ((req->nrtx >= TCP_SYNMAXRTX) ||
+            ((u32_t)(tcp_ticks - req->tmr) > TCP_SYN_RCVD_TIMEOUT / TCP_SLOW_INTERVAL)) {
+          LWIP_DEBUGF(TCP_DEBUG, ("tcp_syn_req_tmr: removing half-open connection from port %"U16_F"\n",
+                                  req->remote_port));
+          tcp_syn_req_free(lpcb, req);
+        } else if ((s32_t)(tcp_ticks - req->rtime) >= 0) {
+          req->nrtx++;
+          req->rtime = tcp_ticks + ((u32_t)TCP_SYN_REQ_RTO << req->nrtx);
+          tcp_syn_req_synack(lpcb, req);
+        }
+      }
+    }
+  }
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_SYN_REQ */
@@ -0,0 +1,324 @@
+/**
+ * @file
+ * Transmission Control Protocol, compact records for connections in TIME_WAIT
+ *
+ * Once a connection is in TIME_WAIT and the application has closed it, all
+ * that is left to do is to acknowledge retransmitted FINs and to keep the
+ * 4-tuple from being reused for 2*TCP_MSL. tcp_tw_compact() copies what is
+ * needed for that into a struct tcp_pcb_tw, appends it to tcp_tw_records and
+ * frees the pcb. tcp_input() finds records with tcp_tw_lookup() and answers
+ * segments from them (tcp_tw_ack()).
+ *
+ * All records live for the same 2*TCP_MSL, so tcp_tw_records is kept in the
+ * order they expire in: new and restarted records are appended, and expiring
+ * records are only ever taken from the head.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_TW_COMPACT /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/memp.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+
+#include <string.h>
+
+/** TIME_WAIT lifetime of a record in tcp_ticks */
+#define TCP_TW_TICKS (2 * TCP_MSL / TCP_SLOW_INTERVAL + 1)
+
+/** List of all records, in the order they expire */
+struct tcp_pcb_tw *tcp_tw_records;
+/** last record on tcp_tw_records (the one to expire last) */
+static struct tcp_pcb_tw *tcp_tw_records_tail;
+
+#if LWIP_TCP_PCB_HASH
+/** Hash table of all records on tcp_tw_records (by 4-tuple) */
+static struct tcp_pcb_tw *tcp_tw_hash[TCP_PCB_HASH_SIZE];
+#endif /* LWIP_TCP_PCB_HASH */
+
+#if LWIP_TCP_PCB_TIMERS
+/** removes expired records, armed for the head of tcp_tw_records */
+static struct sys_timeo tcp_tw_timer;
+
+static void tcp_tw_timeout(void *arg);
+
+/** Arm tcp_tw_timer for the record which expires first */
+static void
+tcp_tw_timer_update(void)
+{
+  u32_t ticks;
+
+  if (tcp_tw_records == NULL) {
+    sys_untimeout_static(&tcp_tw_timer);
+    return;
+  }
+  tcp_ticks_update();
+  ticks = tcp_tw_records->expires - tcp_ticks;
+  if ((s32_t)ticks < 1) {
+    ticks = 1;
+  }
+  sys_timeout_static(&tcp_tw_timer, ticks * TCP_SLOW_INTERVAL, tcp_tw_timeout, NULL);
+}
+#endif /* LWIP_TCP_PCB_TIMERS */
+
+/** Append a record to tcp_tw_records, keeping the list in expiry order */
+static void
+tcp_tw_append(struct tcp_pcb_tw *tw)
+{
+  tw->next = NULL;
+  if (tcp_tw_records_tail == NULL) {
+    tcp_tw_records = tw;
+  } else {
+    /* A connection may have entered TIME_WAIT before the application closed
+       it, so it can be older than the tail: keep it a little longer rather
+       than searching for its place. */
+    if ((s32_t)(tw->expires - tcp_tw_records_tail->expires) < 0) {
+      tw->expires = tcp_tw_records_tail->expires;
+    }
+    tcp_tw_records_tail->next = tw;
+  }
+  tcp_tw_records_tail = tw;
+}
+
+/** Remove a record from tcp_tw_records (O(1) for the head) */
+static void
+tcp_tw_unlink(struct tcp_pcb_tw *tw)
+{
+  struct tcp_pcb_tw *prev = NULL;
+
+  if (tcp_tw_records != tw) {
+    for (prev = tcp_tw_records; prev->next != tw; prev = prev->next) {
+      LWIP_ASSERT("tcp_tw_unlink: record on tcp_tw_records", prev->next != NULL);
+    }
+    prev->next = tw->next;
+  } else {
+    tcp_tw_records = tw->next;
+  }
+  if (tcp_tw_records_tail == tw) {
+    tcp_tw_records_tail = prev;
+  }
+  tw->next = NULL;
+}
+
+/** Remove a record from tcp_tw_records and the hash table and free it */
+static void
+tcp_tw_free(struct tcp_pcb_tw *tw)
+{
+#if LWIP_TCP_PCB_HASH
+  struct tcp_pcb_tw **pp = &tcp_tw_hash[tcp_pcb_hash_idx(&tw->local_ip, tw->local_port,
+                                                         &tw->remote_ip, tw->remote_port)];
+  for (; *pp != NULL; pp = &(*pp)->hash_next) {
+    if (*pp == tw) {
+      *pp = tw->hash_next;
+      break;
+    }
+  }
+#endif /* LWIP_TCP_PCB_HASH */
+  tcp_tw_unlink(tw);
+  memp_free(MEMP_TCP_PCB_TW, tw);
+#if LWIP_TCP_PCB_TIMERS
+  if (tcp_tw_records == NULL) {
+    sys_untimeout_static(&tcp_tw_timer);
+  }
+#endif /* LWIP_TCP_PCB_TIMERS */
+}
+
+/** Free all records at the head of tcp_tw_records which have expired */
+static void
+tcp_tw_expire(void)
+{
+  while ((tcp_tw_records != NULL) && ((s32_t)(tcp_ticks - tcp_tw_records->expires) >= 0)) {
+    tcp_tw_free(tcp_tw_records);
+  }
+}
+
+#if LWIP_TCP_PCB_TIMERS
+static void
+tcp_tw_timeout(void *arg)
+{
+  LWIP_UNUSED_ARG(arg);
+
+  tcp_ticks_update();
+  tcp_tw_expire();
+  tcp_tw_timer_update();
+}
+#else /* LWIP_TCP_PCB_TIMERS */
+/**
+ * Free expired records. Called from tcp_slowtmr().
+ */
+void
+tcp_tw_tmr(void)
+{
+  tcp_tw_expire();
+}
+#endif /* LWIP_TCP_PCB_TIMERS */
+
+/**
+ * Replace a pcb in TIME_WAIT which is not referenced by the application any
+ * more by a compact record. If no record can be allocated (MEMP_NUM_TCP_PCB_TW
+ * is 0), the pcb stays on tcp_tw_pcbs. If all records are in use, the oldest
+ * one is dropped.
+ *
+ * @param pcb the tcp_pcb in TIME_WAIT, freed on success
+ */
+void
+tcp_tw_compact(struct tcp_pcb *pcb)
+{
+  struct tcp_pcb_tw *tw;
+#if LWIP_TCP_PCB_HASH
+  u32_t idx;
+#endif /* LWIP_TCP_PCB_HASH */
+
+  LWIP_ASSERT("tcp_tw_compact: pcb->state == TIME_WAIT", pcb->state == TIME_WAIT);
+  LWIP_ASSERT("tcp_tw_compact: no segments left", (pcb->unsent == NULL) && (pcb->unacked == NULL));
+
+  tw = (struct tcp_pcb_tw *)memp_malloc(MEMP_TCP_PCB_TW);
+  if ((tw == NULL) && (tcp_tw_records != NULL)) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_tw_compact: dropping oldest TIME_WAIT record %p\n",
+                            (void *)tcp_tw_records));
+    tcp_tw_free(tcp_tw_records);
+    tw = (struct tcp_pcb_tw *)memp_malloc(MEMP_TCP_PCB_TW);
+  }
+  if (tw == NULL) {
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_tw_compact: out of records, keeping the pcb\n"));
+    return;
+  }
+  if (pcb->refused_data != NULL) {
+    pbuf_free(pcb->refused_data);
+    pcb->refused_data = NULL;
+  }
+  memset(tw, 0, sizeof(struct tcp_pcb_tw));
+  ip_addr_copy(tw->local_ip, pcb->local_ip);
+  ip_addr_copy(tw->remote_ip, pcb->remote_ip);
+  tw->local_port = pcb->local_port;
+  tw->remote_port = pcb->remote_port;
+  tw->snd_nxt = pcb->snd_nxt;
+  tw->rcv_nxt = pcb->rcv_nxt;
+  tw->expires = pcb->tmr + TCP_TW_TICKS;
+  tw->rcv_wnd = pcb->rcv_wnd;
+  tw->wnd = TCPWND_MIN16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd));
+  tw->netif_idx = pcb->netif_idx;
+  tw->tos = pcb->tos;
+  tw->ttl = pcb->ttl;
+#if LWIP_TCP_TIMESTAMPS
+  tw->ts = (u8_t)((pcb->flags & TF_TIMESTAMP) != 0);
+  tw->ts_recent = pcb->ts_recent;
+#endif /* LWIP_TCP_TIMESTAMPS */
+
+  tcp_pcb_remove(&tcp_tw_pcbs, pcb);
+  tcp_free(pcb);
+
+  tcp_tw_append(tw);
+#if LWIP_TCP_PCB_HASH
+  idx = tcp_pcb_hash_idx(&tw->local_ip, tw->local_port, &tw->remote_ip, tw->remote_port);
+  tw->hash_next = tcp_tw_hash[idx];
+  tcp_tw_hash[idx] = tw;
+#endif /* LWIP_TCP_PCB_HASH */
+#if LWIP_TCP_PCB_TIMERS
+  if (tcp_tw_records == tw) {
+    tcp_tw_timer_update();
+  }
+#else /* LWIP_TCP_PCB_TIMERS */
+  tcp_timer_needed();
+#endif /* LWIP_TCP_PCB_TIMERS */
+}
+
+/**
+ * Restart the 2*TCP_MSL timeout of a record (a FIN was retransmitted): the
+ * record now expires last and is moved to the tail of tcp_tw_records.
+ *
+ * @param tw the record to restart
+ */
+void
+tcp_tw_restart(struct tcp_pcb_tw *tw)
+{
+  tw->expires = tcp_ticks + TCP_TW_TICKS;
+  if (tcp_tw_records_tail != tw) {
+    tcp_tw_unlink(tw);
+    tcp_tw_append(tw);
+#if LWIP_TCP_PCB_TIMERS
+    tcp_tw_timer_update();
+#endif /* LWIP_TCP_PCB_TIMERS */
+  }
+}
+
+/**
+ * Find the record an incoming segment belongs to.
+ *
+ * @param local_ip destination address of the segment
+ * @param local_port destination port of the segment
+ * @param remote_ip source address of the segment
+ * @param remote_port source port of the segment
+ * @param inp netif the segment was received on (NULL to match any netif)
+ * @return the matching record or NULL if there is none
+ */
+struct tcp_pcb_tw *
+tcp_tw_lookup(const ip_addr_t *local_ip, u16_t local_port,
+              const ip_addr_t *remote_ip, u16_t remote_port,
+              const struct netif *inp)
+{
+  struct tcp_pcb_tw *tw;
+
+#if LWIP_TCP_PCB_HASH
+  for (tw = tcp_tw_hash[tcp_pcb_hash_idx(local_ip, local_port, remote_ip, remote_port)];
+       tw != NULL; tw = tw->hash_next)
+#else /* LWIP_TCP_PCB_HASH */
+  for (tw = tcp_tw_records; tw != NULL; tw = tw->next)
+#endif /* LWIP_TCP_PCB_HASH */
+  {
+    /* check if the connection was bound to a specific netif */
+    if ((inp != NULL) && (tw->netif_idx != NETIF_NO_INDEX) &&
+        (tw->netif_idx != netif_get_index(inp))) {
+      continue;
+    }
+    if ((tw->remote_port == remote_port) &&
+        (tw->local_port == local_port) &&
+        ip_addr_cmp(&tw->remote_ip, remote_ip) &&
+        ip_addr_cmp(&tw->local_ip, local_ip)) {
+      return tw;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Free all records (e.g. to release all TCP memory).
+ */
+void
+tcp_tw_free_all(void)
+{
+  while (tcp_tw_records != NULL) {
+    tcp_tw_free(tcp_tw_records);
+  }
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_TW_COMPACT */
@@ -0,0 +1,178 @@
+/**
+ * @file
+ * Transmission Control Protocol, completion of zero-copy writes
+ *
+ * With LWIP_TCP_ZEROCOPY, tcp_write_ref() queues data like tcp_write() without
+ * TCP_WRITE_FLAG_COPY, but references it with custom pbufs (struct
+ * tcp_zc_pbuf) that count their buffer's references (struct tcp_zc). When the
+ * last of them is freed - normally when the data is acknowledged and its
+ * segments are freed, but a netif may hold on to a pbuf a bit longer - the
+ * buffer is complete. Complete buffers are reported to the application in the
+ * order they were written, after the sent callback of the ACK that freed them
+ * (a buffer whose last pbuf is freed later by a netif is reported by the next
+ * run of the fast timer, not from within pbuf_free()).
+ *
+ * Buffers that are still referenced when their pcb is freed are reported to
+ * the pcb's last callback (with tpcb == NULL) as soon as their last pbuf is
+ * freed.
+ */
+
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP && LWIP_TCP_ZEROCOPY /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/memp.h"
+
+/** Report a complete buffer and free it */
+static err_t
+tcp_zc_done_report(struct tcp_zc *zc, struct tcp_pcb *pcb, tcp_zc_done_fn done, void *arg)
+{
+  err_t err = ERR_OK;
+  void *cookie = zc->cookie;
+  u16_t len = zc->len;
+
+  memp_free(MEMP_TCP_ZC, zc);
+  LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_zc: buffer %p (%"U16_F" bytes) complete\n", cookie, len));
+  if (done != NULL) {
+    err = done(arg, pcb, cookie, len);
+  }
+  return err;
+}
+
+/** custom_free_function of struct tcp_zc_pbuf */
+static void
+tcp_zc_pbuf_free(struct pbuf *p)
+{
+  struct tcp_zc *zc = ((struct tcp_zc_pbuf *)p)->zc;
+
+  memp_free(MEMP_TCP_ZC_PBUF, p);
+  LWIP_ASSERT("tcp_zc_pbuf_free: refs > 0", zc->refs > 0);
+  zc->refs--;
+  if (zc->refs == 0) {
+    if (zc->pcb == NULL) {
+      /* the pcb is gone, nobody else will report this buffer */
+      tcp_zc_done_report(zc, NULL, zc->done, zc->arg);
+    } else {
+      /* freed after the ACK (e.g. by a netif): callbacks must not run from
+         within pbuf_free(), so leave it to the fast timer (tcp_input() reports
+         it right away if this is the ACK processing) */
+      zc->pcb->zc_pending = 1;
+#if LWIP_TCP_PCB_TIMERS
+      tcp_timer_update(zc->pcb);
+#endif /* LWIP_TCP_PCB_TIMERS */
+    }
+  }
+}
+
+/**
+ * Allocate a pbuf referencing 'len' bytes of a buffer written with
+ * tcp_write_ref(). The pbuf is of type PBUF_REF so that it isn't extended by
+ * tcp_write() and is copied by anything that queues it (see PBUF_NEEDS_COPY).
+ */
+struct pbuf *
+tcp_zc_pbuf_alloc(struct tcp_zc *zc, const void *payload, u16_t len)
+{
+  struct tcp_zc_pbuf *zp;
+  struct pbuf *p;
+
+  zp = (struct tcp_zc_pbuf *)memp_malloc(MEMP_TCP_ZC_PBUF);
+  if (zp == NULL) {
+    return NULL;
+  }
+  p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &zp->pc, LWIP_CONST_CAST(void *, payload), len);
+  LWIP_ASSERT("tcp_zc_pbuf_alloc: pbuf_alloced_custom", p != NULL);
+  zp->pc.custom_free_function = tcp_zc_pbuf_free;
+  zp->zc = zc;
+  zc->refs++;
+  return p;
+}
+
+/**
+ * Report the buffers of a pcb that are complete, in the order they were
+ * written (a complete buffer waits for the ones written before it).
+ *
+ * @return ERR_ABRT if a callback aborted the pcb, ERR_OK otherwise
+ */
+err_t
+tcp_zc_report(struct tcp_pcb *pcb)
+{
+  pcb->zc_pending = 0;
+  while ((pcb->zc != NULL) && (pcb->zc->refs == 0)) {
+    struct tcp_zc *zc = pcb->zc;
+    pcb->zc = zc->next;
+    if (tcp_zc_done_report(zc, pcb, pcb->zc_done, pcb->callback_arg) == ERR_ABRT) {
+      return ERR_ABRT;
+    }
+  }
+  return ERR_OK;
+}
+
+/**
+ * Called when a pcb is freed: report its complete buffers and leave the
+ * others to be reported by tcp_zc_pbuf_free(), both with tpcb == NULL.
+ */
+void
+tcp_zc_free(struct tcp_pcb *pcb)
+{
+  struct tcp_zc *zc;
+
+  while (pcb->zc != NULL) {
+    zc = pcb->zc;
+    pcb->zc = zc->next;
+    if (zc->refs == 0) {
+      tcp_zc_done_report(zc, NULL, pcb->zc_done, pcb->callback_arg);
+    } else {
+      zc->pcb = NULL;
+      zc->done = pcb->zc_done;
+      zc->arg = pcb->callback_arg;
+    }
+  }
+}
+
+/**
+ * @ingroup tcp_raw
+ * Used to specify the function that should be called when the stack is done
+ * with a buffer written with tcp_write_ref().
+ *
+ * @param pcb tcp_pcb to set the callback
+ * @param zc_done callback function to call for each buffer
+ */
+void
+tcp_zc_done(struct tcp_pcb *pcb, tcp_zc_done_fn zc_done)
+{
+  if (pcb != NULL) {
+    LWIP_ASSERT("invalid socket state for zc_done callback", pcb->state != LISTEN);
+    pcb->zc_done = zc_done;
+  }
+}
+
+#endif /* LWIP_TCP && LWIP_TCP_ZEROCOPY */
@@ -109,11 +109,19 @@ const int lwip_num_cyclic_timers = LWIP_ARRAYSIZE(lwip_cyclic_timers);
 
 #if LWIP_TIMERS && !LWIP_TIMERS_CUSTOM
 
+#if !LWIP_TIMERS_WHEEL
 /** The one and only timeout list */
 static struct sys_timeo *next_timeout;
 static u32_t timeouts_last_time;
+#endif /* !LWIP_TIMERS_WHEEL */
 
-#if LWIP_TCP
+#if LWIP_TCP && LWIP_TCP_PCB_TIMERS
+/** Per-pcb TCP timers are used, the TCP timer is not needed */
+void
+tcp_timer_needed(void)
+{
+}
+#elif LWIP_TCP
 /** global variable that shows if the tcp timer is currently scheduled or not */
 static int tcpip_tcp_timer_active;
 
@@ -130,7 +138,7 @@ tcpip_tcp_timer(void *arg)
   /* call TCP timer handler */
   tcp_tmr();
   /* timer still needed? */
-  if (tcp_active_pcbs || tcp_tw_pcbs) {
+  if (tcp_active_pcbs || tcp_tw_pcbs || TCP_TW_RECORDS_PENDING()) {
     /* restart timer */
     sys_timeout(TCP_TMR_INTERVAL, tcpip_tcp_timer, NULL);
   } else {
@@ -142,13 +150,13 @@ tcpip_tcp_timer(void *arg)
 /**
  * Called from TCP_REG when registering a new PCB:
  * the reason is to have the TCP timer only running when
- * there are active (or time-wait) PCBs.
+ * there are active (or time-wait) PCBs or compact time-wait records.
  */
 void
 tcp_timer_needed(void)
 {
   /* timer is off but needed again? */
-  if (!tcpip_tcp_timer_active && (tcp_active_pcbs || tcp_tw_pcbs)) {
+  if (!tcpip_tcp_timer_active && (tcp_active_pcbs || tcp_tw_pcbs || TCP_TW_RECORDS_PENDING())) {
     /* enable and start timer */
     tcpip_tcp_timer_active = 1;
     sys_timeout(TCP_TMR_INTERVAL, tcpip_tcp_timer, NULL);
@@ -159,17 +167,20 @@ tcp_timer_needed(void)
 /**
  * Timer callback function that calls cyclic->handler() and reschedules itself.
  *
- * @param arg unused argument
+ * @param arg the struct lwip_cyclic_timer to call
  */
-static void
-cyclic_timer(void *arg)
+#if !LWIP_TESTMODE
+static
+#endif
+void
+lwip_cyclic_timer(void *arg)
 {
   const struct lwip_cyclic_timer* cyclic = (const struct lwip_cyclic_timer*)arg;
 #if LWIP_DEBUG_TIMERNAMES
   LWIP_DEBUGF(TIMERS_DEBUG, ("tcpip: %s()\n", cyclic->handler_name));
 #endif
   cyclic->handler();
-  sys_timeout(cyclic->interval_ms, cyclic_timer, arg);
+  sys_timeout(cyclic->interval_ms, lwip_cyclic_timer, arg);
 }
 
 /** Initialize this module */
@@ -179,14 +190,403 @@ void sys_timeouts_init(void)
   /* tcp_tmr() at index 0 is started on demand */
   for (i = (LWIP_TCP ? 1 : 0); i < LWIP_ARRAYSIZE(lwip_cyclic_timers); i++) {
     /* we have to cast via size_t to get rid of const warning
-      (this is OK as cyclic_timer() casts back to const* */
-    sys_timeout(lwip_cyclic_timers[i].interval_ms, cyclic_timer, LWIP_CONST_CAST(void*, &lwip_cyclic_timers[i]));
+      (this is OK as lwip_cyclic_timer() casts back to const* */
+    sys_timeout(lwip_cyclic_timers[i].interval_ms, lwip_cyclic_timer, LWIP_CONST_CAST(void*, &lwip_cyclic_timers[i]));
   }
 
+#if !LWIP_TIMERS_WHEEL
   /* Initialise timestamp for sys_check_timeouts */
   timeouts_last_time = sys_now();
+#endif /* !LWIP_TIMERS_WHEEL */
+}
+
+#if LWIP_TIMERS_WHEEL
+
+/* The wheel has SYS_TIMEO_WHEEL_LEVELS levels of SYS_TIMEO_WHEEL_SLOTS slots.
+ * Level 0 slots are 1 ms wide, each higher level's slots are
+ * SYS_TIMEO_WHEEL_SLOTS times wider than those of the level below, so the
+ * wheel covers the whole 32 bit range of sys_now(). A timeout is stored at the
+ * lowest level that can hold its expiry time relative to the wheel clock and
+ * is moved down ("cascaded") when the wheel clock reaches its slot. */
+#define SYS_TIMEO_WHEEL_BITS     4
+#define SYS_TIMEO_WHEEL_SLOTS    (1 << SYS_TIMEO_WHEEL_BITS)
+#define SYS_TIMEO_WHEEL_LEVELS   (32 / SYS_TIMEO_WHEEL_BITS)
+#define SYS_TIMEO_WHEEL_SHIFT(level) ((level) * SYS_TIMEO_WHEEL_BITS)
+#define SYS_TIMEO_WHEEL_MASK(level)  (((u32_t)1 << SYS_TIMEO_WHEEL_SHIFT(level)) - 1)
+#define SYS_TIMEO_WHEEL_IDX(time, level) \
+  (((time) >> SYS_TIMEO_WHEEL_SHIFT(level)) & (SYS_TIMEO_WHEEL_SLOTS - 1))
+
+/** The timer wheel */
+static struct sys_timeo *timeo_wheel[SYS_TIMEO_WHEEL_LEVELS][SYS_TIMEO_WHEEL_SLOTS];
+/** Timeouts allocated by sys_timeout(), hashed by (handler, arg) */
+static struct sys_timeo *timeo_hash[LWIP_TIMERS_WHEEL_HASH_SIZE];
+/** Wheel clock: time of the last wheel event processed */
+static u32_t timeo_wheel_time;
+/** Difference between sys_now() and the wheel clock (see sys_restart_timeouts()) */
+static u32_t timeo_wheel_offset;
+/** Number of timeouts in the wheel */
+static u32_t timeo_wheel_count;
+
+#define timeo_wheel_now() (sys_now() - timeo_wheel_offset)
+
+static u32_t
+sys_timeo_hash_idx(sys_timeout_handler handler, void *arg)
+{
+  u32_t h = (u32_t)(mem_ptr_t)handler ^ ((u32_t)(mem_ptr_t)arg * 0x9e3779b1UL);
+  h ^= h >> 16;
+  return h % LWIP_TIMERS_WHEEL_HASH_SIZE;
+}
+
+/** Link a timeout into the wheel slot matching its expiry time */
+static void
+sys_timeo_wheel_insert(struct sys_timeo *t)
+{
+  struct sys_timeo **slot;
+  u32_t delta = t->time - timeo_wheel_time;
+  int level = 0;
+
+  while ((level < SYS_TIMEO_WHEEL_LEVELS - 1) &&
+         (delta >= ((u32_t)SYS_TIMEO_WHEEL_SLOTS << SYS_TIMEO_WHEEL_SHIFT(level)))) {
+    level++;
+  }
+  slot = &timeo_wheel[level][SYS_TIMEO_WHEEL_IDX(t->time, level)];
+  t->next = *slot;
+  if (t->next != NULL) {
+    t->next->pprev = &t->next;
+  }
+  t->pprev = slot;
+  *slot = t;
+}
+
+/** Unlink a timeout from its wheel slot */
+static void
+sys_timeo_wheel_remove(struct sys_timeo *t)
+{
+  *t->pprev = t->next;
+  if (t->next != NULL) {
+    t->next->pprev = t->pprev;
+  }
+  t->pprev = NULL;
+}
+
+/** Unlink a timeout allocated by sys_timeout() from the (handler, arg) hash */
+static void
+sys_timeo_hash_remove(struct sys_timeo *t)
+{
+  *t->hash_pprev = t->hash_next;
+  if (t->hash_next != NULL) {
+    t->hash_next->hash_pprev = t->hash_pprev;
+  }
+  t->hash_pprev = NULL;
+}
+
+/**
+ * Return the number of ms from the wheel clock to the next wheel event, which
+ * is either an expiring timeout or a slot that has to be cascaded. This is
+ * a lower bound for the time left until the next timeout expires.
+ * Must only be called if the wheel is not empty.
+ */
+static u32_t
+sys_timeo_wheel_next(void)
+{
+  u32_t next = 0xffffffff;
+  int level;
+
+  for (level = 0; level < SYS_TIMEO_WHEEL_LEVELS; level++) {
+    u32_t idx = SYS_TIMEO_WHEEL_IDX(timeo_wheel_time, level);
+    u32_t i;
+    /* level 0 slot 'idx' expires now; higher level slots at 'idx' have already
+       been cascaded, so the next event there is one full round ahead */
+    for (i = (level == 0) ? 0 : 1; i <= ((level == 0) ? (SYS_TIMEO_WHEEL_SLOTS - 1) : SYS_TIMEO_WHEEL_SLOTS); i++) {
+      if (timeo_wheel[level][(idx + i) & (SYS_TIMEO_WHEEL_SLOTS - 1)] != NULL) {
+        /* unsigned arithmetic: wraps for the topmost level as it should */
+        u32_t delta = (i << SYS_TIMEO_WHEEL_SHIFT(level)) - (timeo_wheel_time & SYS_TIMEO_WHEEL_MASK(level));
+        if (delta < next) {
+          next = delta;
+        }
+        break;
+      }
+    }
+  }
+  return next;
+}
+
+/** Arm a timeout (already filled in except for 'time') */
+static void
+sys_timeo_wheel_add(struct sys_timeo *t, u32_t msecs)
+{
+  u32_t now = timeo_wheel_now();
+  if (timeo_wheel_count == 0) {
+    /* nothing pending: the wheel clock may jump */
+    timeo_wheel_time = now;
+  }
+  t->time = now + msecs;
+  sys_timeo_wheel_insert(t);
+  timeo_wheel_count++;
+}
+
+/**
+ * Create a one-shot timer (aka timeout). Timeouts are processed in the
+ * following cases:
+ * - while waiting for a message using sys_timeouts_mbox_fetch()
+ * - by calling sys_check_timeouts() (NO_SYS==1 only)
+ *
+ * @param msecs time in milliseconds after that the timer should expire
+ * @param handler callback function to call when msecs have elapsed
+ * @param arg argument to pass to the callback function
+ */
+#if LWIP_DEBUG_TIMERNAMES
+void
+sys_timeout_debug(u32_t msecs, sys_timeout_handler handler, void *arg, const char* handler_name)
+#else /* LWIP_DEBUG_TIMERNAMES */
+void
+sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg)
+#endif /* LWIP_DEBUG_TIMERNAMES */
+{
+  struct sys_timeo *timeout, **bucket;
+
+  timeout = (struct sys_timeo *)memp_malloc(MEMP_SYS_TIMEOUT);
+  if (timeout == NULL) {
+    LWIP_ASSERT("sys_timeout: timeout != NULL, pool MEMP_SYS_TIMEOUT is empty", timeout != NULL);
+    return;
+  }
+
+  timeout->h = handler;
+  timeout->arg = arg;
+#if LWIP_DEBUG_TIMERNAMES
+  timeout->handler_name = handler_name;
+  LWIP_DEBUGF(TIMERS_DEBUG, ("sys_timeout: %p msecs=%"U32_F" handler=%s arg=%p\n",
+    (void *)timeout, msecs, handler_name, (void *)arg));
+#endif /* LWIP_DEBUG_TIMERNAMES */
+
+  bucket = &timeo_hash[sys_timeo_hash_idx(handler, arg)];
+  timeout->hash_next = *bucket;
+  if (timeout->hash_next != NULL) {
+    timeout->hash_next->hash_pprev = &timeout->hash_next;
+  }
+  timeout->hash_pprev = bucket;
+  *bucket = timeout;
+
+  sys_timeo_wheel_add(timeout, msecs);
+}
+
+/**
+ * Remove the pending timeout matching handler and arg that would expire first
+ * (subsequent entries remain untouched), even though the timeout has not
+ * triggered yet.
+ *
+ * @param handler callback function that would be called by the timeout
+ * @param arg callback argument that would be passed to handler
+*/
+void
+sys_untimeout(sys_timeout_handler handler, void *arg)
+{
+  struct sys_timeo *t, *match = NULL;
+
+  for (t = timeo_hash[sys_timeo_hash_idx(handler, arg)]; t != NULL; t = t->hash_next) {
+    if ((t->h == handler) && (t->arg == arg)) {
+      if ((match == NULL) ||
+          ((u32_t)(t->time - timeo_wheel_time) < (u32_t)(match->time - timeo_wheel_time))) {
+        match = t;
+      }
+    }
+  }
+  if (match != NULL) {
+    sys_timeo_wheel_remove(match);
+    sys_timeo_hash_remove(match);
+    timeo_wheel_count--;
+    memp_free(MEMP_SYS_TIMEOUT, match);
+  }
 }
 
+/**
+ * Arm a caller-provided timeout. Unlike sys_timeout(), this never allocates
+ * and cannot fail. If 't' is already pending, it is re-armed.
+ * 't' must have been zeroed before it is used for the first time and must not
+ * be freed while pending. sys_untimeout() does not see such timeouts, use
+ * sys_untimeout_static() instead.
+ *
+ * @param t timeout storage owned by the caller
+ * @param msecs time in milliseconds after that the timer should expire
+ * @param handler callback function to call when msecs have elapsed
+ * @param arg argument to pass to the callback function
+ */
+#if LWIP_DEBUG_TIMERNAMES
+void
+sys_timeout_static_debug(struct sys_timeo *t, u32_t msecs, sys_timeout_handler handler, void *arg, const char* handler_name)
+#else /* LWIP_DEBUG_TIMERNAMES */
+void
+sys_timeout_static(struct sys_timeo *t, u32_t msecs, sys_timeout_handler handler, void *arg)
+#endif /* LWIP_DEBUG_TIMERNAMES */
+{
+  LWIP_ASSERT("sys_timeout_static: invalid timeout", t != NULL);
+
+  sys_untimeout_static(t);
+  t->h = handler;
+  t->arg = arg;
+  t->hash_pprev = NULL;
+#if LWIP_DEBUG_TIMERNAMES
+  t->handler_name = handler_name;
+  LWIP_DEBUGF(TIMERS_DEBUG, ("sys_timeout_static: %p msecs=%"U32_F" handler=%s arg=%p\n",
+    (void *)t, msecs, handler_name, (void *)arg));
+#endif /* LWIP_DEBUG_TIMERNAMES */
+  sys_timeo_wheel_add(t, msecs);
+}
+
+/**
+ * Cancel a timeout armed with sys_timeout_static(). Does nothing if 't' is
+ * not pending.
+ *
+ * @param t timeout storage passed to sys_timeout_static()
+ */
+void
+sys_untimeout_static(struct sys_timeo *t)
+{
+  LWIP_ASSERT("sys_untimeout_static: invalid timeout", t != NULL);
+  LWIP_ASSERT("sys_untimeout_static: not a static timeout", t->hash_pprev == NULL);
+
+  if (t->pprev != NULL) {
+    sys_timeo_wheel_remove(t);
+    timeo_wheel_count--;
+  }
+}
+
+/** Check whether a timeout armed with sys_timeout_static() is pending */
+u8_t
+sys_timeout_static_pending(const struct sys_timeo *t)
+{
+  return (t->pprev != NULL) ? 1 : 0;
+}
+
+/**
+ * Advance the wheel clock by one tick: cascade the higher level slots that
+ * start at the new time and call the handlers of all timeouts expiring now.
+ */
+static void
+sys_timeo_wheel_tick(void)
+{
+  int level;
+  struct sys_timeo **slot;
+
+  /* cascade from the top so entries end up in the right lower level slot */
+  for (level = SYS_TIMEO_WHEEL_LEVELS - 1; level > 0; level--) {
+    if ((timeo_wheel_time & SYS_TIMEO_WHEEL_MASK(level)) == 0) {
+      struct sys_timeo *t;
+      slot = &timeo_wheel[level][SYS_TIMEO_WHEEL_IDX(timeo_wheel_time, level)];
+      t = *slot;
+      *slot = NULL;
+      while (t != NULL) {
+        struct sys_timeo *next = t->next;
+        sys_timeo_wheel_insert(t);
+        t = next;
+      }
+    }
+  }
+
+  /* handlers may add or remove timeouts, so always take the slot's head */
+  slot = &timeo_wheel[0][SYS_TIMEO_WHEEL_IDX(timeo_wheel_time, 0)];
+  while (*slot != NULL) {
+    struct sys_timeo *t = *slot;
+    sys_timeout_handler handler = t->h;
+    void *arg = t->arg;
+
+    LWIP_ASSERT("sys_timeo_wheel_tick: timeout in wrong slot", t->time == timeo_wheel_time);
+    sys_timeo_wheel_remove(t);
+    timeo_wheel_count--;
+#if LWIP_DEBUG_TIMERNAMES
+    if (handler != NULL) {
+      LWIP_DEBUGF(TIMERS_DEBUG, ("sct calling h=%s arg=%p\n",
+        t->handler_name, arg));
+    }
+#endif /* LWIP_DEBUG_TIMERNAMES */
+    if (t->hash_pprev != NULL) {
+      sys_timeo_hash_remove(t);
+      memp_free(MEMP_SYS_TIMEOUT, t);
+    }
+    if (handler != NULL) {
+#if !NO_SYS
+      /* For LWIP_TCPIP_CORE_LOCKING, lock the core before calling the
+         timeout handler function. */
+      LOCK_TCPIP_CORE();
+#endif /* !NO_SYS */
+      handler(arg);
+#if !NO_SYS
+      UNLOCK_TCPIP_CORE();
+#endif /* !NO_SYS */
+    }
+    LWIP_TCPIP_THREAD_ALIVE();
+  }
+}
+
+/**
+ * @ingroup lwip_nosys
+ * Handle timeouts for NO_SYS==1 (i.e. without using
+ * tcpip_thread/sys_timeouts_mbox_fetch(). Uses sys_now() to call timeout
+ * handler functions when timeouts expire.
+ *
+ * Must be called periodically from your main loop.
+ */
+#if !NO_SYS && !LWIP_TESTMODE && !defined __DOXYGEN__
+static
+#endif /* !NO_SYS && !LWIP_TESTMODE */
+void
+sys_check_timeouts(void)
+{
+  u32_t now = timeo_wheel_now();
+
+  for (;;) {
+    u32_t next;
+    PBUF_CHECK_FREE_OOSEQ();
+    if (timeo_wheel_count == 0) {
+      timeo_wheel_time = now;
+      break;
+    }
+    next = sys_timeo_wheel_next();
+    /* this cares for wraparounds */
+    if (next > (u32_t)(now - timeo_wheel_time)) {
+      break;
+    }
+    timeo_wheel_time += next;
+    sys_timeo_wheel_tick();
+  }
+}
+
+/** Set back the timestamp of the last call to sys_check_timeouts()
+ * This is necessary if sys_check_timeouts() hasn't been called for a long
+ * time (e.g. while saving energy) to prevent all timer functions of that
+ * period being called.
+ */
+void
+sys_restart_timeouts(void)
+{
+  timeo_wheel_offset = sys_now() - timeo_wheel_time;
+}
+
+/** Return the time left before the next timeout is due. If no timeouts are
+ * enqueued, returns 0xffffffff. With LWIP_TIMERS_WHEEL, this may be earlier
+ * than the next expiry (when the wheel has to cascade).
+ */
+#if !NO_SYS && !LWIP_TESTMODE && !defined __DOXYGEN__
+static
+#endif /* !NO_SYS && !LWIP_TESTMODE */
+u32_t
+sys_timeouts_sleeptime(void)
+{
+  u32_t next, diff;
+  if (timeo_wheel_count == 0) {
+    return 0xffffffff;
+  }
+  next = sys_timeo_wheel_next();
+  diff = timeo_wheel_now() - timeo_wheel_time;
+  if (diff > next) {
+    return 0;
+  } else {
+    return next - diff;
+  }
+}
+
+#else /* LWIP_TIMERS_WHEEL */
+
 /**
  * Create a one-shot timer (aka timeout). Timeouts are processed in the
  * following cases:
@@ -307,9 +707,9 @@ sys_untimeout(sys_timeout_handler handler, void *arg)
  *
  * Must be called periodically from your main loop.
  */
-#if !NO_SYS && !defined __DOXYGEN__
+#if !NO_SYS && !LWIP_TESTMODE && !defined __DOXYGEN__
 static
-#endif /* !NO_SYS */
+#endif /* !NO_SYS && !LWIP_TESTMODE */
 void
 sys_check_timeouts(void)
 {
@@ -375,9 +775,9 @@ sys_restart_timeouts(void)
 /** Return the time left before the next timeout is due. If no timeouts are
  * enqueued, returns 0xffffffff
  */
-#if !NO_SYS
+#if !NO_SYS && !LWIP_TESTMODE && !defined __DOXYGEN__
 static
-#endif /* !NO_SYS */
+#endif /* !NO_SYS && !LWIP_TESTMODE */
 u32_t
 sys_timeouts_sleeptime(void)
 {
@@ -393,6 +793,8 @@ sys_timeouts_sleeptime(void)
   }
 }
 
+#endif /* LWIP_TIMERS_WHEEL */
+
 #if !NO_SYS
 
 /**
@@ -408,12 +810,12 @@ sys_timeouts_mbox_fetch(sys_mbox_t *mbox, void **msg)
   u32_t sleeptime;
 
 again:
-  if (!next_timeout) {
+  sleeptime = sys_timeouts_sleeptime();
+  if (sleeptime == 0xffffffff) {
     sys_arch_mbox_fetch(mbox, msg, 0);
     return;
   }
 
-  sleeptime = sys_timeouts_sleeptime();
   if (sleeptime == 0 || sys_arch_mbox_fetch(mbox, msg, sleeptime) == SYS_ARCH_TIMEOUT) {
     /* If a SYS_ARCH_TIMEOUT value is returned, a timeout occurred
        before a message could be fetched. */
@@ -308,6 +308,10 @@ udp_input(struct pbuf *p, struct netif *inp)
   if (for_us) {
     LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_TRACE, ("udp_input: calculating checksum\n"));
 #if CHECKSUM_CHECK_UDP
+#if LWIP_CHECKSUM_OFFLOAD
+    /* already verified by the netif */
+    if (!(p->flags & PBUF_FLAG_CHKSUM_VERIFIED))
+#endif /* LWIP_CHECKSUM_OFFLOAD */
     IF__NETIF_CHECKSUM_ENABLED(inp, CHECKSUM_CHECK_UDP) {
 #if LWIP_UDPLITE
       if (ip_current_header_proto() == IP_PROTO_UDPLITE) {
@@ -741,6 +745,9 @@ udp_sendto_if_src_chksum(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *d
   udphdr->dest = lwip_htons(dst_port);
   /* in UDP, 0 checksum means 'no checksum' */
   udphdr->chksum = 0x0000;
+#if LWIP_CHECKSUM_OFFLOAD
+  q->chksum_offset = 0;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
 
   /* Multicast Loop? */
 #if LWIP_MULTICAST_TX_OPTIONS
@@ -809,6 +816,14 @@ udp_sendto_if_src_chksum(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *d
       /* Checksum is mandatory over IPv6. */
       if (IP_IS_V6(dst_ip) || (pcb->flags & UDP_FLAGS_NOCHKSUM) == 0) {
         u16_t udpchksum;
+#if LWIP_CHECKSUM_OFFLOAD
+        if (netif->chksum_partial & NETIF_CHKSUM_PARTIAL_UDP) {
+          /* the netif sums up the datagram, starting from the pseudo header */
+          udpchksum = (u16_t)~ip_chksum_pseudo_partial(q, IP_PROTO_UDP, q->tot_len, 0,
+            src_ip, dst_ip);
+          q->chksum_offset = UDP_CHKSUM_OFFSET;
+        } else
+#endif /* LWIP_CHECKSUM_OFFLOAD */
 #if LWIP_CHECKSUM_ON_COPY
         if (have_chksum) {
           u32_t acc;
@@ -64,6 +64,7 @@ extern "C" {
 #define NETCONN_MORE        0x02
 #define NETCONN_DONTBLOCK   0x04
 #define NETCONN_NOAUTORCVD  0x08 /* prevent netconn_recv_data_tcp() from updating the tcp window - must be done manually via netconn_tcp_recvd() */
+#define NETCONN_ZEROCOPY    0x10 /* TCP: reference the data (like without NETCONN_COPY) and count it in netconn_get_zc_done() when the stack is done with it, see LWIP_TCP_ZEROCOPY */
 
 /* Flags for struct netconn.flags (u8_t) */
 /** This netconn had an error, don't block on recvmbox/acceptmbox any more */
@@ -72,6 +73,12 @@ extern "C" {
 #define NETCONN_FLAG_NON_BLOCKING             0x02
 /** Was the last connect action a non-blocking one? */
 #define NETCONN_FLAG_IN_NONBLOCKING_CONNECT   0x04
+#if LWIP_TCP && LWIP_TCP_FASTOPEN
+/** TCP: use TCP Fast Open: netconn_connect() returns immediately and data
+    written before the connection is established is sent with the SYN if a
+    cookie is cached; listening netconns accept data in SYNs */
+#define NETCONN_FLAG_FASTOPEN                 0x08
+#endif /* LWIP_TCP && LWIP_TCP_FASTOPEN */
 /** If a nonblocking write has been rejected before, poll_tcp needs to
     check if the netconn is writable again */
 #define NETCONN_FLAG_CHECK_WRITESPACE         0x10
@@ -270,6 +277,10 @@ struct netconn {
       Also used during connect and close. */
   struct api_msg *current_msg;
 #endif /* LWIP_TCP */
+#if LWIP_TCP && LWIP_TCP_ZEROCOPY
+  /** TCP: number of bytes written with NETCONN_ZEROCOPY the stack is done with */
+  u32_t zc_done;
+#endif /* LWIP_TCP && LWIP_TCP_ZEROCOPY */
   /** A callback function that is informed about events for this netconn */
   netconn_callback callback;
 };
@@ -338,6 +349,11 @@ err_t   netconn_write_vectors_partly(struct netconn *conn, struct netvector *vec
 err_t   netconn_close(struct netconn *conn);
 err_t   netconn_shutdown(struct netconn *conn, u8_t shut_rx, u8_t shut_tx);
 
+#if LWIP_TCP && LWIP_TCP_INFO
+struct tcp_info;
+err_t   netconn_tcp_info(struct netconn *conn, struct tcp_info *info);
+#endif /* LWIP_TCP && LWIP_TCP_INFO */
+
 #if LWIP_IGMP || (LWIP_IPV6 && LWIP_IPV6_MLD)
 err_t   netconn_join_leave_group(struct netconn *conn, const ip_addr_t *multiaddr,
                              const ip_addr_t *netif_addr, enum netconn_igmp join_or_leave);
@@ -381,6 +397,31 @@ err_t   netconn_err(struct netconn *conn);
 #define netconn_get_ipv6only(conn)        (((conn)->flags & NETCONN_FLAG_IPV6_V6ONLY) != 0)
 #endif /* LWIP_IPV6 */
 
+#if LWIP_TCP && LWIP_TCP_FASTOPEN
+/** @ingroup netconn_tcp
+ * TCP: Set the TCP Fast Open status of a netconn (see NETCONN_FLAG_FASTOPEN),
+ * must be set before netconn_connect() or netconn_listen()
+ */
+#define netconn_set_fastopen(conn, val)  do { if(val) { \
+  netconn_set_flags(conn, NETCONN_FLAG_FASTOPEN); \
+} else { \
+  netconn_clear_flags(conn, NETCONN_FLAG_FASTOPEN); }} while(0)
+/** @ingroup netconn_tcp
+ * TCP: Get the TCP Fast Open status of a netconn (see NETCONN_FLAG_FASTOPEN)
+ */
+#define netconn_get_fastopen(conn)        (((conn)->flags & NETCONN_FLAG_FASTOPEN) != 0)
+#endif /* LWIP_TCP && LWIP_TCP_FASTOPEN */
+
+#if LWIP_TCP && LWIP_TCP_ZEROCOPY
+/** @ingroup netconn_tcp
+ * TCP: Get the number of bytes written with NETCONN_ZEROCOPY that the stack is
+ * done with (acknowledged and no longer referenced; wraps around at 2^32).
+ * The buffers are done with in the order they were written, so the first
+ * netconn_get_zc_done() bytes written with NETCONN_ZEROCOPY may be reused.
+ */
+#define netconn_get_zc_done(conn)         ((conn)->zc_done)
+#endif /* LWIP_TCP && LWIP_TCP_ZEROCOPY */
+
 #if LWIP_SO_SNDTIMEO
 /** Set the send timeout in milliseconds */
 #define netconn_set_sendtimeout(conn, timeout)      ((conn)->send_timeout = (timeout))
@@ -56,7 +56,11 @@
 /** Function-like macro: same as MEMCPY but returns the checksum of copied data
     as u16_t */
 # ifndef LWIP_CHKSUM_COPY
-#  define LWIP_CHKSUM_COPY(dst, src, len) lwip_chksum_copy(dst, src, len)
+#  if LWIP_CHKSUM_SIMD
+#   define LWIP_CHKSUM_COPY(dst, src, len) lwip_chksum_copy_simd(dst, src, len)
+#  else /* LWIP_CHKSUM_SIMD */
+#   define LWIP_CHKSUM_COPY(dst, src, len) lwip_chksum_copy(dst, src, len)
+#  endif /* LWIP_CHKSUM_SIMD */
 #  ifndef LWIP_CHKSUM_COPY_ALGORITHM
 #   define LWIP_CHKSUM_COPY_ALGORITHM 1
 #  endif /* LWIP_CHKSUM_COPY_ALGORITHM */
@@ -97,6 +101,27 @@ u16_t ip_chksum_pseudo(struct pbuf *p, u8_t proto, u16_t proto_len,
 u16_t ip_chksum_pseudo_partial(struct pbuf *p, u8_t proto, u16_t proto_len,
        u16_t chksum_len, const ip_addr_t *src, const ip_addr_t *dest);
 
+#if LWIP_CHECKSUM_OFFLOAD
+void ip_chksum_complete(struct pbuf *p);
+#endif /* LWIP_CHECKSUM_OFFLOAD */
+
+#if LWIP_CHKSUM_SIMD
+/** Checksum kernels for LWIP_CHKSUM_SIMD */
+#define LWIP_CHKSUM_KERNEL_SCALAR 0
+#define LWIP_CHKSUM_KERNEL_SSE2   1
+#define LWIP_CHKSUM_KERNEL_AVX2   2
+#define LWIP_CHKSUM_KERNEL_NEON   3
+
+u16_t lwip_standard_chksum(const void *dataptr, int len);
+u16_t lwip_chksum_simd(const void *dataptr, int len);
+void lwip_chksum_simd_init(void);
+u8_t lwip_chksum_simd_select(u8_t kernel);
+u8_t lwip_chksum_simd_get(void);
+#if LWIP_CHECKSUM_ON_COPY
+u16_t lwip_chksum_copy_simd(void *dst, const void *src, u16_t len);
+#endif /* LWIP_CHECKSUM_ON_COPY */
+#endif /* LWIP_CHKSUM_SIMD */
+
 #ifdef __cplusplus
 }
 #endif
@@ -163,6 +163,10 @@ extern struct ip_globals ip_data;
 #define ip_current_header_proto() (ip_current_is_v6() ? \
                                    IP6H_NEXTH(ip6_current_header()) :\
                                    IPH_PROTO(ip4_current_header()))
+/** Get the ECN field (IP_ECN_*) */
+#define ip_current_ecn()          ((u8_t)((ip_current_is_v6() ? \
+                                   IP6H_TC(ip6_current_header()) : \
+                                   IPH_TOS(ip4_current_header())) & IP_ECN_MASK))
 /** Get the transport layer header */
 #define ip_next_header_ptr()     ((const void*)((ip_current_is_v6() ? \
   (const u8_t*)ip6_current_header() : (const u8_t*)ip4_current_header())  + ip_current_header_tot_len()))
@@ -182,6 +186,8 @@ extern struct ip_globals ip_data;
 #define ip_current_is_v6()        0
 /** Get the transport layer protocol */
 #define ip_current_header_proto() IPH_PROTO(ip4_current_header())
+/** Get the ECN field (IP_ECN_*) */
+#define ip_current_ecn()          ((u8_t)(IPH_TOS(ip4_current_header()) & IP_ECN_MASK))
 /** Get the transport layer header */
 #define ip_next_header_ptr()     ((const void*)((const u8_t*)ip4_current_header() + ip_current_header_tot_len()))
 /** Source IP4 address of current_header */
@@ -199,6 +205,8 @@ extern struct ip_globals ip_data;
 #define ip_current_is_v6()        1
 /** Get the transport layer protocol */
 #define ip_current_header_proto() IP6H_NEXTH(ip6_current_header())
+/** Get the ECN field (IP_ECN_*) */
+#define ip_current_ecn()          ((u8_t)(IP6H_TC(ip6_current_header()) & IP_ECN_MASK))
 /** Get the transport layer header */
 #define ip_next_header_ptr()     ((const void*)(((const u8_t*)ip6_current_header()) + ip_current_header_tot_len()))
 /** Source IP6 address of current_header */
@@ -105,6 +105,10 @@ extern "C" {
 /** If set, the netif has MLD6 capability.
  * Set by the netif driver in its init function. */
 #define NETIF_FLAG_MLD6         0x40U
+/** If set, the netif cuts TCP super-segments (pbufs with tso_mss != 0, up
+ * to netif->tso_max bytes) into segments itself (LWIP_TCP_TSO).
+ * Set by the netif driver in its init function. */
+#define NETIF_FLAG_TSO          0x80U
 
 /**
  * @}
@@ -142,6 +146,13 @@ enum lwip_internal_netif_client_data_index
 #define NETIF_CHECKSUM_DISABLE_ALL  0x0000
 #endif /* LWIP_CHECKSUM_CTRL_PER_NETIF */
 
+#if LWIP_CHECKSUM_OFFLOAD
+/** The netif completes the checksum of TCP segments (pbuf->chksum_offset) */
+#define NETIF_CHKSUM_PARTIAL_TCP    0x01U
+/** The netif completes the checksum of UDP datagrams (pbuf->chksum_offset) */
+#define NETIF_CHKSUM_PARTIAL_UDP    0x02U
+#endif /* LWIP_CHECKSUM_OFFLOAD */
+
 struct netif;
 
 /** MAC Filter Actions, these are passed to a netif's igmp_mac_filter or
@@ -311,8 +322,28 @@ struct netif {
 #if LWIP_CHECKSUM_CTRL_PER_NETIF
   u16_t chksum_flags;
 #endif /* LWIP_CHECKSUM_CTRL_PER_NETIF*/
+#if LWIP_CHECKSUM_OFFLOAD
+  /** NETIF_CHKSUM_PARTIAL_* flags: protocols whose checksum this netif
+   * completes for outgoing packets */
+  u8_t chksum_partial;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
   /** maximum transfer unit (in bytes) */
   u16_t mtu;
+#if LWIP_TCP_TSO
+  /** maximum size (IP packet, in bytes) of TCP super-segments sent to this
+   * netif, 0 to send single segments. Without NETIF_FLAG_TSO, super-segments
+   * are cut up in software before netif->output. */
+  u16_t tso_max;
+#endif /* LWIP_TCP_TSO */
+#if LWIP_NETIF_GRO
+  /** maximum size (IP packet, in bytes) received TCP segments are merged
+   * to before IP input, 0 to disable merging (see netif_gro_input()) */
+  u16_t gro_max;
+  /** number of packets held back in gro_pkts */
+  u8_t gro_num;
+  /** packets held back for merging, oldest first */
+  struct pbuf *gro_pkts[NETIF_GRO_FLOWS];
+#endif /* LWIP_NETIF_GRO */
   /** link level hardware address of this interface */
   u8_t hwaddr[NETIF_MAX_HWADDR_LEN];
   /** number of bytes used in hwaddr */
@@ -482,6 +513,20 @@ void netif_poll_all(void);
 
 err_t netif_input(struct pbuf *p, struct netif *inp);
 
+#if LWIP_NETIF_GRO
+err_t netif_gro_input(struct pbuf *p, struct netif *inp);
+void netif_gro_flush(struct netif *netif);
+#endif /* LWIP_NETIF_GRO */
+
+#if LWIP_TCP && LWIP_TCP_TSO
+#if LWIP_IPV4
+err_t netif_gso_output_ip4(struct netif *netif, struct pbuf *p, const ip4_addr_t *dest);
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6
+err_t netif_gso_output_ip6(struct netif *netif, struct pbuf *p, const ip6_addr_t *dest);
+#endif /* LWIP_IPV6 */
+#endif /* LWIP_TCP && LWIP_TCP_TSO */
+
 #if LWIP_IPV6
 /** @ingroup netif_ip6 */
 #define netif_ip_addr6(netif, i)  ((const ip_addr_t*)(&((netif)->ip6_addr[i])))
@@ -120,6 +120,28 @@
 #if !defined LWIP_TIMERS_CUSTOM || defined __DOXYGEN__
 #define LWIP_TIMERS_CUSTOM              0
 #endif
+
+/**
+ * LWIP_TIMERS_WHEEL==1: Keep pending sys_timeouts in a hierarchical timer
+ * wheel instead of the sorted delta list. Arming, cancelling and expiring a
+ * timeout are O(1) regardless of the number of pending timeouts (the list
+ * is O(n) for sys_timeout() and sys_untimeout()). This also enables the
+ * intrusive sys_timeout_static()/sys_untimeout_static() API, which does not
+ * allocate from MEMP_SYS_TIMEOUT.
+ * Costs 8*16 pointers of RAM for the wheel plus LWIP_TIMERS_WHEEL_HASH_SIZE
+ * pointers for the sys_untimeout() lookup table.
+ */
+#if !defined LWIP_TIMERS_WHEEL || defined __DOXYGEN__
+#define LWIP_TIMERS_WHEEL               0
+#endif
+
+/**
+ * LWIP_TIMERS_WHEEL_HASH_SIZE: number of buckets used to find timeouts by
+ * (handler, arg) in sys_untimeout() when LWIP_TIMERS_WHEEL==1.
+ */
+#if !defined LWIP_TIMERS_WHEEL_HASH_SIZE || defined __DOXYGEN__
+#define LWIP_TIMERS_WHEEL_HASH_SIZE     16
+#endif
 /**
  * @}
  */
@@ -408,6 +430,43 @@
 #define MEMP_NUM_TCP_SEG                16
 #endif
 
+/**
+ * MEMP_NUM_TCP_SYN_REQ: the number of half-open connections (in state
+ * SYN_RCVD, all listeners) kept as request entries instead of tcp_pcbs.
+ * (requires the LWIP_TCP_SYN_REQ option)
+ */
+#if !defined MEMP_NUM_TCP_SYN_REQ || defined __DOXYGEN__
+#define MEMP_NUM_TCP_SYN_REQ            MEMP_NUM_TCP_PCB
+#endif
+
+/**
+ * MEMP_NUM_TCP_PCB_TW: the number of connections in TIME_WAIT kept as compact
+ * records after the application has closed them. If all are in use, the
+ * oldest record is dropped for a new one.
+ * (requires the LWIP_TCP_TW_COMPACT option)
+ */
+#if !defined MEMP_NUM_TCP_PCB_TW || defined __DOXYGEN__
+#define MEMP_NUM_TCP_PCB_TW             MEMP_NUM_TCP_PCB
+#endif
+
+/**
+ * MEMP_NUM_TCP_ZC: the number of buffers written with tcp_write_ref() that
+ * can be outstanding (not yet reported complete) at the same time, over all
+ * connections. (requires the LWIP_TCP_ZEROCOPY option)
+ */
+#if !defined MEMP_NUM_TCP_ZC || defined __DOXYGEN__
+#define MEMP_NUM_TCP_ZC                 MEMP_NUM_TCP_SEG
+#endif
+
+/**
+ * MEMP_NUM_TCP_ZC_PBUF: the number of pbufs referencing buffers written with
+ * tcp_write_ref(). Every segment (or part of a segment) holding such data
+ * needs one. (requires the LWIP_TCP_ZEROCOPY option)
+ */
+#if !defined MEMP_NUM_TCP_ZC_PBUF || defined __DOXYGEN__
+#define MEMP_NUM_TCP_ZC_PBUF            MEMP_NUM_TCP_SEG
+#endif
+
 /**
  * MEMP_NUM_ALTCP_PCB: the number of simultaneously active altcp layer pcbs.
  * (requires the LWIP_ALTCP option)
@@ -701,6 +760,45 @@
 #define IP_FRAG                         1
 #endif
 
+/**
+ * IP_PMTUD==1: Path MTU discovery for IPv4 (RFC 1191). TCP segments are sent
+ * with the Don't Fragment flag, and ICMP "fragmentation needed" messages for
+ * them lower the path MTU of their destination, which is kept in a cache
+ * (IP_PMTU_CACHE_SIZE entries) for IP_PMTU_TIMEOUT. The connection the
+ * message refers to lowers its MSS and retransmits at once; connections
+ * try the larger MSS again when the cache entry has expired.
+ * Requires TCP_CALCULATE_EFF_SEND_MSS (if LWIP_TCP is enabled).
+ */
+#if !defined IP_PMTUD || defined __DOXYGEN__
+#define IP_PMTUD                        0
+#endif
+
+/**
+ * IP_PMTU_CACHE_SIZE: Number of destinations for which a path MTU smaller
+ * than the MTU of the outgoing netif is cached (IP_PMTUD). When the cache is
+ * full, the entry that was updated longest ago is replaced.
+ */
+#if !defined IP_PMTU_CACHE_SIZE || defined __DOXYGEN__
+#define IP_PMTU_CACHE_SIZE              8
+#endif
+
+/**
+ * IP_PMTU_TIMEOUT: Time in milliseconds after which a path MTU estimate
+ * expires, so that an increase of the path MTU is detected (RFC 1191
+ * recommends 10 minutes).
+ */
+#if !defined IP_PMTU_TIMEOUT || defined __DOXYGEN__
+#define IP_PMTU_TIMEOUT                 (10 * 60 * 1000)
+#endif
+
+/**
+ * IP_PMTU_MIN: The smallest path MTU accepted from ICMP messages. This keeps
+ * forged messages from making connections send tiny segments.
+ */
+#if !defined IP_PMTU_MIN || defined __DOXYGEN__
+#define IP_PMTU_MIN                     552
+#endif
+
 #if !LWIP_IPV4
 /* disable IPv4 extensions when IPv4 is disabled */
 #undef IP_FORWARD
@@ -709,6 +807,8 @@
 #define IP_REASSEMBLY                   0
 #undef IP_FRAG
 #define IP_FRAG                         0
+#undef IP_PMTUD
+#define IP_PMTUD                        0
 #endif /* !LWIP_IPV4 */
 
 /**
@@ -1232,6 +1332,37 @@
 #define LWIP_TCP_MAX_SACK_NUM           4
 #endif
 
+/**
+ * LWIP_TCP_SACK_IN==1: TCP uses the selective acknowledgements (SACKs)
+ * received from the remote host for loss recovery (RFC 6675): a scoreboard
+ * over the unacked queue tracks SACKed segments and only the holes are
+ * retransmitted during fast recovery, instead of stalling until the RTO
+ * after the first partial ACK.
+ * SACK is negotiated via LWIP_TCP_SACK_OUT, which must be enabled, too.
+ */
+#if !defined LWIP_TCP_SACK_IN || defined __DOXYGEN__
+#define LWIP_TCP_SACK_IN                0
+#endif
+
+/**
+ * LWIP_TCP_CUBIC==1: Compile in the CUBIC congestion control algorithm
+ * (RFC 9438) next to the default Reno/NewReno one. The algorithm is selected
+ * per connection via tcp_set_congestion() or the TCP_CONGESTION socket option.
+ * Requires 64-bit integer support (LWIP_HAVE_INT64).
+ */
+#if !defined LWIP_TCP_CUBIC || defined __DOXYGEN__
+#define LWIP_TCP_CUBIC                  0
+#endif
+
+/**
+ * LWIP_TCP_CC_DEFAULT: The congestion control ops (struct tcp_cc_ops) new
+ * connections start with: tcp_cc_reno or (with LWIP_TCP_CUBIC) tcp_cc_cubic.
+ * Connections accepted on a listening pcb inherit the listener's algorithm.
+ */
+#if !defined LWIP_TCP_CC_DEFAULT || defined __DOXYGEN__
+#define LWIP_TCP_CC_DEFAULT             tcp_cc_reno
+#endif
+
 /**
  * TCP_MSS: TCP Maximum segment size. (default is 536, a conservative default,
  * you might want to increase this.)
@@ -1290,6 +1421,47 @@
 #define TCP_SNDQUEUELOWAT               LWIP_MAX(((TCP_SND_QUEUELEN)/2), 5)
 #endif
 
+/**
+ * LWIP_TCP_SNDBUF_PCB==1: Make the send buffer size a per-pcb setting
+ * (tcp_set_sndbuf(), SO_SNDBUF) instead of using TCP_SND_BUF for all pcbs.
+ * TCP_SND_BUF is the default size. The pbuf limit (TCP_SND_QUEUELEN) and
+ * the low-water marks (TCP_SNDLOWAT, TCP_SNDQUEUELOWAT) of a pcb scale
+ * with its buffer size. The total by which all pcbs exceed TCP_SND_BUF is
+ * limited by TCP_SND_BUF_MEM.
+ */
+#if !defined LWIP_TCP_SNDBUF_PCB || defined __DOXYGEN__
+#define LWIP_TCP_SNDBUF_PCB             0
+#endif
+
+/**
+ * TCP_SND_BUF_MEM: Total number of bytes the send buffers of all pcbs
+ * together may exceed TCP_SND_BUF with LWIP_TCP_SNDBUF_PCB. This protects
+ * the pools segments and pbufs are allocated from.
+ */
+#if !defined TCP_SND_BUF_MEM || defined __DOXYGEN__
+#define TCP_SND_BUF_MEM                 (4 * TCP_SND_BUF)
+#endif
+
+/**
+ * LWIP_TCP_SND_AUTOTUNE==1: With LWIP_TCP_SNDBUF_PCB, don't allocate the
+ * size set with tcp_set_sndbuf() right away but start with TCP_SND_BUF and
+ * grow the send buffer towards twice the congestion window as that opens.
+ * This lets the application keep a fast connection busy while slow or idle
+ * connections stay small. The size set with tcp_set_sndbuf() (default
+ * TCP_SND_AUTOTUNE_MAX) is the limit.
+ */
+#if !defined LWIP_TCP_SND_AUTOTUNE || defined __DOXYGEN__
+#define LWIP_TCP_SND_AUTOTUNE           0
+#endif
+
+/**
+ * TCP_SND_AUTOTUNE_MAX: Default limit of the send buffer of a pcb for
+ * LWIP_TCP_SND_AUTOTUNE (bytes).
+ */
+#if !defined TCP_SND_AUTOTUNE_MAX || defined __DOXYGEN__
+#define TCP_SND_AUTOTUNE_MAX            (4 * TCP_SND_BUF)
+#endif
+
 /**
  * TCP_OOSEQ_MAX_BYTES: The maximum number of bytes queued on ooseq per pcb.
  * Default is 0 (no limit). Only valid for TCP_QUEUE_OOSEQ==1.
@@ -1306,6 +1478,41 @@
 #define TCP_OOSEQ_MAX_PBUFS             0
 #endif
 
+/**
+ * LWIP_TCP_OOSEQ_TREE==1: Index the out-of-sequence queue (pcb->ooseq) with a
+ * balanced search tree keyed by sequence number, so that queueing a segment
+ * takes O(log n) instead of a walk over the whole queue. Adjacent segments are
+ * coalesced into one (up to 64 KByte) so that SACK generation and in-order
+ * delivery only see a few segments per contiguous range.
+ * Useful with big windows (LWIP_WND_SCALE) and links that reorder a lot.
+ * Only valid for TCP_QUEUE_OOSEQ==1.
+ */
+#if !defined LWIP_TCP_OOSEQ_TREE || defined __DOXYGEN__
+#define LWIP_TCP_OOSEQ_TREE             0
+#endif
+
+/**
+ * LWIP_TCP_OOSEQ_MEM==1: Account the pbufs queued on ooseq of all pcbs
+ * against one budget (TCP_OOSEQ_MEM_PBUFS). When the budget is exceeded, or
+ * when PBUF_POOL runs empty, segments are pruned from the end of the queue
+ * (highest sequence numbers first) of the pcb holding the most pbufs, instead
+ * of dropping whole queues. A pcb holding no more than its share of the
+ * budget is never pruned because of the budget.
+ * With TCP_STATS, the pressure is counted in lwip_stats.tcp_ooseq.
+ * Only valid for TCP_QUEUE_OOSEQ==1.
+ */
+#if !defined LWIP_TCP_OOSEQ_MEM || defined __DOXYGEN__
+#define LWIP_TCP_OOSEQ_MEM              0
+#endif
+
+/**
+ * TCP_OOSEQ_MEM_PBUFS: The maximum number of pbufs queued on ooseq of all
+ * pcbs together with LWIP_TCP_OOSEQ_MEM==1.
+ */
+#if !defined TCP_OOSEQ_MEM_PBUFS || defined __DOXYGEN__
+#define TCP_OOSEQ_MEM_PBUFS             (PBUF_POOL_SIZE / 2)
+#endif
+
 /**
  * TCP_LISTEN_BACKLOG: Enable the backlog option for tcp listen pcb.
  */
@@ -1350,6 +1557,283 @@
 #define LWIP_TCP_TIMESTAMPS             0
 #endif
 
+/**
+ * LWIP_TCP_TS_RTTM==1: measure the round-trip time with the timestamp echoed
+ * in every ACK that acknowledges new data (RFC 7323 RTTM), also for
+ * retransmitted segments, instead of timing one segment per window with the
+ * slow timer. The timestamps are taken from sys_now(), so the estimator runs
+ * with millisecond resolution; the gains are scaled down by the number of
+ * samples expected per window (RFC 7323 appendix G).
+ * Connections that don't agree on timestamps keep the classic measurement.
+ * Requires LWIP_TCP_TIMESTAMPS.
+ */
+#if !defined LWIP_TCP_TS_RTTM || defined __DOXYGEN__
+#define LWIP_TCP_TS_RTTM                0
+#endif
+
+/**
+ * LWIP_TCP_ECN==1: support Explicit Congestion Notification (RFC 3168).
+ * ECN is requested in the SYN of active opens and accepted in the SYN-ACK
+ * of passive opens. When both sides agree, data segments are sent ECT(0);
+ * a CE mark on a received segment is echoed with ECE until the peer answers
+ * with CWR, and an ECE from the peer reduces cwnd through the congestion
+ * control algorithm (at most once per window) like a loss would.
+ * A retransmitted SYN is sent without ECN, in case the first one was
+ * dropped because of it.
+ */
+#if !defined LWIP_TCP_ECN || defined __DOXYGEN__
+#define LWIP_TCP_ECN                    0
+#endif
+
+/**
+ * LWIP_TCP_PLPMTUD==1: detect path MTU black holes (RFC 4821, packetization
+ * layer PMTUD) where packets that are too big are dropped without an ICMP
+ * message. After TCP_PMTU_BLACKHOLE_RTX retransmission timeouts in a row,
+ * the MSS is lowered to TCP_PMTU_BASE_MSS and the lower path MTU is cached
+ * like one learned from ICMP; the larger MSS is tried again when the cache
+ * entry expires. Requires IP_PMTUD.
+ */
+#if !defined LWIP_TCP_PLPMTUD || defined __DOXYGEN__
+#define LWIP_TCP_PLPMTUD                0
+#endif
+
+/**
+ * TCP_PMTU_BASE_MSS: The MSS a connection falls back to when it detects a
+ * path MTU black hole (LWIP_TCP_PLPMTUD).
+ */
+#if !defined TCP_PMTU_BASE_MSS || defined __DOXYGEN__
+#define TCP_PMTU_BASE_MSS               LWIP_MIN(536, TCP_MSS)
+#endif
+
+/**
+ * TCP_PMTU_BLACKHOLE_RTX: The number of retransmission timeouts in a row
+ * after which a connection assumes a path MTU black hole (LWIP_TCP_PLPMTUD).
+ */
+#if !defined TCP_PMTU_BLACKHOLE_RTX || defined __DOXYGEN__
+#define TCP_PMTU_BLACKHOLE_RTX          2
+#endif
+
+/**
+ * LWIP_TCP_ZEROCOPY==1: Enable tcp_write_ref(), a tcp_write() without copy
+ * that reports per buffer when the stack is done with the data: the
+ * completion callback (tcp_zc_done()) is called once the last byte of the
+ * buffer is acknowledged and all pbufs referencing it are freed. Completions
+ * are reported in the order the buffers were written. Also enables
+ * NETCONN_ZEROCOPY and MSG_ZEROCOPY.
+ */
+#if !defined LWIP_TCP_ZEROCOPY || defined __DOXYGEN__
+#define LWIP_TCP_ZEROCOPY               0
+#endif
+
+/**
+ * LWIP_TCP_TSO==1: Enable TCP segmentation offload: tcp_output() merges
+ * queued segments into super-segments of up to netif->tso_max bytes (IP
+ * packet size) for netifs that set it. Such a pbuf carries the payload size
+ * of the segments it is to be cut into in p->tso_mss. Netifs with
+ * NETIF_FLAG_TSO cut it up themselves (hardware); for other netifs, this is
+ * done in software right before netif->output (generic segmentation
+ * offload), which still saves the per-segment work of the TCP layer.
+ */
+#if !defined LWIP_TCP_TSO || defined __DOXYGEN__
+#define LWIP_TCP_TSO                    0
+#endif
+
+/**
+ * LWIP_TCP_PCB_HASH==1: demultiplex incoming segments through hash tables
+ * instead of walking the pcb lists. Connected pcbs (active and TIME-WAIT) are
+ * hashed by their 4-tuple, listening pcbs by their local port. The pcb lists
+ * are kept as they are (they are still used by the timers).
+ * Enable this if you have many connections: the per-segment lookup cost does
+ * not grow with the number of pcbs then.
+ */
+#if !defined LWIP_TCP_PCB_HASH || defined __DOXYGEN__
+#define LWIP_TCP_PCB_HASH               0
+#endif
+
+/**
+ * TCP_PCB_HASH_SIZE: number of buckets in the hash table for connected pcbs
+ * (only used if LWIP_TCP_PCB_HASH==1). Costs one pointer per bucket.
+ * The default keeps the load factor at 1 or below for all pcbs of the
+ * MEMP_TCP_PCB pool.
+ */
+#if !defined TCP_PCB_HASH_SIZE || defined __DOXYGEN__
+#define TCP_PCB_HASH_SIZE               MEMP_NUM_TCP_PCB
+#endif
+
+/**
+ * TCP_LISTEN_PCB_HASH_SIZE: number of buckets in the hash table for listening
+ * pcbs (only used if LWIP_TCP_PCB_HASH==1). Costs one pointer per bucket.
+ */
+#if !defined TCP_LISTEN_PCB_HASH_SIZE || defined __DOXYGEN__
+#define TCP_LISTEN_PCB_HASH_SIZE        MEMP_NUM_TCP_PCB_LISTEN
+#endif
+
+/**
+ * LWIP_TCP_INFO==1: Maintain per-connection counters (retransmitted
+ * segments, fast retransmits, retransmission timeouts, bytes acknowledged)
+ * and provide a snapshot of the connection state in struct tcp_info:
+ * tcp_get_info() (raw API), netconn_tcp_info() and the TCP_INFO socket
+ * option. Costs 16 bytes per tcp_pcb.
+ */
+#if !defined LWIP_TCP_INFO || defined __DOXYGEN__
+#define LWIP_TCP_INFO                   0
+#endif
+
+/**
+ * LWIP_TCP_PCB_TIMERS==1: Drive the TCP timers per pcb instead of scanning
+ * all pcbs from tcp_slowtmr()/tcp_fasttmr() every 500/250 ms. Each pcb arms
+ * its own timeout for its next deadline (retransmission, persist, keepalive,
+ * delayed ACK, FIN-WAIT-2/SYN-RCVD/LAST-ACK/TIME-WAIT expiry), so idle
+ * connections don't cause any timer work and the stack can sleep while
+ * nothing is due. tcp_tmr() does nothing in this mode.
+ * Connections with data in flight or an active persist timer are still
+ * processed once per TCP_SLOW_INTERVAL. A poll callback (tcp_poll(), or every
+ * pcb with LWIP_EVENT_API) is the exception to "no wakeups while idle": it
+ * wakes its pcb up every poll interval. The netconn API only installs it
+ * while a write or close is pending.
+ * When changing the keepalive settings of a connected pcb directly (raw API),
+ * call tcp_timer_update() afterwards.
+ * Requires LWIP_TIMERS_WHEEL (for sys_timeout_static()).
+ */
+#if !defined LWIP_TCP_PCB_TIMERS || defined __DOXYGEN__
+#define LWIP_TCP_PCB_TIMERS             0
+#endif
+
+/**
+ * LWIP_TCP_PACING==1: Pace outgoing TCP data instead of sending everything
+ * cwnd/snd_wnd allows in one burst. The pacing rate is derived from cwnd and
+ * the smoothed RTT (200% in slow start, 120% in congestion avoidance) and can
+ * be limited per connection with tcp_set_max_pacing_rate() or the
+ * SO_MAX_PACING_RATE socket option. Segments are released by a per-pcb
+ * timeout at millisecond granularity, bursts are limited to TCP_PACING_BURST.
+ * Requires LWIP_TIMERS_WHEEL (for sys_timeout_static()).
+ */
+#if !defined LWIP_TCP_PACING || defined __DOXYGEN__
+#define LWIP_TCP_PACING                 0
+#endif
+
+/**
+ * TCP_PACING_BURST: The number of full-sized segments that may be sent
+ * back-to-back when pacing (only used if LWIP_TCP_PACING==1). At high rates,
+ * the amount of data due within 2 ms may be sent at once, too.
+ */
+#if !defined TCP_PACING_BURST || defined __DOXYGEN__
+#define TCP_PACING_BURST                2
+#endif
+
+/**
+ * LWIP_TCP_RACK==1: Time-based loss detection: RACK (RFC 8985) marks a
+ * segment lost when a segment sent sufficiently later has been delivered,
+ * and a Tail Loss Probe (TLP) is sent when no ACK arrives for about two RTTs,
+ * so losses at the end of a flight are repaired by fast recovery instead of
+ * waiting for the retransmission timeout. Segments carry a millisecond
+ * transmit timestamp for this. Only used for connections that negotiated SACK.
+ * Requires LWIP_TCP_SACK_IN and LWIP_TIMERS_WHEEL (for sys_timeout_static()).
+ */
+#if !defined LWIP_TCP_RACK || defined __DOXYGEN__
+#define LWIP_TCP_RACK                   0
+#endif
+
+/**
+ * LWIP_TCP_FASTOPEN==1: TCP Fast Open (RFC 7413). Clients send a cookie
+ * request with their SYN and cache the cookie returned by the server (see
+ * TCP_FASTOPEN_CACHE_SIZE); later connections to that server carry up to
+ * one MSS of data written before the handshake completes in the SYN.
+ * Listeners generate and validate cookies (a keyed hash of the client
+ * address) and pass data received in a SYN with a valid cookie to the
+ * application right away. Such connections count against the listen backlog
+ * (TCP_LISTEN_BACKLOG) until the handshake completes. Enabled per pcb with
+ * tcp_fastopen_enable() or the TCP_FASTOPEN socket option / MSG_FASTOPEN flag.
+ * The cookie key is initialized from LWIP_RAND(); ports without it should
+ * set a secret key with tcp_fastopen_set_key().
+ */
+#if !defined LWIP_TCP_FASTOPEN || defined __DOXYGEN__
+#define LWIP_TCP_FASTOPEN               0
+#endif
+
+/**
+ * TCP_FASTOPEN_CACHE_SIZE: Number of servers (remote IP addresses) a
+ * TCP Fast Open client remembers cookies for (only used if
+ * LWIP_TCP_FASTOPEN==1). The least recently used entry is replaced.
+ */
+#if !defined TCP_FASTOPEN_CACHE_SIZE || defined __DOXYGEN__
+#define TCP_FASTOPEN_CACHE_SIZE         4
+#endif
+
+/**
+ * LWIP_TCP_SYN_REQ==1: Keep connections in state SYN_RCVD as small request
+ * entries (struct tcp_syn_req, allocated from MEMP_NUM_TCP_SYN_REQ) in a hash
+ * table of their listener instead of tcp_pcbs on tcp_active_pcbs. The
+ * SYN-ACK is sent (and retransmitted) without a pcb; the connection pcb is
+ * only allocated when the final ACK of the handshake arrives. SYNs with a
+ * TCP Fast Open option to a TCP Fast Open listener still get a pcb.
+ */
+#if !defined LWIP_TCP_SYN_REQ || defined __DOXYGEN__
+#define LWIP_TCP_SYN_REQ                0
+#endif
+
+/**
+ * TCP_SYN_REQ_HASH_SIZE: number of buckets in the request entry hash table
+ * of each listening pcb (only used if LWIP_TCP_SYN_REQ==1). Costs one
+ * pointer per bucket and listener.
+ */
+#if !defined TCP_SYN_REQ_HASH_SIZE || defined __DOXYGEN__
+#define TCP_SYN_REQ_HASH_SIZE           4
+#endif
+
+/**
+ * LWIP_TCP_TW_COMPACT==1: Replace the tcp_pcb of a connection in TIME_WAIT
+ * by a compact record (struct tcp_pcb_tw, allocated from MEMP_NUM_TCP_PCB_TW)
+ * holding only what is needed to answer retransmitted FINs for 2*TCP_MSL:
+ * the 4-tuple, snd_nxt/rcv_nxt, the window, the timestamp to echo and the
+ * TIME_WAIT timer. This is done as soon as the connection is in TIME_WAIT and
+ * the application has closed it (tcp_close()), so the tcp_pcb is available
+ * for new connections right away. Records are kept on their own list in the
+ * order they expire (not on tcp_tw_pcbs), so they are not listed by the SNMP
+ * TCP connection tables.
+ */
+#if !defined LWIP_TCP_TW_COMPACT || defined __DOXYGEN__
+#define LWIP_TCP_TW_COMPACT             0
+#endif
+
+/**
+ * LWIP_TCP_SYNCOOKIES==1: Answer SYNs to listening pcbs with a stateless
+ * SYN cookie instead of allocating a tcp_pcb while the stack is under
+ * pressure (see TCP_SYNCOOKIE_SYN_THRESHOLD and TCP_SYNCOOKIE_PCB_RESERVE).
+ * The peer's MSS is encoded in the initial sequence number (and window
+ * scale and SACK permitted in the timestamp if LWIP_TCP_TIMESTAMPS==1);
+ * the connection pcb is only created when the final ACK of the handshake
+ * returns a valid cookie. Like the TCP Fast Open key, the cookie key is
+ * initialized from LWIP_RAND() or set with tcp_syncookie_set_key().
+ */
+#if !defined LWIP_TCP_SYNCOOKIES || defined __DOXYGEN__
+#define LWIP_TCP_SYNCOOKIES             0
+#endif
+
+/**
+ * TCP_SYNCOOKIE_SYN_THRESHOLD: Number of half-open connections (in state
+ * SYN_RCVD, all listeners) from which new SYNs are answered with SYN cookies
+ * (only used if LWIP_TCP_SYNCOOKIES==1). With LWIP_TCP_SYN_REQ==1, the
+ * default is to use cookies once all request entries are in use.
+ */
+#if !defined TCP_SYNCOOKIE_SYN_THRESHOLD || defined __DOXYGEN__
+#if LWIP_TCP_SYN_REQ
+#define TCP_SYNCOOKIE_SYN_THRESHOLD     MEMP_NUM_TCP_SYN_REQ
+#else
+#define TCP_SYNCOOKIE_SYN_THRESHOLD     ((MEMP_NUM_TCP_PCB + 1) / 2)
+#endif
+#endif
+
+/**
+ * TCP_SYNCOOKIE_PCB_RESERVE: SYN cookies are used when fewer than this
+ * number of tcp_pcbs are free, so that half-open connections never make
+ * tcp_alloc() kill established connections (only used if
+ * LWIP_TCP_SYNCOOKIES==1).
+ */
+#if !defined TCP_SYNCOOKIE_PCB_RESERVE || defined __DOXYGEN__
+#define TCP_SYNCOOKIE_PCB_RESERVE       1
+#endif
+
 /**
  * TCP_WND_UPDATE_THRESHOLD: difference in window to trigger an
  * explicit window update
@@ -1390,6 +1874,41 @@
 #define TCP_RCV_SCALE                   0
 #endif
 
+/**
+ * LWIP_TCP_RCV_AUTOTUNE==1: Size the receive window of each connection by
+ * its needs instead of using TCP_WND for all of them. A connection starts
+ * with TCP_WND. Once per round-trip time, the stack checks how much the
+ * application consumed (tcp_recved()). If the application keeps up with the
+ * window, the window is grown to twice that amount, up to the per-pcb limit
+ * (tcp_set_rcvbuf(), SO_RCVBUF). The extra window of all connections is
+ * limited by TCP_RCV_AUTOTUNE_MEM and taken back when PBUF_POOL runs empty.
+ * The round-trip time is measured on the receive side by timing how long the
+ * peer takes to send one window of data.
+ * Without LWIP_WND_SCALE (or if the peer doesn't scale), the window can only
+ * grow to 64 KByte.
+ */
+#if !defined LWIP_TCP_RCV_AUTOTUNE || defined __DOXYGEN__
+#define LWIP_TCP_RCV_AUTOTUNE           0
+#endif
+
+/**
+ * TCP_RCV_AUTOTUNE_MAX: Default per-pcb limit of the receive window for
+ * LWIP_TCP_RCV_AUTOTUNE (bytes). Can be changed per pcb with tcp_set_rcvbuf()
+ * or SO_RCVBUF. Accepted pcbs inherit the limit of their listener.
+ */
+#if !defined TCP_RCV_AUTOTUNE_MAX || defined __DOXYGEN__
+#define TCP_RCV_AUTOTUNE_MAX            (4 * TCP_WND)
+#endif
+
+/**
+ * TCP_RCV_AUTOTUNE_MEM: Total number of bytes all pcbs together may grow their
+ * receive window beyond TCP_WND with LWIP_TCP_RCV_AUTOTUNE. This should fit
+ * the memory available for received data (PBUF_POOL).
+ */
+#if !defined TCP_RCV_AUTOTUNE_MEM || defined __DOXYGEN__
+#define TCP_RCV_AUTOTUNE_MEM            (4 * TCP_WND)
+#endif
+
 /** LWIP_ALTCP==1: enable the altcp API
  * altcp is an abstraction layer that prevents applications linking against the
  * tcp.h functions but provides the same functionality. It is used to e.g. add
@@ -1565,6 +2084,26 @@
 #define LWIP_NETIF_TX_SINGLE_PBUF             0
 #endif /* LWIP_NETIF_TX_SINGLE_PBUF */
 
+/**
+ * LWIP_NETIF_GRO==1: Support generic receive offload: for netifs that set
+ * netif->gro_max, received TCP segments that continue each other (same
+ * flow, in sequence, only ACK/PSH set, same options) are merged into one
+ * IP packet of up to gro_max bytes before IP input, so TCP processes (and
+ * acknowledges) them at once. Segments are held back until the driver calls
+ * netif_gro_flush() at the end of its receive burst.
+ */
+#if !defined LWIP_NETIF_GRO || defined __DOXYGEN__
+#define LWIP_NETIF_GRO                        0
+#endif /* LWIP_NETIF_GRO */
+
+/**
+ * NETIF_GRO_FLOWS: The number of TCP flows per netif that segments can be
+ * held back for at the same time (LWIP_NETIF_GRO).
+ */
+#if !defined NETIF_GRO_FLOWS || defined __DOXYGEN__
+#define NETIF_GRO_FLOWS                       4
+#endif /* NETIF_GRO_FLOWS */
+
 /**
  * LWIP_NUM_NETIF_CLIENT_DATA: Number of clients that may store
  * data in client_data member array of struct netif (max. 256).
@@ -2251,6 +2790,29 @@
 #if !defined LWIP_CHECKSUM_ON_COPY || defined __DOXYGEN__
 #define LWIP_CHECKSUM_ON_COPY           0
 #endif
+
+/**
+ * LWIP_CHECKSUM_OFFLOAD==1: Per-packet checksum offload. Drivers mark
+ * received packets whose TCP/UDP checksum the hardware has verified with
+ * PBUF_FLAG_CHKSUM_VERIFIED, so TCP and UDP don't check it again. On netifs
+ * that set NETIF_CHKSUM_PARTIAL_TCP/_UDP in netif->chksum_partial, TCP and
+ * UDP only put the pseudo header checksum into outgoing packets and leave
+ * the rest to the hardware (pbuf->chksum_start/chksum_offset), except for
+ * packets that are fragmented (completed in software) or looped back.
+ */
+#if !defined LWIP_CHECKSUM_OFFLOAD || defined __DOXYGEN__
+#define LWIP_CHECKSUM_OFFLOAD           0
+#endif
+
+/**
+ * LWIP_CHKSUM_SIMD==1: Use vectorized checksum kernels (SSE2/AVX2 on x86,
+ * NEON on ARM) as LWIP_CHKSUM, selected in lwip_init() according to the
+ * features of the CPU, with the LWIP_CHKSUM_ALGORITHM code as fallback.
+ * Needs GCC or clang. Don't define LWIP_CHKSUM with this.
+ */
+#if !defined LWIP_CHKSUM_SIMD || defined __DOXYGEN__
+#define LWIP_CHKSUM_SIMD                0
+#endif
 /**
  * @}
  */
@@ -3120,6 +3682,14 @@
 #if !defined LWIP_PERF || defined __DOXYGEN__
 #define LWIP_PERF                       0
 #endif
+
+/**
+ * LWIP_TESTMODE: Changes to make unit tests possible (exports otherwise
+ * static functions)
+ */
+#if !defined LWIP_TESTMODE
+#define LWIP_TESTMODE                   0
+#endif
 /**
  * @}
  */
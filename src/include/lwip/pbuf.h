@@ -50,9 +50,10 @@ extern "C" {
  * pbuf_alloced_custom()) and when pbuf_free gives up their last reference, they
  * are freed by calling pbuf_custom->custom_free_function().
  * Currently, the pbuf_custom code is only needed for one specific configuration
- * of IP_FRAG, unless required by external driver/application code. */
+ * of IP_FRAG (and for LWIP_TCP_ZEROCOPY), unless required by external
+ * driver/application code. */
 #ifndef LWIP_SUPPORT_CUSTOM_PBUF
-#define LWIP_SUPPORT_CUSTOM_PBUF ((IP_FRAG && !LWIP_NETIF_TX_SINGLE_PBUF) || (LWIP_IPV6 && LWIP_IPV6_FRAG))
+#define LWIP_SUPPORT_CUSTOM_PBUF ((IP_FRAG && !LWIP_NETIF_TX_SINGLE_PBUF) || (LWIP_IPV6 && LWIP_IPV6_FRAG) || (LWIP_TCP && LWIP_TCP_ZEROCOPY))
 #endif
 
 /** @ingroup pbuf 
@@ -181,6 +182,11 @@ typedef enum {
 #define PBUF_FLAG_LLMCAST   0x10U
 /** indicates this pbuf includes a TCP FIN flag */
 #define PBUF_FLAG_TCP_FIN   0x20U
+/** indicates this packet holds TCP segments merged by GRO (LWIP_NETIF_GRO) */
+#define PBUF_FLAG_GRO       0x40U
+/** indicates the TCP/UDP checksum of this received packet has been verified
+    (by the netif, LWIP_CHECKSUM_OFFLOAD, or by GRO) */
+#define PBUF_FLAG_CHKSUM_VERIFIED 0x80U
 
 /** Main packet buffer struct */
 struct pbuf {
@@ -219,6 +225,24 @@ struct pbuf {
 
   /** For incoming packets, this contains the input netif's index */
   u8_t if_idx;
+
+#if LWIP_TCP_TSO
+  /** For TCP super-segments, the payload size of the segments to cut it
+   * into (0 for other packets) */
+  u16_t tso_mss;
+#endif /* LWIP_TCP_TSO */
+
+#if LWIP_CHECKSUM_OFFLOAD
+  /** For outgoing packets whose TCP/UDP checksum the netif completes, the
+   * offset of the TCP/UDP header from the IP header (set by IP output) */
+  u16_t chksum_start;
+  /** For outgoing packets whose TCP/UDP checksum the netif completes, the
+   * offset of the checksum field from chksum_start, 0 if the checksum is
+   * complete. The field holds the pseudo header checksum (not inverted):
+   * the netif sums up from chksum_start to the end and stores the
+   * inverted sum there. */
+  u16_t chksum_offset;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
 };
 
 
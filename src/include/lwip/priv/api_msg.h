@@ -49,6 +49,7 @@
 #include "lwip/sys.h"
 #include "lwip/igmp.h"
 #include "lwip/api.h"
+#include "lwip/tcp.h"
 #include "lwip/priv/tcpip_priv.h"
 
 #ifdef __cplusplus
@@ -147,6 +148,12 @@ struct api_msg {
       u8_t backlog;
     } lb;
 #endif /* TCP_LISTEN_BACKLOG */
+#if LWIP_TCP && LWIP_TCP_INFO
+    /** used for lwip_netconn_do_tcp_info */
+    struct {
+      struct tcp_info API_MSG_M_DEF(info);
+    } ti;
+#endif /* LWIP_TCP && LWIP_TCP_INFO */
   } msg;
 #if LWIP_NETCONN_SEM_PER_THREAD
   sys_sem_t* op_completed_sem;
@@ -203,6 +210,9 @@ void lwip_netconn_do_write           (void *m);
 void lwip_netconn_do_getaddr         (void *m);
 void lwip_netconn_do_close           (void *m);
 void lwip_netconn_do_shutdown        (void *m);
+#if LWIP_TCP && LWIP_TCP_INFO
+void lwip_netconn_do_tcp_info        (void *m);
+#endif /* LWIP_TCP && LWIP_TCP_INFO */
 #if LWIP_IGMP || (LWIP_IPV6 && LWIP_IPV6_MLD)
 void lwip_netconn_do_join_leave_group(void *m);
 #endif /* LWIP_IGMP || (LWIP_IPV6 && LWIP_IPV6_MLD) */
@@ -52,6 +52,19 @@ LWIP_MEMPOOL(TCP_PCB_LISTEN, MEMP_NUM_TCP_PCB_LISTEN,  sizeof(struct tcp_pcb_lis
 LWIP_MEMPOOL(TCP_SEG,        MEMP_NUM_TCP_SEG,         sizeof(struct tcp_seg),        "TCP_SEG")
 #endif /* LWIP_TCP */
 
+#if LWIP_TCP && LWIP_TCP_SYN_REQ
+LWIP_MEMPOOL(TCP_SYN_REQ,    MEMP_NUM_TCP_SYN_REQ,     sizeof(struct tcp_syn_req),    "TCP_SYN_REQ")
+#endif /* LWIP_TCP && LWIP_TCP_SYN_REQ */
+
+#if LWIP_TCP && LWIP_TCP_TW_COMPACT
+LWIP_MEMPOOL(TCP_PCB_TW,     MEMP_NUM_TCP_PCB_TW,      sizeof(struct tcp_pcb_tw),     "TCP_PCB_TW")
+#endif /* LWIP_TCP && LWIP_TCP_TW_COMPACT */
+
+#if LWIP_TCP && LWIP_TCP_ZEROCOPY
+LWIP_MEMPOOL(TCP_ZC,         MEMP_NUM_TCP_ZC,          sizeof(struct tcp_zc),         "TCP_ZC")
+LWIP_MEMPOOL(TCP_ZC_PBUF,    MEMP_NUM_TCP_ZC_PBUF,     sizeof(struct tcp_zc_pbuf),    "TCP_ZC_PBUF")
+#endif /* LWIP_TCP && LWIP_TCP_ZEROCOPY */
+
 #if LWIP_ALTCP && LWIP_TCP
 LWIP_MEMPOOL(ALTCP_PCB,      MEMP_NUM_ALTCP_PCB,       sizeof(struct altcp_pcb),      "ALTCP_PCB")
 #endif /* LWIP_ALTCP && LWIP_TCP */
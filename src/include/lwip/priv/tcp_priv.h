@@ -62,10 +62,12 @@ void             tcp_init    (void);  /* Initialize this module. */
 void             tcp_tmr     (void);  /* Must be called every
                                          TCP_TMR_INTERVAL
                                          ms. (Typically 250 ms). */
+#if !LWIP_TCP_PCB_TIMERS
 /* It is also possible to call these two functions at the right
    intervals (instead of calling tcp_tmr()). */
 void             tcp_slowtmr (void);
 void             tcp_fasttmr (void);
+#endif /* !LWIP_TCP_PCB_TIMERS */
 
 /* Call this from a netif driver (watch out for threading issues!) that has
    returned a memory error on transmit and now has free buffers to send more.
@@ -84,6 +86,167 @@ err_t            tcp_rexmit_rto_prepare(struct tcp_pcb *pcb);
 void             tcp_rexmit_rto_commit(struct tcp_pcb *pcb);
 void             tcp_rexmit_rto  (struct tcp_pcb *pcb);
 void             tcp_rexmit_fast (struct tcp_pcb *pcb);
+#if LWIP_TCP_SACK_IN
+void             tcp_rexmit_sack (struct tcp_pcb *pcb, u8_t force);
+#endif /* LWIP_TCP_SACK_IN */
+#if LWIP_TCP_RACK
+void             tcp_rack_update (struct tcp_pcb *pcb, const struct tcp_seg *seg);
+u8_t             tcp_rack_lost   (const struct tcp_pcb *pcb, const struct tcp_seg *seg);
+void             tcp_rack_ack    (struct tcp_pcb *pcb);
+void             tcp_rack_sent   (struct tcp_pcb *pcb);
+void             tcp_rack_stop   (struct tcp_pcb *pcb);
+err_t            tcp_rexmit_last (struct tcp_pcb *pcb);
+/** RACK: is this (not SACKed) segment lost? */
+#define TCP_RACK_IS_LOST(pcb, seg) tcp_rack_lost(pcb, seg)
+#else /* LWIP_TCP_RACK */
+#define TCP_RACK_IS_LOST(pcb, seg) 0
+#endif /* LWIP_TCP_RACK */
+#if LWIP_TCP_FASTOPEN
+void             tcp_fastopen_init(void);
+void             tcp_fastopen_cookie_gen(const ip_addr_t *addr, u8_t *cookie);
+u8_t             tcp_fastopen_cookie_valid(const ip_addr_t *addr, const u8_t *cookie, u8_t len);
+u8_t             tcp_fastopen_cookie_get(const ip_addr_t *addr, u8_t *cookie, u16_t *mss);
+void             tcp_fastopen_cookie_set(const ip_addr_t *addr, const u8_t *cookie, u8_t len, u16_t mss);
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_FASTOPEN || LWIP_TCP_SYNCOOKIES
+u64_t            tcp_siphash(const u8_t *key, const u8_t *data, u16_t len);
+#endif /* LWIP_TCP_FASTOPEN || LWIP_TCP_SYNCOOKIES */
+#if LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ
+/** Options of a segment to a listening pcb (a SYN or the ACK returning a
+ * SYN cookie), parsed without a pcb */
+struct tcp_syn_opts {
+  /** MSS option (INITIAL_MSS if not present) */
+  u16_t mss;
+  /** window scale option (TCP_SYN_OPTS_NO_WS if not present) */
+  u8_t snd_scale;
+  /** SACK permitted option present */
+  u8_t sack_perm;
+  /** timestamp option present */
+  u8_t ts;
+#if LWIP_TCP_FASTOPEN
+  /** TCP Fast Open option present */
+  u8_t fastopen;
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_ECN
+  /** ECN-setup SYN (ECE and CWR set) */
+  u8_t ecn;
+#endif /* LWIP_TCP_ECN */
+  u32_t tsval;
+  u32_t tsecr;
+};
+#define TCP_SYN_OPTS_NO_WS 0xFFU
+
+void             tcp_synack  (const struct tcp_pcb_listen *lpcb, u32_t iss, u32_t ackno,
+                              const ip_addr_t *local_ip, const ip_addr_t *remote_ip,
+                              u16_t remote_port, const struct tcp_syn_opts *opts, u32_t tsval);
+#endif /* LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ */
+#if LWIP_TCP_SYN_REQ
+/** A connection in state SYN_RCVD kept by its listener without a tcp_pcb */
+struct tcp_syn_req {
+  struct tcp_syn_req *next;
+  ip_addr_t local_ip;
+  ip_addr_t remote_ip;
+  u16_t remote_port;
+  /** number of SYN-ACK retransmissions */
+  u8_t nrtx;
+  /** our initial sequence number */
+  u32_t iss;
+  /** sequence number of the SYN + 1 */
+  u32_t rcv_nxt;
+  /** tcp_ticks when the SYN was received */
+  u32_t tmr;
+  /** tcp_ticks when the SYN-ACK is retransmitted next */
+  u32_t rtime;
+  /** options of the SYN */
+  struct tcp_syn_opts opts;
+};
+
+struct tcp_syn_req *tcp_syn_req_find(struct tcp_pcb_listen *lpcb, const ip_addr_t *local_ip,
+                                     const ip_addr_t *remote_ip, u16_t remote_port);
+struct tcp_syn_req *tcp_syn_req_new (struct tcp_pcb_listen *lpcb, const ip_addr_t *local_ip,
+                                     const ip_addr_t *remote_ip, u16_t remote_port,
+                                     u32_t rcv_nxt, const struct tcp_syn_opts *opts);
+void             tcp_syn_req_free(struct tcp_pcb_listen *lpcb, struct tcp_syn_req *req);
+void             tcp_syn_req_free_all(struct tcp_pcb_listen *lpcb);
+void             tcp_syn_req_synack(const struct tcp_pcb_listen *lpcb, const struct tcp_syn_req *req);
+void             tcp_syn_req_tmr(void);
+#endif /* LWIP_TCP_SYN_REQ */
+#if LWIP_TCP_TW_COMPACT
+/** A connection in TIME_WAIT closed by the application, kept on
+ * tcp_tw_records instead of its tcp_pcb. */
+struct tcp_pcb_tw {
+  /** next record on tcp_tw_records (which expires at the same time or later) */
+  struct tcp_pcb_tw *next;
+#if LWIP_TCP_PCB_HASH
+  struct tcp_pcb_tw *hash_next;
+#endif /* LWIP_TCP_PCB_HASH */
+  ip_addr_t local_ip;
+  ip_addr_t remote_ip;
+  u16_t local_port;
+  u16_t remote_port;
+  u32_t snd_nxt;
+  u32_t rcv_nxt;
+  /** tcp_ticks when the record expires */
+  u32_t expires;
+#if LWIP_TCP_TIMESTAMPS
+  u32_t ts_recent;
+#endif /* LWIP_TCP_TIMESTAMPS */
+  tcpwnd_size_t rcv_wnd;
+  /** window field of our ACKs (already scaled) */
+  u16_t wnd;
+  u8_t netif_idx;
+  u8_t tos;
+  u8_t ttl;
+#if LWIP_TCP_TIMESTAMPS
+  /** the timestamp option is in use */
+  u8_t ts;
+#endif /* LWIP_TCP_TIMESTAMPS */
+};
+
+/** List of all compact TIME_WAIT records, oldest (first to expire) first */
+extern struct tcp_pcb_tw *tcp_tw_records;
+
+void tcp_tw_compact(struct tcp_pcb *pcb);
+void tcp_tw_free_all(void);
+void tcp_tw_restart(struct tcp_pcb_tw *tw);
+struct tcp_pcb_tw *tcp_tw_lookup(const ip_addr_t *local_ip, u16_t local_port,
+                                 const ip_addr_t *remote_ip, u16_t remote_port,
+                                 const struct netif *inp);
+void tcp_tw_ack(const struct tcp_pcb_tw *tw);
+#if !LWIP_TCP_PCB_TIMERS
+void tcp_tw_tmr(void);
+#endif /* !LWIP_TCP_PCB_TIMERS */
+#define TCP_TW_RECORDS_PENDING() (tcp_tw_records != NULL)
+#else /* LWIP_TCP_TW_COMPACT */
+#define TCP_TW_RECORDS_PENDING() 0
+#endif /* LWIP_TCP_TW_COMPACT */
+#if LWIP_TCP_SYNCOOKIES
+/** number of pcbs in state SYN_RCVD */
+extern u16_t tcp_syn_rcvd_pending;
+/** number of tcp_pcbs allocated by tcp_alloc() */
+extern u16_t tcp_pcbs_used;
+/** Call when a pcb leaves state SYN_RCVD or is removed */
+#define TCP_SYN_RCVD_DONE(pcb) do { if ((pcb)->state == SYN_RCVD) { \
+  LWIP_ASSERT("tcp_syn_rcvd_pending != 0", tcp_syn_rcvd_pending != 0); \
+  tcp_syn_rcvd_pending--; } } while(0)
+
+void             tcp_syncookie_init(void);
+u8_t             tcp_syncookie_needed(void);
+u32_t            tcp_syncookie_gen(const ip_addr_t *local_ip, const ip_addr_t *remote_ip,
+                                   u16_t local_port, u16_t remote_port, u32_t peer_iss,
+                                   const struct tcp_syn_opts *opts);
+u8_t             tcp_syncookie_check(const ip_addr_t *local_ip, const ip_addr_t *remote_ip,
+                                     u16_t local_port, u16_t remote_port, u32_t peer_iss,
+                                     u32_t cookie, struct tcp_syn_opts *opts);
+#if LWIP_TCP_TIMESTAMPS
+u32_t            tcp_syncookie_tsval(const struct tcp_syn_opts *opts);
+#endif /* LWIP_TCP_TIMESTAMPS */
+#else /* LWIP_TCP_SYNCOOKIES */
+#define TCP_SYN_RCVD_DONE(pcb)
+#endif /* LWIP_TCP_SYNCOOKIES */
+/** Call an optional congestion control hook */
+#define TCP_CC_EVENT(pcb, event) do { \
+  if ((pcb)->cc->event != NULL) { (pcb)->cc->event(pcb); } } while(0)
 u32_t            tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb);
 err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 
@@ -100,7 +263,7 @@ err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
                             ((tpcb)->flags & (TF_NODELAY | TF_INFR)) || \
                             (((tpcb)->unsent != NULL) && (((tpcb)->unsent->next != NULL) || \
                               ((tpcb)->unsent->len >= (tpcb)->mss))) || \
-                            ((tcp_sndbuf(tpcb) == 0) || (tcp_sndqueuelen(tpcb) >= TCP_SND_QUEUELEN)) \
+                            ((tcp_sndbuf(tpcb) == 0) || (tcp_sndqueuelen(tpcb) >= TCP_SND_QUEUELEN_MAX(tpcb))) \
                             ) ? 1 : 0)
 #define tcp_output_nagle(tpcb) (tcp_do_output_nagle(tpcb) ? tcp_output(tpcb) : ERR_OK)
 
@@ -136,6 +299,13 @@ err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 #define TCP_MSL 60000UL /* The maximum segment lifetime in milliseconds */
 #endif
 
+/* As initial send MSS, we use TCP_MSS but limit it to 536. */
+#if TCP_MSS > 536
+#define INITIAL_MSS 536
+#else
+#define INITIAL_MSS TCP_MSS
+#endif
+
 /* Keepalive values, compliant with RFC 1122. Don't change this unless you know what you're doing */
 #ifndef  TCP_KEEPIDLE_DEFAULT
 #define  TCP_KEEPIDLE_DEFAULT     7200000UL /* Default KEEPALIVE timer in milliseconds */
@@ -260,13 +430,25 @@ struct tcp_seg {
   u16_t chksum;
   u8_t  chksum_swapped;
 #endif /* TCP_CHECKSUM_ON_COPY */
-  u8_t  flags;
-#define TF_SEG_OPTS_MSS         (u8_t)0x01U /* Include MSS option. */
-#define TF_SEG_OPTS_TS          (u8_t)0x02U /* Include timestamp option. */
-#define TF_SEG_DATA_CHECKSUMMED (u8_t)0x04U /* ALL data (not the header) is
+#if LWIP_TCP_RACK
+  u32_t xmit_time;         /* sys_now() when this segment was last sent */
+#endif /* LWIP_TCP_RACK */
+#if LWIP_TCP_OOSEQ_TREE
+  struct tcp_seg *oos_left;  /* children in pcb->ooseq_root (ooseq only) */
+  struct tcp_seg *oos_right;
+#endif /* LWIP_TCP_OOSEQ_TREE */
+  u16_t flags;
+#define TF_SEG_OPTS_MSS         (u16_t)0x01U /* Include MSS option. */
+#define TF_SEG_OPTS_TS          (u16_t)0x02U /* Include timestamp option. */
+#define TF_SEG_DATA_CHECKSUMMED (u16_t)0x04U /* ALL data (not the header) is
                                                checksummed into 'chksum' */
-#define TF_SEG_OPTS_WND_SCALE   (u8_t)0x08U /* Include WND SCALE option */
-#define TF_SEG_OPTS_SACK_PERM   (u8_t)0x10U /* Include SACK Permitted option */
+#define TF_SEG_OPTS_WND_SCALE   (u16_t)0x08U /* Include WND SCALE option */
+#define TF_SEG_OPTS_SACK_PERM   (u16_t)0x10U /* Include SACK Permitted option */
+#define TF_SEG_SACKED           (u16_t)0x20U /* Segment SACKed by the remote host (LWIP_TCP_SACK_IN) */
+#define TF_SEG_SACK_REXMIT      (u16_t)0x40U /* Segment retransmitted in current SACK-based recovery */
+#define TF_SEG_REXMIT           (u16_t)0x80U /* Segment has been retransmitted (LWIP_TCP_RACK) */
+#define TF_SEG_OPTS_FASTOPEN    (u16_t)0x100U /* Include TCP Fast Open option with cookie */
+#define TF_SEG_OPTS_FASTOPEN_REQ (u16_t)0x200U /* Include TCP Fast Open cookie request */
   struct tcp_hdr *tcphdr;  /* the TCP header */
 };
 
@@ -275,7 +457,9 @@ struct tcp_seg {
 #define LWIP_TCP_OPT_MSS        2
 #define LWIP_TCP_OPT_WS         3
 #define LWIP_TCP_OPT_SACK_PERM  4
+#define LWIP_TCP_OPT_SACK       5
 #define LWIP_TCP_OPT_TS         8
+#define LWIP_TCP_OPT_FASTOPEN   34
 
 #define LWIP_TCP_OPT_LEN_MSS    4
 #if LWIP_TCP_TIMESTAMPS
@@ -298,11 +482,23 @@ struct tcp_seg {
 #define LWIP_TCP_OPT_LEN_SACK_PERM_OUT 0
 #endif
 
+#if LWIP_TCP_FASTOPEN
+/* cookies we send (and cache) are at most 8 bytes: kind, len, cookie and NOP padding */
+#define TCP_FASTOPEN_COOKIE_LEN            8
+#define LWIP_TCP_OPT_LEN_FASTOPEN_OUT      12 /* aligned for output (includes NOP padding) */
+#define LWIP_TCP_OPT_LEN_FASTOPEN_REQ_OUT  4  /* aligned for output (includes NOP padding) */
+#else
+#define LWIP_TCP_OPT_LEN_FASTOPEN_OUT      0
+#define LWIP_TCP_OPT_LEN_FASTOPEN_REQ_OUT  0
+#endif
+
 #define LWIP_TCP_OPT_LENGTH(flags) \
   (flags & TF_SEG_OPTS_MSS       ? LWIP_TCP_OPT_LEN_MSS           : 0) + \
   (flags & TF_SEG_OPTS_TS        ? LWIP_TCP_OPT_LEN_TS_OUT        : 0) + \
   (flags & TF_SEG_OPTS_WND_SCALE ? LWIP_TCP_OPT_LEN_WS_OUT        : 0) + \
-  (flags & TF_SEG_OPTS_SACK_PERM ? LWIP_TCP_OPT_LEN_SACK_PERM_OUT : 0)
+  (flags & TF_SEG_OPTS_SACK_PERM ? LWIP_TCP_OPT_LEN_SACK_PERM_OUT : 0) + \
+  (flags & TF_SEG_OPTS_FASTOPEN  ? LWIP_TCP_OPT_LEN_FASTOPEN_OUT  : 0) + \
+  (flags & TF_SEG_OPTS_FASTOPEN_REQ ? LWIP_TCP_OPT_LEN_FASTOPEN_REQ_OUT : 0)
 
 /** This returns a TCP header option for MSS in an u32_t */
 #define TCP_BUILD_MSS_OPTION(mss) lwip_htonl(0x02040000 | ((mss) & 0xFFFF))
@@ -340,6 +536,41 @@ extern struct tcp_pcb *tcp_tw_pcbs;      /* List of all TCP PCBs in TIME-WAIT. *
 #define NUM_TCP_PCB_LISTS               4
 extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
 
+#if LWIP_TCP_PCB_HASH
+/* Hash tables used to demultiplex incoming segments (see LWIP_TCP_PCB_HASH).
+   PCBs on tcp_active_pcbs and tcp_tw_pcbs are hashed by their 4-tuple,
+   PCBs on tcp_listen_pcbs are hashed by their local port. */
+extern struct tcp_pcb *tcp_pcb_hash[TCP_PCB_HASH_SIZE];
+extern struct tcp_pcb_listen *tcp_listen_pcb_hash[TCP_LISTEN_PCB_HASH_SIZE];
+
+u32_t tcp_pcb_hash_idx(const ip_addr_t *local_ip, u16_t local_port,
+                       const ip_addr_t *remote_ip, u16_t remote_port);
+void tcp_pcb_hash_add(struct tcp_pcb **pcbs, struct tcp_pcb *pcb);
+void tcp_pcb_hash_remove(struct tcp_pcb **pcbs, struct tcp_pcb *pcb);
+struct tcp_pcb *tcp_pcb_hash_lookup(const ip_addr_t *local_ip, u16_t local_port,
+                                    const ip_addr_t *remote_ip, u16_t remote_port,
+                                    const struct netif *inp);
+struct tcp_pcb_listen *tcp_listen_pcb_hash_lookup(const ip_addr_t *local_ip, u16_t local_port,
+                                                  const struct netif *inp);
+#define TCP_PCB_HASH_ADD(pcbs, npcb) tcp_pcb_hash_add(pcbs, npcb)
+#define TCP_PCB_HASH_RMV(pcbs, npcb) tcp_pcb_hash_remove(pcbs, npcb)
+#else /* LWIP_TCP_PCB_HASH */
+#define TCP_PCB_HASH_ADD(pcbs, npcb)
+#define TCP_PCB_HASH_RMV(pcbs, npcb)
+#endif /* LWIP_TCP_PCB_HASH */
+
+#if LWIP_TCP_PCB_TIMERS
+/* With per-pcb timers, tcp_ticks is derived from sys_now() when entering TCP
+   (tcp_input, tcp_output, pcb timers...) instead of being counted by tcp_slowtmr(). */
+void tcp_ticks_update(void);
+#define TCP_TICKS_UPDATE()     tcp_ticks_update()
+/* (Re-)arm the pcb's timeout after its timer state may have changed */
+#define TCP_TIMER_UPDATE(pcb)  tcp_timer_update(pcb)
+#else /* LWIP_TCP_PCB_TIMERS */
+#define TCP_TICKS_UPDATE()
+#define TCP_TIMER_UPDATE(pcb)
+#endif /* LWIP_TCP_PCB_TIMERS */
+
 /* Axioms about the above lists:
    1) Every TCP PCB that is not CLOSED is in one of the lists.
    2) A PCB is only in one of the lists.
@@ -364,6 +595,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                             (npcb)->next = *(pcbs); \
                             LWIP_ASSERT("TCP_REG: npcb->next != npcb", (npcb)->next != (npcb)); \
                             *(pcbs) = (npcb); \
+                            TCP_PCB_HASH_ADD(pcbs, npcb); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
               tcp_timer_needed(); \
                             } while(0)
@@ -380,6 +612,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                                } \
                             } \
                             (npcb)->next = NULL; \
+                            TCP_PCB_HASH_RMV(pcbs, npcb); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
                             LWIP_DEBUGF(TCP_DEBUG, ("TCP_RMV: removed %p from %p\n", (npcb), *(pcbs))); \
                             } while(0)
@@ -390,6 +623,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
   do {                                             \
     (npcb)->next = *pcbs;                          \
     *(pcbs) = (npcb);                              \
+    TCP_PCB_HASH_ADD(pcbs, npcb);                  \
     tcp_timer_needed();                            \
   } while (0)
 
@@ -410,6 +644,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
       }                                            \
     }                                              \
     (npcb)->next = NULL;                           \
+    TCP_PCB_HASH_RMV(pcbs, npcb);                  \
   } while(0)
 
 #endif /* LWIP_DEBUG */
@@ -437,6 +672,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
 struct tcp_pcb *tcp_pcb_copy(struct tcp_pcb *pcb);
 void tcp_pcb_purge(struct tcp_pcb *pcb);
 void tcp_pcb_remove(struct tcp_pcb **pcblist, struct tcp_pcb *pcb);
+void tcp_free(struct tcp_pcb *pcb);
 
 void tcp_segs_free(struct tcp_seg *seg);
 void tcp_seg_free(struct tcp_seg *seg);
@@ -466,6 +702,12 @@ void tcp_rst(const struct tcp_pcb* pcb, u32_t seqno, u32_t ackno,
        u16_t local_port, u16_t remote_port);
 
 u32_t tcp_next_iss(struct tcp_pcb *pcb);
+#if LWIP_TCP_SYN_REQ
+u32_t tcp_next_iss_addr(const ip_addr_t *local_ip, u16_t local_port,
+                        const ip_addr_t *remote_ip, u16_t remote_port);
+#endif /* LWIP_TCP_SYN_REQ */
+
+u32_t tcp_srtt_ms(const struct tcp_pcb *pcb);
 
 err_t tcp_keepalive(struct tcp_pcb *pcb);
 err_t tcp_zero_window_probe(struct tcp_pcb *pcb);
@@ -506,6 +748,104 @@ void tcp_netif_ip_addr_changed(const ip_addr_t* old_addr, const ip_addr_t* new_a
 void tcp_free_ooseq(struct tcp_pcb *pcb);
 #endif
 
+#if LWIP_TCP_OOSEQ_TREE
+void tcp_ooseq_tree_insert(struct tcp_pcb *pcb, struct tcp_seg *seg);
+void tcp_ooseq_tree_remove(struct tcp_pcb *pcb, struct tcp_seg *seg);
+struct tcp_seg *tcp_ooseq_tree_lookup(struct tcp_pcb *pcb, u32_t seqno);
+#define TCP_OOSEQ_TREE_REMOVE(pcb, seg) tcp_ooseq_tree_remove(pcb, seg)
+#define TCP_OOSEQ_TREE_CLEAR(pcb)       ((pcb)->ooseq_root = NULL)
+#else /* LWIP_TCP_OOSEQ_TREE */
+#define TCP_OOSEQ_TREE_REMOVE(pcb, seg)
+#define TCP_OOSEQ_TREE_CLEAR(pcb)
+#endif /* LWIP_TCP_OOSEQ_TREE */
+
+#if LWIP_TCP_INFO
+#define TCP_INFO_INC(pcb, cnt)         ++(pcb)->cnt
+#define TCP_INFO_ADD(pcb, cnt, n)      ((pcb)->cnt += (n))
+#else /* LWIP_TCP_INFO */
+#define TCP_INFO_INC(pcb, cnt)
+#define TCP_INFO_ADD(pcb, cnt, n)
+#endif /* LWIP_TCP_INFO */
+
+#if LWIP_TCP_OOSEQ_MEM
+u16_t tcp_ooseq_prune(struct tcp_pcb *pcb, u16_t pbufs);
+void tcp_ooseq_mem_add(struct tcp_pcb *pcb, u16_t pbufs);
+void tcp_ooseq_mem_sub(struct tcp_pcb *pcb, u16_t pbufs);
+void tcp_ooseq_mem_check(void);
+void tcp_ooseq_mem_reclaim(void);
+#define TCP_OOSEQ_MEM_ADD(pcb, pbufs)  tcp_ooseq_mem_add(pcb, pbufs)
+#define TCP_OOSEQ_MEM_SUB(pcb, pbufs)  tcp_ooseq_mem_sub(pcb, pbufs)
+#define TCP_OOSEQ_MEM_CHECK()          tcp_ooseq_mem_check()
+#else /* LWIP_TCP_OOSEQ_MEM */
+#define TCP_OOSEQ_MEM_ADD(pcb, pbufs)
+#define TCP_OOSEQ_MEM_SUB(pcb, pbufs)
+#define TCP_OOSEQ_MEM_CHECK()
+#endif /* LWIP_TCP_OOSEQ_MEM */
+
+#if LWIP_TCP_RCV_AUTOTUNE
+void tcp_rcv_autotune_init(struct tcp_pcb *pcb);
+void tcp_rcv_rtt_measure(struct tcp_pcb *pcb);
+void tcp_rcv_autotune(struct tcp_pcb *pcb, u16_t len);
+void tcp_rcv_autotune_free(struct tcp_pcb *pcb);
+void tcp_rcv_autotune_reclaim(void);
+#define TCP_RCV_AUTOTUNE_INIT(pcb)     tcp_rcv_autotune_init(pcb)
+#define TCP_RCV_RTT_MEASURE(pcb)       tcp_rcv_rtt_measure(pcb)
+#define TCP_RCV_AUTOTUNE(pcb, len)     tcp_rcv_autotune(pcb, len)
+#define TCP_RCV_AUTOTUNE_FREE(pcb)     tcp_rcv_autotune_free(pcb)
+#else /* LWIP_TCP_RCV_AUTOTUNE */
+#define TCP_RCV_AUTOTUNE_INIT(pcb)
+#define TCP_RCV_RTT_MEASURE(pcb)
+#define TCP_RCV_AUTOTUNE(pcb, len)
+#define TCP_RCV_AUTOTUNE_FREE(pcb)
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+
+#if LWIP_TCP_SNDBUF_PCB
+void tcp_sndbuf_update(struct tcp_pcb *pcb);
+void tcp_sndbuf_free(struct tcp_pcb *pcb);
+#define TCP_SNDBUF_UPDATE(pcb)         tcp_sndbuf_update(pcb)
+#define TCP_SNDBUF_FREE(pcb)           tcp_sndbuf_free(pcb)
+#else /* LWIP_TCP_SNDBUF_PCB */
+#define TCP_SNDBUF_UPDATE(pcb)
+#define TCP_SNDBUF_FREE(pcb)
+#endif /* LWIP_TCP_SNDBUF_PCB */
+
+#if IP_PMTUD
+void tcp_split_unsent(struct tcp_pcb *pcb);
+void tcp_pmtu_icmp(const ip4_addr_t *local_ip, const ip4_addr_t *remote_ip,
+                   u16_t local_port, u16_t remote_port, u32_t seqno, u16_t mtu, u16_t len);
+void tcp_pmtu_probe(struct tcp_pcb *pcb);
+#endif /* IP_PMTUD */
+#if LWIP_TCP_PLPMTUD
+void tcp_pmtu_blackhole(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_PLPMTUD */
+
+#if LWIP_TCP_ZEROCOPY
+/** A buffer written with tcp_write_ref() */
+struct tcp_zc {
+  /** next buffer of the same pcb (pcb->zc) */
+  struct tcp_zc *next;
+  /** the pcb, NULL after the pcb has been freed */
+  struct tcp_pcb *pcb;
+  /** callback and argument of the freed pcb */
+  tcp_zc_done_fn done;
+  void *arg;
+  void *cookie;
+  u16_t len;
+  /** number of pbufs referencing the buffer */
+  u16_t refs;
+};
+
+/** A pbuf referencing (a part of) a buffer written with tcp_write_ref() */
+struct tcp_zc_pbuf {
+  struct pbuf_custom pc;
+  struct tcp_zc *zc;
+};
+
+struct pbuf *tcp_zc_pbuf_alloc(struct tcp_zc *zc, const void *payload, u16_t len);
+err_t        tcp_zc_report(struct tcp_pcb *pcb);
+void         tcp_zc_free(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_ZEROCOPY */
+
 #ifdef __cplusplus
 }
 #endif
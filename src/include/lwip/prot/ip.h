@@ -45,6 +45,14 @@
 #define IP_PROTO_UDPLITE 136
 #define IP_PROTO_TCP     6
 
+/* ECN field (RFC 3168): the low two bits of the IPv4 TOS and the IPv6
+   traffic class */
+#define IP_ECN_MASK      0x03U
+#define IP_ECN_NOT_ECT   0x00U
+#define IP_ECN_ECT1      0x01U
+#define IP_ECN_ECT0      0x02U
+#define IP_ECN_CE        0x03U
+
 /** This operates on a void* by loading the first byte */
 #define IP_HDR_GET_VERSION(ptr)   ((*(u8_t*)(ptr)) >> 4)
 
@@ -45,6 +45,8 @@ extern "C" {
 
 /* Length of the TCP header, excluding options. */
 #define TCP_HLEN 20
+/* Offset of the checksum field in the TCP header. */
+#define TCP_CHKSUM_OFFSET 16
 
 /* Fields are (of course) in network byte order.
  * Some fields are converted to host byte order in tcp_input().
@@ -83,6 +85,8 @@ PACK_STRUCT_END
 #define TCPH_HDRLEN(phdr) ((u16_t)(lwip_ntohs((phdr)->_hdrlen_rsvd_flags) >> 12))
 #define TCPH_HDRLEN_BYTES(phdr) ((u8_t)(TCPH_HDRLEN(phdr) << 2))
 #define TCPH_FLAGS(phdr)  ((u8_t)((lwip_ntohs((phdr)->_hdrlen_rsvd_flags) & TCP_FLAGS)))
+/* ECN flags (not included in TCP_FLAGS) */
+#define TCPH_ECN_FLAGS(phdr) ((u8_t)((lwip_ntohs((phdr)->_hdrlen_rsvd_flags) & (TCP_ECE | TCP_CWR))))
 
 #define TCPH_HDRLEN_SET(phdr, len) (phdr)->_hdrlen_rsvd_flags = lwip_htons(((len) << 12) | TCPH_FLAGS(phdr))
 #define TCPH_FLAGS_SET(phdr, flags) (phdr)->_hdrlen_rsvd_flags = (((phdr)->_hdrlen_rsvd_flags & PP_HTONS(~TCP_FLAGS)) | lwip_htons(flags))
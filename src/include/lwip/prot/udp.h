@@ -44,6 +44,8 @@ extern "C" {
 #endif
 
 #define UDP_HLEN 8
+/* Offset of the checksum field in the UDP header. */
+#define UDP_CHKSUM_OFFSET 6
 
 /* Fields are (of course) in network byte order. */
 #ifdef PACK_STRUCT_USE_INCLUDES
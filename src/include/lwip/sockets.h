@@ -206,7 +206,7 @@ struct ifreq {
 #define SO_DONTLINGER   ((int)(~SO_LINGER))
 #define SO_OOBINLINE    0x0100 /* Unimplemented: leave received OOB data in line */
 #define SO_REUSEPORT    0x0200 /* Unimplemented: allow local address & port reuse */
-#define SO_SNDBUF       0x1001 /* Unimplemented: send buffer size */
+#define SO_SNDBUF       0x1001 /* send buffer size (TCP only, LWIP_TCP_SNDBUF_PCB) */
 #define SO_RCVBUF       0x1002 /* receive buffer size */
 #define SO_SNDLOWAT     0x1003 /* Unimplemented: send low-water mark */
 #define SO_RCVLOWAT     0x1004 /* Unimplemented: receive low-water mark */
@@ -217,6 +217,7 @@ struct ifreq {
 #define SO_CONTIMEO     0x1009 /* Unimplemented: connect timeout */
 #define SO_NO_CHECK     0x100a /* don't create UDP checksum */
 #define SO_BINDTODEVICE 0x100b /* bind to device */
+#define SO_MAX_PACING_RATE 0x100c /* limit the TCP pacing rate (bytes/s as u32_t, 0: no limit) */
 
 /*
  * Structure used for manipulating linger option.
@@ -261,6 +262,8 @@ struct linger {
 #define MSG_DONTWAIT   0x08    /* Nonblocking i/o for this operation only */
 #define MSG_MORE       0x10    /* Sender will send more */
 #define MSG_NOSIGNAL   0x20    /* Uninmplemented: Requests not to send the SIGPIPE signal if an attempt to send is made on a stream-oriented socket that is no longer connected. */
+#define MSG_FASTOPEN   0x40    /* TCP: connect to the given address with TCP Fast Open (sendto()/sendmsg() on an unconnected socket, needs LWIP_TCP_FASTOPEN) */
+#define MSG_ZEROCOPY   0x80    /* TCP: send without copying the data, see TCP_ZEROCOPY_DONE (needs LWIP_TCP_ZEROCOPY) */
 
 
 /*
@@ -279,6 +282,10 @@ struct linger {
 #define TCP_KEEPIDLE   0x03    /* set pcb->keep_idle  - Same as TCP_KEEPALIVE, but use seconds for get/setsockopt */
 #define TCP_KEEPINTVL  0x04    /* set pcb->keep_intvl - Use seconds for get/setsockopt */
 #define TCP_KEEPCNT    0x05    /* set pcb->keep_cnt   - Use number of probes sent for get/setsockopt */
+#define TCP_CONGESTION 0x06    /* congestion control algorithm by name (string optval), see tcp_set_congestion() */
+#define TCP_FASTOPEN   0x07    /* use (connect) or accept (listen) TCP Fast Open, see LWIP_TCP_FASTOPEN */
+#define TCP_INFO       0x08    /* get a snapshot of the connection (struct tcp_info, read-only), see LWIP_TCP_INFO */
+#define TCP_ZEROCOPY_DONE 0x09 /* get the number of bytes sent with MSG_ZEROCOPY that may be reused (u32_t, read-only), see LWIP_TCP_ZEROCOPY */
 #endif /* LWIP_TCP */
 
 #if LWIP_IPV6
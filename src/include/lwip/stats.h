@@ -94,6 +94,16 @@ struct stats_igmp {
   STAT_COUNTER tx_report;        /* Sent reports. */
 };
 
+/** TCP out-of-sequence queue memory stats (LWIP_TCP_OOSEQ_MEM) */
+struct stats_tcp_ooseq {
+  STAT_COUNTER used;             /* pbufs queued on ooseq of all pcbs. */
+  STAT_COUNTER max;              /* Highest 'used'. */
+  STAT_COUNTER pressure;         /* Budget (TCP_OOSEQ_MEM_PBUFS) exceeded. */
+  STAT_COUNTER reclaim;          /* Reclaims because PBUF_POOL was empty. */
+  STAT_COUNTER pruned_segs;      /* Segments dropped or trimmed. */
+  STAT_COUNTER pruned_pbufs;     /* pbufs freed by pruning. */
+};
+
 /** Memory stats */
 struct stats_mem {
 #if defined(LWIP_DEBUG) || LWIP_STATS_DISPLAY
@@ -261,6 +271,10 @@ struct stats_ {
 #if TCP_STATS
   /** TCP */
   struct stats_proto tcp;
+#if LWIP_TCP_OOSEQ_MEM
+  /** TCP out-of-sequence queue memory */
+  struct stats_tcp_ooseq tcp_ooseq;
+#endif
 #endif
 #if MEM_STATS
   /** Heap */
@@ -329,6 +343,22 @@ void stats_init(void);
 #define TCP_STATS_DISPLAY()
 #endif
 
+#if TCP_STATS && LWIP_TCP_OOSEQ_MEM
+#define TCP_OOSEQ_STATS_INC(x) STATS_INC(tcp_ooseq.x)
+#define TCP_OOSEQ_STATS_SET_USED(y) do { lwip_stats.tcp_ooseq.used = (STAT_COUNTER)(y); \
+                                if (lwip_stats.tcp_ooseq.max < lwip_stats.tcp_ooseq.used) { \
+                                    lwip_stats.tcp_ooseq.max = lwip_stats.tcp_ooseq.used; \
+                                } \
+                             } while(0)
+#define TCP_OOSEQ_STATS_ADD(x, y) lwip_stats.tcp_ooseq.x = (STAT_COUNTER)(lwip_stats.tcp_ooseq.x + (y))
+#define TCP_OOSEQ_STATS_DISPLAY() stats_display_tcp_ooseq(&lwip_stats.tcp_ooseq)
+#else
+#define TCP_OOSEQ_STATS_INC(x)
+#define TCP_OOSEQ_STATS_SET_USED(y)
+#define TCP_OOSEQ_STATS_ADD(x, y)
+#define TCP_OOSEQ_STATS_DISPLAY()
+#endif
+
 #if UDP_STATS
 #define UDP_STATS_INC(x) STATS_INC(x)
 #define UDP_STATS_DISPLAY() stats_display_proto(&lwip_stats.udp, "UDP")
@@ -472,6 +502,7 @@ void stats_init(void);
 void stats_display(void);
 void stats_display_proto(struct stats_proto *proto, const char *name);
 void stats_display_igmp(struct stats_igmp *igmp, const char *name);
+void stats_display_tcp_ooseq(struct stats_tcp_ooseq *ooseq);
 void stats_display_mem(struct stats_mem *mem, const char *name);
 void stats_display_memp(struct stats_mem *mem, int index);
 void stats_display_sys(struct stats_sys *sys);
@@ -479,6 +510,7 @@ void stats_display_sys(struct stats_sys *sys);
 #define stats_display()
 #define stats_display_proto(proto, name)
 #define stats_display_igmp(igmp, name)
+#define stats_display_tcp_ooseq(ooseq)
 #define stats_display_mem(mem, name)
 #define stats_display_memp(mem, index)
 #define stats_display_sys(sys)
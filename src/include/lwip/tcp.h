@@ -50,12 +50,17 @@
 #include "lwip/err.h"
 #include "lwip/ip6.h"
 #include "lwip/ip6_addr.h"
+#if LWIP_TCP_PCB_TIMERS || LWIP_TCP_PACING || LWIP_TCP_RACK
+#include "lwip/timeouts.h"
+#endif /* LWIP_TCP_PCB_TIMERS || LWIP_TCP_PACING || LWIP_TCP_RACK */
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct tcp_pcb;
+struct tcp_cc_ops;
+struct tcp_syn_req;
 
 /** Function prototype for tcp accept callback functions. Called when a new
  * connection can be accepted on a listening pcb.
@@ -95,6 +100,28 @@ typedef err_t (*tcp_recv_fn)(void *arg, struct tcp_pcb *tpcb,
 typedef err_t (*tcp_sent_fn)(void *arg, struct tcp_pcb *tpcb,
                               u16_t len);
 
+#if LWIP_TCP_ZEROCOPY
+/** Function prototype for the completion callback of tcp_write_ref(). Called
+ * when the stack is done with a buffer: all of its data has been acknowledged
+ * and no pbuf references it any more. Buffers are reported in the order they
+ * were written.
+ *
+ * @param arg Additional argument to pass to the callback function (@see tcp_arg())
+ * @param tpcb tcp pcb, or NULL if the pcb has been freed (connection closed or
+ *             aborted) before the buffer was reported: the buffer may be
+ *             reused, but the data may not have been delivered
+ * @param cookie The cookie passed to tcp_write_ref()
+ * @param len The length of the buffer
+ * @return ERR_OK (ignored when tpcb is NULL)
+ *            Only return ERR_ABRT if you have called tcp_abort from within the
+ *            callback function!
+ */
+typedef err_t (*tcp_zc_done_fn)(void *arg, struct tcp_pcb *tpcb,
+                              void *cookie, u16_t len);
+
+struct tcp_zc;
+#endif /* LWIP_TCP_ZEROCOPY */
+
 /** Function prototype for tcp poll callback functions. Called periodically as
  * specified by @see tcp_poll.
  *
@@ -136,13 +163,18 @@ typedef err_t (*tcp_connected_fn)(void *arg, struct tcp_pcb *tpcb, err_t err);
 #define RCV_WND_SCALE(pcb, wnd) (((wnd) >> (pcb)->rcv_scale))
 #define SND_WND_SCALE(pcb, wnd) (((wnd) << (pcb)->snd_scale))
 #define TCPWND16(x)             ((u16_t)LWIP_MIN((x), 0xFFFF))
-#define TCP_WND_MAX(pcb)        ((tcpwnd_size_t)(((pcb)->flags & TF_WND_SCALE) ? TCP_WND : TCPWND16(TCP_WND)))
+#define TCP_WND_DEFAULT(pcb)    ((tcpwnd_size_t)(((pcb)->flags & TF_WND_SCALE) ? TCP_WND : TCPWND16(TCP_WND)))
 #else
 #define RCV_WND_SCALE(pcb, wnd) (wnd)
 #define SND_WND_SCALE(pcb, wnd) (wnd)
 #define TCPWND16(x)             (x)
-#define TCP_WND_MAX(pcb)        TCP_WND
+#define TCP_WND_DEFAULT(pcb)    TCP_WND
 #endif
+#if LWIP_TCP_RCV_AUTOTUNE
+#define TCP_WND_MAX(pcb)        ((pcb)->rcv_buf)
+#else /* LWIP_TCP_RCV_AUTOTUNE */
+#define TCP_WND_MAX(pcb)        TCP_WND_DEFAULT(pcb)
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
 /* Increments a tcpwnd_size_t and holds at max value rather than rollover */
 #define TCP_WND_INC(wnd, inc)   do { \
                                   if ((tcpwnd_size_t)(wnd + inc) >= wnd) { \
@@ -165,14 +197,65 @@ struct tcp_sack_range {
 
 typedef u16_t tcpflags_t;
 
+#if LWIP_TCP_CUBIC
+/** Per-connection state of the CUBIC congestion control (see tcp_cc.c) */
+struct tcp_cubic {
+  /** sys_now() when the current congestion avoidance epoch started */
+  u32_t epoch_start;
+  /** sys_now() of the last ACK processed */
+  u32_t last_ack;
+  /** time (ms) from epoch_start until the window reaches origin */
+  u32_t k;
+  /** window before the last reduction */
+  tcpwnd_size_t w_max;
+  /** plateau of the cubic function for this epoch (0: no epoch running) */
+  tcpwnd_size_t origin;
+  /** window a Reno flow would have (RFC 9438 4.3) */
+  tcpwnd_size_t w_est;
+};
+#endif /* LWIP_TCP_CUBIC */
+
+#if LWIP_TCP_PCB_HASH
+#define TCP_PCB_HASH_NEXT(type) type *hash_next; /* for the demux hash chain */
+#else /* LWIP_TCP_PCB_HASH */
+#define TCP_PCB_HASH_NEXT(type)
+#endif /* LWIP_TCP_PCB_HASH */
+
+#if LWIP_TCP_FASTOPEN
+#define TCP_PCB_FASTOPEN u8_t fastopen; /* TCP_FASTOPEN_* flags */
+#define TCP_FASTOPEN_ENABLED  0x01U /* use (active pcb) or accept (listen pcb) TCP Fast Open */
+#define TCP_FASTOPEN_COOKIE   0x02U /* SYN_RCVD: send a cookie in the SYN-ACK */
+#define TCP_FASTOPEN_ACCEPTED 0x04U /* SYN_RCVD: data in SYN accepted, accept callback already called */
+#else /* LWIP_TCP_FASTOPEN */
+#define TCP_PCB_FASTOPEN
+#endif /* LWIP_TCP_FASTOPEN */
+
+#if LWIP_TCP_RCV_AUTOTUNE
+#define TCP_PCB_RCVBUF u32_t rcv_buf_max; /* limit of the receive window (tcp_set_rcvbuf()) */
+#else /* LWIP_TCP_RCV_AUTOTUNE */
+#define TCP_PCB_RCVBUF
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+
+#if LWIP_TCP_SNDBUF_PCB
+#define TCP_PCB_SNDBUF u32_t snd_buf_max; /* size (limit with auto-tuning) of the send buffer (tcp_set_sndbuf()) */
+#else /* LWIP_TCP_SNDBUF_PCB */
+#define TCP_PCB_SNDBUF
+#endif /* LWIP_TCP_SNDBUF_PCB */
+
 /**
  * members common to struct tcp_pcb and struct tcp_listen_pcb
  */
 #define TCP_PCB_COMMON(type) \
   type *next; /* for the linked list */ \
+  TCP_PCB_HASH_NEXT(type) \
   void *callback_arg; \
   enum tcp_state state; /* TCP state */ \
   u8_t prio; \
+  TCP_PCB_FASTOPEN \
+  TCP_PCB_RCVBUF \
+  TCP_PCB_SNDBUF \
+  /* congestion control algorithm */ \
+  const struct tcp_cc_ops *cc; \
   /* ports are in host byte order */ \
   u16_t local_port
 
@@ -193,6 +276,11 @@ struct tcp_pcb_listen {
   u8_t backlog;
   u8_t accepts_pending;
 #endif /* TCP_LISTEN_BACKLOG */
+
+#if LWIP_TCP_SYN_REQ
+  /* half-open connections (SYN_RCVD), hashed by remote address and port */
+  struct tcp_syn_req *syn_reqs[TCP_SYN_REQ_HASH_SIZE];
+#endif /* LWIP_TCP_SYN_REQ */
 };
 
 
@@ -227,6 +315,12 @@ struct tcp_pcb {
 #define TF_RTO         0x0800U /* RTO timer has fired, in-flight data moved to unsent and being retransmitted */
 #if LWIP_TCP_SACK_OUT
 #define TF_SACK        0x1000U /* Selective ACKs enabled */
+#endif
+#if LWIP_TCP_SACK_IN
+#define TF_SACK_RECOVERY 0x2000U /* In SACK-based loss recovery (RFC 6675), TF_INFR is set, too */
+#endif
+#if LWIP_TCP_TW_COMPACT
+#define TF_APPCLOSED   0x4000U /* tcp_close() succeeded, the application doesn't reference the pcb any more */
 #endif
 
   /* the rest of the fields are in host byte order
@@ -236,12 +330,34 @@ struct tcp_pcb {
   u8_t polltmr, pollinterval;
   u8_t last_timer;
   u32_t tmr;
+#if LWIP_TCP_PCB_TIMERS
+  /* per-pcb timeout, armed for the next deadline of this pcb */
+  struct sys_timeo timer;
+  /* sys_now() the timeout is armed for */
+  u32_t timer_due;
+  /* tcp_ticks value at which tcp_slowtmr work is due (if timer_slow != 0) */
+  u32_t timer_tick;
+  /* tcp_ticks value of the last poll (or of the last ACK for new data) */
+  u32_t timer_poll;
+  u8_t timer_slow;
+#endif /* LWIP_TCP_PCB_TIMERS */
 
   /* receiver variables */
   u32_t rcv_nxt;   /* next seqno expected */
   tcpwnd_size_t rcv_wnd;   /* receiver window available */
   tcpwnd_size_t rcv_ann_wnd; /* receiver window to announce */
   u32_t rcv_ann_right_edge; /* announced right edge of window */
+#if LWIP_TCP_RCV_AUTOTUNE
+  tcpwnd_size_t rcv_buf;   /* current size of the receive window (TCP_WND_MAX) */
+  /* receive side RTT estimation: time to receive one window of data */
+  u32_t rcv_rtt_seq;   /* measurement ends when rcv_nxt reaches this */
+  u32_t rcv_rtt_time;  /* sys_now() at the start of the measurement, 0: none running */
+  u32_t rcv_rtt;       /* estimated RTT in milliseconds, 0: unknown */
+  /* data consumed by the application (tcp_recved()) per RTT */
+  u32_t rcv_space_time; /* sys_now() at the start of the current period */
+  u32_t rcv_space;      /* most bytes consumed in one period so far */
+  u32_t rcv_copied;     /* bytes consumed in the current period */
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
 
 #if LWIP_TCP_SACK_OUT
   /* SACK ranges to include in ACK packets (entry is invalid if left==right) */
@@ -269,10 +385,52 @@ struct tcp_pcb {
   /* congestion avoidance/control variables */
   tcpwnd_size_t cwnd;
   tcpwnd_size_t ssthresh;
+#if LWIP_TCP_CUBIC
+  struct tcp_cubic cubic;
+#endif /* LWIP_TCP_CUBIC */
+
+#if LWIP_TCP_PACING
+  /* releases paced segments */
+  struct sys_timeo pacing_timer;
+  /* send credit (bytes + 1/1000 bytes) as of sys_now() == pacing_time */
+  u32_t pacing_time;
+  u32_t pacing_credit;
+  u16_t pacing_frac;
+  /* upper limit for the pacing rate (bytes/s, 0: no limit) */
+  u32_t max_pacing_rate;
+  /* the RTT sample taken with rttest in milliseconds: sys_now() when the
+     timed segment was sent and the smoothed RTT (scaled by 8, 0: none) */
+  u32_t pacing_rtt_time;
+  u32_t pacing_srtt;
+#endif /* LWIP_TCP_PACING */
 
   /* first byte following last rto byte */
   u32_t rto_end;
 
+#if LWIP_TCP_SACK_IN
+  /* snd_nxt when SACK-based loss recovery was entered (RFC 6675 RecoveryPoint) */
+  u32_t sack_recover;
+#endif /* LWIP_TCP_SACK_IN */
+
+#if LWIP_TCP_RACK
+  /* RACK reordering timer or TLP probe timeout */
+  struct sys_timeo rack_timer;
+  /* transmit time and end of the most recently sent segment that was delivered */
+  u32_t rack_xmit_time;
+  u32_t rack_end_seq;
+  /* RTT of that segment, smoothed and minimum RTT (all in milliseconds) */
+  u32_t rack_rtt;
+  u32_t rack_srtt;
+  u32_t rack_min_rtt;
+  /* snd_nxt when the last loss probe was sent */
+  u32_t tlp_high_seq;
+  u8_t rack_flags;
+#define TCP_RACK_VALID        0x01U /* rack_xmit_time/rack_end_seq are set */
+#define TCP_RACK_RTT_VALID    0x02U /* rack_srtt/rack_min_rtt are set */
+#define TCP_RACK_TIMER_REO    0x04U /* rack_timer is the reordering timer */
+#define TCP_RACK_TLP_PENDING  0x08U /* loss probe sent, not acked yet */
+#endif /* LWIP_TCP_RACK */
+
   /* sender variables */
   u32_t snd_nxt;   /* next new seqno to be sent */
   u32_t snd_wl1, snd_wl2; /* Sequence and acknowledgement numbers of last
@@ -284,6 +442,10 @@ struct tcp_pcb {
   tcpwnd_size_t snd_buf;   /* Available buffer space for sending (in bytes). */
 #define TCP_SNDQUEUELEN_OVERFLOW (0xffffU-3)
   u16_t snd_queuelen; /* Number of pbufs currently in the send buffer. */
+#if LWIP_TCP_SNDBUF_PCB
+  tcpwnd_size_t snd_buf_size; /* Current size of the send buffer (snd_buf + queued bytes) */
+  u16_t snd_queuelen_max; /* Limit of snd_queuelen (TCP_SND_QUEUELEN scaled to snd_buf_size) */
+#endif /* LWIP_TCP_SNDBUF_PCB */
 
 #if TCP_OVERSIZE
   /* Extra bytes available at the end of the last pbuf in unsent. */
@@ -297,6 +459,12 @@ struct tcp_pcb {
   struct tcp_seg *unacked;  /* Sent but unacknowledged segments. */
 #if TCP_QUEUE_OOSEQ
   struct tcp_seg *ooseq;    /* Received out of sequence segments. */
+#if LWIP_TCP_OOSEQ_TREE
+  struct tcp_seg *ooseq_root; /* Search tree over the segments on ooseq */
+#endif /* LWIP_TCP_OOSEQ_TREE */
+#if LWIP_TCP_OOSEQ_MEM
+  u16_t ooseq_pbufs;        /* pbufs on ooseq accounted against TCP_OOSEQ_MEM_PBUFS */
+#endif /* LWIP_TCP_OOSEQ_MEM */
 #endif /* TCP_QUEUE_OOSEQ */
 
   struct pbuf *refused_data; /* Data previously received but not yet taken by upper layer */
@@ -322,6 +490,34 @@ struct tcp_pcb {
   u32_t ts_lastacksent;
   u32_t ts_recent;
 #endif /* LWIP_TCP_TIMESTAMPS */
+#if LWIP_TCP_TS_RTTM
+  /* RTT estimator fed by echoed timestamps (in ms, 0: no sample yet) */
+  u32_t ts_srtt;   /* smoothed RTT, scaled by 8 */
+  u32_t ts_rttvar; /* RTT variation, scaled by 4 */
+#endif /* LWIP_TCP_TS_RTTM */
+#if LWIP_TCP_ECN
+  /* Explicit Congestion Notification (RFC 3168) */
+  u8_t ecn;
+#define TCP_ECN_SYN    0x01U /* ECN-setup SYN sent */
+#define TCP_ECN_ON     0x02U /* ECN agreed with the remote host */
+#define TCP_ECN_ECE    0x04U /* CE received: set ECE in ACKs until CWR is received */
+#define TCP_ECN_CWR    0x08U /* cwnd reduced for ECE: set CWR in the next new data segment */
+  u32_t ecn_recover; /* snd_nxt when cwnd was reduced for ECE the last time */
+#endif /* LWIP_TCP_ECN */
+#if IP_PMTUD
+  /* Path MTU discovery */
+  u16_t snd_mss_max; /* MSS announced by the remote host, the limit when the
+                        path MTU increases */
+  u32_t pmtu_time;   /* sys_now() when the MSS was changed for the path MTU */
+#endif /* IP_PMTUD */
+#if LWIP_TCP_ZEROCOPY
+  /* buffers written with tcp_write_ref() and not yet reported, in write order */
+  struct tcp_zc *zc;
+  /* Function to be called when the stack is done with such a buffer */
+  tcp_zc_done_fn zc_done;
+  /* a buffer was completed outside of tcp_input(), reported by the fast timer */
+  u8_t zc_pending;
+#endif /* LWIP_TCP_ZEROCOPY */
 
   /* idle time before KEEPALIVE is sent */
   u32_t keep_idle;
@@ -344,8 +540,78 @@ struct tcp_pcb {
   u8_t snd_scale;
   u8_t rcv_scale;
 #endif
+
+#if LWIP_TCP_INFO
+  /* counters reported by tcp_get_info() */
+  u32_t info_retrans;       /* segments retransmitted */
+  u32_t info_fast_retrans;  /* fast retransmits (loss recovery entered) */
+  u32_t info_rto;           /* retransmission timeouts */
+  u32_t info_bytes_acked;   /* sequence space acknowledged by the remote host */
+#endif /* LWIP_TCP_INFO */
 };
 
+#if LWIP_TCP_INFO
+/** Options used on a connection (struct tcp_info.options) */
+#define TCP_INFO_OPT_TIMESTAMPS  0x01U
+#define TCP_INFO_OPT_SACK        0x02U
+#define TCP_INFO_OPT_WSCALE      0x04U
+#define TCP_INFO_OPT_ECN         0x08U
+
+/** @ingroup tcp_raw
+ * Snapshot of the state of a connection, filled by tcp_get_info().
+ * Times are in milliseconds, windows and buffers in bytes. The counters
+ * (total_retrans to bytes_acked) are 32 bit and wrap around.
+ */
+struct tcp_info {
+  u8_t  state;          /* enum tcp_state */
+  u8_t  options;        /* TCP_INFO_OPT_* */
+  u8_t  snd_wscale;     /* window scale received from the remote host */
+  u8_t  rcv_wscale;     /* window scale sent to the remote host */
+  u8_t  retransmits;    /* retransmissions of the oldest unacknowledged data */
+  u8_t  dupacks;        /* duplicate ACKs received in a row */
+  u16_t mss;            /* maximum segment size used for sending */
+  u32_t rto;            /* current retransmission timeout */
+  u32_t rtt;            /* smoothed round-trip time (0: not measured yet) */
+  u32_t rttvar;         /* round-trip time variation */
+  u32_t cwnd;           /* congestion window */
+  u32_t ssthresh;       /* slow start threshold */
+  u32_t snd_wnd;        /* window announced by the remote host */
+  u32_t rcv_wnd;        /* receive window available */
+  u32_t snd_buf;        /* free space in the send buffer */
+  u32_t unacked;        /* bytes in flight: sent but not acknowledged */
+  u32_t unsent;         /* bytes enqueued but not sent yet */
+  u16_t snd_queuelen;   /* pbufs in the send buffer */
+  u16_t ooseq_segs;     /* segments received out of sequence and queued */
+  u32_t ooseq_bytes;    /* bytes in those segments */
+  u32_t total_retrans;  /* segments retransmitted */
+  u32_t fast_retrans;   /* fast retransmits */
+  u32_t rto_events;     /* retransmission timeouts */
+  u32_t bytes_acked;    /* bytes acknowledged by the remote host */
+};
+#endif /* LWIP_TCP_INFO */
+
+/** Congestion control algorithm. The hooks update pcb->cwnd and pcb->ssthresh;
+ * all but ack, loss and rto may be NULL. */
+struct tcp_cc_ops {
+  /** name used by tcp_set_congestion() and TCP_CONGESTION */
+  const char *name;
+  /** the connection was established (initial cwnd is set) or switched to this algorithm */
+  void (*init)(struct tcp_pcb *pcb);
+  /** 'acked' bytes of new data were acknowledged outside of fast recovery */
+  void (*ack)(struct tcp_pcb *pcb, tcpwnd_size_t acked);
+  /** loss detected by fast retransmit: reduce ssthresh (cwnd is set by the caller) */
+  void (*loss)(struct tcp_pcb *pcb);
+  /** retransmission timeout: reduce ssthresh and cwnd */
+  void (*rto)(struct tcp_pcb *pcb);
+  /** transmission starts with no data in flight */
+  void (*idle)(struct tcp_pcb *pcb);
+};
+
+extern const struct tcp_cc_ops tcp_cc_reno;
+#if LWIP_TCP_CUBIC
+extern const struct tcp_cc_ops tcp_cc_cubic;
+#endif /* LWIP_TCP_CUBIC */
+
 #if LWIP_EVENT_API
 
 enum lwip_event {
@@ -392,12 +658,52 @@ void             tcp_poll    (struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interv
 #define          tcp_sndbuf(pcb)          (TCPWND16((pcb)->snd_buf))
 /** @ingroup tcp_raw */
 #define          tcp_sndqueuelen(pcb)     ((pcb)->snd_queuelen)
+#if LWIP_TCP_SNDBUF_PCB
+/* per-pcb limits scaled by the send buffer size of the pcb */
+#define          TCP_SND_QUEUELEN_MAX(pcb) ((pcb)->snd_queuelen_max)
+#define          TCP_SNDLOWAT_PCB(pcb)     ((tcpwnd_size_t)(((u32_t)(TCP_SNDLOWAT) * (pcb)->snd_buf_size) / (TCP_SND_BUF)))
+#define          TCP_SNDQUEUELOWAT_PCB(pcb) ((u16_t)LWIP_MAX(((u32_t)(TCP_SNDQUEUELOWAT) * (pcb)->snd_queuelen_max) / (TCP_SND_QUEUELEN), 1))
+void             tcp_set_sndbuf(struct tcp_pcb *pcb, u32_t size);
+/** @ingroup tcp_raw */
+#define          tcp_get_sndbuf(pcb)      ((pcb)->snd_buf_max)
+#else /* LWIP_TCP_SNDBUF_PCB */
+#define          TCP_SND_QUEUELEN_MAX(pcb) (TCP_SND_QUEUELEN)
+#define          TCP_SNDLOWAT_PCB(pcb)     (TCP_SNDLOWAT)
+#define          TCP_SNDQUEUELOWAT_PCB(pcb) (TCP_SNDQUEUELOWAT)
+#endif /* LWIP_TCP_SNDBUF_PCB */
 /** @ingroup tcp_raw */
 #define          tcp_nagle_disable(pcb)   tcp_set_flags(pcb, TF_NODELAY)
 /** @ingroup tcp_raw */
 #define          tcp_nagle_enable(pcb)    tcp_clear_flags(pcb, TF_NODELAY)
 /** @ingroup tcp_raw */
 #define          tcp_nagle_disabled(pcb)  tcp_is_flag_set(pcb, TF_NODELAY)
+#if LWIP_TCP_PACING
+/** @ingroup tcp_raw */
+#define          tcp_set_max_pacing_rate(pcb, rate) ((pcb)->max_pacing_rate = (rate))
+/** @ingroup tcp_raw */
+#define          tcp_get_max_pacing_rate(pcb)       ((pcb)->max_pacing_rate)
+u32_t            tcp_pacing_rate(const struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_PACING */
+#if LWIP_TCP_FASTOPEN
+/** @ingroup tcp_raw
+ * Enable TCP Fast Open: on a listen pcb (or before tcp_listen()), SYNs with
+ * a valid cookie and data are accepted. Before tcp_connect(), a cookie is
+ * requested from the server or, if one is cached, the SYN is deferred and
+ * sent with the data of the first tcp_write() by tcp_output(). */
+#define          tcp_fastopen_enable(pcb)  ((pcb)->fastopen |= TCP_FASTOPEN_ENABLED)
+/** @ingroup tcp_raw */
+#define          tcp_fastopen_disable(pcb) ((pcb)->fastopen = (u8_t)((pcb)->fastopen & ~TCP_FASTOPEN_ENABLED))
+/** @ingroup tcp_raw */
+#define          tcp_fastopen_enabled(pcb) (((pcb)->fastopen & TCP_FASTOPEN_ENABLED) != 0)
+/** length of the key passed to tcp_fastopen_set_key() */
+#define          TCP_FASTOPEN_KEY_LEN      16
+void             tcp_fastopen_set_key(const u8_t *key);
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_SYNCOOKIES
+/** length of the key passed to tcp_syncookie_set_key() */
+#define          TCP_SYNCOOKIE_KEY_LEN     16
+void             tcp_syncookie_set_key(const u8_t *key);
+#endif /* LWIP_TCP_SYNCOOKIES */
 
 #if TCP_LISTEN_BACKLOG
 #define          tcp_backlog_set(pcb, new_backlog) do { \
@@ -413,6 +719,11 @@ void             tcp_backlog_accepted(struct tcp_pcb* pcb);
 #define          tcp_accepted(pcb) do { LWIP_UNUSED_ARG(pcb); } while(0) /* compatibility define, not needed any more */
 
 void             tcp_recved  (struct tcp_pcb *pcb, u16_t len);
+#if LWIP_TCP_RCV_AUTOTUNE
+void             tcp_set_rcvbuf(struct tcp_pcb *pcb, u32_t size);
+/** @ingroup tcp_raw */
+#define          tcp_get_rcvbuf(pcb) ((pcb)->rcv_buf_max)
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
 err_t            tcp_bind    (struct tcp_pcb *pcb, const ip_addr_t *ipaddr,
                               u16_t port);
 void             tcp_bind_netif(struct tcp_pcb *pcb, const struct netif *netif);
@@ -430,12 +741,29 @@ err_t            tcp_shutdown(struct tcp_pcb *pcb, int shut_rx, int shut_tx);
 
 err_t            tcp_write   (struct tcp_pcb *pcb, const void *dataptr, u16_t len,
                               u8_t apiflags);
+#if LWIP_TCP_ZEROCOPY
+err_t            tcp_write_ref(struct tcp_pcb *pcb, const void *dataptr, u16_t len,
+                              u8_t apiflags, void *cookie);
+void             tcp_zc_done (struct tcp_pcb *pcb, tcp_zc_done_fn zc_done);
+#endif /* LWIP_TCP_ZEROCOPY */
 
 void             tcp_setprio (struct tcp_pcb *pcb, u8_t prio);
 
+err_t            tcp_set_congestion(struct tcp_pcb *pcb, const char *name);
+void             tcp_set_congestion_ops(struct tcp_pcb *pcb, const struct tcp_cc_ops *ops);
+/** @ingroup tcp_raw */
+#define          tcp_get_congestion(pcb)  ((pcb)->cc->name)
+void             tcp_cc_slow_start(struct tcp_pcb *pcb, tcpwnd_size_t acked);
+
 err_t            tcp_output  (struct tcp_pcb *pcb);
+#if LWIP_TCP_PCB_TIMERS
+void             tcp_timer_update(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_PCB_TIMERS */
 
 err_t            tcp_tcp_get_tcp_addrinfo(struct tcp_pcb *pcb, int local, ip_addr_t *addr, u16_t *port);
+#if LWIP_TCP_INFO
+err_t            tcp_get_info(const struct tcp_pcb *pcb, struct tcp_info *info);
+#endif /* LWIP_TCP_INFO */
 
 #define tcp_dbg_get_tcp_state(pcb) ((pcb)->state)
 
@@ -87,6 +87,12 @@ typedef void (* sys_timeout_handler)(void *arg);
 
 struct sys_timeo {
   struct sys_timeo *next;
+#if LWIP_TIMERS_WHEEL
+  /* wheel slot linkage and (handler, arg) lookup for sys_untimeout() */
+  struct sys_timeo **pprev;
+  struct sys_timeo *hash_next;
+  struct sys_timeo **hash_pprev;
+#endif /* LWIP_TIMERS_WHEEL */
   u32_t time;
   sys_timeout_handler h;
   void *arg;
@@ -105,13 +111,30 @@ void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg);
 #endif /* LWIP_DEBUG_TIMERNAMES */
 
 void sys_untimeout(sys_timeout_handler handler, void *arg);
+
+#if LWIP_TIMERS_WHEEL
+#if LWIP_DEBUG_TIMERNAMES
+void sys_timeout_static_debug(struct sys_timeo *t, u32_t msecs, sys_timeout_handler handler, void *arg, const char* handler_name);
+#define sys_timeout_static(t, msecs, handler, arg) sys_timeout_static_debug(t, msecs, handler, arg, #handler)
+#else /* LWIP_DEBUG_TIMERNAMES */
+void sys_timeout_static(struct sys_timeo *t, u32_t msecs, sys_timeout_handler handler, void *arg);
+#endif /* LWIP_DEBUG_TIMERNAMES */
+void sys_untimeout_static(struct sys_timeo *t);
+u8_t sys_timeout_static_pending(const struct sys_timeo *t);
+#endif /* LWIP_TIMERS_WHEEL */
+
 void sys_restart_timeouts(void);
-#if NO_SYS
+#if NO_SYS || LWIP_TESTMODE
 void sys_check_timeouts(void);
 u32_t sys_timeouts_sleeptime(void);
-#else /* NO_SYS */
+#endif /* NO_SYS || LWIP_TESTMODE */
+#if !NO_SYS
 void sys_timeouts_mbox_fetch(sys_mbox_t *mbox, void **msg);
-#endif /* NO_SYS */
+#endif /* !NO_SYS */
+
+#if LWIP_TESTMODE
+void lwip_cyclic_timer(void *arg);
+#endif /* LWIP_TESTMODE */
 
 
 #endif /* LWIP_TIMERS */
@@ -181,7 +181,14 @@ ethernet_input(struct pbuf *p, struct netif *netif)
         goto free_and_return;
       } else {
         /* pass to IP layer */
-        ip4_input(p, netif);
+#if LWIP_NETIF_GRO
+        if (netif->gro_max != 0) {
+          netif_gro_input(p, netif);
+        } else
+#endif /* LWIP_NETIF_GRO */
+        {
+          ip4_input(p, netif);
+        }
       }
       break;
 
@@ -224,7 +231,14 @@ ethernet_input(struct pbuf *p, struct netif *netif)
         goto free_and_return;
       } else {
         /* pass to IPv6 layer */
-        ip6_input(p, netif);
+#if LWIP_NETIF_GRO
+        if (netif->gro_max != 0) {
+          netif_gro_input(p, netif);
+        } else
+#endif /* LWIP_NETIF_GRO */
+        {
+          ip6_input(p, netif);
+        }
       }
       break;
 #endif /* LWIP_IPV6 */
@@ -44,11 +44,14 @@ sockets_teardown(void)
   fail_unless(test_sockets_get_used_count() == 0);
   /* poll until all memory is released... */
   tcpip_thread_poll_one();
-  while (tcp_tw_pcbs) {
-    tcp_abort(tcp_tw_pcbs);
-    tcpip_thread_poll_one();
-  }
-  tcpip_thread_poll_one();
+  do {
+    while (tcp_tw_pcbs) {
+      tcp_abort(tcp_tw_pcbs);
+    }
+#if LWIP_TCP_TW_COMPACT
+    tcp_tw_free_all();
+#endif /* LWIP_TCP_TW_COMPACT */
+  } while (tcpip_thread_poll_one());
   /* ensure full free heap */
   lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
 }
@@ -785,6 +788,71 @@ cleanup:
 }
 END_TEST
 
+/* A TCP Fast Open connect returns at once: the socket must be writable then
+   (data written before the handshake completes goes with the SYN) */
+START_TEST(test_sockets_fastopen_writable)
+{
+#if LWIP_TCP_FASTOPEN && LWIP_SOCKET_SELECT
+  int sl, sact, spass;
+  int ret;
+  int arg;
+  struct sockaddr_in sa_listen;
+  const u16_t port = 1235;
+  fd_set writeset;
+  struct timeval tv;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(test_sockets_get_used_count() == 0);
+
+  memset(&sa_listen, 0, sizeof(sa_listen));
+  sa_listen.sin_family = AF_INET;
+  sa_listen.sin_port = PP_HTONS(port);
+  sa_listen.sin_addr.s_addr = PP_HTONL(INADDR_LOOPBACK);
+
+  sl = lwip_socket(AF_INET, SOCK_STREAM, 0);
+  fail_unless(sl >= 0);
+  ret = lwip_bind(sl, (struct sockaddr *)&sa_listen, sizeof(sa_listen));
+  fail_unless(ret == 0);
+  ret = lwip_listen(sl, 0);
+  fail_unless(ret == 0);
+
+  sact = lwip_socket(AF_INET, SOCK_STREAM, 0);
+  fail_unless(sact >= 0);
+  arg = 1;
+  ret = lwip_ioctl(sact, FIONBIO, &arg);
+  fail_unless(ret == 0);
+  ret = lwip_setsockopt(sact, IPPROTO_TCP, TCP_FASTOPEN, &arg, sizeof(arg));
+  fail_unless(ret == 0);
+  ret = lwip_connect(sact, (struct sockaddr *)&sa_listen, sizeof(sa_listen));
+  fail_unless(ret == 0);
+
+  FD_ZERO(&writeset);
+  FD_SET(sact, &writeset);
+  tv.tv_sec = tv.tv_usec = 0;
+  ret = lwip_select(sact + 1, NULL, &writeset, NULL, &tv);
+  fail_unless(ret == 1);
+  fail_unless(FD_ISSET(sact, &writeset));
+
+  /* let the handshake complete */
+  tcpip_thread_poll_one();
+  tcpip_thread_poll_one();
+  tcpip_thread_poll_one();
+  tcpip_thread_poll_one();
+  spass = lwip_accept(sl, NULL, NULL);
+  fail_unless(spass >= 0);
+
+  ret = lwip_close(sact);
+  fail_unless(ret == 0);
+  ret = lwip_close(spass);
+  fail_unless(ret == 0);
+  ret = lwip_close(sl);
+  fail_unless(ret == 0);
+#else /* LWIP_TCP_FASTOPEN && LWIP_SOCKET_SELECT */
+  LWIP_UNUSED_ARG(_i);
+#endif /* LWIP_TCP_FASTOPEN && LWIP_SOCKET_SELECT */
+}
+END_TEST
+
 /** Create the suite including all tests for this module */
 Suite *
 sockets_suite(void)
@@ -795,6 +863,7 @@ sockets_suite(void)
     TESTFUNC(test_sockets_msgapis),
     TESTFUNC(test_sockets_select),
     TESTFUNC(test_sockets_recv_after_rst),
+    TESTFUNC(test_sockets_fastopen_writable),
   };
   return create_suite("SOCKETS", tests, sizeof(tests)/sizeof(testfunc), sockets_setup, sockets_teardown);
 }
@@ -47,9 +47,11 @@ u32_t sys_jiffies(void)
   return (u32_t)0; /* todo */
 }
 
+u32_t lwip_sys_now;
+
 u32_t sys_now(void)
 {
-  return (u32_t)0; /* todo */
+  return lwip_sys_now;
 }
 
 void sys_init(void)
@@ -0,0 +1,347 @@
+#include "test_chksum.h"
+
+#include "lwip/inet_chksum.h"
+#include "lwip/ip_addr.h"
+#include "lwip/prot/ip.h"
+#include "lwip/prot/ip6.h"
+#include "lwip/def.h"
+
+/** Define to 1 to add the throughput microbenchmark (printed to stdout) */
+#ifndef CHKSUM_TEST_BENCH
+#define CHKSUM_TEST_BENCH 0
+#endif
+
+#if CHKSUM_TEST_BENCH
+#include <stdio.h>
+#include <time.h>
+#endif /* CHKSUM_TEST_BENCH */
+
+/* offsets (alignments) and lengths checked against the reference */
+#define CHKSUM_TEST_OFFSETS 32
+#define CHKSUM_TEST_LENGTHS 600
+#define CHKSUM_TEST_BUFSIZE 0x10000
+
+static u8_t chksum_buf[CHKSUM_TEST_BUFSIZE + CHKSUM_TEST_OFFSETS];
+#if LWIP_CHECKSUM_ON_COPY
+static u8_t chksum_dst[CHKSUM_TEST_BUFSIZE + CHKSUM_TEST_OFFSETS];
+#endif /* LWIP_CHECKSUM_ON_COPY */
+
+#if LWIP_CHKSUM_SIMD
+static const u8_t chksum_kernels[] = {
+  LWIP_CHKSUM_KERNEL_SCALAR, LWIP_CHKSUM_KERNEL_SSE2,
+  LWIP_CHKSUM_KERNEL_AVX2, LWIP_CHKSUM_KERNEL_NEON
+};
+static const char *chksum_kernel_names[] = { "scalar", "SSE2", "AVX2", "NEON" };
+static u8_t chksum_kernel_saved;
+#define CHKSUM_NUM_KERNELS    LWIP_ARRAYSIZE(chksum_kernels)
+#define CHKSUM_SELECT(i)      lwip_chksum_simd_select(chksum_kernels[i])
+#define CHKSUM_KERNEL_NAME(i) chksum_kernel_names[i]
+#else /* LWIP_CHKSUM_SIMD */
+#define CHKSUM_NUM_KERNELS    1
+#define CHKSUM_SELECT(i)      1
+#define CHKSUM_KERNEL_NAME(i) "LWIP_CHKSUM"
+#endif /* LWIP_CHKSUM_SIMD */
+
+/* Setups/teardown functions */
+
+static void
+chksum_setup(void)
+{
+#if LWIP_CHKSUM_SIMD
+  chksum_kernel_saved = lwip_chksum_simd_get();
+#endif /* LWIP_CHKSUM_SIMD */
+}
+
+static void
+chksum_teardown(void)
+{
+#if LWIP_CHKSUM_SIMD
+  lwip_chksum_simd_select(chksum_kernel_saved);
+#endif /* LWIP_CHKSUM_SIMD */
+}
+
+/* Helper functions */
+
+/** Fill the buffer with pseudo random data (or a constant if 'fill' >= 0) */
+static void
+chksum_fill(int fill)
+{
+  u32_t x = 0x12345678;
+  size_t i;
+  for (i = 0; i < sizeof(chksum_buf); i++) {
+    x = x * 1103515245 + 12345;
+    chksum_buf[i] = (u8_t)((fill >= 0) ? fill : (int)(x >> 16));
+  }
+}
+
+/** Reference: RFC 1071 one byte at a time, returns what inet_chksum() does */
+static u16_t
+chksum_ref(const u8_t *data, u32_t len)
+{
+  u32_t acc = 0;
+  u32_t i;
+  for (i = 0; i + 1 < len; i += 2) {
+    acc += ((u32_t)data[i] << 8) | data[i + 1];
+  }
+  if (len & 1) {
+    acc += (u32_t)data[len - 1] << 8;
+  }
+  while (acc >> 16) {
+    acc = (acc & 0xffff) + (acc >> 16);
+  }
+  return (u16_t)~lwip_htons((u16_t)acc);
+}
+
+/** Check inet_chksum() of all kernels against the reference for all
+ * offsets and a range of lengths of the buffer contents */
+static void
+chksum_check_all(u32_t max_len)
+{
+  u32_t off, len;
+  size_t k;
+  for (off = 0; off < CHKSUM_TEST_OFFSETS; off++) {
+    for (len = 0; len <= max_len; len++) {
+      u16_t ref = chksum_ref(&chksum_buf[off], len);
+      for (k = 0; k < CHKSUM_NUM_KERNELS; k++) {
+        if (CHKSUM_SELECT(k)) {
+          u16_t chksum = inet_chksum(&chksum_buf[off], (u16_t)len);
+          fail_unless(chksum == ref, "%s: offset %d len %d: 0x%04x instead of 0x%04x",
+                      CHKSUM_KERNEL_NAME(k), (int)off, (int)len, chksum, ref);
+        }
+      }
+    }
+  }
+}
+
+#if LWIP_CHECKSUM_ON_COPY
+/** Check LWIP_CHKSUM_COPY() of all kernels: copied data and checksum */
+static void
+chksum_check_copy(u32_t src_off, u32_t dst_off, u32_t len)
+{
+  u16_t ref = (u16_t)~chksum_ref(&chksum_buf[src_off], len);
+  size_t k;
+  for (k = 0; k < CHKSUM_NUM_KERNELS; k++) {
+    if (CHKSUM_SELECT(k)) {
+      u16_t chksum;
+      memset(chksum_dst, 0xa5, len + 8);
+      chksum = LWIP_CHKSUM_COPY(&chksum_dst[dst_off], &chksum_buf[src_off], (u16_t)len);
+      fail_unless(chksum == ref, "%s: offsets %d/%d len %d: 0x%04x instead of 0x%04x",
+                  CHKSUM_KERNEL_NAME(k), (int)src_off, (int)dst_off, (int)len, chksum, ref);
+      fail_unless(memcmp(&chksum_dst[dst_off], &chksum_buf[src_off], len) == 0);
+      /* nothing written before or after the destination */
+      fail_unless((dst_off == 0) || (chksum_dst[dst_off - 1] == 0xa5));
+      fail_unless(chksum_dst[dst_off + len] == 0xa5);
+    }
+  }
+}
+#endif /* LWIP_CHECKSUM_ON_COPY */
+
+/** Create a pbuf chain of the buffer contents, cut at 'cuts' (0-terminated) */
+static struct pbuf *
+chksum_chain(u32_t off, u16_t len, const u16_t *cuts)
+{
+  struct pbuf *p = NULL;
+  u16_t pos = 0;
+  while (pos < len) {
+    u16_t n = (u16_t)(((*cuts != 0) && (*cuts < len)) ? (*cuts++ - pos) : (len - pos));
+    struct pbuf *q = pbuf_alloc(PBUF_RAW, n, PBUF_RAM);
+    fail_unless(q != NULL);
+    MEMCPY(q->payload, &chksum_buf[off + pos], n);
+    if (p == NULL) {
+      p = q;
+    } else {
+      pbuf_cat(p, q);
+    }
+    pos = (u16_t)(pos + n);
+  }
+  return p;
+}
+
+/* Test functions */
+
+/** All kernels return the same as the reference, for any alignment and
+ * length (odd ones included), also for data that makes the sums carry */
+START_TEST(test_chksum_kernels)
+{
+  u32_t off;
+  size_t k;
+  static const u32_t lens[] = { 1023, 1024, 1025, 1499, 1500, 1501, 4095, 4097, 32767, 65534, 65535 };
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  chksum_fill(-1);
+  chksum_check_all(CHKSUM_TEST_LENGTHS);
+  for (i = 0; i < LWIP_ARRAYSIZE(lens); i++) {
+    for (off = 0; off < CHKSUM_TEST_OFFSETS; off += 7) {
+      u16_t ref = chksum_ref(&chksum_buf[off], lens[i]);
+      for (k = 0; k < CHKSUM_NUM_KERNELS; k++) {
+        if (CHKSUM_SELECT(k)) {
+          fail_unless(inet_chksum(&chksum_buf[off], (u16_t)lens[i]) == ref);
+        }
+      }
+    }
+  }
+  chksum_fill(0xff);
+  chksum_check_all(300);
+  chksum_fill(0);
+  chksum_check_all(100);
+}
+END_TEST
+
+/** inet_chksum_pbuf() and the pseudo header checksums over pbuf chains
+ * with odd and even pbuf lengths */
+START_TEST(test_chksum_pbuf)
+{
+  static const u16_t cuts[][4] = {
+    { 0 }, { 1, 0 }, { 7, 8, 0 }, { 33, 64, 1001, 0 }, { 2, 4, 37, 0 }
+  };
+  static const u16_t lens[] = { 1, 16, 63, 577, 1500 };
+  u8_t pseudo[40 + 1500];
+  size_t c, l, k;
+  LWIP_UNUSED_ARG(_i);
+
+  chksum_fill(-1);
+  for (c = 0; c < LWIP_ARRAYSIZE(cuts); c++) {
+    for (l = 0; l < LWIP_ARRAYSIZE(lens); l++) {
+      u16_t len = lens[l];
+      u32_t off = (u32_t)(c + l) % CHKSUM_TEST_OFFSETS;
+      struct pbuf *p = chksum_chain(off, len, cuts[c]);
+      for (k = 0; k < CHKSUM_NUM_KERNELS; k++) {
+        if (!CHKSUM_SELECT(k)) {
+          continue;
+        }
+        fail_unless(inet_chksum_pbuf(p) == chksum_ref(&chksum_buf[off], len));
+#if LWIP_IPV4
+        {
+          ip4_addr_t src, dst;
+          IP4_ADDR(&src, 192, 168, 1, 3);
+          IP4_ADDR(&dst, 10, 0, 255, 254);
+          MEMCPY(&pseudo[0], &src, 4);
+          MEMCPY(&pseudo[4], &dst, 4);
+          pseudo[8] = 0;
+          pseudo[9] = IP_PROTO_TCP;
+          pseudo[10] = (u8_t)(len >> 8);
+          pseudo[11] = (u8_t)len;
+          MEMCPY(&pseudo[12], &chksum_buf[off], len);
+          fail_unless(inet_chksum_pseudo(p, IP_PROTO_TCP, len, &src, &dst) ==
+                      chksum_ref(pseudo, 12u + len));
+        }
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6
+        {
+          ip6_addr_t src, dst;
+          IP6_ADDR(&src, PP_HTONL(0x20010db8), PP_HTONL(0x1), PP_HTONL(0x2), PP_HTONL(0x3));
+          IP6_ADDR(&dst, PP_HTONL(0xfe800000), 0, PP_HTONL(0xabcd), PP_HTONL(0xff01));
+          MEMCPY(&pseudo[0], src.addr, 16);
+          MEMCPY(&pseudo[16], dst.addr, 16);
+          memset(&pseudo[32], 0, 8);
+          pseudo[34] = (u8_t)(len >> 8);
+          pseudo[35] = (u8_t)len;
+          pseudo[39] = IP6_NEXTH_UDP;
+          MEMCPY(&pseudo[40], &chksum_buf[off], len);
+          fail_unless(ip6_chksum_pseudo(p, IP6_NEXTH_UDP, len, &src, &dst) ==
+                      chksum_ref(pseudo, 40u + len));
+        }
+#endif /* LWIP_IPV6 */
+      }
+      pbuf_free(p);
+    }
+  }
+}
+END_TEST
+
+#if LWIP_CHECKSUM_ON_COPY
+/** LWIP_CHKSUM_COPY() copies the data and returns the same checksum as the
+ * reference for any alignment of source and destination and any length */
+START_TEST(test_chksum_copy)
+{
+  static const u32_t lens[] = { 1499, 1500, 4097, 65535 };
+  u32_t src_off, dst_off, len;
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  chksum_fill(-1);
+  for (src_off = 0; src_off < CHKSUM_TEST_OFFSETS; src_off++) {
+    for (dst_off = 0; dst_off < 4; dst_off++) {
+      for (len = 0; len <= CHKSUM_TEST_LENGTHS; len++) {
+        chksum_check_copy(src_off, dst_off, len);
+      }
+    }
+  }
+  for (i = 0; i < LWIP_ARRAYSIZE(lens); i++) {
+    for (src_off = 0; src_off < CHKSUM_TEST_OFFSETS; src_off += 5) {
+      chksum_check_copy(src_off, src_off & 3, lens[i]);
+      chksum_check_copy(src_off, 3 - (src_off & 3), lens[i]);
+    }
+  }
+  chksum_fill(0xff);
+  for (len = 0; len <= 300; len++) {
+    chksum_check_copy(4, 0, len);
+    chksum_check_copy(1, 3, len);
+  }
+}
+END_TEST
+#endif /* LWIP_CHECKSUM_ON_COPY */
+
+#if CHKSUM_TEST_BENCH
+/** Microbenchmark: throughput of each kernel for a few packet sizes
+ * (the results only are checked, the numbers are printed) */
+START_TEST(test_chksum_bench)
+{
+  static const u16_t sizes[] = { 64, 1500, 65535 };
+  const u32_t total = 16 * 1024 * 1024;
+  size_t s, k;
+  LWIP_UNUSED_ARG(_i);
+
+  chksum_fill(-1);
+  for (s = 0; s < LWIP_ARRAYSIZE(sizes); s++) {
+    u16_t ref = chksum_ref(&chksum_buf[1], sizes[s]);
+    for (k = 0; k < CHKSUM_NUM_KERNELS; k++) {
+      u32_t i, n = total / sizes[s];
+      u16_t chksum = 0;
+      clock_t start;
+      double secs;
+      if (!CHKSUM_SELECT(k)) {
+        continue;
+      }
+      start = clock();
+      for (i = 0; i < n; i++) {
+        /* odd offset: the worst case for the scalar code */
+        chksum = inet_chksum(&chksum_buf[1], sizes[s]);
+      }
+      secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+      fail_unless(chksum == ref);
+      printf("chksum %-6s %5u bytes: %8.1f MB/s\n", CHKSUM_KERNEL_NAME(k), sizes[s],
+             (secs > 0) ? ((double)n * sizes[s] / secs / 1e6) : 0.0);
+#if LWIP_CHECKSUM_ON_COPY
+      start = clock();
+      for (i = 0; i < n; i++) {
+        chksum = LWIP_CHKSUM_COPY(chksum_dst, &chksum_buf[1], sizes[s]);
+      }
+      secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+      fail_unless((u16_t)(chksum ^ ref) == 0xffff);
+      printf("copy   %-6s %5u bytes: %8.1f MB/s\n", CHKSUM_KERNEL_NAME(k), sizes[s],
+             (secs > 0) ? ((double)n * sizes[s] / secs / 1e6) : 0.0);
+#endif /* LWIP_CHECKSUM_ON_COPY */
+    }
+  }
+}
+END_TEST
+#endif /* CHKSUM_TEST_BENCH */
+
+/** Create the suite including all tests for this module */
+Suite *
+chksum_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_chksum_kernels),
+    TESTFUNC(test_chksum_pbuf),
+#if LWIP_CHECKSUM_ON_COPY
+    TESTFUNC(test_chksum_copy),
+#endif /* LWIP_CHECKSUM_ON_COPY */
+#if CHKSUM_TEST_BENCH
+    TESTFUNC(test_chksum_bench),
+#endif /* CHKSUM_TEST_BENCH */
+  };
+  return create_suite("CHKSUM", tests, sizeof(tests)/sizeof(testfunc), chksum_setup, chksum_teardown);
+}
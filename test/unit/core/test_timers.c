@@ -0,0 +1,222 @@
+#include "test_timers.h"
+
+#include "lwip/timeouts.h"
+#include "lwip/memp.h"
+#include "lwip/stats.h"
+#include "arch/sys_arch.h"
+
+#if !LWIP_TIMERS || LWIP_TIMERS_CUSTOM || !LWIP_TESTMODE
+#error "This tests needs the lwIP timer implementation and LWIP_TESTMODE"
+#endif
+
+#define NUM_TEST_TIMERS 8
+
+static u32_t fired[NUM_TEST_TIMERS];
+static u32_t fired_count;
+
+/* Setups/teardown functions */
+
+static void
+timers_setup(void)
+{
+  int i;
+  /* stop the stack's cyclic timers so only the test's timeouts are pending */
+  for (i = 0; i < lwip_num_cyclic_timers; i++) {
+    sys_untimeout(lwip_cyclic_timer, LWIP_CONST_CAST(void*, &lwip_cyclic_timers[i]));
+  }
+  memset(fired, 0, sizeof(fired));
+  fired_count = 0;
+}
+
+static void
+timers_teardown(void)
+{
+  int i;
+  lwip_sys_now = 0;
+  sys_restart_timeouts();
+  for (i = (LWIP_TCP ? 1 : 0); i < lwip_num_cyclic_timers; i++) {
+    sys_timeout(lwip_cyclic_timers[i].interval_ms, lwip_cyclic_timer, LWIP_CONST_CAST(void*, &lwip_cyclic_timers[i]));
+  }
+}
+
+/* Helper functions */
+
+static void
+test_timeout_handler(void *arg)
+{
+  mem_ptr_t idx = (mem_ptr_t)arg;
+  fail_unless(idx < NUM_TEST_TIMERS);
+  fired[idx] = lwip_sys_now;
+  fired_count++;
+}
+
+/** advance time 1 ms at a time, running expired timeouts */
+static void
+advance_time(u32_t msecs)
+{
+  u32_t i;
+  for (i = 0; i < msecs; i++) {
+    lwip_sys_now++;
+    sys_check_timeouts();
+  }
+}
+
+/* Test functions */
+
+static void
+check_expiry_order(u32_t start)
+{
+  static const u32_t delays[NUM_TEST_TIMERS] = {0, 1, 15, 16, 17, 255, 256, 4097};
+  mem_ptr_t i;
+
+  lwip_sys_now = start;
+  sys_check_timeouts();
+  for (i = 0; i < NUM_TEST_TIMERS; i++) {
+    sys_timeout(delays[i], test_timeout_handler, (void *)i);
+  }
+  sys_check_timeouts();
+  fail_unless(fired_count == 1);
+  advance_time(5000);
+  fail_unless(fired_count == NUM_TEST_TIMERS);
+  for (i = 0; i < NUM_TEST_TIMERS; i++) {
+    /* each timeout fires exactly when due, neither earlier nor later */
+    fail_unless(fired[i] == (u32_t)(start + delays[i]));
+  }
+}
+
+/** Timeouts expire exactly on time, across wheel levels */
+START_TEST(test_timers_expiry)
+{
+  LWIP_UNUSED_ARG(_i);
+  check_expiry_order(1000);
+}
+END_TEST
+
+/** Timeouts expire correctly when sys_now() wraps around */
+START_TEST(test_timers_wraparound)
+{
+  LWIP_UNUSED_ARG(_i);
+  check_expiry_order(0xffffff00UL);
+}
+END_TEST
+
+/** Long timeouts cascade down the wheel and still expire exactly on time */
+START_TEST(test_timers_long)
+{
+  u32_t sleeptime;
+  LWIP_UNUSED_ARG(_i);
+
+  lwip_sys_now = 12345;
+  sys_check_timeouts();
+  sys_timeout(0x12345678UL, test_timeout_handler, (void *)0);
+  sys_timeout(100000, test_timeout_handler, (void *)1);
+
+  /* sleep in steps given by sys_timeouts_sleeptime(), which must never
+     overshoot the next expiry */
+  while (fired_count < 2) {
+    sleeptime = sys_timeouts_sleeptime();
+    fail_unless(sleeptime != 0xffffffff);
+    fail_unless(sleeptime != 0);
+    lwip_sys_now += sleeptime;
+    sys_check_timeouts();
+  }
+  fail_unless(fired[0] == 12345 + 0x12345678UL);
+  fail_unless(fired[1] == 12345 + 100000);
+  fail_unless(sys_timeouts_sleeptime() == 0xffffffff);
+}
+END_TEST
+
+/** sys_untimeout() cancels the first matching timeout only */
+START_TEST(test_timers_untimeout)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  lwip_sys_now = 0;
+  sys_check_timeouts();
+  sys_timeout(300, test_timeout_handler, (void *)1);
+  sys_timeout(100, test_timeout_handler, (void *)1);
+  sys_timeout(200, test_timeout_handler, (void *)2);
+  fail_unless(MEMP_STATS_GET(used, MEMP_SYS_TIMEOUT) == 3);
+
+  sys_untimeout(test_timeout_handler, (void *)1);
+  fail_unless(MEMP_STATS_GET(used, MEMP_SYS_TIMEOUT) == 2);
+  advance_time(250);
+  fail_unless(fired_count == 1);
+  fail_unless(fired[2] == 200);
+  advance_time(100);
+  fail_unless(fired_count == 2);
+  fail_unless(fired[1] == 300);
+  fail_unless(MEMP_STATS_GET(used, MEMP_SYS_TIMEOUT) == 0);
+
+  /* nothing to cancel */
+  sys_untimeout(test_timeout_handler, (void *)1);
+}
+END_TEST
+
+#if LWIP_TIMERS_WHEEL
+static struct sys_timeo static_timeo;
+
+static void
+test_static_rearm_handler(void *arg)
+{
+  test_timeout_handler(arg);
+  if (fired_count < 3) {
+    sys_timeout_static(&static_timeo, 10, test_static_rearm_handler, arg);
+  }
+}
+
+/** Caller-provided timeouts: arm, re-arm, cancel and re-arm from the handler */
+START_TEST(test_timers_static)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&static_timeo, 0, sizeof(static_timeo));
+  lwip_sys_now = 500;
+  sys_check_timeouts();
+
+  sys_timeout_static(&static_timeo, 50, test_timeout_handler, (void *)3);
+  fail_unless(sys_timeout_static_pending(&static_timeo));
+  fail_unless(MEMP_STATS_GET(used, MEMP_SYS_TIMEOUT) == 0);
+  /* re-arming moves the expiry */
+  sys_timeout_static(&static_timeo, 100, test_timeout_handler, (void *)3);
+  /* sys_untimeout() does not see static timeouts */
+  sys_untimeout(test_timeout_handler, (void *)3);
+  advance_time(99);
+  fail_unless(fired_count == 0);
+  advance_time(1);
+  fail_unless(fired_count == 1);
+  fail_unless(fired[3] == 600);
+  fail_unless(!sys_timeout_static_pending(&static_timeo));
+
+  sys_timeout_static(&static_timeo, 10, test_timeout_handler, (void *)3);
+  sys_untimeout_static(&static_timeo);
+  fail_unless(!sys_timeout_static_pending(&static_timeo));
+  /* cancelling twice is fine */
+  sys_untimeout_static(&static_timeo);
+  advance_time(20);
+  fail_unless(fired_count == 1);
+
+  sys_timeout_static(&static_timeo, 10, test_static_rearm_handler, (void *)4);
+  advance_time(100);
+  fail_unless(fired_count == 3);
+  fail_unless(fired[4] == 640);
+  fail_unless(sys_timeouts_sleeptime() == 0xffffffff);
+}
+END_TEST
+#endif /* LWIP_TIMERS_WHEEL */
+
+/** Create the suite including all tests for this module */
+Suite *
+timers_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_timers_expiry),
+    TESTFUNC(test_timers_wraparound),
+    TESTFUNC(test_timers_long),
+    TESTFUNC(test_timers_untimeout),
+#if LWIP_TIMERS_WHEEL
+    TESTFUNC(test_timers_static),
+#endif /* LWIP_TIMERS_WHEEL */
+  };
+  return create_suite("TIMERS", tests, sizeof(tests)/sizeof(testfunc), timers_setup, timers_teardown);
+}
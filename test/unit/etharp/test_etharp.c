@@ -20,6 +20,12 @@ struct eth_addr test_ethaddr2 = {{1,1,1,1,1,2}};
 struct eth_addr test_ethaddr3 = {{1,1,1,1,1,3}};
 struct eth_addr test_ethaddr4 = {{1,1,1,1,1,4}};
 static int linkoutput_ctr;
+#if LWIP_TCP_TSO
+static u16_t linkoutput_tso_mss;
+#endif /* LWIP_TCP_TSO */
+#if LWIP_CHECKSUM_OFFLOAD
+static u16_t linkoutput_chksum_offset;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
 
 /* Helper functions */
 static void
@@ -38,6 +44,12 @@ default_netif_linkoutput(struct netif *netif, struct pbuf *p)
   fail_unless(netif == &test_netif);
   fail_unless(p != NULL);
   linkoutput_ctr++;
+#if LWIP_TCP_TSO
+  linkoutput_tso_mss = p->tso_mss;
+#endif /* LWIP_TCP_TSO */
+#if LWIP_CHECKSUM_OFFLOAD
+  linkoutput_chksum_offset = p->chksum_offset;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
   return ERR_OK;
 }
 
@@ -260,13 +272,59 @@ START_TEST(test_etharp_table)
 }
 END_TEST
 
+#if LWIP_CHECKSUM_OFFLOAD || LWIP_TCP_TSO
+/** A packet that has to be copied while waiting for ARP (here: PBUF_REF)
+ * keeps the offload metadata the netif needs to send it */
+START_TEST(test_etharp_queue_offload)
+{
+  static u8_t data[40];
+  ip4_addr_t adr;
+  struct pbuf *q;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  IP4_ADDR(&adr, 192, 168, 0, 10);
+  q = pbuf_alloc(PBUF_RAW, sizeof(data), PBUF_REF);
+  fail_unless(q != NULL);
+  q->payload = data;
+#if LWIP_TCP_TSO
+  q->tso_mss = 536;
+#endif /* LWIP_TCP_TSO */
+#if LWIP_CHECKSUM_OFFLOAD
+  q->chksum_start = 20;
+  q->chksum_offset = 16;
+#endif /* LWIP_CHECKSUM_OFFLOAD */
+
+  linkoutput_ctr = 0;
+  err = etharp_query(&test_netif, &adr, q);
+  fail_unless(err == ERR_OK);
+  pbuf_free(q);
+  /* the ARP request */
+  fail_unless(linkoutput_ctr == 1);
+
+  create_arp_response(&adr);
+  /* the queued copy */
+  fail_unless(linkoutput_ctr == 2);
+#if LWIP_TCP_TSO
+  fail_unless(linkoutput_tso_mss == 536);
+#endif /* LWIP_TCP_TSO */
+#if LWIP_CHECKSUM_OFFLOAD
+  fail_unless(linkoutput_chksum_offset == 16);
+#endif /* LWIP_CHECKSUM_OFFLOAD */
+}
+END_TEST
+#endif /* LWIP_CHECKSUM_OFFLOAD || LWIP_TCP_TSO */
+
 
 /** Create the suite including all tests for this module */
 Suite *
 etharp_suite(void)
 {
   testfunc tests[] = {
-    TESTFUNC(test_etharp_table)
+    TESTFUNC(test_etharp_table),
+#if LWIP_CHECKSUM_OFFLOAD || LWIP_TCP_TSO
+    TESTFUNC(test_etharp_queue_offload),
+#endif /* LWIP_CHECKSUM_OFFLOAD || LWIP_TCP_TSO */
   };
   return create_suite("ETHARP", tests, sizeof(tests)/sizeof(testfunc), etharp_setup, etharp_teardown);
 }
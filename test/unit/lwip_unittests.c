@@ -6,6 +6,8 @@
 #include "tcp/test_tcp_oos.h"
 #include "core/test_mem.h"
 #include "core/test_pbuf.h"
+#include "core/test_timers.h"
+#include "core/test_chksum.h"
 #include "etharp/test_etharp.h"
 #include "dhcp/test_dhcp.h"
 #include "mdns/test_mdns.h"
@@ -64,6 +66,8 @@ int main(void)
     tcp_oos_suite,
     mem_suite,
     pbuf_suite,
+    timers_suite,
+    chksum_suite,
     etharp_suite,
     dhcp_suite,
     mdns_suite,
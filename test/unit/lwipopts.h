@@ -43,6 +43,7 @@
 #define LWIP_NETBUF_RECVINFO            1
 #define LWIP_HAVE_LOOPIF                1
 #define TCPIP_THREAD_TEST
+#define LWIP_TESTMODE                   1
 
 /* Enable DHCP to test it, disable UDP checksum to easier inject packets */
 #define LWIP_DHCP                       1
@@ -57,6 +58,49 @@
 #define TCP_RCV_SCALE                   0
 #define PBUF_POOL_SIZE                  400 /* pbuf tests need ~200KByte */
 
+/* The optional TCP, timer and checksum features. Build the unit tests with
+   -DLWIP_UNITTESTS_DEFAULT_OPTS=1, too, so that the default paths (tcp_tmr()
+   scanning the pcb lists, linear pcb demultiplexing, Reno, no SACK...) keep
+   being tested. */
+#ifndef LWIP_UNITTESTS_DEFAULT_OPTS
+#define LWIP_UNITTESTS_DEFAULT_OPTS     0
+#endif
+#if !LWIP_UNITTESTS_DEFAULT_OPTS
+#define LWIP_TIMERS_WHEEL               1
+#define LWIP_TCP_SACK_OUT               1
+#define LWIP_TCP_SACK_IN                1
+#define LWIP_TCP_CUBIC                  1
+#define LWIP_TCP_PACING                 1
+#define LWIP_TCP_RACK                   1
+#define LWIP_TCP_FASTOPEN               1
+#define LWIP_TCP_SYNCOOKIES             1
+#define LWIP_TCP_SYN_REQ                1
+#define LWIP_TCP_TW_COMPACT             1
+#define LWIP_TCP_OOSEQ_TREE             1
+#define LWIP_TCP_OOSEQ_MEM              1
+#define LWIP_TCP_INFO                   1
+#define LWIP_TCP_TIMESTAMPS             1
+#define LWIP_TCP_TS_RTTM                1
+#define LWIP_TCP_ECN                    1
+#define IP_PMTUD                        1
+#define LWIP_TCP_PLPMTUD                1
+#define LWIP_TCP_ZEROCOPY               1
+#define LWIP_TCP_TSO                    1
+#define LWIP_NETIF_GRO                  1
+#define LWIP_CHECKSUM_OFFLOAD           1
+#define LWIP_CHKSUM_SIMD                1
+#define LWIP_CHECKSUM_ON_COPY           1
+#define LWIP_CHKSUM_COPY_ALGORITHM      2
+#define TCP_CHECKSUM_ON_COPY_SANITY_CHECK 1
+#define TCP_CHECKSUM_ON_COPY_SANITY_CHECK_FAIL(msg) LWIP_ASSERT("TCP checksum on copy mismatch", 0)
+#define LWIP_TCP_RCV_AUTOTUNE           1
+#define LWIP_TCP_SNDBUF_PCB             1
+#define LWIP_TCP_SND_AUTOTUNE           1
+#define LWIP_TCP_PCB_HASH               1
+#define LWIP_TCP_PCB_TIMERS             1
+#define TCP_PCB_HASH_SIZE               4096 /* demux test uses up to 10000 pcbs */
+#endif /* !LWIP_UNITTESTS_DEFAULT_OPTS */
+
 /* Enable IGMP and MDNS for MDNS tests */
 #define LWIP_IGMP                       1
 #define LWIP_MDNS_RESPONDER             1
@@ -35,6 +35,9 @@ tcp_remove_all(void)
   tcp_remove(tcp_listen_pcbs.pcbs);
   tcp_remove(tcp_active_pcbs);
   tcp_remove(tcp_tw_pcbs);
+#if LWIP_TCP_TW_COMPACT
+  tcp_tw_free_all();
+#endif /* LWIP_TCP_TW_COMPACT */
   fail_unless(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
   fail_unless(MEMP_STATS_GET(used, MEMP_TCP_PCB_LISTEN) == 0);
   fail_unless(MEMP_STATS_GET(used, MEMP_TCP_SEG) == 0);
@@ -43,23 +46,26 @@ tcp_remove_all(void)
 
 /** Create a TCP segment usable for passing to tcp_input */
 static struct pbuf*
-tcp_create_segment_wnd(ip_addr_t* src_ip, ip_addr_t* dst_ip,
-                   u16_t src_port, u16_t dst_port, void* data, size_t data_len,
-                   u32_t seqno, u32_t ackno, u8_t headerflags, u16_t wnd)
+tcp_create_segment_wnd_opts(const ip_addr_t* src_ip, const ip_addr_t* dst_ip,
+                   u16_t src_port, u16_t dst_port, const void* data, size_t data_len,
+                   u32_t seqno, u32_t ackno, u8_t headerflags, u16_t wnd,
+                   const u8_t* opts, u8_t optlen)
 {
   struct pbuf *p, *q;
   struct ip_hdr* iphdr;
   struct tcp_hdr* tcphdr;
-  u16_t pbuf_len = (u16_t)(sizeof(struct ip_hdr) + sizeof(struct tcp_hdr) + data_len);
+  u16_t hdrlen = (u16_t)(sizeof(struct tcp_hdr) + optlen);
+  u16_t pbuf_len = (u16_t)(sizeof(struct ip_hdr) + hdrlen + data_len);
   LWIP_ASSERT("data_len too big", data_len <= 0xFFFF);
+  LWIP_ASSERT("optlen must be a multiple of 4", (optlen & 3) == 0);
 
   p = pbuf_alloc(PBUF_RAW, pbuf_len, PBUF_POOL);
   EXPECT_RETNULL(p != NULL);
   /* first pbuf must be big enough to hold the headers */
-  EXPECT_RETNULL(p->len >= (sizeof(struct ip_hdr) + sizeof(struct tcp_hdr)));
+  EXPECT_RETNULL(p->len >= (sizeof(struct ip_hdr) + hdrlen));
   if (data_len > 0) {
     /* first pbuf must be big enough to hold at least 1 data byte, too */
-    EXPECT_RETNULL(p->len > (sizeof(struct ip_hdr) + sizeof(struct tcp_hdr)));
+    EXPECT_RETNULL(p->len > (sizeof(struct ip_hdr) + hdrlen));
   }
 
   for(q = p; q != NULL; q = q->next) {
@@ -83,17 +89,20 @@ tcp_create_segment_wnd(ip_addr_t* src_ip, ip_addr_t* dst_ip,
   tcphdr->dest  = htons(dst_port);
   tcphdr->seqno = htonl(seqno);
   tcphdr->ackno = htonl(ackno);
-  TCPH_HDRLEN_SET(tcphdr, sizeof(struct tcp_hdr)/4);
+  TCPH_HDRLEN_SET(tcphdr, hdrlen/4);
   TCPH_FLAGS_SET(tcphdr, headerflags);
   tcphdr->wnd   = htons(wnd);
+  if (optlen > 0) {
+    MEMCPY(tcphdr + 1, opts, optlen);
+  }
 
   if (data_len > 0) {
     /* let p point to TCP data */
-    pbuf_header(p, -(s16_t)sizeof(struct tcp_hdr));
+    pbuf_header(p, -(s16_t)hdrlen);
     /* copy data */
     pbuf_take(p, data, (u16_t)data_len);
     /* let p point to TCP header again */
-    pbuf_header(p, sizeof(struct tcp_hdr));
+    pbuf_header(p, (s16_t)hdrlen);
   }
 
   /* calculate checksum */
@@ -106,10 +115,20 @@ tcp_create_segment_wnd(ip_addr_t* src_ip, ip_addr_t* dst_ip,
   return p;
 }
 
+/** Create a TCP segment usable for passing to tcp_input */
+static struct pbuf*
+tcp_create_segment_wnd(const ip_addr_t* src_ip, const ip_addr_t* dst_ip,
+                   u16_t src_port, u16_t dst_port, const void* data, size_t data_len,
+                   u32_t seqno, u32_t ackno, u8_t headerflags, u16_t wnd)
+{
+  return tcp_create_segment_wnd_opts(src_ip, dst_ip, src_port, dst_port, data,
+    data_len, seqno, ackno, headerflags, wnd, NULL, 0);
+}
+
 /** Create a TCP segment usable for passing to tcp_input */
 struct pbuf*
-tcp_create_segment(ip_addr_t* src_ip, ip_addr_t* dst_ip,
-                   u16_t src_port, u16_t dst_port, void* data, size_t data_len,
+tcp_create_segment(const ip_addr_t* src_ip, const ip_addr_t* dst_ip,
+                   u16_t src_port, u16_t dst_port, const void* data, size_t data_len,
                    u32_t seqno, u32_t ackno, u8_t headerflags)
 {
   return tcp_create_segment_wnd(src_ip, dst_ip, src_port, dst_port, data,
@@ -140,6 +159,29 @@ struct pbuf* tcp_create_rx_segment_wnd(struct tcp_pcb* pcb, void* data, size_t d
     data, data_len, pcb->rcv_nxt + seqno_offset, pcb->lastack + ackno_offset, headerflags, wnd);
 }
 
+/** Create a TCP segment with options usable for passing to tcp_input
+ * - IP-addresses, ports and seqno are taken from pcb
+ * - ackno is absolute
+ * - opts must be padded to a multiple of 4 bytes
+ */
+struct pbuf* tcp_create_rx_segment_opts(struct tcp_pcb* pcb, void* data, size_t data_len,
+                   u32_t ackno, u8_t headerflags, const u8_t* opts, u8_t optlen)
+{
+  return tcp_create_segment_wnd_opts(&pcb->remote_ip, &pcb->local_ip, pcb->remote_port, pcb->local_port,
+    data, data_len, pcb->rcv_nxt, ackno, headerflags, TCP_WND, opts, optlen);
+}
+
+/** Create a TCP segment with options usable for passing to tcp_input
+ * - opts must be padded to a multiple of 4 bytes
+ */
+struct pbuf* tcp_create_segment_opts(const ip_addr_t* src_ip, const ip_addr_t* dst_ip,
+                   u16_t src_port, u16_t dst_port, const void* data, size_t data_len,
+                   u32_t seqno, u32_t ackno, u8_t headerflags, const u8_t* opts, u8_t optlen)
+{
+  return tcp_create_segment_wnd_opts(src_ip, dst_ip, src_port, dst_port,
+    data, data_len, seqno, ackno, headerflags, TCP_WND, opts, optlen);
+}
+
 /** Safely bring a tcp_pcb into the requested state */
 void
 tcp_set_state(struct tcp_pcb* pcb, enum tcp_state state, const ip_addr_t* local_ip,
@@ -157,22 +199,23 @@ tcp_set_state(struct tcp_pcb* pcb, enum tcp_state state, const ip_addr_t* local_
   pcb->lastack = iss;
   pcb->snd_lbb = iss;
   
+  /* addresses and ports must be set before registering (pcbs are hashed) */
   if (state == ESTABLISHED) {
-    TCP_REG(&tcp_active_pcbs, pcb);
     ip_addr_copy(pcb->local_ip, *local_ip);
     pcb->local_port = local_port;
     ip_addr_copy(pcb->remote_ip, *remote_ip);
     pcb->remote_port = remote_port;
+    TCP_REG(&tcp_active_pcbs, pcb);
   } else if(state == LISTEN) {
-    TCP_REG(&tcp_listen_pcbs.pcbs, pcb);
     ip_addr_copy(pcb->local_ip, *local_ip);
     pcb->local_port = local_port;
+    TCP_REG(&tcp_listen_pcbs.pcbs, pcb);
   } else if(state == TIME_WAIT) {
-    TCP_REG(&tcp_tw_pcbs, pcb);
     ip_addr_copy(pcb->local_ip, *local_ip);
     pcb->local_port = local_port;
     ip_addr_copy(pcb->remote_ip, *remote_ip);
     pcb->remote_port = remote_port;
+    TCP_REG(&tcp_tw_pcbs, pcb);
   } else {
     fail();
   }
@@ -35,13 +35,18 @@ extern const ip_addr_t test_netmask;
 /* Helper functions */
 void tcp_remove_all(void);
 
-struct pbuf* tcp_create_segment(ip_addr_t* src_ip, ip_addr_t* dst_ip,
-                   u16_t src_port, u16_t dst_port, void* data, size_t data_len,
+struct pbuf* tcp_create_segment(const ip_addr_t* src_ip, const ip_addr_t* dst_ip,
+                   u16_t src_port, u16_t dst_port, const void* data, size_t data_len,
                    u32_t seqno, u32_t ackno, u8_t headerflags);
 struct pbuf* tcp_create_rx_segment(struct tcp_pcb* pcb, void* data, size_t data_len,
                    u32_t seqno_offset, u32_t ackno_offset, u8_t headerflags);
 struct pbuf* tcp_create_rx_segment_wnd(struct tcp_pcb* pcb, void* data, size_t data_len,
                    u32_t seqno_offset, u32_t ackno_offset, u8_t headerflags, u16_t wnd);
+struct pbuf* tcp_create_rx_segment_opts(struct tcp_pcb* pcb, void* data, size_t data_len,
+                   u32_t ackno, u8_t headerflags, const u8_t* opts, u8_t optlen);
+struct pbuf* tcp_create_segment_opts(const ip_addr_t* src_ip, const ip_addr_t* dst_ip,
+                   u16_t src_port, u16_t dst_port, const void* data, size_t data_len,
+                   u32_t seqno, u32_t ackno, u8_t headerflags, const u8_t* opts, u8_t optlen);
 void tcp_set_state(struct tcp_pcb* pcb, enum tcp_state state, const ip_addr_t* local_ip,
                    const ip_addr_t* remote_ip, u16_t local_port, u16_t remote_port);
 void test_tcp_counters_err(void* arg, err_t err);
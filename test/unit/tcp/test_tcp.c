@@ -4,6 +4,17 @@
 #include "lwip/stats.h"
 #include "tcp_helper.h"
 #include "lwip/inet_chksum.h"
+#if LWIP_TCP_PCB_TIMERS || LWIP_TCP_PACING || LWIP_TCP_RACK
+#include "lwip/timeouts.h"
+#endif /* LWIP_TCP_PCB_TIMERS || LWIP_TCP_PACING || LWIP_TCP_RACK */
+#if LWIP_TCP_PCB_TIMERS || LWIP_TCP_CUBIC || LWIP_TCP_PACING || LWIP_TCP_RACK || LWIP_TCP_SYNCOOKIES || LWIP_TCP_RCV_AUTOTUNE || LWIP_TCP_TS_RTTM || IP_PMTUD
+#include "lwip/sys.h"
+#include "arch/sys_arch.h"
+#endif /* LWIP_TCP_PCB_TIMERS || LWIP_TCP_CUBIC || LWIP_TCP_PACING || LWIP_TCP_RACK || LWIP_TCP_SYNCOOKIES || LWIP_TCP_RCV_AUTOTUNE || LWIP_TCP_TS_RTTM || IP_PMTUD */
+#if IP_PMTUD
+#include "lwip/ip4_pmtu.h"
+#include "lwip/icmp.h"
+#endif /* IP_PMTUD */
 
 #ifdef _MSC_VER
 #pragma warning(disable: 4307) /* we explicitly wrap around TCP seqnos */
@@ -29,6 +40,15 @@ static u32_t seqnos[] = {
 
 static u8_t test_tcp_timer;
 
+#if LWIP_TCP_PCB_TIMERS
+/* per-pcb timers are driven by sys_now(): advance time by one tcp_tmr() period */
+static void
+test_tcp_tmr(void)
+{
+  lwip_sys_now += TCP_TMR_INTERVAL;
+  sys_check_timeouts();
+}
+#else /* LWIP_TCP_PCB_TIMERS */
 /* our own version of tcp_tmr so we can reset fast/slow timer state */
 static void
 test_tcp_tmr(void)
@@ -38,6 +58,7 @@ test_tcp_tmr(void)
     tcp_slowtmr();
   }
 }
+#endif /* LWIP_TCP_PCB_TIMERS */
 
 /* Setups/teardown functions */
 static struct netif *old_netif_list;
@@ -59,6 +80,21 @@ tcp_setup(void)
   test_tcp_timer = 0;
   tcp_remove_all();
   lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+#if LWIP_TCP_PCB_TIMERS || LWIP_TCP_PACING || LWIP_TCP_RACK
+  {
+    int i;
+    /* stop the stack's cyclic timers so only tcp timers run when advancing time */
+    for (i = 0; i < lwip_num_cyclic_timers; i++) {
+      sys_untimeout(lwip_cyclic_timer, LWIP_CONST_CAST(void*, &lwip_cyclic_timers[i]));
+    }
+  }
+#endif /* LWIP_TCP_PCB_TIMERS || LWIP_TCP_PACING || LWIP_TCP_RACK */
+#if LWIP_TCP_PCB_TIMERS
+  /* restart the tcp tick clock half a tick early, so that slow ticks happen
+     on the same test_tcp_tmr() calls as with tcp_fasttmr()/tcp_slowtmr() */
+  tcp_init();
+  lwip_sys_now += TCP_TMR_INTERVAL;
+#endif /* LWIP_TCP_PCB_TIMERS */
 }
 
 static void
@@ -71,6 +107,14 @@ tcp_teardown(void)
   netif_list = old_netif_list;
   netif_default = old_netif_default;
   lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+#if LWIP_TCP_PCB_TIMERS || LWIP_TCP_PACING || LWIP_TCP_RACK
+  {
+    int i;
+    for (i = 1; i < lwip_num_cyclic_timers; i++) {
+      sys_timeout(lwip_cyclic_timers[i].interval_ms, lwip_cyclic_timer, LWIP_CONST_CAST(void*, &lwip_cyclic_timers[i]));
+    }
+  }
+#endif /* LWIP_TCP_PCB_TIMERS || LWIP_TCP_PACING || LWIP_TCP_RACK */
 }
 
 
@@ -997,6 +1041,2915 @@ START_TEST(test_tcp_zwp_timeout)
 }
 END_TEST
 
+#if LWIP_TCP_SACK_IN
+#define SACK_TEST_SEGS 10
+
+/* data segments sent by the pcb, in order */
+static u32_t sack_tx_seqno[4 * SACK_TEST_SEGS];
+static u16_t sack_tx_num, sack_tx_pos;
+static u32_t sack_tx_bytes;
+
+/** netif output recording the seqno of each data segment sent */
+static err_t
+test_tcp_sack_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  struct tcp_hdr tcphdr;
+  u16_t hlen, len;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  EXPECT_RETX(pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0) == sizeof(iphdr), ERR_OK);
+  hlen = (u16_t)IPH_HL_BYTES(&iphdr);
+  EXPECT_RETX(pbuf_copy_partial(p, &tcphdr, sizeof(tcphdr), hlen) == sizeof(tcphdr), ERR_OK);
+  len = (u16_t)(p->tot_len - hlen - TCPH_HDRLEN_BYTES(&tcphdr));
+  if (len > 0) {
+    EXPECT_RETX(sack_tx_num < LWIP_ARRAYSIZE(sack_tx_seqno), ERR_OK);
+    sack_tx_seqno[sack_tx_num++] = lwip_ntohl(tcphdr.seqno);
+    sack_tx_bytes += len;
+  }
+  return ERR_OK;
+}
+
+/** Send SACK_TEST_SEGS full-sized segments and let a simple receiver drop the
+ * first transmission of segments 1, 4 and 7 and ACK every segment it gets
+ * (with SACK blocks if 'sack' is set). Returns the number of retransmitted
+ * bytes; 'rto_ticks' returns the number of tcp_tmr() calls needed because
+ * nothing was in flight any more. */
+static u32_t
+test_tcp_sack_lossy_transfer(struct netif *netif, u8_t sack, u32_t *rto_ticks)
+{
+  u8_t received[SACK_TEST_SEGS], dropped[SACK_TEST_SEGS];
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  u32_t iss, i;
+  err_t err;
+
+  test_tcp_init_netif(netif, &txcounters, &test_local_ip, &test_netmask);
+  netif->output = test_tcp_sack_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  memset(received, 0, sizeof(received));
+  memset(dropped, 0, sizeof(dropped));
+  sack_tx_num = sack_tx_pos = 0;
+  sack_tx_bytes = 0;
+  *rto_ticks = 0;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RETX(pcb != NULL, 0);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = SACK_TEST_SEGS * TCP_MSS;
+  if (sack) {
+    tcp_set_flags(pcb, TF_SACK);
+  }
+  iss = pcb->snd_nxt;
+
+  err = tcp_write(pcb, tx_data, SACK_TEST_SEGS * TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RETX(err == ERR_OK, 0);
+  err = tcp_output(pcb);
+  EXPECT_RETX(err == ERR_OK, 0);
+  EXPECT_RETX(sack_tx_num == SACK_TEST_SEGS, 0);
+
+  while ((pcb->unacked != NULL) || (pcb->unsent != NULL)) {
+    u8_t opts[40];
+    u8_t optlen = 0;
+    u32_t ack_idx;
+    if (sack_tx_pos == sack_tx_num) {
+      /* nothing in flight any more: wait for the RTO */
+      test_tcp_tmr();
+      (*rto_ticks)++;
+      EXPECT_RETX(*rto_ticks < 100, 0);
+      continue;
+    }
+    i = (sack_tx_seqno[sack_tx_pos++] - iss) / TCP_MSS;
+    EXPECT_RETX(i < SACK_TEST_SEGS, 0);
+    if (((i % 3) == 1) && !dropped[i]) {
+      dropped[i] = 1;
+      continue;
+    }
+    received[i] = 1;
+    for (ack_idx = 0; (ack_idx < SACK_TEST_SEGS) && received[ack_idx]; ack_idx++);
+    if (sack) {
+      /* SACK option: two NOPs, kind, length and up to 4 blocks */
+      u32_t j = ack_idx;
+      optlen = 4;
+      while ((j < SACK_TEST_SEGS) && (optlen < sizeof(opts))) {
+        u32_t left, right;
+        for (; (j < SACK_TEST_SEGS) && !received[j]; j++);
+        if (j == SACK_TEST_SEGS) {
+          break;
+        }
+        left = lwip_htonl(iss + j * TCP_MSS);
+        for (; (j < SACK_TEST_SEGS) && received[j]; j++);
+        right = lwip_htonl(iss + j * TCP_MSS);
+        memcpy(&opts[optlen], &left, 4);
+        memcpy(&opts[optlen + 4], &right, 4);
+        optlen = (u8_t)(optlen + 8);
+      }
+      if (optlen == 4) {
+        optlen = 0;
+      } else {
+        opts[0] = opts[1] = LWIP_TCP_OPT_NOP;
+        opts[2] = LWIP_TCP_OPT_SACK;
+        opts[3] = (u8_t)(optlen - 2);
+      }
+    }
+    p = tcp_create_rx_segment_opts(pcb, NULL, 0, iss + ack_idx * TCP_MSS, TCP_ACK, opts, optlen);
+    EXPECT_RETX(p != NULL, 0);
+    test_tcp_input(p, netif);
+  }
+  for (i = 0; i < SACK_TEST_SEGS; i++) {
+    EXPECT(received[i]);
+  }
+
+  /* make sure the pcb is freed */
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 1);
+  tcp_abort(pcb);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+  return sack_tx_bytes - SACK_TEST_SEGS * TCP_MSS;
+}
+
+/** Check that SACK-based recovery retransmits only the holes of a window
+ * with multiple losses, while NewReno recovery needs an RTO and
+ * retransmits more */
+START_TEST(test_tcp_sack_multi_loss)
+{
+  struct netif netif;
+  u32_t reno_bytes, reno_ticks, sack_bytes, sack_ticks;
+  LWIP_UNUSED_ARG(_i);
+
+  reno_bytes = test_tcp_sack_lossy_transfer(&netif, 0, &reno_ticks);
+  sack_bytes = test_tcp_sack_lossy_transfer(&netif, 1, &sack_ticks);
+
+  EXPECT(sack_bytes == 3 * TCP_MSS);
+  EXPECT(sack_ticks == 0);
+  EXPECT(reno_ticks > 0);
+  EXPECT(sack_bytes < reno_bytes);
+}
+END_TEST
+
+/** Check that entering SACK-based recovery retransmits the first hole even if
+ * less than (DupThresh - 1) * SMSS bytes are SACKed above it and new data is
+ * waiting: 3 small segments SACKed in 3 blocks make it lost (RFC 6675) */
+START_TEST(test_tcp_sack_recovery_small_segs)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  u8_t opts[28];
+  u32_t iss, i;
+  u16_t tx_num;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_sack_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  sack_tx_num = 0;
+  sack_tx_bytes = 0;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 10 * TCP_MSS;
+  tcp_set_flags(pcb, TF_SACK);
+  iss = pcb->snd_nxt;
+
+  /* 6 segments of 100 bytes */
+  tcp_nagle_disable(pcb);
+  for (i = 0; i < 6; i++) {
+    err = tcp_write(pcb, &tx_data[i * 100], 100, TCP_WRITE_FLAG_COPY);
+    EXPECT_RET(err == ERR_OK);
+    err = tcp_output(pcb);
+    EXPECT_RET(err == ERR_OK);
+  }
+  EXPECT_RET(sack_tx_num == 6);
+  /* more data, held back by Nagle's algorithm */
+  tcp_nagle_enable(pcb);
+  err = tcp_write(pcb, &tx_data[600], 100, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_output(pcb);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(sack_tx_num == 6);
+  EXPECT_RET(pcb->unsent != NULL);
+#if LWIP_TCP_RACK
+  /* ACKs come back after 100 ms, so that RACK doesn't detect the losses */
+  lwip_sys_now += 100;
+#endif /* LWIP_TCP_RACK */
+
+  /* segments 0, 2 and 4 are lost: 3 duplicate ACKs with 1, 2 and 3 SACK blocks */
+  opts[0] = opts[1] = LWIP_TCP_OPT_NOP;
+  opts[2] = LWIP_TCP_OPT_SACK;
+  for (i = 0; i < 3; i++) {
+    u32_t left = lwip_htonl(iss + (2 * i + 1) * 100);
+    u32_t right = lwip_htonl(iss + (2 * i + 2) * 100);
+    memcpy(&opts[4 + 8 * i], &left, 4);
+    memcpy(&opts[8 + 8 * i], &right, 4);
+    opts[3] = (u8_t)(2 + 8 * (i + 1));
+    p = tcp_create_rx_segment_opts(pcb, NULL, 0, iss, TCP_ACK, opts, (u8_t)(4 + 8 * (i + 1)));
+    EXPECT_RET(p != NULL);
+    tx_num = sack_tx_num;
+    test_tcp_input(p, &netif);
+    if (i < 2) {
+      EXPECT(sack_tx_num == tx_num);
+    }
+  }
+
+  /* the first hole is retransmitted first, the new data does not replace it */
+  EXPECT(pcb->flags & TF_SACK_RECOVERY);
+  EXPECT_RET(sack_tx_num > tx_num);
+  EXPECT(sack_tx_seqno[tx_num] == iss);
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_TCP_SACK_IN */
+
+/** Check selecting the congestion control algorithm by name */
+START_TEST(test_tcp_cc_select)
+{
+  struct tcp_pcb *pcb, *lpcb;
+  LWIP_UNUSED_ARG(_i);
+
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  EXPECT(strcmp(tcp_get_congestion(pcb), "reno") == 0);
+  EXPECT(tcp_set_congestion(pcb, "nosuchalgo") == ERR_VAL);
+  EXPECT(pcb->cc == &tcp_cc_reno);
+#if LWIP_TCP_CUBIC
+  EXPECT(tcp_set_congestion(pcb, "cubic") == ERR_OK);
+  EXPECT(strcmp(tcp_get_congestion(pcb), "cubic") == 0);
+#endif /* LWIP_TCP_CUBIC */
+
+  /* listeners keep the algorithm to pass it on to accepted connections */
+  EXPECT(tcp_bind(pcb, &test_local_ip, 1234) == ERR_OK);
+  lpcb = tcp_listen(pcb);
+  EXPECT_RET(lpcb != NULL);
+#if LWIP_TCP_CUBIC
+  EXPECT(lpcb->cc == &tcp_cc_cubic);
+#else /* LWIP_TCP_CUBIC */
+  EXPECT(lpcb->cc == &tcp_cc_reno);
+#endif /* LWIP_TCP_CUBIC */
+  tcp_close(lpcb);
+}
+END_TEST
+
+#if LWIP_TCP_CUBIC
+/** Feed 'rtts' round trips (of 500 ms) of ACKs for a full cwnd to the
+ * congestion control of a pcb */
+static void
+test_tcp_cc_rounds(struct tcp_pcb *pcb, int rtts)
+{
+  int i;
+  for (i = 0; i < rtts; i++) {
+    tcpwnd_size_t acked, cwnd = pcb->cwnd;
+    lwip_sys_now += 500;
+    for (acked = 0; acked < cwnd; acked += pcb->mss) {
+      pcb->cc->ack(pcb, pcb->mss);
+    }
+  }
+}
+
+/** Check CUBIC's window after a loss: smaller reduction than Reno, fast
+ * (concave) return to the previous maximum, then convex probing beyond */
+START_TEST(test_tcp_cubic_growth)
+{
+  struct tcp_pcb *reno, *cubic;
+  u32_t epoch_start;
+  LWIP_UNUSED_ARG(_i);
+
+  reno = tcp_new();
+  cubic = tcp_new();
+  EXPECT_RET((reno != NULL) && (cubic != NULL));
+  EXPECT(tcp_set_congestion(cubic, "cubic") == ERR_OK);
+  reno->mss = cubic->mss = TCP_MSS;
+  reno->snd_wnd = cubic->snd_wnd = 100 * TCP_MSS;
+  reno->sa = cubic->sa = 8; /* srtt: one slow tick (500 ms) */
+  reno->cwnd = cubic->cwnd = 20 * TCP_MSS;
+
+  /* loss: Reno halves, CUBIC reduces to 0.7 */
+  reno->cc->loss(reno);
+  cubic->cc->loss(cubic);
+  EXPECT(reno->ssthresh == 10 * TCP_MSS);
+  EXPECT(cubic->ssthresh == (20 * TCP_MSS * 717) / 1024);
+  reno->cwnd = reno->ssthresh;
+  cubic->cwnd = cubic->ssthresh;
+
+  /* K is ~2.5 s: after 5 rounds, CUBIC is back close to the old maximum
+     while Reno grew by one segment per round */
+  test_tcp_cc_rounds(reno, 5);
+  test_tcp_cc_rounds(cubic, 5);
+  EXPECT(reno->cwnd == 15 * TCP_MSS);
+  EXPECT(cubic->cwnd >= 18 * TCP_MSS);
+  EXPECT(cubic->cwnd <= 21 * TCP_MSS);
+
+  /* the idle period does not count as growth time */
+  epoch_start = cubic->cubic.epoch_start;
+  lwip_sys_now += 10000;
+  TCP_CC_EVENT(cubic, idle);
+  EXPECT(cubic->cubic.epoch_start == epoch_start + 10000);
+
+  /* beyond the plateau, CUBIC probes for more bandwidth much faster */
+  test_tcp_cc_rounds(reno, 10);
+  test_tcp_cc_rounds(cubic, 10);
+  EXPECT(reno->cwnd == 25 * TCP_MSS);
+  EXPECT(cubic->cwnd > 2 * reno->cwnd);
+
+  /* RTO: back to one segment, ssthresh 0.7 of the window */
+  cubic->cwnd = 40 * TCP_MSS;
+  cubic->cc->rto(cubic);
+  EXPECT(cubic->cwnd == TCP_MSS);
+  EXPECT(cubic->ssthresh == (40 * TCP_MSS * 717) / 1024);
+
+  tcp_abort(reno);
+  tcp_abort(cubic);
+}
+END_TEST
+#endif /* LWIP_TCP_CUBIC */
+
+#if LWIP_TCP_PACING
+#define PACING_TEST_SEGS 8
+static u32_t pacing_tx_time[PACING_TEST_SEGS];
+static u16_t pacing_tx_num;
+
+/** netif output recording when each data segment is sent */
+static err_t
+test_tcp_pacing_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  struct tcp_hdr tcphdr;
+  u16_t hlen;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  EXPECT_RETX(pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0) == sizeof(iphdr), ERR_OK);
+  hlen = (u16_t)IPH_HL_BYTES(&iphdr);
+  EXPECT_RETX(pbuf_copy_partial(p, &tcphdr, sizeof(tcphdr), hlen) == sizeof(tcphdr), ERR_OK);
+  if (p->tot_len > hlen + TCPH_HDRLEN_BYTES(&tcphdr)) {
+    EXPECT_RETX(pacing_tx_num < PACING_TEST_SEGS, ERR_OK);
+    pacing_tx_time[pacing_tx_num++] = sys_now();
+  }
+  return ERR_OK;
+}
+
+/** Check that a paced connection sends a small burst and then releases its
+ * segments spaced according to the pacing rate */
+START_TEST(test_tcp_pacing_spacing)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  err_t err;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_pacing_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  pacing_tx_num = 0;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = PACING_TEST_SEGS * TCP_MSS;
+  /* tcp_ticks must not be 0 to time a segment */
+  test_tcp_tmr();
+  test_tcp_tmr();
+
+  /* no RTT measured yet: not paced */
+  EXPECT(tcp_pacing_rate(pcb) == 0);
+  err = tcp_write(pcb, tx_data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_output(pcb);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(pacing_tx_num == 1);
+  /* the ACK comes back after 20 ms, far less than a slow timer tick */
+  lwip_sys_now += 20;
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(pcb->unacked == NULL);
+  pacing_tx_num = 0;
+
+  /* the rate follows cwnd/srtt (200% in slow start) */
+  pcb->cwnd = PACING_TEST_SEGS * TCP_MSS;
+  EXPECT(tcp_pacing_rate(pcb) == 2 * PACING_TEST_SEGS * TCP_MSS * (1000 / 20));
+  pcb->ssthresh = pcb->cwnd;
+  EXPECT(tcp_pacing_rate(pcb) == PACING_TEST_SEGS * TCP_MSS * (1000 / 20) * 6 / 5);
+  /* ...unless limited: 10 segments per second */
+  tcp_set_max_pacing_rate(pcb, 10 * TCP_MSS);
+  EXPECT(tcp_pacing_rate(pcb) == 10 * TCP_MSS);
+
+  lwip_sys_now += 1000;
+  err = tcp_write(pcb, tx_data, PACING_TEST_SEGS * TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_output(pcb);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT(pacing_tx_num == TCP_PACING_BURST);
+
+  for (i = 0; (i < 2000) && (pacing_tx_num < PACING_TEST_SEGS); i++) {
+    lwip_sys_now++;
+    sys_check_timeouts();
+  }
+  EXPECT_RET(pacing_tx_num == PACING_TEST_SEGS);
+  for (i = 1; i < TCP_PACING_BURST; i++) {
+    EXPECT(pacing_tx_time[i] == pacing_tx_time[0]);
+  }
+  for (i = TCP_PACING_BURST; i < PACING_TEST_SEGS; i++) {
+    EXPECT(pacing_tx_time[i] - pacing_tx_time[i - 1] == 100);
+  }
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_TCP_PACING */
+
+#if LWIP_TCP_RACK
+#define RACK_TEST_SEGS 4
+#define RACK_TEST_RTT  10
+static u32_t rack_tx_seqno[4 * RACK_TEST_SEGS];
+static u32_t rack_tx_time[4 * RACK_TEST_SEGS];
+static u16_t rack_tx_num;
+
+/** netif output recording seqno and time of each data segment sent */
+static err_t
+test_tcp_rack_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  struct tcp_hdr tcphdr;
+  u16_t hlen;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  EXPECT_RETX(pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0) == sizeof(iphdr), ERR_OK);
+  hlen = (u16_t)IPH_HL_BYTES(&iphdr);
+  EXPECT_RETX(pbuf_copy_partial(p, &tcphdr, sizeof(tcphdr), hlen) == sizeof(tcphdr), ERR_OK);
+  if (p->tot_len > hlen + TCPH_HDRLEN_BYTES(&tcphdr)) {
+    EXPECT_RETX(rack_tx_num < LWIP_ARRAYSIZE(rack_tx_seqno), ERR_OK);
+    rack_tx_seqno[rack_tx_num] = lwip_ntohl(tcphdr.seqno);
+    rack_tx_time[rack_tx_num++] = sys_now();
+  }
+  return ERR_OK;
+}
+
+/** Let time pass in 1 ms steps until a data segment is sent */
+static void
+test_tcp_rack_wait_tx(u32_t max_ms)
+{
+  u16_t num = rack_tx_num;
+  u32_t i;
+  for (i = 0; (i < max_ms) && (rack_tx_num == num); i++) {
+    lwip_sys_now++;
+    sys_check_timeouts();
+  }
+}
+
+/** Check that losing the last two segments of a flight is repaired by a
+ * tail loss probe and RACK within a few RTTs instead of by the RTO */
+START_TEST(test_tcp_rack_tail_loss)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  u8_t opts[12];
+  u32_t iss, left, right, start;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_rack_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  rack_tx_num = 0;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = RACK_TEST_SEGS * TCP_MSS;
+  tcp_set_flags(pcb, TF_SACK);
+  iss = pcb->snd_nxt;
+
+  lwip_sys_now += 1000;
+  start = sys_now();
+  err = tcp_write(pcb, tx_data, RACK_TEST_SEGS * TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_output(pcb);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(rack_tx_num == RACK_TEST_SEGS);
+
+  /* the first two segments arrive, the last two are lost */
+  lwip_sys_now += RACK_TEST_RTT;
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, iss + 2 * TCP_MSS - pcb->lastack, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->rack_srtt == RACK_TEST_RTT);
+
+  /* no more ACKs: the last segment is sent again as probe after 2 RTTs */
+  test_tcp_rack_wait_tx(1000);
+  EXPECT_RET(rack_tx_num == RACK_TEST_SEGS + 1);
+  EXPECT(rack_tx_seqno[RACK_TEST_SEGS] == iss + 3 * TCP_MSS);
+  EXPECT(rack_tx_time[RACK_TEST_SEGS] == start + 3 * RACK_TEST_RTT);
+
+  /* the probe is SACKed: RACK marks the other lost segment and retransmits it */
+  lwip_sys_now += RACK_TEST_RTT;
+  left = lwip_htonl(iss + 3 * TCP_MSS);
+  right = lwip_htonl(iss + 4 * TCP_MSS);
+  opts[0] = opts[1] = LWIP_TCP_OPT_NOP;
+  opts[2] = LWIP_TCP_OPT_SACK;
+  opts[3] = 10;
+  memcpy(&opts[4], &left, 4);
+  memcpy(&opts[8], &right, 4);
+  p = tcp_create_rx_segment_opts(pcb, NULL, 0, iss + 2 * TCP_MSS, TCP_ACK, opts, sizeof(opts));
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(rack_tx_num == RACK_TEST_SEGS + 2);
+  EXPECT(rack_tx_seqno[RACK_TEST_SEGS + 1] == iss + 2 * TCP_MSS);
+  EXPECT(pcb->flags & TF_SACK_RECOVERY);
+
+  /* recovered one RTT later, long before the RTO */
+  lwip_sys_now += RACK_TEST_RTT;
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, iss + 4 * TCP_MSS - pcb->lastack, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(sys_now() - start == 5 * RACK_TEST_RTT);
+  EXPECT(5 * RACK_TEST_RTT < pcb->rto * TCP_SLOW_INTERVAL);
+  EXPECT(!sys_timeout_static_pending(&pcb->rack_timer));
+  EXPECT(rack_tx_num == RACK_TEST_SEGS + 2);
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_TCP_RACK */
+
+#if LWIP_TCP_FASTOPEN || LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ || LWIP_TCP_TW_COMPACT
+/* the last segment sent (recorded by test_tcp_record_netif_output()) */
+static struct tcp_hdr rec_tx_hdr;
+static u8_t rec_tx_opts[40];
+static u16_t rec_tx_datalen;
+static u16_t rec_tx_num;
+
+/** netif output recording the header, options and data length of each segment */
+static err_t
+test_tcp_record_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  u16_t hlen, optlen;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  EXPECT_RETX(pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0) == sizeof(iphdr), ERR_OK);
+  hlen = (u16_t)IPH_HL_BYTES(&iphdr);
+  EXPECT_RETX(pbuf_copy_partial(p, &rec_tx_hdr, sizeof(rec_tx_hdr), hlen) == sizeof(rec_tx_hdr), ERR_OK);
+  optlen = (u16_t)(TCPH_HDRLEN_BYTES(&rec_tx_hdr) - TCP_HLEN);
+  memset(rec_tx_opts, LWIP_TCP_OPT_EOL, sizeof(rec_tx_opts));
+  EXPECT_RETX(pbuf_copy_partial(p, rec_tx_opts, optlen, (u16_t)(hlen + TCP_HLEN)) == optlen, ERR_OK);
+  rec_tx_datalen = (u16_t)(p->tot_len - hlen - TCPH_HDRLEN_BYTES(&rec_tx_hdr));
+  rec_tx_num++;
+  return ERR_OK;
+}
+
+#if LWIP_TCP_FASTOPEN || LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ
+/** Find an option of the last segment sent, NULL if not present */
+static const u8_t *
+test_tcp_rec_tx_opt(u8_t kind)
+{
+  u16_t i = 0;
+  while ((i < sizeof(rec_tx_opts)) && (rec_tx_opts[i] != LWIP_TCP_OPT_EOL)) {
+    if (rec_tx_opts[i] == LWIP_TCP_OPT_NOP) {
+      i++;
+    } else if (rec_tx_opts[i] == kind) {
+      return &rec_tx_opts[i];
+    } else {
+      i = (u16_t)(i + rec_tx_opts[i + 1]);
+    }
+  }
+  return NULL;
+}
+#endif /* LWIP_TCP_FASTOPEN || LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ */
+#endif /* LWIP_TCP_FASTOPEN || LWIP_TCP_SYNCOOKIES || LWIP_TCP_SYN_REQ || LWIP_TCP_TW_COMPACT */
+
+#if LWIP_TCP_FASTOPEN
+static struct tcp_pcb *fastopen_accepted;
+static u8_t fastopen_accept_calls;
+
+/** Get the cookie of the TFO option of the last segment sent.
+ * @return cookie length (0 for a cookie request), -1 if there is no TFO option */
+static int
+test_tcp_fastopen_tx_cookie(u8_t *cookie)
+{
+  const u8_t *opt = test_tcp_rec_tx_opt(LWIP_TCP_OPT_FASTOPEN);
+  if (opt != NULL) {
+    int len = opt[1] - 2;
+    memcpy(cookie, &opt[2], (size_t)len);
+    return len;
+  }
+  return -1;
+}
+
+static err_t
+test_tcp_fastopen_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
+{
+  EXPECT_RETX(err == ERR_OK, ERR_VAL);
+  fastopen_accepted = newpcb;
+  fastopen_accept_calls++;
+  tcp_arg(newpcb, arg);
+  tcp_recv(newpcb, test_tcp_counters_recv);
+  tcp_err(newpcb, test_tcp_counters_err);
+  return ERR_OK;
+}
+
+/** Check the client side of TCP Fast Open: cookie request, caching the
+ * cookie, sending data with the SYN and the fallback when the server only
+ * acknowledges the SYN */
+START_TEST(test_tcp_fastopen_client)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  static const u8_t cookie[TCP_FASTOPEN_COOKIE_LEN] = {1, 2, 3, 4, 5, 6, 7, 8};
+  u8_t tx_cookie[TCP_FASTOPEN_COOKIE_LEN];
+  u8_t opts[12];
+  u16_t mss, num;
+  u32_t syn_seqno;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_record_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  rec_tx_num = 0;
+  tcp_fastopen_cookie_set(&test_remote_ip, NULL, 0, 0);
+
+  /* first connection: the SYN requests a cookie */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_fastopen_enable(pcb);
+  err = tcp_connect(pcb, &test_remote_ip, TEST_REMOTE_PORT, NULL);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(rec_tx_num == 1);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == TCP_SYN);
+  EXPECT(test_tcp_fastopen_tx_cookie(tx_cookie) == 0);
+
+  /* the <SYN,ACK> carries a cookie, which is cached */
+  opts[0] = opts[1] = LWIP_TCP_OPT_NOP;
+  opts[2] = LWIP_TCP_OPT_FASTOPEN;
+  opts[3] = 2 + sizeof(cookie);
+  memcpy(&opts[4], cookie, sizeof(cookie));
+  p = tcp_create_rx_segment_opts(pcb, NULL, 0, pcb->lastack + 1, TCP_SYN | TCP_ACK, opts, sizeof(opts));
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->state == ESTABLISHED);
+  EXPECT(tcp_fastopen_cookie_get(&test_remote_ip, tx_cookie, &mss) == sizeof(cookie));
+  EXPECT(memcmp(tx_cookie, cookie, sizeof(cookie)) == 0);
+  tcp_abort(pcb);
+
+  /* second connection: the SYN is deferred and sent with the data */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_fastopen_enable(pcb);
+  num = rec_tx_num;
+  err = tcp_connect(pcb, &test_remote_ip, TEST_REMOTE_PORT, NULL);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT(rec_tx_num == num);
+  syn_seqno = pcb->lastack;
+  err = tcp_write(pcb, tx_data, 100, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_output(pcb);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(rec_tx_num == num + 1);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == TCP_SYN);
+  EXPECT(lwip_ntohl(rec_tx_hdr.seqno) == syn_seqno);
+  EXPECT(rec_tx_datalen == 100);
+  EXPECT(test_tcp_fastopen_tx_cookie(tx_cookie) == sizeof(cookie));
+  EXPECT(memcmp(tx_cookie, cookie, sizeof(cookie)) == 0);
+  EXPECT(pcb->unsent == NULL);
+  EXPECT(pcb->snd_nxt == syn_seqno + 1 + 100);
+
+  /* the <SYN,ACK> acknowledges the data, too */
+  p = tcp_create_rx_segment_opts(pcb, NULL, 0, syn_seqno + 1 + 100, TCP_SYN | TCP_ACK, opts, sizeof(opts));
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->state == ESTABLISHED);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(pcb->snd_queuelen == 0);
+  EXPECT(pcb->snd_buf == TCP_SND_BUF);
+  EXPECT(rec_tx_num == num + 2); /* ACK */
+  tcp_abort(pcb);
+
+  /* third connection: the server only acknowledges the SYN and sends no
+     cookie: the data is sent again and the cookie is forgotten */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_fastopen_enable(pcb);
+  num = rec_tx_num;
+  err = tcp_connect(pcb, &test_remote_ip, TEST_REMOTE_PORT, NULL);
+  EXPECT_RET(err == ERR_OK);
+  syn_seqno = pcb->lastack;
+  err = tcp_write(pcb, tx_data, 100, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_output(pcb);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(rec_tx_num == num + 1);
+  EXPECT(rec_tx_datalen == 100);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 1, TCP_SYN | TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->state == ESTABLISHED);
+  EXPECT_RET(rec_tx_num == num + 2);
+  EXPECT((TCPH_FLAGS(&rec_tx_hdr) & (TCP_SYN | TCP_ACK)) == TCP_ACK);
+  EXPECT(lwip_ntohl(rec_tx_hdr.seqno) == syn_seqno + 1);
+  EXPECT(rec_tx_datalen == 100);
+  EXPECT(pcb->unacked != NULL);
+  EXPECT(tcp_fastopen_cookie_get(&test_remote_ip, tx_cookie, &mss) == 0);
+  tcp_abort(pcb);
+}
+END_TEST
+
+/** Check the server side of TCP Fast Open: cookie generation and early
+ * accept of a connection with data in the SYN */
+START_TEST(test_tcp_fastopen_server)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb, *lpcb;
+  struct pbuf *p;
+  u8_t cookie[TCP_FASTOPEN_COOKIE_LEN];
+  u8_t opts[12];
+  const u32_t seqno = 1000;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_record_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  rec_tx_num = 0;
+  fastopen_accept_calls = 0;
+  fastopen_accepted = NULL;
+
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  err = tcp_bind(pcb, &test_local_ip, TEST_LOCAL_PORT);
+  EXPECT_RET(err == ERR_OK);
+  tcp_fastopen_enable(pcb);
+  lpcb = tcp_listen_with_backlog(pcb, 2);
+  EXPECT_RET(lpcb != NULL);
+  tcp_arg(lpcb, &counters);
+  tcp_accept(lpcb, test_tcp_fastopen_accept);
+
+  /* a cookie request is answered with the cookie for the client's address */
+  opts[0] = opts[1] = LWIP_TCP_OPT_NOP;
+  opts[2] = LWIP_TCP_OPT_FASTOPEN;
+  opts[3] = 2;
+  p = tcp_create_segment_opts(&test_remote_ip, &test_local_ip, TEST_REMOTE_PORT, TEST_LOCAL_PORT,
+    NULL, 0, seqno, 0, TCP_SYN, opts, 4);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(rec_tx_num == 1);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == (TCP_SYN | TCP_ACK));
+  EXPECT_RET(test_tcp_fastopen_tx_cookie(cookie) == TCP_FASTOPEN_COOKIE_LEN);
+  EXPECT(tcp_fastopen_cookie_valid(&test_remote_ip, cookie, TCP_FASTOPEN_COOKIE_LEN));
+  EXPECT(fastopen_accept_calls == 0);
+
+  /* a SYN with that cookie and data (from another port): the connection is
+     accepted and the data is passed to the application right away */
+  opts[3] = 2 + TCP_FASTOPEN_COOKIE_LEN;
+  memcpy(&opts[4], cookie, TCP_FASTOPEN_COOKIE_LEN);
+  p = tcp_create_segment_opts(&test_remote_ip, &test_local_ip, TEST_REMOTE_PORT + 1, TEST_LOCAL_PORT,
+    tx_data, 100, seqno, 0, TCP_SYN, opts, sizeof(opts));
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(fastopen_accept_calls == 1);
+  EXPECT_RET(fastopen_accepted != NULL);
+  EXPECT(fastopen_accepted->state == SYN_RCVD);
+  EXPECT(counters.recved_bytes == 100);
+  EXPECT_RET(rec_tx_num == 2);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == (TCP_SYN | TCP_ACK));
+  EXPECT(lwip_ntohl(rec_tx_hdr.ackno) == seqno + 1 + 100);
+  EXPECT(test_tcp_fastopen_tx_cookie(cookie) < 0);
+
+#if TCP_LISTEN_BACKLOG
+  /* until its handshake completes, the connection counts against the listen
+     backlog (2, the other one is the cookie request): another SYN with a
+     valid cookie is dropped */
+  EXPECT(((struct tcp_pcb_listen *)lpcb)->accepts_pending == 2);
+  p = tcp_create_segment_opts(&test_remote_ip, &test_local_ip, TEST_REMOTE_PORT + 2, TEST_LOCAL_PORT,
+    tx_data, 100, seqno, 0, TCP_SYN, opts, sizeof(opts));
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(fastopen_accept_calls == 1);
+  EXPECT(rec_tx_num == 2);
+#endif /* TCP_LISTEN_BACKLOG */
+
+  /* the handshake completes without a second accept */
+  p = tcp_create_segment(&test_remote_ip, &test_local_ip, TEST_REMOTE_PORT + 1, TEST_LOCAL_PORT,
+    NULL, 0, seqno + 1 + 100, lwip_ntohl(rec_tx_hdr.seqno) + 1, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(fastopen_accepted->state == ESTABLISHED);
+  EXPECT(fastopen_accept_calls == 1);
+  EXPECT(counters.recved_bytes == 100);
+#if TCP_LISTEN_BACKLOG
+  EXPECT(((struct tcp_pcb_listen *)lpcb)->accepts_pending == 1);
+#endif /* TCP_LISTEN_BACKLOG */
+
+  tcp_abort(fastopen_accepted);
+  tcp_close(lpcb);
+}
+END_TEST
+#endif /* LWIP_TCP_FASTOPEN */
+
+#if LWIP_TCP_SYNCOOKIES
+static struct tcp_pcb *syncookie_accepted;
+static u8_t syncookie_accept_calls;
+
+static err_t
+test_tcp_syncookie_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
+{
+  EXPECT_RETX(err == ERR_OK, ERR_VAL);
+  syncookie_accepted = newpcb;
+  syncookie_accept_calls++;
+  tcp_arg(newpcb, arg);
+  tcp_recv(newpcb, test_tcp_counters_recv);
+  tcp_err(newpcb, test_tcp_counters_err);
+  return ERR_OK;
+}
+
+/** Send a segment from the remote host (port) to the listening port */
+static void
+test_tcp_syncookie_input(struct netif *netif, u16_t port, u32_t seqno, u32_t ackno, u8_t flags,
+                         const u8_t *data, u16_t len, u8_t *opts, u8_t optlen)
+{
+  struct pbuf *p = tcp_create_segment_opts(&test_remote_ip, &test_local_ip,
+    port, TEST_LOCAL_PORT, data, len, seqno, ackno, flags, opts, optlen);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, netif);
+}
+
+/** Check SYN cookies: once TCP_SYNCOOKIE_SYN_THRESHOLD connections are
+ * half-open, SYNs are answered without creating a pcb and the pcb is only
+ * created by the ACK returning a valid cookie */
+START_TEST(test_tcp_syncookie)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb, *lpcb;
+  /* MSS, window scale, SACK permitted */
+  u8_t opts[12] = {2, 4, 0x05, 0x78, 1, 3, 3, 7, 1, 1, 4, 2};
+  const u32_t seqno = 1000;
+  u16_t i, pcbs_used, syn_rcvd;
+  u32_t cookie;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_record_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  rec_tx_num = 0;
+  syncookie_accept_calls = 0;
+  syncookie_accepted = NULL;
+
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  err = tcp_bind(pcb, &test_local_ip, TEST_LOCAL_PORT);
+  EXPECT_RET(err == ERR_OK);
+  lpcb = tcp_listen(pcb);
+  EXPECT_RET(lpcb != NULL);
+  tcp_arg(lpcb, &counters);
+  tcp_accept(lpcb, test_tcp_syncookie_accept);
+
+  /* below the threshold, SYNs create half-open connections */
+  syn_rcvd = tcp_syn_rcvd_pending;
+  for (i = 0; i < TCP_SYNCOOKIE_SYN_THRESHOLD; i++) {
+    test_tcp_syncookie_input(&netif, (u16_t)(TEST_REMOTE_PORT + i), seqno, 0, TCP_SYN, NULL, 0, NULL, 0);
+  }
+  EXPECT_RET(tcp_syn_rcvd_pending == syn_rcvd + TCP_SYNCOOKIE_SYN_THRESHOLD);
+  EXPECT_RET(rec_tx_num == TCP_SYNCOOKIE_SYN_THRESHOLD);
+
+  /* above, the SYN is answered with a cookie and no pcb is allocated */
+  pcbs_used = tcp_pcbs_used;
+  test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 100, seqno, 0, TCP_SYN, NULL, 0, opts, sizeof(opts));
+  EXPECT(tcp_pcbs_used == pcbs_used);
+  EXPECT(tcp_syn_rcvd_pending == syn_rcvd + TCP_SYNCOOKIE_SYN_THRESHOLD);
+  EXPECT_RET(rec_tx_num == TCP_SYNCOOKIE_SYN_THRESHOLD + 1);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == (TCP_SYN | TCP_ACK));
+  EXPECT(lwip_ntohl(rec_tx_hdr.ackno) == seqno + 1);
+  EXPECT(test_tcp_rec_tx_opt(LWIP_TCP_OPT_MSS) != NULL);
+#if !LWIP_TCP_TIMESTAMPS
+  /* without timestamps, these cannot be stored in the cookie */
+  EXPECT(test_tcp_rec_tx_opt(LWIP_TCP_OPT_WS) == NULL);
+  EXPECT(test_tcp_rec_tx_opt(LWIP_TCP_OPT_SACK_PERM) == NULL);
+#endif /* !LWIP_TCP_TIMESTAMPS */
+  cookie = lwip_ntohl(rec_tx_hdr.seqno);
+
+  /* an ACK with a wrong cookie is answered with a RST */
+  test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 100, seqno + 1, cookie + 2, TCP_ACK, NULL, 0, NULL, 0);
+  EXPECT_RET(rec_tx_num == TCP_SYNCOOKIE_SYN_THRESHOLD + 2);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) & TCP_RST);
+  EXPECT(syncookie_accept_calls == 0);
+  EXPECT(tcp_pcbs_used == pcbs_used);
+
+  /* the ACK with the cookie creates and establishes the connection, data
+     in it is passed to the application */
+  test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 100, seqno + 1, cookie + 1, TCP_ACK, tx_data, 10, NULL, 0);
+  EXPECT_RET(syncookie_accept_calls == 1);
+  EXPECT_RET(syncookie_accepted != NULL);
+  EXPECT(syncookie_accepted->state == ESTABLISHED);
+  EXPECT(syncookie_accepted->remote_port == TEST_REMOTE_PORT + 100);
+  EXPECT(syncookie_accepted->mss == LWIP_MIN(536, TCP_MSS));
+  EXPECT(syncookie_accepted->snd_nxt == cookie + 1);
+  EXPECT(syncookie_accepted->rcv_nxt == seqno + 1 + 10);
+  EXPECT(counters.recved_bytes == 10);
+  EXPECT(tcp_pcbs_used == pcbs_used + 1);
+  EXPECT(tcp_syn_rcvd_pending == syn_rcvd + TCP_SYNCOOKIE_SYN_THRESHOLD);
+  tcp_abort(syncookie_accepted);
+
+#if LWIP_TCP_TIMESTAMPS
+  {
+    /* with timestamps, window scale and SACK permitted are restored, too */
+    u8_t ts_opts[24] = {2, 4, 0x05, 0x78, 1, 3, 3, 7, 1, 1, 4, 2, 1, 1, 8, 10, 0, 0, 0, 1, 0, 0, 0, 0};
+    const u8_t *ts;
+    test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 102, seqno, 0, TCP_SYN, NULL, 0, ts_opts, sizeof(ts_opts));
+    EXPECT(TCPH_FLAGS(&rec_tx_hdr) == (TCP_SYN | TCP_ACK));
+#if LWIP_WND_SCALE
+    EXPECT(test_tcp_rec_tx_opt(LWIP_TCP_OPT_WS) != NULL);
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+    EXPECT(test_tcp_rec_tx_opt(LWIP_TCP_OPT_SACK_PERM) != NULL);
+#endif /* LWIP_TCP_SACK_OUT */
+    ts = test_tcp_rec_tx_opt(LWIP_TCP_OPT_TS);
+    EXPECT_RET(ts != NULL);
+    cookie = lwip_ntohl(rec_tx_hdr.seqno);
+    /* ACK: echo the timestamp value */
+    ts_opts[0] = ts_opts[1] = LWIP_TCP_OPT_NOP;
+    ts_opts[2] = LWIP_TCP_OPT_TS;
+    ts_opts[3] = LWIP_TCP_OPT_LEN_TS;
+    memset(&ts_opts[4], 0, 4);
+    ts_opts[7] = 2;
+    memcpy(&ts_opts[8], &ts[2], 4);
+    test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 102, seqno + 1, cookie + 1, TCP_ACK, NULL, 0, ts_opts, 12);
+    EXPECT_RET(syncookie_accept_calls == 2);
+    EXPECT(syncookie_accepted->state == ESTABLISHED);
+    EXPECT(syncookie_accepted->flags & TF_TIMESTAMP);
+#if LWIP_WND_SCALE
+    EXPECT(syncookie_accepted->flags & TF_WND_SCALE);
+    EXPECT(syncookie_accepted->snd_scale == 7);
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+    EXPECT(syncookie_accepted->flags & TF_SACK);
+#endif /* LWIP_TCP_SACK_OUT */
+    tcp_abort(syncookie_accepted);
+    syncookie_accept_calls = 1;
+  }
+#endif /* LWIP_TCP_TIMESTAMPS */
+
+  /* cookies stay valid across the wrap of sys_now() */
+  {
+    u32_t now = lwip_sys_now;
+    lwip_sys_now = 0xFFFFFFFFUL - 1000;
+    test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 103, seqno, 0, TCP_SYN, NULL, 0, NULL, 0);
+    EXPECT(TCPH_FLAGS(&rec_tx_hdr) == (TCP_SYN | TCP_ACK));
+    cookie = lwip_ntohl(rec_tx_hdr.seqno);
+    lwip_sys_now += 2000;
+    test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 103, seqno + 1, cookie + 1, TCP_ACK, NULL, 0, NULL, 0);
+    EXPECT_RET(syncookie_accept_calls == 2);
+    EXPECT(syncookie_accepted->remote_port == TEST_REMOTE_PORT + 103);
+    tcp_abort(syncookie_accepted);
+    syncookie_accept_calls = 1;
+    lwip_sys_now = now;
+  }
+
+  /* cookies expire */
+  test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 101, seqno, 0, TCP_SYN, NULL, 0, NULL, 0);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == (TCP_SYN | TCP_ACK));
+  cookie = lwip_ntohl(rec_tx_hdr.seqno);
+  lwip_sys_now += 3 * 65536;
+  test_tcp_syncookie_input(&netif, TEST_REMOTE_PORT + 101, seqno + 1, cookie + 1, TCP_ACK, NULL, 0, NULL, 0);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) & TCP_RST);
+  EXPECT(syncookie_accept_calls == 1);
+
+  tcp_close(lpcb);
+}
+END_TEST
+#endif /* LWIP_TCP_SYNCOOKIES */
+
+#if LWIP_TCP_SYN_REQ
+static struct tcp_pcb *syn_req_accepted;
+static u8_t syn_req_accept_calls;
+
+static err_t
+test_tcp_syn_req_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
+{
+  EXPECT_RETX(err == ERR_OK, ERR_VAL);
+  syn_req_accepted = newpcb;
+  syn_req_accept_calls++;
+  tcp_arg(newpcb, arg);
+  tcp_recv(newpcb, test_tcp_counters_recv);
+  tcp_err(newpcb, test_tcp_counters_err);
+  return ERR_OK;
+}
+
+/** Send a segment from the remote host (port) to the listening port */
+static void
+test_tcp_syn_req_input(struct netif *netif, u16_t port, u32_t seqno, u32_t ackno, u8_t flags,
+                       const u8_t *data, u16_t len, u8_t *opts, u8_t optlen)
+{
+  struct pbuf *p = tcp_create_segment_opts(&test_remote_ip, &test_local_ip,
+    port, TEST_LOCAL_PORT, data, len, seqno, ackno, flags, opts, optlen);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, netif);
+}
+
+/** Check request entries: a SYN to a listener allocates no pcb, the SYN-ACK
+ * is (re)transmitted from the entry and the final ACK promotes it to a pcb */
+START_TEST(test_tcp_syn_req)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb, *lpcb;
+  struct tcp_syn_req *req;
+  /* MSS, window scale, SACK permitted */
+  u8_t opts[12] = {2, 4, 0x05, 0x78, 1, 3, 3, 7, 1, 1, 4, 2};
+  const u32_t seqno = 1000;
+  u32_t iss;
+  u16_t num;
+  int i;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_record_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  rec_tx_num = 0;
+  syn_req_accept_calls = 0;
+  syn_req_accepted = NULL;
+
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  err = tcp_bind(pcb, &test_local_ip, TEST_LOCAL_PORT);
+  EXPECT_RET(err == ERR_OK);
+  lpcb = tcp_listen(pcb);
+  EXPECT_RET(lpcb != NULL);
+  tcp_arg(lpcb, &counters);
+  tcp_accept(lpcb, test_tcp_syn_req_accept);
+
+  /* the SYN creates a request entry, no pcb */
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT, seqno, 0, TCP_SYN, NULL, 0, opts, sizeof(opts));
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 1);
+  EXPECT(tcp_active_pcbs == NULL);
+  req = tcp_syn_req_find((struct tcp_pcb_listen *)lpcb, &test_local_ip, &test_remote_ip, TEST_REMOTE_PORT);
+  EXPECT_RET(req != NULL);
+  EXPECT_RET(rec_tx_num == 1);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == (TCP_SYN | TCP_ACK));
+  EXPECT(lwip_ntohl(rec_tx_hdr.ackno) == seqno + 1);
+  EXPECT(test_tcp_rec_tx_opt(LWIP_TCP_OPT_MSS) != NULL);
+#if LWIP_WND_SCALE
+  EXPECT(test_tcp_rec_tx_opt(LWIP_TCP_OPT_WS) != NULL);
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+  EXPECT(test_tcp_rec_tx_opt(LWIP_TCP_OPT_SACK_PERM) != NULL);
+#endif /* LWIP_TCP_SACK_OUT */
+  iss = lwip_ntohl(rec_tx_hdr.seqno);
+  EXPECT(req->iss == iss);
+
+  /* a retransmitted SYN gets the same SYN-ACK */
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT, seqno, 0, TCP_SYN, NULL, 0, opts, sizeof(opts));
+  EXPECT_RET(rec_tx_num == 2);
+  EXPECT(lwip_ntohl(rec_tx_hdr.seqno) == iss);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 1);
+
+  /* the SYN-ACK is retransmitted after the initial RTO (3 seconds) */
+  for (i = 0; i < 2000 / TCP_TMR_INTERVAL; i++) {
+    test_tcp_tmr();
+  }
+  EXPECT(rec_tx_num == 2);
+  for (i = 0; i < 1000 / TCP_TMR_INTERVAL; i++) {
+    test_tcp_tmr();
+  }
+  EXPECT_RET(rec_tx_num == 3);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == (TCP_SYN | TCP_ACK));
+  EXPECT(lwip_ntohl(rec_tx_hdr.seqno) == iss);
+
+  /* an ACK for something else is answered with a RST */
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT, seqno + 1, iss + 2, TCP_ACK, NULL, 0, NULL, 0);
+  EXPECT_RET(rec_tx_num == 4);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) & TCP_RST);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 1);
+
+  /* the final ACK promotes the entry to an established pcb, data in it is
+     passed to the application */
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT, seqno + 1, iss + 1, TCP_ACK, tx_data, 10, NULL, 0);
+  EXPECT_RET(syn_req_accept_calls == 1);
+  EXPECT_RET(syn_req_accepted != NULL);
+  EXPECT(syn_req_accepted->state == ESTABLISHED);
+  EXPECT(syn_req_accepted->remote_port == TEST_REMOTE_PORT);
+  EXPECT(syn_req_accepted->mss == LWIP_MIN(1400, TCP_MSS));
+  EXPECT(syn_req_accepted->snd_nxt == iss + 1);
+  EXPECT(syn_req_accepted->rcv_nxt == seqno + 1 + 10);
+#if LWIP_WND_SCALE
+  EXPECT(syn_req_accepted->flags & TF_WND_SCALE);
+  EXPECT(syn_req_accepted->snd_scale == 7);
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+  EXPECT(syn_req_accepted->flags & TF_SACK);
+#endif /* LWIP_TCP_SACK_OUT */
+  EXPECT(counters.recved_bytes == 10);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 1);
+  tcp_abort(syn_req_accepted);
+
+  /* a RST with the right sequence number removes the entry */
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT + 1, seqno, 0, TCP_SYN, NULL, 0, NULL, 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 1);
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT + 1, seqno + 2, 0, TCP_RST, NULL, 0, NULL, 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 1);
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT + 1, seqno + 1, 0, TCP_RST, NULL, 0, NULL, 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 0);
+
+  /* an entry whose handshake does not complete times out */
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT + 2, seqno, 0, TCP_SYN, NULL, 0, NULL, 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 1);
+  num = rec_tx_num;
+  for (i = 0; i < (TCP_SYN_RCVD_TIMEOUT + 2 * TCP_SLOW_INTERVAL) / TCP_TMR_INTERVAL; i++) {
+    test_tcp_tmr();
+  }
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 0);
+  EXPECT(rec_tx_num > num);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+
+  /* closing the listener frees its entries */
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT + 3, seqno, 0, TCP_SYN, NULL, 0, NULL, 0);
+  test_tcp_syn_req_input(&netif, TEST_REMOTE_PORT + 4, seqno, 0, TCP_SYN, NULL, 0, NULL, 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 2);
+  tcp_close(lpcb);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SYN_REQ) == 0);
+}
+END_TEST
+#endif /* LWIP_TCP_SYN_REQ */
+
+#if LWIP_TCP_TW_COMPACT
+/** Check that a connection in TIME_WAIT is kept as a compact record once the
+ * application has closed it: the pcb is freed, retransmitted FINs are still
+ * acknowledged and the record expires after 2*TCP_MSL */
+START_TEST(test_tcp_tw_compact)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  u32_t snd_nxt, rcv_nxt;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_record_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  rec_tx_num = 0;
+
+  /* active close: FIN_WAIT_1 */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  EXPECT_RET(tcp_close(pcb) == ERR_OK);
+  EXPECT_RET(pcb->state == FIN_WAIT_1);
+  EXPECT_RET(rec_tx_num == 1);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) & TCP_FIN);
+  snd_nxt = pcb->snd_nxt;
+  rcv_nxt = pcb->rcv_nxt;
+
+  /* our FIN is acknowledged and the remote host closes, too: the FIN is
+     acknowledged and only a compact record is left */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 1, TCP_ACK | TCP_FIN);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(rec_tx_num == 2);
+  EXPECT(lwip_ntohl(rec_tx_hdr.ackno) == rcv_nxt + 1);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB_TW) == 1);
+  EXPECT(tcp_active_pcbs == NULL);
+  EXPECT(tcp_tw_pcbs == NULL);
+  EXPECT_RET(tcp_tw_records != NULL);
+  EXPECT(tcp_tw_records->remote_port == TEST_REMOTE_PORT);
+  EXPECT(tcp_tw_records->next == NULL);
+
+  /* a retransmitted FIN is acknowledged from the record */
+  p = tcp_create_segment(&test_remote_ip, &test_local_ip,
+                         TEST_REMOTE_PORT, TEST_LOCAL_PORT, NULL, 0, rcv_nxt, snd_nxt, TCP_ACK | TCP_FIN);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(rec_tx_num == 3);
+  EXPECT(TCPH_FLAGS(&rec_tx_hdr) == TCP_ACK);
+  EXPECT(lwip_ntohl(rec_tx_hdr.seqno) == snd_nxt);
+  EXPECT(lwip_ntohl(rec_tx_hdr.ackno) == rcv_nxt + 1);
+
+  /* the record expires after 2*TCP_MSL */
+  for (i = 0; i < (int)((2 * TCP_MSL - TCP_SLOW_INTERVAL) / TCP_TMR_INTERVAL); i++) {
+    test_tcp_tmr();
+  }
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB_TW) == 1);
+  for (i = 0; i < 4 * TCP_SLOW_INTERVAL / TCP_TMR_INTERVAL; i++) {
+    test_tcp_tmr();
+  }
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB_TW) == 0);
+  EXPECT(tcp_tw_records == NULL);
+
+  /* a pcb still owned by the application (tx side shut down only) stays a
+     pcb in TIME_WAIT until it is closed */
+  memset(&counters, 0, sizeof(counters));
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  EXPECT_RET(tcp_shutdown(pcb, 0, 1) == ERR_OK);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 1, TCP_ACK | TCP_FIN);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(counters.close_calls == 1);
+  EXPECT_RET(pcb->state == TIME_WAIT);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 1);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB_TW) == 0);
+  EXPECT_RET(tcp_close(pcb) == ERR_OK);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB_TW) == 1);
+
+  /* records are kept in expiry order: a retransmitted FIN restarts the
+     TIME_WAIT timeout and moves the record to the tail */
+  memset(&counters, 0, sizeof(counters));
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT + 1);
+  EXPECT_RET(tcp_close(pcb) == ERR_OK);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 1, TCP_ACK | TCP_FIN);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB_TW) == 2);
+  EXPECT_RET((tcp_tw_records != NULL) && (tcp_tw_records->next != NULL));
+  EXPECT(tcp_tw_records->remote_port == TEST_REMOTE_PORT);
+  EXPECT(tcp_tw_records->next->remote_port == TEST_REMOTE_PORT + 1);
+  p = tcp_create_segment(&test_remote_ip, &test_local_ip, TEST_REMOTE_PORT, TEST_LOCAL_PORT,
+                         NULL, 0, tcp_tw_records->rcv_nxt - 1, tcp_tw_records->snd_nxt, TCP_ACK | TCP_FIN);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET((tcp_tw_records != NULL) && (tcp_tw_records->next != NULL));
+  EXPECT(tcp_tw_records->remote_port == TEST_REMOTE_PORT + 1);
+  EXPECT(tcp_tw_records->next->remote_port == TEST_REMOTE_PORT);
+  EXPECT((s32_t)(tcp_tw_records->next->expires - tcp_tw_records->expires) >= 0);
+
+  /* the port stays in use while the record exists */
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  EXPECT(tcp_bind(pcb, &test_local_ip, TEST_LOCAL_PORT) == ERR_USE);
+  tcp_abort(pcb);
+
+  tcp_tw_free_all();
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB_TW) == 0);
+  EXPECT(tcp_tw_records == NULL);
+}
+END_TEST
+#endif /* LWIP_TCP_TW_COMPACT */
+
+#if LWIP_TCP_RCV_AUTOTUNE
+#define RCV_AUTOTUNE_TEST_RTT 100
+
+/** Simulate 'rounds' round-trip times of a bulk transfer: the peer sends all
+ * the window we announced and the application consumes everything at once. */
+static void
+test_tcp_rcv_autotune_rounds(struct tcp_pcb *pcb, struct netif *netif, int rounds)
+{
+  static u8_t data[TCP_MSS];
+  while (rounds-- > 0) {
+    u32_t wnd;
+    lwip_sys_now += RCV_AUTOTUNE_TEST_RTT;
+    tcp_ack_now(pcb);
+    tcp_output(pcb);
+    wnd = pcb->rcv_ann_right_edge - pcb->rcv_nxt;
+    while (wnd > 0) {
+      u16_t len = (u16_t)LWIP_MIN(wnd, TCP_MSS);
+      struct pbuf *p = tcp_create_rx_segment(pcb, data, len, 0, 0, TCP_ACK);
+      EXPECT_RET(p != NULL);
+      test_tcp_input(p, netif);
+      tcp_recved(pcb, len);
+      wnd -= len;
+    }
+  }
+}
+
+/** Check that the receive window grows for a bulk transfer up to the limit
+ * of the pcb and the global budget, that lowering the limit doesn't take back
+ * announced window and that memory pressure resets the window. */
+START_TEST(test_tcp_rcv_autotune)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb, *pcb2;
+  u32_t right_edge;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(&counters, 0, sizeof(counters));
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  EXPECT(pcb->rcv_buf == TCP_WND);
+  EXPECT(tcp_get_rcvbuf(pcb) == TCP_RCV_AUTOTUNE_MAX);
+
+  /* an idle connection keeps the default window */
+  lwip_sys_now += 10 * RCV_AUTOTUNE_TEST_RTT;
+  tcp_recved(pcb, 0);
+  EXPECT(pcb->rcv_buf == TCP_WND);
+
+  /* the window doubles once per RTT up to the limit */
+  test_tcp_rcv_autotune_rounds(pcb, &netif, 3);
+  EXPECT(pcb->rcv_rtt == RCV_AUTOTUNE_TEST_RTT);
+  EXPECT(pcb->rcv_buf > TCP_WND);
+  EXPECT(pcb->rcv_wnd == pcb->rcv_buf);
+  test_tcp_rcv_autotune_rounds(pcb, &netif, 4);
+  EXPECT(pcb->rcv_buf == TCP_RCV_AUTOTUNE_MAX);
+  EXPECT(pcb->rcv_wnd == TCP_RCV_AUTOTUNE_MAX);
+
+  /* lowering the limit doesn't take back window already announced */
+  tcp_ack_now(pcb);
+  tcp_output(pcb);
+  right_edge = pcb->rcv_ann_right_edge;
+  EXPECT(right_edge == pcb->rcv_nxt + TCP_RCV_AUTOTUNE_MAX);
+  tcp_set_rcvbuf(pcb, 2 * TCP_WND);
+  EXPECT(tcp_get_rcvbuf(pcb) == 2 * TCP_WND);
+  EXPECT(TCP_SEQ_GEQ(pcb->rcv_nxt + pcb->rcv_wnd, right_edge));
+  test_tcp_rcv_autotune_rounds(pcb, &netif, 2);
+  EXPECT(pcb->rcv_buf == 2 * TCP_WND);
+
+  /* a second connection only gets what is left of the global budget */
+  tcp_set_rcvbuf(pcb, TCP_RCV_AUTOTUNE_MAX);
+  test_tcp_rcv_autotune_rounds(pcb, &netif, 4);
+  EXPECT(pcb->rcv_buf == TCP_RCV_AUTOTUNE_MAX);
+  pcb2 = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb2 != NULL);
+  tcp_set_state(pcb2, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT + 1);
+  test_tcp_rcv_autotune_rounds(pcb2, &netif, 8);
+  EXPECT(pcb2->rcv_buf == TCP_WND + TCP_RCV_AUTOTUNE_MEM - (TCP_RCV_AUTOTUNE_MAX - TCP_WND));
+
+  /* running out of pbufs takes the extra window back */
+  tcp_rcv_autotune_reclaim();
+  test_tcp_rcv_autotune_rounds(pcb, &netif, 2);
+  EXPECT(pcb->rcv_buf == TCP_WND);
+  /* ... and it grows again afterwards */
+  lwip_sys_now += 1000;
+  test_tcp_rcv_autotune_rounds(pcb, &netif, 4);
+  EXPECT(pcb->rcv_buf > TCP_WND);
+
+  tcp_abort(pcb2);
+  tcp_abort(pcb);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+}
+END_TEST
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+
+#if LWIP_TCP_SNDBUF_PCB
+/** Check per-pcb send buffer sizes: a small buffer limits tcp_write(), the
+ * buffer grows towards 2 * cwnd within the global limit and shrinking keeps
+ * queued data until it is acknowledged. */
+START_TEST(test_tcp_sndbuf)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb, *pcb2;
+  struct pbuf *p;
+  static u8_t data[TCP_MSS];
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(&counters, 0, sizeof(counters));
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  EXPECT(tcp_sndbuf(pcb) == TCP_SND_BUF);
+  EXPECT(TCP_SND_QUEUELEN_MAX(pcb) == TCP_SND_QUEUELEN);
+  pcb->cwnd = TCP_MSS;
+
+  /* a small buffer only takes what fits */
+  tcp_set_sndbuf(pcb, TCP_MSS);
+  EXPECT(tcp_get_sndbuf(pcb) == TCP_MSS);
+  EXPECT(tcp_sndbuf(pcb) == TCP_MSS);
+  EXPECT(TCP_SND_QUEUELEN_MAX(pcb) < TCP_SND_QUEUELEN);
+  EXPECT(TCP_SNDLOWAT_PCB(pcb) < TCP_MSS);
+  err = tcp_write(pcb, data, TCP_MSS / 2, TCP_WRITE_FLAG_COPY);
+  EXPECT(err == ERR_OK);
+  err = tcp_write(pcb, data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT(err == ERR_MEM);
+  EXPECT(tcp_output(pcb) == ERR_OK);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS / 2, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(tcp_sndbuf(pcb) == TCP_MSS);
+
+#if LWIP_TCP_SND_AUTOTUNE
+  /* with auto-tuning, the buffer follows cwnd up to the limit */
+  tcp_set_sndbuf(pcb, TCP_SND_AUTOTUNE_MAX);
+  EXPECT(pcb->snd_buf_size == LWIP_MAX(TCP_MSS, 2 * (u32_t)pcb->cwnd));
+  pcb->cwnd = TCP_SND_BUF;
+  err = tcp_write(pcb, data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT(err == ERR_OK);
+  EXPECT(tcp_output(pcb) == ERR_OK);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->snd_buf_size >= 2 * TCP_SND_BUF);
+  EXPECT(tcp_sndbuf(pcb) == pcb->snd_buf_size);
+  pcb->cwnd = TCP_SND_AUTOTUNE_MAX;
+  err = tcp_write(pcb, data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT(err == ERR_OK);
+  EXPECT(tcp_output(pcb) == ERR_OK);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+#else /* LWIP_TCP_SND_AUTOTUNE */
+  tcp_set_sndbuf(pcb, TCP_SND_AUTOTUNE_MAX);
+#endif /* LWIP_TCP_SND_AUTOTUNE */
+  EXPECT(pcb->snd_buf_size == TCP_SND_AUTOTUNE_MAX);
+  EXPECT(TCP_SND_QUEUELEN_MAX(pcb) > TCP_SND_QUEUELEN);
+
+  /* a second pcb only gets what is left of TCP_SND_BUF_MEM */
+  pcb2 = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb2 != NULL);
+  tcp_set_state(pcb2, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT + 1);
+  pcb2->cwnd = TCP_SND_AUTOTUNE_MAX;
+  tcp_set_sndbuf(pcb2, TCP_SND_AUTOTUNE_MAX);
+  EXPECT(pcb2->snd_buf_size == TCP_SND_BUF + TCP_SND_BUF_MEM - (TCP_SND_AUTOTUNE_MAX - TCP_SND_BUF));
+
+  /* shrinking keeps the queued data, the rest is done when it is acked */
+  pcb->cwnd = TCP_SND_BUF;
+  err = tcp_write(pcb, data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT(err == ERR_OK);
+  err = tcp_write(pcb, data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT(err == ERR_OK);
+  tcp_set_sndbuf(pcb, TCP_MSS);
+  EXPECT(tcp_sndbuf(pcb) == 0);
+  EXPECT(pcb->snd_buf_size == 2 * TCP_MSS);
+  EXPECT(tcp_output(pcb) == ERR_OK);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 2 * TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->snd_buf_size == TCP_MSS);
+  EXPECT(tcp_sndbuf(pcb) == TCP_MSS);
+
+  /* the space given back is available to the other pcb */
+  tcp_set_sndbuf(pcb2, TCP_SND_AUTOTUNE_MAX);
+  EXPECT(pcb2->snd_buf_size == TCP_SND_AUTOTUNE_MAX);
+
+  tcp_abort(pcb2);
+  tcp_abort(pcb);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+}
+END_TEST
+#endif /* LWIP_TCP_SNDBUF_PCB */
+
+#if LWIP_TCP_INFO
+/** Check the connection snapshot and the counters of tcp_get_info() */
+START_TEST(test_tcp_info)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb, *lpcb;
+  struct tcp_info info;
+  struct pbuf *p;
+  err_t err;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 4 * TCP_MSS; i++) {
+    tx_data[i] = (u8_t)i;
+  }
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(&counters, 0, sizeof(counters));
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 4 * TCP_MSS;
+
+  /* four segments in flight */
+  err = tcp_write(pcb, tx_data, 4 * TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(txcounters.num_tx_calls == 4);
+  EXPECT_RET(tcp_get_info(pcb, &info) == ERR_OK);
+  EXPECT(info.state == ESTABLISHED);
+  EXPECT(info.mss == TCP_MSS);
+  EXPECT(info.cwnd == 4 * TCP_MSS);
+  EXPECT(info.unacked == 4 * TCP_MSS);
+  EXPECT(info.unsent == 0);
+  EXPECT(info.snd_buf == TCP_SND_BUF - 4 * TCP_MSS);
+  EXPECT(info.rto == (u32_t)pcb->rto * TCP_SLOW_INTERVAL);
+  EXPECT(info.total_retrans == 0);
+  EXPECT(info.bytes_acked == 0);
+
+  /* first segment acked, then three duplicate ACKs: fast retransmit */
+  for (i = 0; i < 4; i++) {
+    p = tcp_create_rx_segment(pcb, NULL, 0, 0, (i == 0) ? TCP_MSS : 0, TCP_ACK);
+    EXPECT_RET(p != NULL);
+    test_tcp_input(p, &netif);
+  }
+  EXPECT_RET(tcp_get_info(pcb, &info) == ERR_OK);
+  EXPECT(info.bytes_acked == TCP_MSS);
+  EXPECT(info.dupacks == 3);
+  EXPECT(info.fast_retrans == 1);
+  EXPECT(info.total_retrans == 1);
+  EXPECT(info.retransmits == 1);
+  EXPECT(info.rto_events == 0);
+  EXPECT(info.unacked == 3 * TCP_MSS);
+
+  /* data received out of sequence */
+  p = tcp_create_rx_segment(pcb, tx_data, 10, 10, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(tcp_get_info(pcb, &info) == ERR_OK);
+  EXPECT(info.ooseq_segs == 1);
+  EXPECT(info.ooseq_bytes == 10);
+
+  /* retransmission timeout */
+  while (!(pcb->flags & TF_RTO)) {
+    test_tcp_tmr();
+  }
+  EXPECT_RET(tcp_get_info(pcb, &info) == ERR_OK);
+  EXPECT(info.rto_events == 1);
+  EXPECT(info.fast_retrans == 1);
+  EXPECT(info.total_retrans == 2);
+  EXPECT(info.cwnd == TCP_MSS);
+  tcp_abort(pcb);
+
+  /* a listening pcb only reports its state */
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  err = tcp_bind(pcb, &test_local_ip, TEST_LOCAL_PORT);
+  EXPECT_RET(err == ERR_OK);
+  lpcb = tcp_listen(pcb);
+  EXPECT_RET(lpcb != NULL);
+  memset(&info, 0xff, sizeof(info));
+  EXPECT_RET(tcp_get_info(lpcb, &info) == ERR_OK);
+  EXPECT(info.state == LISTEN);
+  EXPECT(info.cwnd == 0);
+  tcp_close(lpcb);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+}
+END_TEST
+#endif /* LWIP_TCP_INFO */
+
+#if LWIP_TCP_TS_RTTM
+/* Build a timestamp option (with two NOPs for alignment) */
+static void
+test_tcp_ts_opt(u8_t *opts, u32_t tsval, u32_t tsecr)
+{
+  opts[0] = LWIP_TCP_OPT_NOP;
+  opts[1] = LWIP_TCP_OPT_NOP;
+  opts[2] = LWIP_TCP_OPT_TS;
+  opts[3] = LWIP_TCP_OPT_LEN_TS;
+  opts[4] = (u8_t)(tsval >> 24);
+  opts[5] = (u8_t)(tsval >> 16);
+  opts[6] = (u8_t)(tsval >> 8);
+  opts[7] = (u8_t)tsval;
+  opts[8] = (u8_t)(tsecr >> 24);
+  opts[9] = (u8_t)(tsecr >> 16);
+  opts[10] = (u8_t)(tsecr >> 8);
+  opts[11] = (u8_t)tsecr;
+}
+
+/** Check that every ACK echoing a timestamp gives an RTT sample with
+ * millisecond resolution, also after a retransmission */
+START_TEST(test_tcp_ts_rttm)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  u8_t opts[12];
+  u32_t sent;
+  /* data per segment: the timestamp option takes 12 bytes */
+  u16_t seglen = TCP_MSS - (LWIP_TCP_OPT_LENGTH(TF_SEG_OPTS_TS));
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(&counters, 0, sizeof(counters));
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 4 * TCP_MSS;
+  tcp_set_flags(pcb, TF_TIMESTAMP);
+  tcp_nagle_disable(pcb);
+
+  /* two segments, the first is acked after 40 ms (a timestamp of 0 would
+     not be taken as echo) */
+  lwip_sys_now += 1000;
+  sent = sys_now();
+  err = tcp_write(pcb, tx_data, 2 * seglen, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(txcounters.num_tx_calls == 2);
+  lwip_sys_now += 40;
+  test_tcp_ts_opt(opts, 1, sent);
+  p = tcp_create_rx_segment_opts(pcb, NULL, 0, pcb->lastack + seglen, TCP_ACK, opts, sizeof(opts));
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  /* first sample: srtt = 40, rttvar = 20, rto = 40 + max(500, 80) ms */
+  EXPECT(pcb->ts_srtt == (40 << 3));
+  EXPECT(pcb->ts_rttvar == (20 << 2));
+  EXPECT(pcb->rto == 2);
+  EXPECT(pcb->rttest == 0);
+  /* the RTT is below one slow tick: sa is rounded up instead of reading as
+     "no estimate", the millisecond value is what CUBIC and pacing get */
+  EXPECT(pcb->sa == 1);
+  EXPECT(tcp_srtt_ms(pcb) == 40);
+
+  /* the second segment times out and is retransmitted */
+  while (!(pcb->flags & TF_RTO)) {
+    test_tcp_tmr();
+  }
+  EXPECT_RET(txcounters.num_tx_calls == 3);
+  /* the retransmission is acked 20 ms after it has been sent */
+  sent = sys_now();
+  lwip_sys_now += 20;
+  test_tcp_ts_opt(opts, 2, sent);
+  p = tcp_create_rx_segment_opts(pcb, NULL, 0, pcb->snd_nxt, TCP_ACK, opts, sizeof(opts));
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  /* srtt = 40 + (20 - 40) / 8, rttvar = 20 + (20 - 20) / 4 */
+  EXPECT(pcb->ts_srtt == (40 << 3) - 20);
+  EXPECT(pcb->ts_rttvar == (20 << 2));
+  EXPECT(pcb->rto == 2);
+  EXPECT(tcp_srtt_ms(pcb) == 37);
+
+  /* an ACK without timestamp doesn't change the estimate */
+  err = tcp_write(pcb, tx_data, seglen, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  lwip_sys_now += 1000;
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, seglen, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(pcb->ts_srtt == (40 << 3) - 20);
+  EXPECT(pcb->rto == 2);
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_TCP_TS_RTTM */
+
+#if LWIP_TCP_ECN
+/* the last segment sent (recorded by test_tcp_ecn_netif_output()) */
+static u8_t ecn_tx_tos;
+static u8_t ecn_tx_flags;
+static u16_t ecn_tx_num;
+
+/** netif output recording the IP ECN field and the TCP flags (with ECE and
+ * CWR) of each segment */
+static err_t
+test_tcp_ecn_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  struct tcp_hdr tcphdr;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  EXPECT_RETX(pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0) == sizeof(iphdr), ERR_OK);
+  EXPECT_RETX(pbuf_copy_partial(p, &tcphdr, sizeof(tcphdr), (u16_t)IPH_HL_BYTES(&iphdr)) == sizeof(tcphdr), ERR_OK);
+  ecn_tx_tos = (u8_t)(IPH_TOS(&iphdr) & IP_ECN_MASK);
+  ecn_tx_flags = (u8_t)(TCPH_FLAGS(&tcphdr) | TCPH_ECN_FLAGS(&tcphdr));
+  ecn_tx_num++;
+  return ERR_OK;
+}
+
+/** Check ECN negotiation, ECT marking of data, the echo of a CE mark and
+ * the reduction of the congestion window (once per window) on ECE */
+START_TEST(test_tcp_ecn)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_ecn_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  ecn_tx_num = 0;
+
+  /* the SYN asks for ECN, the <SYN,ACK> agrees */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  err = tcp_connect(pcb, &test_remote_ip, TEST_REMOTE_PORT, NULL);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(ecn_tx_num == 1);
+  EXPECT(ecn_tx_flags == (TCP_SYN | TCP_ECE | TCP_CWR));
+  EXPECT(ecn_tx_tos == IP_ECN_NOT_ECT);
+  EXPECT(pcb->ecn == TCP_ECN_SYN);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 1, TCP_SYN | TCP_ACK | TCP_ECE);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(pcb->state == ESTABLISHED);
+  EXPECT(pcb->ecn == TCP_ECN_ON);
+  EXPECT_RET(ecn_tx_num == 2);
+  EXPECT(ecn_tx_flags == TCP_ACK);
+  EXPECT(ecn_tx_tos == IP_ECN_NOT_ECT);
+
+  /* data is sent ECN-capable */
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 4 * TCP_MSS;
+  pcb->ssthresh = 0xffff;
+  tcp_nagle_disable(pcb);
+  err = tcp_write(pcb, tx_data, 2 * TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(ecn_tx_num == 4);
+  EXPECT(ecn_tx_tos == IP_ECN_ECT0);
+  EXPECT(!(ecn_tx_flags & (TCP_ECE | TCP_CWR)));
+
+  /* a CE mark is echoed at once and in every ACK until the peer sends CWR */
+  p = tcp_create_rx_segment(pcb, tx_data, 10, 0, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  IPH_TOS_SET((struct ip_hdr *)p->payload, IP_ECN_CE);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->ecn & TCP_ECN_ECE);
+  EXPECT_RET(ecn_tx_num == 5);
+  EXPECT(ecn_tx_flags == (TCP_ACK | TCP_ECE));
+  EXPECT(ecn_tx_tos == IP_ECN_NOT_ECT);
+  p = tcp_create_rx_segment(pcb, tx_data, 10, 0, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  test_tcp_tmr();
+  EXPECT_RET(ecn_tx_num == 6);
+  EXPECT(ecn_tx_flags == (TCP_ACK | TCP_ECE));
+  p = tcp_create_rx_segment(pcb, tx_data, 10, 0, 0, TCP_ACK | TCP_CWR);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(!(pcb->ecn & TCP_ECN_ECE));
+  test_tcp_tmr();
+  EXPECT_RET(ecn_tx_num == 7);
+  EXPECT(ecn_tx_flags == TCP_ACK);
+
+  /* ECE halves the window, but only once per window of data */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK | TCP_ECE);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->ssthresh == 2 * TCP_MSS);
+  EXPECT(pcb->cwnd == 2 * TCP_MSS);
+  EXPECT(pcb->ecn & TCP_ECN_CWR);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK | TCP_ECE);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(pcb->ssthresh == 2 * TCP_MSS);
+  EXPECT(pcb->cwnd == 2 * TCP_MSS);
+
+  /* the next new data carries CWR */
+  err = tcp_write(pcb, tx_data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(ecn_tx_num == 8);
+  EXPECT(ecn_tx_flags == (TCP_ACK | TCP_PSH | TCP_CWR));
+  EXPECT(ecn_tx_tos == IP_ECN_ECT0);
+  EXPECT(!(pcb->ecn & TCP_ECN_CWR));
+
+  /* retransmissions are not ECN-capable */
+  while (!(pcb->flags & TF_RTO)) {
+    test_tcp_tmr();
+  }
+  EXPECT_RET(ecn_tx_num == 9);
+  EXPECT(ecn_tx_tos == IP_ECN_NOT_ECT);
+  EXPECT(!(ecn_tx_flags & TCP_CWR));
+
+  tcp_abort(pcb);
+}
+END_TEST
+
+/** A retransmitted SYN doesn't ask for ECN again, a <SYN,ACK> without ECE
+ * turns it off */
+START_TEST(test_tcp_ecn_syn_fallback)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_ecn_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  ecn_tx_num = 0;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  err = tcp_connect(pcb, &test_remote_ip, TEST_REMOTE_PORT, NULL);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(ecn_tx_num == 1);
+  EXPECT(ecn_tx_flags == (TCP_SYN | TCP_ECE | TCP_CWR));
+  while (ecn_tx_num == 1) {
+    test_tcp_tmr();
+  }
+  EXPECT(ecn_tx_flags == TCP_SYN);
+  EXPECT(pcb->ecn == 0);
+
+  /* the peer answers the first SYN with ECE: ECN stays off */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 1, TCP_SYN | TCP_ACK | TCP_ECE);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(pcb->state == ESTABLISHED);
+  EXPECT(pcb->ecn == 0);
+  err = tcp_write(pcb, tx_data, 10, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT(ecn_tx_tos == IP_ECN_NOT_ECT);
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_TCP_ECN */
+
+#if IP_PMTUD
+/* the segments sent (recorded by test_tcp_pmtu_netif_output()) */
+static u16_t pmtu_tx_len[16];
+static u8_t pmtu_tx_df;
+static u16_t pmtu_tx_num;
+
+/** netif output recording the data length of each segment and whether
+ * all of them had DF set */
+static err_t
+test_tcp_pmtu_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  struct tcp_hdr tcphdr;
+  u16_t hlen;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  EXPECT_RETX(pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0) == sizeof(iphdr), ERR_OK);
+  hlen = (u16_t)IPH_HL_BYTES(&iphdr);
+  EXPECT_RETX(pbuf_copy_partial(p, &tcphdr, sizeof(tcphdr), hlen) == sizeof(tcphdr), ERR_OK);
+  if (!(IPH_OFFSET(&iphdr) & PP_HTONS(IP_DF))) {
+    pmtu_tx_df = 0;
+  }
+  EXPECT_RETX(pmtu_tx_num < LWIP_ARRAYSIZE(pmtu_tx_len), ERR_OK);
+  pmtu_tx_len[pmtu_tx_num++] = (u16_t)(p->tot_len - hlen - TCPH_HDRLEN_BYTES(&tcphdr));
+  return ERR_OK;
+}
+
+/** Pass an ICMP "fragmentation needed" message for a segment of 'pcb' to
+ * the stack, as sent by the remote host */
+static void
+test_tcp_pmtu_icmp(struct netif *netif, struct tcp_pcb *pcb, u32_t seqno, u16_t mtu, u16_t len)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr, *orig;
+  struct icmp_echo_hdr *icmphdr;
+  struct tcp_hdr *tcphdr;
+
+  /* IP header, ICMP header, IP header and 8 bytes of the segment */
+  p = pbuf_alloc(PBUF_RAW, 2 * IP_HLEN + 16, PBUF_RAM);
+  EXPECT_RET(p != NULL);
+  memset(p->payload, 0, p->len);
+  iphdr = (struct ip_hdr *)p->payload;
+  icmphdr = (struct icmp_echo_hdr *)((u8_t *)p->payload + IP_HLEN);
+  orig = (struct ip_hdr *)((u8_t *)icmphdr + 8);
+  tcphdr = (struct tcp_hdr *)((u8_t *)orig + IP_HLEN);
+
+  IPH_VHL_SET(orig, 4, IP_HLEN / 4);
+  IPH_LEN_SET(orig, lwip_htons(len));
+  IPH_OFFSET_SET(orig, PP_HTONS(IP_DF));
+  IPH_TTL_SET(orig, 255);
+  IPH_PROTO_SET(orig, IP_PROTO_TCP);
+  ip4_addr_copy(orig->src, *ip_2_ip4(&pcb->local_ip));
+  ip4_addr_copy(orig->dest, *ip_2_ip4(&pcb->remote_ip));
+  tcphdr->src = lwip_htons(pcb->local_port);
+  tcphdr->dest = lwip_htons(pcb->remote_port);
+  tcphdr->seqno = lwip_htonl(seqno);
+
+  ICMPH_TYPE_SET(icmphdr, ICMP_DUR);
+  ICMPH_CODE_SET(icmphdr, ICMP_DUR_FRAG);
+  icmphdr->seqno = lwip_htons(mtu);
+  icmphdr->chksum = inet_chksum(icmphdr, IP_HLEN + 16);
+
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_LEN_SET(iphdr, lwip_htons(p->tot_len));
+  IPH_TTL_SET(iphdr, 255);
+  IPH_PROTO_SET(iphdr, IP_PROTO_ICMP);
+  ip4_addr_copy(iphdr->src, *ip_2_ip4(&pcb->remote_ip));
+  ip4_addr_copy(iphdr->dest, *ip_2_ip4(&pcb->local_ip));
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  ip4_input(p, netif);
+}
+
+/** Check that TCP segments are sent with DF, that an ICMP "fragmentation
+ * needed" message lowers the MSS and gets the data resent in smaller
+ * segments, and that the larger MSS is used again after IP_PMTU_TIMEOUT */
+START_TEST(test_tcp_pmtud)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  const ip4_addr_t *remote_ip = ip_2_ip4(&test_remote_ip);
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  /* path MTU estimates */
+  EXPECT(ip4_pmtu_estimate(1400, 1500) == 1400);
+  EXPECT(ip4_pmtu_estimate(0, 1500) == 1492);
+  EXPECT(ip4_pmtu_estimate(1500, 1500) == 1492);
+  EXPECT(ip4_pmtu_estimate(68, 1500) == IP_PMTU_MIN);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_pmtu_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  pmtu_tx_num = 0;
+  pmtu_tx_df = 1;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->snd_mss_max = TCP_MSS;
+  pcb->cwnd = 4 * TCP_MSS;
+  tcp_nagle_disable(pcb);
+
+  err = tcp_write(pcb, tx_data, 2 * TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(pmtu_tx_num == 2);
+  EXPECT(pmtu_tx_len[1] == TCP_MSS);
+  EXPECT(pmtu_tx_df);
+
+  /* a message for a segment that is not in flight is ignored */
+  test_tcp_pmtu_icmp(&netif, pcb, pcb->snd_nxt, 552, TCP_MSS + 40);
+  EXPECT(pcb->mss == TCP_MSS);
+  EXPECT(ip4_pmtu_get(remote_ip) == 0);
+  EXPECT(pmtu_tx_num == 2);
+
+  /* the path MTU is 552: the segments are resent at once, split, without
+     reducing cwnd */
+  test_tcp_pmtu_icmp(&netif, pcb, pcb->lastack + TCP_MSS, 552, TCP_MSS + 40);
+  EXPECT(ip4_pmtu_get(remote_ip) == 552);
+  EXPECT(pcb->mss == 552 - 40);
+  EXPECT(pcb->cwnd == 4 * TCP_MSS);
+  EXPECT_RET(pmtu_tx_num == 6);
+  EXPECT(pmtu_tx_len[2] == 552 - 40);
+  EXPECT(pmtu_tx_len[3] == TCP_MSS - (552 - 40));
+  EXPECT(pmtu_tx_len[4] == 552 - 40);
+  EXPECT(pmtu_tx_len[5] == TCP_MSS - (552 - 40));
+  EXPECT(pmtu_tx_df);
+  EXPECT(pcb->snd_queuelen == 4);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 2 * TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(pcb->snd_queuelen == 0);
+  EXPECT(pcb->mss == 552 - 40);
+
+  /* when the estimate has expired, the next ACK brings the MSS back */
+  lwip_sys_now += IP_PMTU_TIMEOUT;
+  err = tcp_write(pcb, tx_data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(pmtu_tx_num == 8);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(pcb->mss == TCP_MSS);
+  EXPECT(ip4_pmtu_get(remote_ip) == 0);
+  err = tcp_write(pcb, tx_data, TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(pmtu_tx_num == 9);
+  EXPECT(pmtu_tx_len[8] == TCP_MSS);
+
+  tcp_abort(pcb);
+}
+END_TEST
+
+#if LWIP_TCP_PLPMTUD
+/** Check that a connection falls back to TCP_PMTU_BASE_MSS when its full
+ * sized segments time out repeatedly (path MTU black hole) */
+START_TEST(test_tcp_pmtu_blackhole)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  /* larger than TCP_PMTU_BASE_MSS (at most TCP_MSS) */
+  const u16_t mss = 2 * TCP_MSS;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_pmtu_netif_output;
+  memset(&counters, 0, sizeof(counters));
+  pmtu_tx_num = 0;
+  pmtu_tx_df = 1;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = mss;
+  pcb->snd_mss_max = mss;
+  pcb->cwnd = 4 * mss;
+  tcp_nagle_disable(pcb);
+
+  err = tcp_write(pcb, tx_data, mss, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(pmtu_tx_num == 1);
+  EXPECT(pmtu_tx_len[0] == mss);
+
+  /* the first retransmission is full sized */
+  while (pmtu_tx_num == 1) {
+    test_tcp_tmr();
+  }
+  EXPECT_RET(pmtu_tx_num == 2);
+  EXPECT(pmtu_tx_len[1] == mss);
+  EXPECT(pcb->mss == mss);
+
+  /* with the second, a black hole is assumed */
+  while (pmtu_tx_num == 2) {
+    test_tcp_tmr();
+  }
+  EXPECT(pcb->mss == TCP_PMTU_BASE_MSS);
+  EXPECT(pmtu_tx_len[2] == TCP_PMTU_BASE_MSS);
+  EXPECT(ip4_pmtu_get(ip_2_ip4(&test_remote_ip)) == TCP_PMTU_BASE_MSS + 40);
+  EXPECT(pcb->unsent != NULL);
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_TCP_PLPMTUD */
+#endif /* IP_PMTUD */
+
+#if LWIP_TCP_ZEROCOPY
+static void *zc_cookies[4];
+static u16_t zc_lens[4];
+static struct tcp_pcb *zc_pcbs[4];
+static int zc_num;
+
+static err_t
+test_tcp_zc_done(void *arg, struct tcp_pcb *tpcb, void *cookie, u16_t len)
+{
+  LWIP_UNUSED_ARG(arg);
+  if (zc_num < 4) {
+    zc_cookies[zc_num] = cookie;
+    zc_lens[zc_num] = len;
+    zc_pcbs[zc_num] = tpcb;
+  }
+  zc_num++;
+  return ERR_OK;
+}
+
+/** Check that buffers written with tcp_write_ref() are reported in order
+ * when all of their data is acknowledged and no pbuf references them */
+START_TEST(test_tcp_write_ref)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p, *held;
+  err_t err;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 4 * TCP_MSS; i++) {
+    tx_data[i] = (u8_t)i;
+  }
+  zc_num = 0;
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(&counters, 0, sizeof(counters));
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 4 * TCP_MSS;
+  tcp_nagle_disable(pcb);
+  tcp_zc_done(pcb, test_tcp_zc_done);
+
+  /* A spans two segments, B and the start of C are appended to the second
+     one, the rest of C goes into the third */
+  err = tcp_write_ref(pcb, tx_data, TCP_MSS + 10, 0, &zc_cookies[0]);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_write_ref(pcb, &tx_data[TCP_MSS + 10], 10, 0, &zc_cookies[1]);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_write_ref(pcb, &tx_data[TCP_MSS + 20], TCP_MSS, 0, &zc_cookies[2]);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_ZC) == 3);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(txcounters.num_tx_calls == 3);
+  EXPECT(txcounters.num_tx_bytes == 2 * TCP_MSS + 20 + 3 * 40U);
+  EXPECT(zc_num == 0);
+
+  /* the first segment completes nothing */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(zc_num == 0);
+
+  /* the second one completes A and B, in order */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT_RET(zc_num == 2);
+  EXPECT(zc_cookies[0] == &zc_cookies[0]);
+  EXPECT(zc_lens[0] == TCP_MSS + 10);
+  EXPECT(zc_pcbs[0] == pcb);
+  EXPECT(zc_cookies[1] == &zc_cookies[1]);
+  EXPECT(zc_lens[1] == 10);
+
+  /* C is acknowledged while a netif still holds its pbuf: it is reported by
+     the fast timer after the pbuf is freed, not from within pbuf_free() */
+  EXPECT_RET(pcb->unacked != NULL);
+  held = pcb->unacked->p;
+  pbuf_ref(held);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 20, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(zc_num == 2);
+  pbuf_free(held);
+  EXPECT(zc_num == 2);
+  test_tcp_tmr();
+  EXPECT_RET(zc_num == 3);
+  EXPECT(zc_cookies[2] == &zc_cookies[2]);
+  EXPECT(zc_lens[2] == TCP_MSS);
+  EXPECT(zc_pcbs[2] == pcb);
+
+  /* D is still referenced when the pcb is freed: it is reported when its
+     last pbuf is freed */
+  err = tcp_write_ref(pcb, tx_data, 10, 0, &zc_cookies[3]);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(pcb->unacked != NULL);
+  held = pcb->unacked->p;
+  pbuf_ref(held);
+  tcp_abort(pcb);
+  EXPECT(zc_num == 3);
+  pbuf_free(held);
+  EXPECT_RET(zc_num == 4);
+  EXPECT(zc_cookies[3] == &zc_cookies[3]);
+  EXPECT(zc_pcbs[3] == NULL);
+
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_ZC) == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_ZC_PBUF) == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+}
+END_TEST
+#endif /* LWIP_TCP_ZEROCOPY */
+
+#if LWIP_TCP_TSO
+/* the packets sent (recorded by test_tcp_tso_netif_output()) */
+static u16_t tso_tx_len[8];
+static u16_t tso_tx_mss[8];
+static u32_t tso_tx_seqno[8];
+static u8_t tso_tx_flags[8];
+static u16_t tso_tx_id[8];
+static u16_t tso_tx_hdrlen[8];
+static u8_t tso_tx_chksum_ok;
+static u16_t tso_tx_num;
+
+/** netif output recording the data length, TSO segment size, sequence
+ * number, flags, IP ID and the length of the first pbuf of each packet and
+ * checking its checksums */
+static err_t
+test_tcp_tso_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  struct tcp_hdr tcphdr;
+  struct pbuf *q;
+  u16_t hlen;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  EXPECT_RETX(pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0) == sizeof(iphdr), ERR_OK);
+  hlen = (u16_t)IPH_HL_BYTES(&iphdr);
+  EXPECT_RETX(pbuf_copy_partial(p, &tcphdr, sizeof(tcphdr), hlen) == sizeof(tcphdr), ERR_OK);
+  EXPECT_RETX(tso_tx_num < LWIP_ARRAYSIZE(tso_tx_len), ERR_OK);
+  tso_tx_len[tso_tx_num] = (u16_t)(p->tot_len - hlen - TCPH_HDRLEN_BYTES(&tcphdr));
+  tso_tx_mss[tso_tx_num] = p->tso_mss;
+  tso_tx_seqno[tso_tx_num] = lwip_ntohl(tcphdr.seqno);
+  tso_tx_flags[tso_tx_num] = TCPH_FLAGS(&tcphdr);
+  tso_tx_id[tso_tx_num] = lwip_ntohs(IPH_ID(&iphdr));
+  tso_tx_hdrlen[tso_tx_num] = p->len;
+  tso_tx_num++;
+
+  if ((lwip_ntohs(IPH_LEN(&iphdr)) != p->tot_len) || (inet_chksum(&iphdr, hlen) != 0)) {
+    tso_tx_chksum_ok = 0;
+  }
+  q = pbuf_alloc(PBUF_RAW, (u16_t)(p->tot_len - hlen), PBUF_RAM);
+  EXPECT_RETX(q != NULL, ERR_OK);
+  pbuf_copy_partial(p, q->payload, q->len, hlen);
+  if (ip_chksum_pseudo(q, IP_PROTO_TCP, q->tot_len, &test_local_ip, &test_remote_ip) != 0) {
+    tso_tx_chksum_ok = 0;
+  }
+  pbuf_free(q);
+  return ERR_OK;
+}
+
+/** Check that queued segments are sent as super-segments to a netif with
+ * NETIF_FLAG_TSO, cut up in software for a netif without it, and split
+ * again when they don't fit into the window after a retransmission timeout */
+START_TEST(test_tcp_tso)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  err_t err;
+  u32_t seqno;
+  u16_t i, id;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 5 * TCP_MSS; i++) {
+    tx_data[i] = (u8_t)i;
+  }
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_tso_netif_output;
+  netif.flags |= NETIF_FLAG_TSO;
+  netif.tso_max = (u16_t)(3 * TCP_MSS + 40);
+  memset(&counters, 0, sizeof(counters));
+  tso_tx_num = 0;
+  tso_tx_chksum_ok = 1;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 8 * TCP_MSS;
+  tcp_nagle_disable(pcb);
+  seqno = pcb->snd_nxt;
+
+  /* TSO: five segments go out as two super-segments of up to tso_max */
+  err = tcp_write(pcb, tx_data, 5 * TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(tso_tx_num == 2);
+  EXPECT(tso_tx_len[0] == 3 * TCP_MSS);
+  EXPECT(tso_tx_mss[0] == TCP_MSS);
+  EXPECT(tso_tx_seqno[0] == seqno);
+  EXPECT(tso_tx_len[1] == 2 * TCP_MSS);
+  EXPECT(tso_tx_mss[1] == TCP_MSS);
+  EXPECT(tso_tx_seqno[1] == seqno + 3 * TCP_MSS);
+  EXPECT(tso_tx_flags[1] & TCP_PSH);
+  EXPECT(tso_tx_chksum_ok);
+  EXPECT(pcb->snd_nxt == seqno + 5 * TCP_MSS);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 5 * TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(pcb->snd_queuelen == 0);
+
+  /* GSO: without NETIF_FLAG_TSO, the super-segment is cut up before
+     netif->output */
+  netif.flags &= (u8_t)~NETIF_FLAG_TSO;
+  tso_tx_num = 0;
+  seqno = pcb->snd_nxt;
+  err = tcp_write(pcb, tx_data, 3 * TCP_MSS, TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT_RET(tso_tx_num == 3);
+  for (i = 0; i < 3; i++) {
+    EXPECT(tso_tx_len[i] == TCP_MSS);
+    EXPECT(tso_tx_mss[i] == 0);
+    EXPECT(tso_tx_seqno[i] == seqno + i * TCP_MSS);
+    EXPECT(((tso_tx_flags[i] & TCP_PSH) != 0) == (i == 2));
+    EXPECT(tso_tx_id[i] == (u16_t)(tso_tx_id[0] + i));
+    /* only the headers are copied */
+    EXPECT(tso_tx_hdrlen[i] == IP_HLEN + TCP_HLEN);
+  }
+  id = tso_tx_id[0];
+  EXPECT(tso_tx_chksum_ok);
+  EXPECT_RET(pcb->unacked != NULL);
+  EXPECT(pcb->unacked->next == NULL);
+  EXPECT(pcb->unacked->len == 3 * TCP_MSS);
+
+  /* after a retransmission timeout, cwnd is one segment: the super-segment
+     is split to resend its first segment only */
+  tso_tx_num = 0;
+  while (tso_tx_num == 0) {
+    test_tcp_tmr();
+  }
+  EXPECT_RET(tso_tx_num == 1);
+  EXPECT(tso_tx_len[0] == TCP_MSS);
+  EXPECT(tso_tx_seqno[0] == seqno);
+  /* the IDs of the GSO segments have been reserved */
+  EXPECT(tso_tx_id[0] == (u16_t)(id + 3));
+  EXPECT(tso_tx_chksum_ok);
+  EXPECT_RET(pcb->unsent != NULL);
+  EXPECT(pcb->unsent->len == 2 * TCP_MSS);
+  EXPECT(lwip_ntohl(pcb->unsent->tcphdr->seqno) == seqno + TCP_MSS);
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 3 * TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->unacked == NULL);
+  EXPECT(pcb->unsent == NULL);
+  EXPECT(pcb->snd_queuelen == 0);
+
+  tcp_abort(pcb);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SEG) == 0);
+}
+END_TEST
+#endif /* LWIP_TCP_TSO */
+
+#if LWIP_NETIF_GRO
+/** Create a segment of 'pcb' carrying tx_data[off..off+len) at rcv_nxt +
+ * seqno_offset that ip4_input() accepts */
+static struct pbuf *
+test_tcp_gro_segment(struct tcp_pcb *pcb, u16_t off, u32_t seqno_offset, u16_t len, u8_t flags)
+{
+  struct pbuf *p = tcp_create_rx_segment(pcb, &tx_data[off], len, seqno_offset, 0, flags);
+  struct ip_hdr *iphdr;
+  EXPECT_RETNULL(p != NULL);
+  iphdr = (struct ip_hdr *)p->payload;
+  IPH_PROTO_SET(iphdr, IP_PROTO_TCP);
+  IPH_TTL_SET(iphdr, 255);
+  IPH_CHKSUM_SET(iphdr, 0);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+  return p;
+}
+
+/** Check that in-sequence segments received in one burst are merged into
+ * one segment for TCP, and that the stream is kept in order when a segment
+ * can't be merged */
+START_TEST(test_tcp_gro)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p[4];
+  u32_t rcv_nxt;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 7 * TCP_MSS; i++) {
+    tx_data[i] = (u8_t)(i * 7);
+  }
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.gro_max = 0xFFFF;
+  memset(&counters, 0, sizeof(counters));
+  counters.expected_data = (char *)tx_data;
+  counters.expected_data_len = 7 * TCP_MSS;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  rcv_nxt = pcb->rcv_nxt;
+
+  /* four segments are held back until the flush, then received at once */
+  for (i = 0; i < 4; i++) {
+    p[i] = test_tcp_gro_segment(pcb, (u16_t)(i * TCP_MSS), i * TCP_MSS, TCP_MSS, TCP_ACK);
+    EXPECT_RET(p[i] != NULL);
+  }
+  for (i = 0; i < 4; i++) {
+    EXPECT(netif_gro_input(p[i], &netif) == ERR_OK);
+  }
+  EXPECT(netif.gro_num == 1);
+  EXPECT(counters.recv_calls == 0);
+  netif_gro_flush(&netif);
+  EXPECT(netif.gro_num == 0);
+  EXPECT(counters.recv_calls == 1);
+  EXPECT(counters.recved_bytes == 4 * TCP_MSS);
+  EXPECT(pcb->rcv_nxt == rcv_nxt + 4 * TCP_MSS);
+  /* one delayed ACK instead of two ACKs sent */
+  EXPECT(txcounters.num_tx_calls == 0);
+  EXPECT(pcb->flags & TF_ACK_DELAY);
+  tcp_recved(pcb, 4 * TCP_MSS);
+
+  /* a corrupted segment passes the held one on and is dropped by TCP;
+     its retransmission is held again and passed on by a PSH segment */
+  p[0] = test_tcp_gro_segment(pcb, 4 * TCP_MSS, 0, TCP_MSS, TCP_ACK);
+  p[1] = test_tcp_gro_segment(pcb, 5 * TCP_MSS, TCP_MSS, TCP_MSS, TCP_ACK);
+  p[2] = test_tcp_gro_segment(pcb, 5 * TCP_MSS, TCP_MSS, TCP_MSS, TCP_ACK);
+  p[3] = test_tcp_gro_segment(pcb, 6 * TCP_MSS, 2 * TCP_MSS, TCP_MSS, TCP_ACK | TCP_PSH);
+  for (i = 0; i < 4; i++) {
+    EXPECT_RET(p[i] != NULL);
+  }
+  ((u8_t *)p[1]->payload)[IP_HLEN + TCP_HLEN] ^= 1;
+  EXPECT(netif_gro_input(p[0], &netif) == ERR_OK);
+  EXPECT(netif.gro_num == 1);
+  EXPECT(netif_gro_input(p[1], &netif) == ERR_OK);
+  EXPECT(netif.gro_num == 0);
+  EXPECT(counters.recv_calls == 2);
+  EXPECT(counters.recved_bytes == 5 * TCP_MSS);
+  EXPECT(netif_gro_input(p[2], &netif) == ERR_OK);
+  EXPECT(netif.gro_num == 1);
+  EXPECT(netif_gro_input(p[3], &netif) == ERR_OK);
+  EXPECT(netif.gro_num == 0);
+  EXPECT(counters.recv_calls == 3);
+  EXPECT(counters.recved_bytes == 7 * TCP_MSS);
+  EXPECT(pcb->rcv_nxt == rcv_nxt + 7 * TCP_MSS);
+
+  tcp_abort(pcb);
+}
+END_TEST
+
+/** Check the TCP checksum of a packet held back by GRO */
+static u8_t
+test_tcp_gro_chksum_ok(struct pbuf *p)
+{
+  u8_t ok;
+  pbuf_remove_header(p, IP_HLEN);
+  ok = (ip_chksum_pseudo(p, IP_PROTO_TCP, p->tot_len, &test_remote_ip, &test_local_ip) == 0);
+  pbuf_add_header(p, IP_HLEN);
+  return ok;
+}
+
+/** Check that the TCP checksum of a merged packet is kept correct (also
+ * for data appended at odd offsets) and that packets not addressed to the
+ * netif are not held back */
+START_TEST(test_tcp_gro_chksum)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  struct tcp_hdr *tcphdr;
+  ip4_addr_t other;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 302; i++) {
+    tx_data[i] = (u8_t)(i * 11 + 3);
+  }
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.gro_max = 0xFFFF;
+  memset(&counters, 0, sizeof(counters));
+  counters.expected_data = (char *)tx_data;
+  counters.expected_data_len = 302;
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+
+  /* odd lengths: the second and third segments are appended at odd and
+     even offsets */
+  for (i = 0; i < 3; i++) {
+    u16_t len = (i < 2) ? 101 : 100;
+    p = test_tcp_gro_segment(pcb, (u16_t)(i * 101), i * 101, len, TCP_ACK);
+    EXPECT_RET(p != NULL);
+    EXPECT(netif_gro_input(p, &netif) == ERR_OK);
+    EXPECT_RET(netif.gro_num == 1);
+    EXPECT(test_tcp_gro_chksum_ok(netif.gro_pkts[0]));
+  }
+  EXPECT(netif.gro_pkts[0]->tot_len == IP_HLEN + TCP_HLEN + 302);
+
+  /* a segment of the flow to another address (to be forwarded) is not
+     held back (and dropped by IP here) */
+  p = test_tcp_gro_segment(pcb, 302, 302, 10, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  iphdr = (struct ip_hdr *)p->payload;
+  IP4_ADDR(&other, 192, 168, 1, 99);
+  ip4_addr_copy(iphdr->dest, other);
+  tcphdr = (struct tcp_hdr *)(iphdr + 1);
+  tcphdr->chksum = 0;
+  pbuf_remove_header(p, IP_HLEN);
+  tcphdr->chksum = inet_chksum_pseudo(p, IP_PROTO_TCP, p->tot_len, ip_2_ip4(&test_remote_ip), &other);
+  pbuf_add_header(p, IP_HLEN);
+  IPH_CHKSUM_SET(iphdr, 0);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+  EXPECT(netif_gro_input(p, &netif) == ERR_OK);
+  EXPECT(netif.gro_num == 1);
+
+  netif_gro_flush(&netif);
+  EXPECT(counters.recv_calls == 1);
+  EXPECT(counters.recved_bytes == 302);
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_NETIF_GRO */
+
+#if LWIP_CHECKSUM_OFFLOAD
+static u16_t chksum_tx_start;
+static u16_t chksum_tx_offset;
+static u8_t chksum_tx_ok;
+
+/** netif output recording where the netif is asked to complete the TCP
+ * checksum and checking the checksum after completing it */
+static err_t
+test_tcp_chksum_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct pbuf *q;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  chksum_tx_start = p->chksum_start;
+  chksum_tx_offset = p->chksum_offset;
+  q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+  EXPECT_RETX(q != NULL, ERR_OK);
+  pbuf_copy(q, p);
+  q->chksum_start = p->chksum_start;
+  q->chksum_offset = p->chksum_offset;
+  if (q->chksum_offset != 0) {
+    ip_chksum_complete(q);
+  }
+  pbuf_remove_header(q, IP_HLEN);
+  chksum_tx_ok = (ip_chksum_pseudo(q, IP_PROTO_TCP, q->tot_len, &test_local_ip, &test_remote_ip) == 0);
+  pbuf_free(q);
+  return ERR_OK;
+}
+
+/** Check that the TCP checksum is left to a netif with
+ * NETIF_CHKSUM_PARTIAL_TCP and that the checksum of received segments
+ * verified by the netif is not checked again */
+START_TEST(test_tcp_chksum_offload)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  struct pbuf *p;
+  struct tcp_hdr *tcphdr;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < TCP_MSS; i++) {
+    tx_data[i] = (u8_t)(i * 3);
+  }
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  netif.output = test_tcp_chksum_netif_output;
+  memset(&counters, 0, sizeof(counters));
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 4 * TCP_MSS;
+  tcp_nagle_disable(pcb);
+
+  /* checksum calculated in software */
+  EXPECT_RET(tcp_write(pcb, tx_data, 101, TCP_WRITE_FLAG_COPY) == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT(chksum_tx_offset == 0);
+  EXPECT(chksum_tx_ok);
+
+  /* left to the netif: only the pseudo header checksum is filled in */
+  netif.chksum_partial = NETIF_CHKSUM_PARTIAL_TCP;
+  chksum_tx_ok = 0;
+  EXPECT_RET(tcp_write(pcb, tx_data, 203, TCP_WRITE_FLAG_COPY) == ERR_OK);
+  EXPECT_RET(tcp_output(pcb) == ERR_OK);
+  EXPECT(chksum_tx_start == IP_HLEN);
+  EXPECT(chksum_tx_offset == TCP_CHKSUM_OFFSET);
+  EXPECT(chksum_tx_ok);
+
+  /* a retransmission to a netif without offload is summed up in software */
+  netif.chksum_partial = 0;
+  chksum_tx_ok = 0;
+  tcp_rexmit_rto(pcb);
+  EXPECT(chksum_tx_offset == 0);
+  EXPECT(chksum_tx_ok);
+
+  /* a segment with a broken checksum is dropped unless the netif verified it */
+  p = tcp_create_rx_segment(pcb, tx_data, 10, 0, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  tcphdr = (struct tcp_hdr *)((u8_t *)p->payload + IP_HLEN);
+  tcphdr->chksum ^= 1;
+  test_tcp_input(p, &netif);
+  EXPECT(counters.recv_calls == 0);
+  p = tcp_create_rx_segment(pcb, tx_data, 10, 0, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  tcphdr = (struct tcp_hdr *)((u8_t *)p->payload + IP_HLEN);
+  tcphdr->chksum ^= 1;
+  p->flags |= PBUF_FLAG_CHKSUM_VERIFIED;
+  test_tcp_input(p, &netif);
+  EXPECT(counters.recv_calls == 1);
+  EXPECT(counters.recved_bytes == 10);
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_CHECKSUM_OFFLOAD */
+
+#if LWIP_TCP_PCB_TIMERS
+/** Check that an idle pcb has no timer running and that keepalive arms the
+ * timer for exactly the probe deadline */
+START_TEST(test_tcp_pcb_timers_idle)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(&counters, 0, sizeof(counters));
+
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+
+  /* nothing to do: no timer */
+  tcp_timer_update(pcb);
+  EXPECT(!sys_timeout_static_pending(&pcb->timer));
+  EXPECT(sys_timeouts_sleeptime() == 0xffffffff);
+
+  /* keepalive: one timer for the first probe, 2 s + 1 tick from now */
+  ip_set_option(pcb, SOF_KEEPALIVE);
+  pcb->keep_idle = 2000;
+  tcp_timer_update(pcb);
+  EXPECT(sys_timeout_static_pending(&pcb->timer));
+  for (i = 0; i < 8; i++) {
+    test_tcp_tmr();
+    EXPECT(txcounters.num_tx_calls == 0);
+  }
+  test_tcp_tmr();
+  EXPECT(txcounters.num_tx_calls == 1);
+  EXPECT(pcb->keep_cnt_sent == 1);
+  /* re-armed for the next probe */
+  EXPECT(sys_timeout_static_pending(&pcb->timer));
+
+  /* keepalive off: no timer */
+  ip_reset_option(pcb, SOF_KEEPALIVE);
+  tcp_timer_update(pcb);
+  EXPECT(!sys_timeout_static_pending(&pcb->timer));
+
+  /* make sure the pcb is freed */
+  EXPECT_RET(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 1);
+  tcp_abort(pcb);
+  EXPECT_RET(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+}
+END_TEST
+
+/** Check that a TIME_WAIT pcb is freed by its own timer after 2*MSL */
+START_TEST(test_tcp_pcb_timers_time_wait)
+{
+  struct tcp_pcb *pcb;
+  u32_t t;
+  LWIP_UNUSED_ARG(_i);
+
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, TIME_WAIT, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  tcp_timer_update(pcb);
+  EXPECT(sys_timeout_static_pending(&pcb->timer));
+
+  for (t = 0; t < 2 * TCP_MSL; t += TCP_SLOW_INTERVAL) {
+    lwip_sys_now += TCP_SLOW_INTERVAL;
+    sys_check_timeouts();
+    EXPECT_RET(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 1);
+  }
+  lwip_sys_now += TCP_SLOW_INTERVAL;
+  sys_check_timeouts();
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+  EXPECT(tcp_tw_pcbs == NULL);
+  EXPECT(sys_timeouts_sleeptime() == 0xffffffff);
+}
+END_TEST
+
+static int pcb_timers_poll_calls;
+
+/** poll callback closing (and so freeing) a SYN_SENT pcb */
+static err_t
+test_tcp_pcb_timers_poll_close(void *arg, struct tcp_pcb *pcb)
+{
+  LWIP_UNUSED_ARG(arg);
+  pcb_timers_poll_calls++;
+  EXPECT(tcp_close(pcb) == ERR_OK);
+  return ERR_OK;
+}
+
+/** Check that a pcb freed by its poll callback is not used any more */
+START_TEST(test_tcp_pcb_timers_poll_free)
+{
+  struct tcp_pcb *pcb;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  pcb_timers_poll_calls = 0;
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  /* still on the active list, but closing frees it */
+  pcb->state = SYN_SENT;
+  tcp_poll(pcb, test_tcp_pcb_timers_poll_close, 1);
+  EXPECT(sys_timeout_static_pending(&pcb->timer));
+
+  for (i = 0; (i < 10) && (pcb_timers_poll_calls == 0); i++) {
+    test_tcp_tmr();
+  }
+  EXPECT(pcb_timers_poll_calls == 1);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+  EXPECT(tcp_active_pcbs == NULL);
+  /* no timer re-armed in the freed pcb */
+  EXPECT(sys_timeouts_sleeptime() == 0xffffffff);
+  test_tcp_tmr();
+  EXPECT(pcb_timers_poll_calls == 1);
+}
+END_TEST
+
+/** poll callback counting its calls */
+static err_t
+test_tcp_pcb_timers_poll_count(void *arg, struct tcp_pcb *pcb)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  pcb_timers_poll_calls++;
+  return ERR_OK;
+}
+
+/** Check that an idle pcb with a poll callback is only woken up once per poll
+ * interval, not on every slow timer tick */
+START_TEST(test_tcp_pcb_timers_poll_interval)
+{
+  struct tcp_pcb *pcb;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  pcb_timers_poll_calls = 0;
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  tcp_poll(pcb, test_tcp_pcb_timers_poll_count, 4);
+  EXPECT(sys_timeout_static_pending(&pcb->timer));
+  /* armed for the poll, 4 ticks (less the part of this tick gone already) */
+  EXPECT(sys_timeouts_sleeptime() > 3 * TCP_SLOW_INTERVAL);
+
+  /* polled every 4 ticks (tcp_setup() starts the tick clock half a tick
+     early), the timer is only armed for the polls */
+  for (i = 0; i < 16 * 2; i++) {
+    test_tcp_tmr();
+    EXPECT(pcb_timers_poll_calls == (i + 2) / 8);
+    EXPECT(pcb->timer_due - sys_now() > (u32_t)(((i + 2) % 8 == 0) ? 3 * TCP_SLOW_INTERVAL : 0));
+  }
+  EXPECT(pcb_timers_poll_calls == 4);
+
+  /* no callback: no timer */
+  tcp_poll(pcb, NULL, 0);
+  EXPECT(!sys_timeout_static_pending(&pcb->timer));
+
+  tcp_abort(pcb);
+}
+END_TEST
+#endif /* LWIP_TCP_PCB_TIMERS */
+
+#if LWIP_TCP_PCB_HASH
+/** Check that segments are demultiplexed to the right pcb via the hash tables */
+START_TEST(test_tcp_pcb_hash_demux)
+{
+  struct test_tcp_counters counters1, counters2;
+  struct tcp_pcb *pcb1, *pcb2, *lpcb;
+  struct pbuf *p;
+  char data[] = {1, 2, 3, 4};
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  memset(&counters1, 0, sizeof(counters1));
+  memset(&counters2, 0, sizeof(counters2));
+
+  /* a listener and two connections on the same local port that differ in
+     the remote port only */
+  lpcb = tcp_new();
+  EXPECT_RET(lpcb != NULL);
+  EXPECT(tcp_bind(lpcb, IP_ADDR_ANY, TEST_LOCAL_PORT) == ERR_OK);
+  lpcb = tcp_listen(lpcb);
+  EXPECT_RET(lpcb != NULL);
+  EXPECT(tcp_listen_pcb_hash_lookup(&test_local_ip, TEST_LOCAL_PORT, NULL) == (struct tcp_pcb_listen *)lpcb);
+  EXPECT(tcp_listen_pcb_hash_lookup(&test_local_ip, TEST_LOCAL_PORT + 1, NULL) == NULL);
+
+  pcb1 = test_tcp_new_counters_pcb(&counters1);
+  EXPECT_RET(pcb1 != NULL);
+  tcp_set_state(pcb1, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  pcb2 = test_tcp_new_counters_pcb(&counters2);
+  EXPECT_RET(pcb2 != NULL);
+  tcp_set_state(pcb2, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT + 1);
+  EXPECT(tcp_pcb_hash_lookup(&test_local_ip, TEST_LOCAL_PORT, &test_remote_ip, TEST_REMOTE_PORT, NULL) == pcb1);
+  EXPECT(tcp_pcb_hash_lookup(&test_local_ip, TEST_LOCAL_PORT, &test_remote_ip, TEST_REMOTE_PORT + 1, NULL) == pcb2);
+  EXPECT(tcp_pcb_hash_lookup(&test_local_ip, TEST_LOCAL_PORT, &test_remote_ip, TEST_REMOTE_PORT + 2, NULL) == NULL);
+
+  p = tcp_create_rx_segment(pcb2, data, sizeof(data), 0, 0, 0);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(counters1.recv_calls == 0);
+  EXPECT(counters2.recv_calls == 1);
+  EXPECT(counters2.recved_bytes == sizeof(data));
+
+  /* the listener does not catch segments for existing connections... */
+  p = tcp_create_rx_segment(pcb1, data, sizeof(data), 0, 0, 0);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(counters1.recv_calls == 1);
+  EXPECT(counters2.recv_calls == 1);
+
+  /* ...but gets the SYN of a new one */
+  p = tcp_create_segment(&test_remote_ip, &test_local_ip,
+    TEST_REMOTE_PORT + 2, TEST_LOCAL_PORT, NULL, 0, 12345, 0, TCP_SYN);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+#if LWIP_TCP_SYN_REQ
+  /* (kept as a request entry of the listener) */
+  EXPECT(tcp_syn_req_find((struct tcp_pcb_listen *)lpcb, &test_local_ip, &test_remote_ip, TEST_REMOTE_PORT + 2) != NULL);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 2);
+#else /* LWIP_TCP_SYN_REQ */
+  EXPECT(tcp_pcb_hash_lookup(&test_local_ip, TEST_LOCAL_PORT, &test_remote_ip, TEST_REMOTE_PORT + 2, NULL) != NULL);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 3);
+#endif /* LWIP_TCP_SYN_REQ */
+
+  /* removed pcbs are removed from the hash tables, too */
+  tcp_abort(pcb1);
+  EXPECT(tcp_pcb_hash_lookup(&test_local_ip, TEST_LOCAL_PORT, &test_remote_ip, TEST_REMOTE_PORT, NULL) == NULL);
+  EXPECT(tcp_close(lpcb) == ERR_OK);
+  EXPECT(tcp_listen_pcb_hash_lookup(&test_local_ip, TEST_LOCAL_PORT, NULL) == NULL);
+}
+END_TEST
+
+/** Check the demux cost from 10 to 10000 connections: the average number of
+ * hash chain entries visited per lookup must only depend on the load factor
+ * N/TCP_PCB_HASH_SIZE (a list walk would visit N/2 pcbs on average). */
+START_TEST(test_tcp_pcb_hash_lookup_cost)
+{
+  static const u32_t num_pcbs[] = {10, 100, 1000, 10000};
+  size_t n;
+  LWIP_UNUSED_ARG(_i);
+
+  for (n = 0; n < LWIP_ARRAYSIZE(num_pcbs); n++) {
+    struct tcp_pcb *pcbs = (struct tcp_pcb *)calloc(num_pcbs[n], sizeof(struct tcp_pcb));
+    u32_t i, probes = 0;
+    EXPECT_RET(pcbs != NULL);
+
+    for (i = 0; i < num_pcbs[n]; i++) {
+      struct tcp_pcb *pcb = &pcbs[i];
+      ip_addr_copy(pcb->local_ip, test_local_ip);
+      pcb->local_port = TEST_LOCAL_PORT;
+      IP_ADDR4(&pcb->remote_ip, 10, (u8_t)(i >> 16), (u8_t)(i >> 8), (u8_t)i);
+      pcb->remote_port = (u16_t)(0x8000 + (i % 64));
+      pcb->state = ESTABLISHED;
+      TCP_REG_ACTIVE(pcb);
+    }
+    for (i = 0; i < num_pcbs[n]; i++) {
+      struct tcp_pcb *pcb = &pcbs[i];
+      struct tcp_pcb *cur = tcp_pcb_hash[tcp_pcb_hash_idx(&pcb->local_ip, pcb->local_port,
+                                                          &pcb->remote_ip, pcb->remote_port)];
+      for (; cur != NULL; cur = cur->hash_next) {
+        probes++;
+        if (cur == pcb) {
+          break;
+        }
+      }
+      EXPECT(cur == pcb);
+      EXPECT(tcp_pcb_hash_lookup(&pcb->local_ip, pcb->local_port, &pcb->remote_ip,
+                                 pcb->remote_port, NULL) == pcb);
+    }
+    /* a successful lookup visits 1 + load/2 entries on average, allow some
+       slack for an uneven distribution */
+    EXPECT(probes <= num_pcbs[n] * (2 + num_pcbs[n] / TCP_PCB_HASH_SIZE));
+
+    while (tcp_active_pcbs != NULL) {
+      struct tcp_pcb *pcb = tcp_active_pcbs;
+      TCP_RMV_ACTIVE(pcb);
+    }
+    for (i = 0; i < TCP_PCB_HASH_SIZE; i++) {
+      EXPECT(tcp_pcb_hash[i] == NULL);
+    }
+    free(pcbs);
+  }
+}
+END_TEST
+#endif /* LWIP_TCP_PCB_HASH */
+
 /** Create the suite including all tests for this module */
 Suite *
 tcp_suite(void)
@@ -1012,7 +3965,79 @@ tcp_suite(void)
     TESTFUNC(test_tcp_tx_full_window_lost_from_unsent),
     TESTFUNC(test_tcp_rto_tracking),
     TESTFUNC(test_tcp_rto_timeout),
-    TESTFUNC(test_tcp_zwp_timeout)
+    TESTFUNC(test_tcp_zwp_timeout),
+#if LWIP_TCP_SACK_IN
+    TESTFUNC(test_tcp_sack_multi_loss),
+    TESTFUNC(test_tcp_sack_recovery_small_segs),
+#endif /* LWIP_TCP_SACK_IN */
+    TESTFUNC(test_tcp_cc_select),
+#if LWIP_TCP_CUBIC
+    TESTFUNC(test_tcp_cubic_growth),
+#endif /* LWIP_TCP_CUBIC */
+#if LWIP_TCP_PACING
+    TESTFUNC(test_tcp_pacing_spacing),
+#endif /* LWIP_TCP_PACING */
+#if LWIP_TCP_RACK
+    TESTFUNC(test_tcp_rack_tail_loss),
+#endif /* LWIP_TCP_RACK */
+#if LWIP_TCP_FASTOPEN
+    TESTFUNC(test_tcp_fastopen_client),
+    TESTFUNC(test_tcp_fastopen_server),
+#endif /* LWIP_TCP_FASTOPEN */
+#if LWIP_TCP_SYNCOOKIES
+    TESTFUNC(test_tcp_syncookie),
+#endif /* LWIP_TCP_SYNCOOKIES */
+#if LWIP_TCP_SYN_REQ
+    TESTFUNC(test_tcp_syn_req),
+#endif /* LWIP_TCP_SYN_REQ */
+#if LWIP_TCP_TW_COMPACT
+    TESTFUNC(test_tcp_tw_compact),
+#endif /* LWIP_TCP_TW_COMPACT */
+#if LWIP_TCP_RCV_AUTOTUNE
+    TESTFUNC(test_tcp_rcv_autotune),
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+#if LWIP_TCP_SNDBUF_PCB
+    TESTFUNC(test_tcp_sndbuf),
+#endif /* LWIP_TCP_SNDBUF_PCB */
+#if LWIP_TCP_INFO
+    TESTFUNC(test_tcp_info),
+#endif /* LWIP_TCP_INFO */
+#if LWIP_TCP_TS_RTTM
+    TESTFUNC(test_tcp_ts_rttm),
+#endif /* LWIP_TCP_TS_RTTM */
+#if LWIP_TCP_ECN
+    TESTFUNC(test_tcp_ecn),
+    TESTFUNC(test_tcp_ecn_syn_fallback),
+#endif /* LWIP_TCP_ECN */
+#if IP_PMTUD
+    TESTFUNC(test_tcp_pmtud),
+#if LWIP_TCP_PLPMTUD
+    TESTFUNC(test_tcp_pmtu_blackhole),
+#endif /* LWIP_TCP_PLPMTUD */
+#endif /* IP_PMTUD */
+#if LWIP_TCP_ZEROCOPY
+    TESTFUNC(test_tcp_write_ref),
+#endif /* LWIP_TCP_ZEROCOPY */
+#if LWIP_TCP_TSO
+    TESTFUNC(test_tcp_tso),
+#endif /* LWIP_TCP_TSO */
+#if LWIP_NETIF_GRO
+    TESTFUNC(test_tcp_gro),
+    TESTFUNC(test_tcp_gro_chksum),
+#endif /* LWIP_NETIF_GRO */
+#if LWIP_CHECKSUM_OFFLOAD
+    TESTFUNC(test_tcp_chksum_offload),
+#endif /* LWIP_CHECKSUM_OFFLOAD */
+#if LWIP_TCP_PCB_TIMERS
+    TESTFUNC(test_tcp_pcb_timers_idle),
+    TESTFUNC(test_tcp_pcb_timers_time_wait),
+    TESTFUNC(test_tcp_pcb_timers_poll_free),
+    TESTFUNC(test_tcp_pcb_timers_poll_interval),
+#endif /* LWIP_TCP_PCB_TIMERS */
+#if LWIP_TCP_PCB_HASH
+    TESTFUNC(test_tcp_pcb_hash_demux),
+    TESTFUNC(test_tcp_pcb_hash_lookup_cost)
+#endif /* LWIP_TCP_PCB_HASH */
   };
   return create_suite("TCP", tests, sizeof(tests)/sizeof(testfunc), tcp_setup, tcp_teardown);
 }
@@ -22,6 +22,13 @@
 #define EXPECT_OOSEQ(x)
 #endif
 
+/** OOSEQ_COALESCE: adjacent segments on pcb->ooseq are merged into one */
+#define OOSEQ_COALESCE LWIP_TCP_OOSEQ_TREE
+
+/** OOSEQ_MEM_TEST: the global ooseq budget can be tested (no per-pcb limits) */
+#define OOSEQ_MEM_TEST (LWIP_TCP_OOSEQ_MEM && LWIP_TCP_OOSEQ_TREE && LWIP_TCP_SACK_OUT && TCP_STATS && \
+                        !TCP_OOSEQ_MAX_BYTES && !TCP_OOSEQ_MAX_PBUFS)
+
 /* helper functions */
 
 /** Get the numbers of segments on the ooseq list */
@@ -36,7 +43,7 @@ static int tcp_oos_count(struct tcp_pcb* pcb)
   return num;
 }
 
-#if TCP_OOSEQ_MAX_PBUFS && (TCP_OOSEQ_MAX_PBUFS < ((TCP_WND / TCP_MSS) + 1)) && (PBUF_POOL_BUFSIZE >= (TCP_MSS + PBUF_LINK_ENCAPSULATION_HLEN + PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN))
+#if (TCP_OOSEQ_MAX_PBUFS && (TCP_OOSEQ_MAX_PBUFS < ((TCP_WND / TCP_MSS) + 1)) && (PBUF_POOL_BUFSIZE >= (TCP_MSS + PBUF_LINK_ENCAPSULATION_HLEN + PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN))) || OOSEQ_MEM_TEST
 /** Get the numbers of pbufs on the ooseq list */
 static int tcp_oos_pbuf_count(struct tcp_pcb* pcb)
 {
@@ -222,11 +229,17 @@ START_TEST(test_tcp_recv_ooseq_FIN_OOSEQ)
     EXPECT(counters.recved_bytes == 0);
     EXPECT(counters.err_calls == 0);
     /* check ooseq queue */
+#if OOSEQ_COALESCE
+    EXPECT_OOSEQ(tcp_oos_count(pcb) == 1);
+    EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 0) == 4);
+    EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 0) == 13); /* includes FIN */
+#else /* OOSEQ_COALESCE */
     EXPECT_OOSEQ(tcp_oos_count(pcb) == 2);
     EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 0) == 4);
     EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 0) == 4);
     EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 1) == 8);
     EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 1) == 9); /* includes FIN */
+#endif /* OOSEQ_COALESCE */
 
     /* pass the segment to tcp_input */
     test_tcp_input(p_4_10, &netif);
@@ -236,11 +249,17 @@ START_TEST(test_tcp_recv_ooseq_FIN_OOSEQ)
     EXPECT(counters.recved_bytes == 0);
     EXPECT(counters.err_calls == 0);
     /* ooseq queue: unchanged */
+#if OOSEQ_COALESCE
+    EXPECT_OOSEQ(tcp_oos_count(pcb) == 1);
+    EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 0) == 4);
+    EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 0) == 13); /* includes FIN */
+#else /* OOSEQ_COALESCE */
     EXPECT_OOSEQ(tcp_oos_count(pcb) == 2);
     EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 0) == 4);
     EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 0) == 4);
     EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 1) == 8);
     EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 1) == 9); /* includes FIN */
+#endif /* OOSEQ_COALESCE */
 
     /* pass the segment to tcp_input */
     test_tcp_input(p_2_14, &netif);
@@ -382,12 +401,19 @@ START_TEST(test_tcp_recv_ooseq_FIN_INSEQ)
     EXPECT(counters.recved_bytes == 0);
     EXPECT(counters.err_calls == 0);
     /* check ooseq queue */
+#if OOSEQ_COALESCE
+    /* p_3_11 has removed p_4_8 from ooseq and has been merged into p_1_2 */
+    EXPECT_OOSEQ(tcp_oos_count(pcb) == 1);
+    EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 0) == 1);
+    EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 0) == 13);
+#else /* OOSEQ_COALESCE */
     EXPECT_OOSEQ(tcp_oos_count(pcb) == 2);
     EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 0) == 1);
     EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 0) == 2);
     /* p_3_11 has removed p_4_8 from ooseq */
     EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 1) == 3);
     EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 1) == 11);
+#endif /* OOSEQ_COALESCE */
 
     /* pass the segment to tcp_input */
     test_tcp_input(p_2_12, &netif);
@@ -397,11 +423,18 @@ START_TEST(test_tcp_recv_ooseq_FIN_INSEQ)
     EXPECT(counters.recved_bytes == 0);
     EXPECT(counters.err_calls == 0);
     /* check ooseq queue */
+#if OOSEQ_COALESCE
+    /* p_2_12 brings no new data: dropped */
+    EXPECT_OOSEQ(tcp_oos_count(pcb) == 1);
+    EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 0) == 1);
+    EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 0) == 13);
+#else /* OOSEQ_COALESCE */
     EXPECT_OOSEQ(tcp_oos_count(pcb) == 2);
     EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 0) == 1);
     EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 0) == 1);
     EXPECT_OOSEQ(tcp_oos_seg_seqno(pcb, 1) == 2);
     EXPECT_OOSEQ(tcp_oos_seg_tcplen(pcb, 1) == 12);
+#endif /* OOSEQ_COALESCE */
 
     /* pass the segment to tcp_input */
     test_tcp_input(pinseq, &netif);
@@ -503,7 +536,7 @@ START_TEST(test_tcp_recv_ooseq_overrun_rxwin)
     EXPECT(counters.err_calls == 0);
     /* check ooseq queue */
     count = tcp_oos_count(pcb);
-    EXPECT_OOSEQ(count == k+1);
+    EXPECT_OOSEQ(count == (OOSEQ_COALESCE ? 1 : k+1));
     datalen = tcp_oos_tcplen(pcb);
     if (i + TCP_MSS < TCP_WND) {
       expected_datalen = (k+1)*TCP_MSS;
@@ -526,7 +559,7 @@ START_TEST(test_tcp_recv_ooseq_overrun_rxwin)
   EXPECT(counters.recved_bytes == 0);
   EXPECT(counters.err_calls == 0);
   /* check ooseq queue */
-  EXPECT_OOSEQ(tcp_oos_count(pcb) == k);
+  EXPECT_OOSEQ(tcp_oos_count(pcb) == (OOSEQ_COALESCE ? 1 : k));
   datalen2 = tcp_oos_tcplen(pcb);
   EXPECT_OOSEQ(datalen == datalen2);
 
@@ -590,7 +623,7 @@ START_TEST(test_tcp_recv_ooseq_overrun_rxwin_edge)
     EXPECT(counters.err_calls == 0);
     /* check ooseq queue */
     count = tcp_oos_count(pcb);
-    EXPECT_OOSEQ(count == k+1);
+    EXPECT_OOSEQ(count == (OOSEQ_COALESCE ? 1 : k+1));
     datalen = tcp_oos_tcplen(pcb);
     if (i + TCP_MSS < TCP_WND) {
       expected_datalen = (k+1)*TCP_MSS;
@@ -613,7 +646,7 @@ START_TEST(test_tcp_recv_ooseq_overrun_rxwin_edge)
   EXPECT(counters.recved_bytes == 0);
   EXPECT(counters.err_calls == 0);
   /* check ooseq queue */
-  EXPECT_OOSEQ(tcp_oos_count(pcb) == k);
+  EXPECT_OOSEQ(tcp_oos_count(pcb) == (OOSEQ_COALESCE ? 1 : k));
   datalen2 = tcp_oos_tcplen(pcb);
   EXPECT_OOSEQ(datalen == datalen2);
 
@@ -692,7 +725,7 @@ START_TEST(test_tcp_recv_ooseq_max_bytes)
   EXPECT(counters.recved_bytes == 0);
   EXPECT(counters.err_calls == 0);
   /* check ooseq queue (ensure the new segment was not accepted) */
-  EXPECT_OOSEQ(tcp_oos_count(pcb) == (i-1));
+  EXPECT_OOSEQ(tcp_oos_count(pcb) == (OOSEQ_COALESCE ? 1 : (i-1)));
   datalen2 = tcp_oos_tcplen(pcb);
   EXPECT_OOSEQ(datalen2 == ((i-1) * TCP_MSS));
 
@@ -767,10 +800,22 @@ START_TEST(test_tcp_recv_ooseq_max_pbufs)
   EXPECT(counters.recved_bytes == 0);
   EXPECT(counters.err_calls == 0);
   /* check ooseq queue (ensure the new segment was not accepted) */
-  EXPECT_OOSEQ(tcp_oos_count(pcb) == (i-1));
+  EXPECT_OOSEQ(tcp_oos_count(pcb) == (OOSEQ_COALESCE ? 1 : (i-1)));
   datalen2 = tcp_oos_tcplen(pcb);
   EXPECT_OOSEQ(datalen2 == (i-1));
 
+#if OOSEQ_COALESCE
+  /* pass in a segment adjacent to the queued ones: it is merged into the
+     coalesced segment and the pbuf over the limit is trimmed again */
+  p_ovr = tcp_create_rx_segment(pcb, &data_full_wnd[i], 1, i, 0, TCP_ACK);
+  EXPECT_RET(p_ovr != NULL);
+  test_tcp_input(p_ovr, &netif);
+  EXPECT(counters.recv_calls == 0);
+  EXPECT_OOSEQ(tcp_oos_count(pcb) == 1);
+  EXPECT_OOSEQ(tcp_oos_pbuf_count(pcb) == (i-1));
+  EXPECT_OOSEQ(tcp_oos_tcplen(pcb) == (i-1));
+#endif /* OOSEQ_COALESCE */
+
   /* make sure the pcb is freed */
   EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 1);
   tcp_abort(pcb);
@@ -903,7 +948,10 @@ static void test_tcp_recv_ooseq_double_FINs(int delay_packet)
       /* already dropped packets, this one is ooseq */
       if (delay_packet & 2) {
         /* correct FIN was ooseq */
-        exp_oos_pbufs++;
+        if (!OOSEQ_COALESCE || (delay_packet & 4)) {
+          /* (else merged into data-after-FIN) */
+          exp_oos_pbufs++;
+        }
         exp_oos_tcplen++;
       }
     } else {
@@ -985,6 +1033,223 @@ FIN_TEST(test_tcp_recv_ooseq_double_FIN_13, 13)
 FIN_TEST(test_tcp_recv_ooseq_double_FIN_14, 14)
 FIN_TEST(test_tcp_recv_ooseq_double_FIN_15, 15)
 
+/** fill a queue of isolated segments in a scrambled order and check that
+ * adjacent segments are coalesced, SACKs cover the range of the most recent
+ * segment and everything is delivered once the first segment arrives */
+START_TEST(test_tcp_recv_ooseq_coalesce)
+{
+#if LWIP_TCP_OOSEQ_TREE && LWIP_TCP_SACK_OUT && !TCP_OOSEQ_MAX_BYTES && !TCP_OOSEQ_MAX_PBUFS
+#define OOS_COALESCE_SEGS    64
+#define OOS_COALESCE_SEGLEN  16
+  int i, j;
+  struct test_tcp_counters counters;
+  struct tcp_pcb* pcb;
+  struct pbuf *p;
+  struct netif netif;
+  struct tcp_seg *seg;
+  u32_t base;
+  LWIP_UNUSED_ARG(_i);
+
+  for(i = 0; i < OOS_COALESCE_SEGS * OOS_COALESCE_SEGLEN; i++) {
+    data_full_wnd[i] = (char)i;
+  }
+
+  /* initialize local vars */
+  test_tcp_init_netif(&netif, NULL, &test_local_ip, &test_netmask);
+  /* initialize counter struct */
+  memset(&counters, 0, sizeof(counters));
+  counters.expected_data_len = OOS_COALESCE_SEGS * OOS_COALESCE_SEGLEN;
+  counters.expected_data = data_full_wnd;
+
+  /* create and initialize the pcb */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  tcp_set_flags(pcb, TF_SACK);
+  base = pcb->rcv_nxt;
+
+  /* odd segments, each one leaves a hole before it */
+  for(j = 0; j < OOS_COALESCE_SEGS / 2; j++) {
+    i = 1 + 2 * ((j * 13) % (OOS_COALESCE_SEGS / 2));
+    p = tcp_create_rx_segment(pcb, &data_full_wnd[i * OOS_COALESCE_SEGLEN], OOS_COALESCE_SEGLEN,
+                              (u32_t)(i * OOS_COALESCE_SEGLEN), 0, TCP_ACK);
+    EXPECT_RET(p != NULL);
+    test_tcp_input(p, &netif);
+    EXPECT(counters.recv_calls == 0);
+    EXPECT(tcp_oos_count(pcb) == j + 1);
+    EXPECT(pcb->rcv_sacks[0].left == base + (u32_t)(i * OOS_COALESCE_SEGLEN));
+    EXPECT(pcb->rcv_sacks[0].right == base + (u32_t)((i + 1) * OOS_COALESCE_SEGLEN));
+  }
+  /* ooseq is sorted and the tree finds every segment */
+  for(seg = pcb->ooseq; seg != NULL; seg = seg->next) {
+    EXPECT(tcp_ooseq_tree_lookup(pcb, seg->tcphdr->seqno + 1) == seg);
+    if (seg->next != NULL) {
+      EXPECT(TCP_SEQ_LT(seg->tcphdr->seqno + seg->len, seg->next->tcphdr->seqno));
+    }
+  }
+
+  /* fill the holes except the first one: every segment joins its neighbours */
+  for(j = 0; j < OOS_COALESCE_SEGS / 2 - 1; j++) {
+    i = 2 + 2 * ((j * 7) % (OOS_COALESCE_SEGS / 2 - 1));
+    p = tcp_create_rx_segment(pcb, &data_full_wnd[i * OOS_COALESCE_SEGLEN], OOS_COALESCE_SEGLEN,
+                              (u32_t)(i * OOS_COALESCE_SEGLEN), 0, TCP_ACK);
+    EXPECT_RET(p != NULL);
+    test_tcp_input(p, &netif);
+    EXPECT(counters.recv_calls == 0);
+    EXPECT(tcp_oos_count(pcb) == OOS_COALESCE_SEGS / 2 - 1 - j);
+    EXPECT(TCP_SEQ_LEQ(pcb->rcv_sacks[0].left, base + (u32_t)((i - 1) * OOS_COALESCE_SEGLEN)));
+    EXPECT(TCP_SEQ_GEQ(pcb->rcv_sacks[0].right, base + (u32_t)((i + 2) * OOS_COALESCE_SEGLEN)));
+  }
+  EXPECT(tcp_oos_count(pcb) == 1);
+  EXPECT(tcp_oos_seg_seqno(pcb, 0) == base + OOS_COALESCE_SEGLEN);
+  EXPECT(tcp_oos_seg_tcplen(pcb, 0) == (OOS_COALESCE_SEGS - 1) * OOS_COALESCE_SEGLEN);
+  EXPECT(pcb->rcv_sacks[0].left == base + OOS_COALESCE_SEGLEN);
+  EXPECT(pcb->rcv_sacks[0].right == base + OOS_COALESCE_SEGS * OOS_COALESCE_SEGLEN);
+  EXPECT(!LWIP_TCP_SACK_VALID(pcb, 1));
+
+  /* a retransmission within the coalesced range changes nothing */
+  p = tcp_create_rx_segment(pcb, &data_full_wnd[10 * OOS_COALESCE_SEGLEN], OOS_COALESCE_SEGLEN,
+                            10 * OOS_COALESCE_SEGLEN, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(tcp_oos_count(pcb) == 1);
+  EXPECT(tcp_oos_seg_tcplen(pcb, 0) == (OOS_COALESCE_SEGS - 1) * OOS_COALESCE_SEGLEN);
+
+  /* the first segment delivers everything */
+  p = tcp_create_rx_segment(pcb, &data_full_wnd[0], OOS_COALESCE_SEGLEN, 0, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(counters.recv_calls == 1);
+  EXPECT(counters.recved_bytes == OOS_COALESCE_SEGS * OOS_COALESCE_SEGLEN);
+  EXPECT(counters.err_calls == 0);
+  EXPECT(pcb->ooseq == NULL);
+  EXPECT(pcb->ooseq_root == NULL);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SEG) == 0);
+
+  /* make sure the pcb is freed */
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 1);
+  tcp_abort(pcb);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+#else /* LWIP_TCP_OOSEQ_TREE && LWIP_TCP_SACK_OUT && !TCP_OOSEQ_MAX_BYTES && !TCP_OOSEQ_MAX_PBUFS */
+  LWIP_UNUSED_ARG(_i);
+#endif /* LWIP_TCP_OOSEQ_TREE && LWIP_TCP_SACK_OUT && !TCP_OOSEQ_MAX_BYTES && !TCP_OOSEQ_MAX_PBUFS */
+}
+END_TEST
+
+
+#if OOSEQ_MEM_TEST
+#define OOS_MEM_SEGLEN  16
+/** Queue 'count' adjacent segments (coalesced into one) after a hole of one
+ * segment, starting with segment number 'first' */
+static void
+test_tcp_oos_mem_queue(struct tcp_pcb *pcb, struct netif *netif, int first, int count)
+{
+  int i;
+  for (i = first; i < first + count; i++) {
+    struct pbuf *p = tcp_create_rx_segment(pcb, &data_full_wnd[i * OOS_MEM_SEGLEN], OOS_MEM_SEGLEN,
+                                           (u32_t)(i * OOS_MEM_SEGLEN), 0, TCP_ACK);
+    EXPECT_RET(p != NULL);
+    test_tcp_input(p, netif);
+  }
+}
+#endif /* OOSEQ_MEM_TEST */
+
+/** The ooseq budget is enforced by pruning the end of the largest queue */
+START_TEST(test_tcp_recv_ooseq_mem)
+{
+#if OOSEQ_MEM_TEST
+  int i;
+  struct test_tcp_counters counters;
+  struct tcp_pcb *pcb1, *pcb2;
+  struct netif netif;
+  struct stats_tcp_ooseq st;
+  u32_t base1, base2;
+  const int n1 = TCP_OOSEQ_MEM_PBUFS / 4;
+  const int n2 = TCP_OOSEQ_MEM_PBUFS - TCP_OOSEQ_MEM_PBUFS / 4;
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT_RET((n2 + 2) * OOS_MEM_SEGLEN <= (int)sizeof(data_full_wnd));
+  for(i = 0; i < (n2 + 2) * OOS_MEM_SEGLEN; i++) {
+    data_full_wnd[i] = (char)i;
+  }
+
+  test_tcp_init_netif(&netif, NULL, &test_local_ip, &test_netmask);
+  memset(&counters, 0, sizeof(counters));
+  st = lwip_stats.tcp_ooseq;
+
+  pcb1 = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb1 != NULL);
+  tcp_set_state(pcb1, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  tcp_set_flags(pcb1, TF_SACK);
+  base1 = pcb1->rcv_nxt;
+  pcb2 = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb2 != NULL);
+  tcp_set_state(pcb2, ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT + 1);
+  tcp_set_flags(pcb2, TF_SACK);
+  base2 = pcb2->rcv_nxt;
+
+  /* fill the budget exactly */
+  test_tcp_oos_mem_queue(pcb1, &netif, 1, n1);
+  test_tcp_oos_mem_queue(pcb2, &netif, 1, n2);
+  EXPECT(pcb1->ooseq_pbufs == n1);
+  EXPECT(pcb2->ooseq_pbufs == n2);
+  EXPECT(tcp_oos_pbuf_count(pcb2) == n2);
+  EXPECT(lwip_stats.tcp_ooseq.used == TCP_OOSEQ_MEM_PBUFS);
+  EXPECT(lwip_stats.tcp_ooseq.pressure == st.pressure);
+
+  /* one more pbuf: the end of the largest queue (the new data) is pruned */
+  test_tcp_oos_mem_queue(pcb2, &netif, n2 + 1, 1);
+  EXPECT(lwip_stats.tcp_ooseq.pressure == st.pressure + 1);
+  EXPECT(lwip_stats.tcp_ooseq.pruned_segs == st.pruned_segs + 1);
+  EXPECT(lwip_stats.tcp_ooseq.pruned_pbufs == st.pruned_pbufs + 1);
+  EXPECT(lwip_stats.tcp_ooseq.used == TCP_OOSEQ_MEM_PBUFS);
+  EXPECT(pcb1->ooseq_pbufs == n1);
+  EXPECT(pcb2->ooseq_pbufs == n2);
+  EXPECT(tcp_oos_count(pcb2) == 1);
+  EXPECT(tcp_oos_seg_tcplen(pcb2, 0) == n2 * OOS_MEM_SEGLEN);
+  EXPECT(pcb2->rcv_sacks[0].left == base2 + OOS_MEM_SEGLEN);
+  EXPECT(pcb2->rcv_sacks[0].right == base2 + (u32_t)((n2 + 1) * OOS_MEM_SEGLEN));
+
+  /* running out of pool pbufs takes half, from the largest queue first */
+  tcp_ooseq_mem_reclaim();
+  EXPECT(lwip_stats.tcp_ooseq.reclaim == st.reclaim + 1);
+  EXPECT(lwip_stats.tcp_ooseq.used == TCP_OOSEQ_MEM_PBUFS - TCP_OOSEQ_MEM_PBUFS / 2);
+  EXPECT(pcb1->ooseq_pbufs == n1);
+  EXPECT(tcp_oos_pbuf_count(pcb1) == n1);
+  EXPECT(pcb2->ooseq_pbufs == n2 - TCP_OOSEQ_MEM_PBUFS / 2);
+  EXPECT(tcp_oos_pbuf_count(pcb2) == n2 - TCP_OOSEQ_MEM_PBUFS / 2);
+  EXPECT(pcb2->rcv_sacks[0].right == base2 + (u32_t)((n2 - TCP_OOSEQ_MEM_PBUFS / 2 + 1) * OOS_MEM_SEGLEN));
+  EXPECT(pcb1->rcv_sacks[0].right == base1 + (u32_t)((n1 + 1) * OOS_MEM_SEGLEN));
+
+  /* delivering the data gives the budget back */
+  test_tcp_oos_mem_queue(pcb2, &netif, 0, 1);
+  EXPECT(counters.recv_calls == 1);
+  EXPECT(pcb2->ooseq == NULL);
+  EXPECT(pcb2->ooseq_pbufs == 0);
+  EXPECT(lwip_stats.tcp_ooseq.used == (STAT_COUNTER)n1);
+
+  /* a segment overlapping the end of the queue: trimming and coalescing
+     keep the accounting in line with the pbufs actually queued */
+  {
+    struct pbuf *p = tcp_create_rx_segment(pcb1, &data_full_wnd[(n1 + 1) * OOS_MEM_SEGLEN - OOS_MEM_SEGLEN / 2],
+                                           OOS_MEM_SEGLEN, (u32_t)((n1 + 1) * OOS_MEM_SEGLEN - OOS_MEM_SEGLEN / 2),
+                                           0, TCP_ACK);
+    EXPECT_RET(p != NULL);
+    test_tcp_input(p, &netif);
+  }
+  EXPECT(tcp_oos_count(pcb1) == 1);
+  EXPECT(pcb1->ooseq_pbufs == tcp_oos_pbuf_count(pcb1));
+  EXPECT(lwip_stats.tcp_ooseq.used == (STAT_COUNTER)tcp_oos_pbuf_count(pcb1));
+  tcp_abort(pcb1);
+  EXPECT(lwip_stats.tcp_ooseq.used == 0);
+  tcp_abort(pcb2);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_SEG) == 0);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+#else /* OOSEQ_MEM_TEST */
+  LWIP_UNUSED_ARG(_i);
+#endif /* OOSEQ_MEM_TEST */
+}
+END_TEST
 
 /** Create the suite including all tests for this module */
 Suite *
@@ -1012,7 +1277,9 @@ tcp_oos_suite(void)
     TESTFUNC(test_tcp_recv_ooseq_double_FIN_12),
     TESTFUNC(test_tcp_recv_ooseq_double_FIN_13),
     TESTFUNC(test_tcp_recv_ooseq_double_FIN_14),
-    TESTFUNC(test_tcp_recv_ooseq_double_FIN_15)
+    TESTFUNC(test_tcp_recv_ooseq_double_FIN_15),
+    TESTFUNC(test_tcp_recv_ooseq_coalesce),
+    TESTFUNC(test_tcp_recv_ooseq_mem)
   };
   return create_suite("TCP_OOS", tests, sizeof(tests)/sizeof(testfunc), tcp_oos_setup, tcp_oos_teardown);
 }